@@ -22,6 +22,7 @@
 #include "Partition.hxx"
 #include "Idle.hxx"
 #include "Stats.hxx"
+#include "input/cache/Manager.hxx"
 
 #ifdef ENABLE_CURL
 #include "RemoteTagCache.hxx"
@@ -50,6 +51,43 @@ Instance::Instance()
 
 Instance::~Instance() noexcept = default;
 
+void
+Instance::CreateClientThreads(unsigned n)
+{
+	assert(client_threads.empty());
+
+	for (unsigned i = 0; i < n; ++i)
+		client_threads.emplace_back(false, "client");
+
+	next_client_thread = client_threads.begin();
+}
+
+void
+Instance::StartClientThreads()
+{
+	for (auto &i : client_threads)
+		i.Start();
+}
+
+void
+Instance::StopClientThreads() noexcept
+{
+	for (auto &i : client_threads)
+		i.Stop();
+}
+
+EventLoop &
+Instance::GetClientEventLoop() noexcept
+{
+	if (client_threads.empty())
+		return event_loop;
+
+	EventLoop &loop = next_client_thread->GetEventLoop();
+	if (++next_client_thread == client_threads.end())
+		next_client_thread = client_threads.begin();
+	return loop;
+}
+
 Partition *
 Instance::FindPartition(const char *name) noexcept
 {
@@ -50,6 +50,7 @@ class UpdateService;
 #include <list>
 
 class ClientList;
+class InputCacheManager;
 struct Partition;
 class StateFile;
 class RemoteTagCache;
@@ -93,6 +94,19 @@ struct Instance final
 	 */
 	EventThread rtio_thread;
 
+	/**
+	 * Worker threads serving client connections (see
+	 * "client_threads").  If this is empty, all clients are
+	 * served by the main thread's #event_loop.
+	 */
+	std::list<EventThread> client_threads;
+
+	/**
+	 * The #client_threads element which will receive the next
+	 * client connection.
+	 */
+	std::list<EventThread>::iterator next_client_thread;
+
 #ifdef ENABLE_SYSTEMD_DAEMON
 	Systemd::Watchdog systemd_watchdog;
 #endif
@@ -121,6 +135,13 @@ struct Instance final
 
 	ClientList *client_list;
 
+	/**
+	 * The global input cache (see "input_cache"); nullptr if
+	 * disabled.  It is declared before #partitions, because their
+	 * decoders use it.
+	 */
+	std::unique_ptr<InputCacheManager> input_cache;
+
 	std::list<Partition> partitions;
 
 	StateFile *state_file = nullptr;
@@ -146,6 +167,22 @@ struct Instance final
 	gcc_pure
 	Partition *FindPartition(const char *name) noexcept;
 
+	/**
+	 * Create the given number of #client_threads (without
+	 * starting them).
+	 */
+	void CreateClientThreads(unsigned n);
+
+	void StartClientThreads();
+	void StopClientThreads() noexcept;
+
+	/**
+	 * Choose the #EventLoop which shall serve the next client
+	 * connection: one of the #client_threads (round-robin) or
+	 * the main thread's #event_loop.
+	 */
+	EventLoop &GetClientEventLoop() noexcept;
+
 	void BeginShutdownPartitions() noexcept;
 	void FinishShutdownPartitions() noexcept;
 
@@ -38,6 +38,8 @@
 #include "Log.hxx"
 #include "LogInit.hxx"
 #include "input/Init.hxx"
+#include "input/cache/Config.hxx"
+#include "input/cache/Manager.hxx"
 #include "event/Loop.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Config.hxx"
@@ -120,9 +122,12 @@ static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
 
 static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * MEGABYTE;
 
-static constexpr
-size_t MIN_BUFFER_SIZE = std::max(CHUNK_SIZE * 32,
-				  64 * KILOBYTE);
+static constexpr size_t MIN_BUFFER_SIZE = 64 * KILOBYTE;
+
+/**
+ * The minimum number of chunks in the #MusicBuffer.
+ */
+static constexpr unsigned MIN_BUFFER_CHUNKS = 32;
 
 #ifdef ANDROID
 Context *context;
@@ -268,6 +273,47 @@ glue_state_file_init(const ConfigData &raw_config)
 	instance->state_file->Read();
 }
 
+/**
+ * Determine the size of each #MusicChunk.  Unless configured
+ * explicitly with "audio_chunk_size", this is derived from the
+ * "audio_output_format" setting.
+ */
+static size_t
+GetChunkSize(const ConfigData &config, const AudioFormat audio_format)
+{
+	const auto *param = config.GetParam(ConfigOption::AUDIO_CHUNK_SIZE);
+	if (param != nullptr) {
+		char *endptr;
+		unsigned long value = strtoul(param->value.c_str(), &endptr, 10);
+		if (endptr == param->value.c_str() || *endptr != 0 ||
+		    value == 0 || value > MAX_CHUNK_SIZE / KILOBYTE)
+			throw FormatRuntimeError("chunk size \"%s\" is not a "
+						 "positive integer up to %lu, line %i",
+						 param->value.c_str(),
+						 (unsigned long)(MAX_CHUNK_SIZE / KILOBYTE),
+						 param->line);
+
+		return std::max<size_t>(value * KILOBYTE, MIN_CHUNK_SIZE);
+	}
+
+	if (!audio_format.IsFullyDefined())
+		return DEFAULT_CHUNK_SIZE;
+
+	return CalculateChunkSize(audio_format);
+}
+
+static void
+InitInputCache(const ConfigData &config)
+{
+	const auto *block = config.GetBlock(ConfigBlockOption::INPUT_CACHE);
+	if (block == nullptr)
+		return;
+
+	block->SetUsed();
+	instance->input_cache =
+		std::make_unique<InputCacheManager>(InputCacheConfig(*block));
+}
+
 /**
  * Initialize the decoder and player core, including the music pipe.
  */
@@ -277,6 +323,23 @@ initialize_decoder_and_player(const ConfigData &config,
 {
 	const ConfigParam *param;
 
+	AudioFormat configured_audio_format = AudioFormat::Undefined();
+	param = config.GetParam(ConfigOption::AUDIO_OUTPUT_FORMAT);
+	if (param != nullptr) {
+		try {
+			configured_audio_format = ParseAudioFormat(param->value.c_str(),
+								   true);
+		} catch (...) {
+			std::throw_with_nested(FormatRuntimeError("error parsing line %i",
+								  param->line));
+		}
+	}
+
+	const size_t chunk_size = GetChunkSize(config,
+					       configured_audio_format);
+	const size_t min_buffer_size =
+		std::max(chunk_size * MIN_BUFFER_CHUNKS, MIN_BUFFER_SIZE);
+
 	size_t buffer_size;
 	param = config.GetParam(ConfigOption::AUDIO_BUFFER_SIZE);
 	if (param != nullptr) {
@@ -288,16 +351,16 @@ initialize_decoder_and_player(const ConfigData &config,
 						 param->value.c_str(), param->line);
 		buffer_size = tmp * KILOBYTE;
 
-		if (buffer_size < MIN_BUFFER_SIZE) {
+		if (buffer_size < min_buffer_size) {
 			FormatWarning(config_domain, "buffer size %lu is too small, using %lu bytes instead",
 				      (unsigned long)buffer_size,
-				      (unsigned long)MIN_BUFFER_SIZE);
-			buffer_size = MIN_BUFFER_SIZE;
+				      (unsigned long)min_buffer_size);
+			buffer_size = min_buffer_size;
 		}
 	} else
-		buffer_size = DEFAULT_BUFFER_SIZE;
+		buffer_size = std::max(DEFAULT_BUFFER_SIZE, min_buffer_size);
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const unsigned buffered_chunks = buffer_size / chunk_size;
 
 	if (buffered_chunks >= 1 << 15)
 		throw FormatRuntimeError("buffer size \"%lu\" is too big",
@@ -307,22 +370,13 @@ initialize_decoder_and_player(const ConfigData &config,
 		config.GetPositive(ConfigOption::MAX_PLAYLIST_LENGTH,
 				   DEFAULT_PLAYLIST_MAX_LENGTH);
 
-	AudioFormat configured_audio_format = AudioFormat::Undefined();
-	param = config.GetParam(ConfigOption::AUDIO_OUTPUT_FORMAT);
-	if (param != nullptr) {
-		try {
-			configured_audio_format = ParseAudioFormat(param->value.c_str(),
-								   true);
-		} catch (...) {
-			std::throw_with_nested(FormatRuntimeError("error parsing line %i",
-								  param->line));
-		}
-	}
-
 	instance->partitions.emplace_back(*instance,
 					  "default",
 					  max_length,
 					  buffered_chunks,
+					  chunk_size,
+					  config.GetBool(ConfigOption::AUDIO_BUFFER_LOCK_FREE,
+							 false),
 					  configured_audio_format,
 					  replay_gain_config);
 	auto &partition = instance->partitions.back();
@@ -490,7 +544,10 @@ MainOrThrow(int argc, char *argv[])
 	const unsigned max_clients =
 		raw_config.GetPositive(ConfigOption::MAX_CONN, 10);
 	instance->client_list = new ClientList(max_clients);
+	instance->CreateClientThreads(raw_config.GetUnsigned(ConfigOption::CLIENT_THREADS,
+							     0));
 
+	InitInputCache(raw_config);
 	initialize_decoder_and_player(raw_config, config.replay_gain);
 
 	listen_global_init(raw_config, *instance->partitions.front().listener);
@@ -569,6 +626,7 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 
 	instance->io_thread.Start();
 	instance->rtio_thread.Start();
+	instance->StartClientThreads();
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr)
@@ -644,6 +702,7 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 	instance->BeginShutdownPartitions();
 
 	delete instance->client_list;
+	instance->StopClientThreads();
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr) {
@@ -22,15 +22,51 @@
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size,
+			 bool lock_free)
+	:chunk_size(_chunk_size)
+{
+	assert(chunk_size > 0);
+
+	if (lock_free)
+		lock_free_buffer = std::make_unique<LockFreeSliceBuffer<MusicChunk>>(num_chunks);
+	else
+		buffer = std::make_unique<SliceBuffer<MusicChunk>>(num_chunks);
+
+	/* the slice buffer may have rounded up the number of
+	   chunks, so ask it instead of using num_chunks */
+	data = HugeArray<uint8_t>(size_t(GetSize()) * chunk_size);
+	data.ForkCow(false);
+}
+
+MusicBuffer::~MusicBuffer() noexcept = default;
+
+inline MusicChunkPtr
+MusicBuffer::Prepare(MusicChunk *chunk, unsigned i) noexcept
+{
+	if (chunk != nullptr) {
+		chunk->data = &data[size_t(i) * chunk_size];
+		chunk->capacity = chunk_size;
+	}
+
+	return MusicChunkPtr(chunk, MusicChunkDeleter(*this));
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
+	if (IsLockFree()) {
+		auto *chunk = lock_free_buffer->Allocate();
+		return Prepare(chunk, chunk != nullptr
+			       ? lock_free_buffer->IndexOf(chunk)
+			       : 0);
+	}
+
 	const std::lock_guard<Mutex> protect(mutex);
-	return MusicChunkPtr(buffer.Allocate(), MusicChunkDeleter(*this));
+	auto *chunk = buffer->Allocate();
+	return Prepare(chunk, chunk != nullptr
+		       ? buffer->IndexOf(chunk)
+		       : 0);
 }
 
 void
@@ -44,9 +80,19 @@ MusicBuffer::Return(MusicChunk *chunk) noexcept
 	chunk->next.reset();
 	chunk->other.reset();
 
-	const std::lock_guard<Mutex> protect(mutex);
-
 	assert(!chunk->other || !chunk->other->other);
 
-	buffer.Free(chunk);
+	if (IsLockFree()) {
+		lock_free_buffer->Free(chunk);
+		return;
+	}
+
+	const std::lock_guard<Mutex> protect(mutex);
+	buffer->Free(chunk);
+
+	/* give the PCM memory back to the kernel when the last
+	   chunk was freed (SliceBuffer does the same with its
+	   own memory) */
+	if (buffer->empty())
+		data.Discard();
 }
@@ -22,8 +22,14 @@
 
 #include "MusicChunkPtr.hxx"
 #include "util/SliceBuffer.hxx"
+#include "util/LockFreeSliceBuffer.hxx"
+#include "util/HugeAllocator.hxx"
 #include "thread/Mutex.hxx"
 
+#include <memory>
+
+#include <stdint.h>
+
 /**
  * An allocator for #MusicChunk objects.
  */
@@ -31,7 +37,28 @@ class MusicBuffer {
 	/** a mutex which protects #buffer */
 	mutable Mutex mutex;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The mutex-protected allocator.  This is nullptr if
+	 * #lock_free_buffer is used instead.
+	 */
+	std::unique_ptr<SliceBuffer<MusicChunk>> buffer;
+
+	/**
+	 * The lock-free allocator; #mutex is not used at all if this
+	 * is set.
+	 */
+	std::unique_ptr<LockFreeSliceBuffer<MusicChunk>> lock_free_buffer;
+
+	/**
+	 * The size of each chunk's PCM buffer.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The PCM buffers of all chunks.  The buffer of the chunk
+	 * with slice index i begins at i * #chunk_size.
+	 */
+	HugeArray<uint8_t> data;
 
 public:
 	/**
@@ -39,8 +66,18 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the size of each chunk's PCM buffer
+	 * @param lock_free use a lock-free free list instead of a
+	 * mutex-protected one
 	 */
-	explicit MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size,
+		    bool lock_free=false);
+
+	~MusicBuffer() noexcept;
+
+	bool IsLockFree() const noexcept {
+		return lock_free_buffer != nullptr;
+	}
 
 #ifndef NDEBUG
 	/**
@@ -49,13 +86,18 @@ public:
 	 * object is inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
-		return buffer.empty();
+		return IsLockFree()
+			? lock_free_buffer->empty()
+			: buffer->empty();
 	}
 #endif
 
 	bool IsFull() const noexcept {
+		if (IsLockFree())
+			return lock_free_buffer->IsFull();
+
 		const std::lock_guard<Mutex> protect(mutex);
-		return buffer.IsFull();
+		return buffer->IsFull();
 	}
 
 	/**
@@ -65,7 +107,16 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
-		return buffer.GetCapacity();
+		return IsLockFree()
+			? lock_free_buffer->GetCapacity()
+			: buffer->GetCapacity();
+	}
+
+	/**
+	 * Returns the size of each chunk's PCM buffer.
+	 */
+	size_t GetChunkSize() const noexcept {
+		return chunk_size;
 	}
 
 	/**
@@ -82,6 +133,13 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk) noexcept;
+
+private:
+	/**
+	 * Assign the PCM buffer to a newly allocated chunk and wrap
+	 * it in a #MusicChunkPtr.
+	 */
+	MusicChunkPtr Prepare(MusicChunk *chunk, unsigned i) noexcept;
 };
 
 #endif
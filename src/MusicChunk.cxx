@@ -23,6 +23,23 @@
 
 #include <assert.h>
 
+size_t
+CalculateChunkSize(const AudioFormat audio_format) noexcept
+{
+	assert(audio_format.IsValid());
+
+	static constexpr AudioFormat cd(44100, SampleFormat::S16, 2);
+	const auto chunk_duration =
+		cd.SizeToTime<std::chrono::microseconds>(DEFAULT_CHUNK_SIZE);
+	const size_t wanted = audio_format.TimeToSize(chunk_duration);
+
+	size_t chunk_size = DEFAULT_CHUNK_SIZE;
+	while (chunk_size < MAX_CHUNK_SIZE && chunk_size < wanted)
+		chunk_size *= 2;
+
+	return chunk_size;
+}
+
 MusicChunkInfo::MusicChunkInfo() noexcept = default;
 MusicChunkInfo::~MusicChunkInfo() noexcept = default;
 
@@ -56,7 +73,7 @@ MusicChunk::Write(const AudioFormat af,
 	}
 
 	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
+	size_t num_frames = (capacity - length) / frame_size;
 	return { data + length, num_frames * frame_size };
 }
 
@@ -65,10 +82,10 @@ MusicChunk::Expand(const AudioFormat af, size_t _length) noexcept
 {
 	const size_t frame_size = af.GetFrameSize();
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= capacity);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > capacity;
 }
@@ -24,6 +24,7 @@
 #include "Chrono.hxx"
 #include "ReplayGainInfo.hxx"
 #include "util/WritableBuffer.hxx"
+#include "util/Compiler.h"
 
 #ifndef NDEBUG
 #include "AudioFormat.hxx"
@@ -34,12 +35,33 @@
 #include <stdint.h>
 #include <stddef.h>
 
-static constexpr size_t CHUNK_SIZE = 4096;
+/**
+ * The default size of a #MusicChunk's data buffer.  This was the
+ * (fixed) chunk size of older MPD versions.
+ */
+static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+
+/**
+ * The limits for the "audio_chunk_size" setting.
+ */
+static constexpr size_t MIN_CHUNK_SIZE = 1024;
+static constexpr size_t MAX_CHUNK_SIZE = 256 * 1024;
 
 struct AudioFormat;
 struct Tag;
 struct MusicChunk;
 
+/**
+ * Calculate a chunk size suitable for the given audio format: each
+ * chunk holds roughly as much time as #DEFAULT_CHUNK_SIZE bytes of CD
+ * audio, which avoids flooding the pipe with tiny chunks at high
+ * sample rates.  The result is a power of two between
+ * #DEFAULT_CHUNK_SIZE and #MAX_CHUNK_SIZE.
+ */
+gcc_const
+size_t
+CalculateChunkSize(AudioFormat audio_format) noexcept;
+
 /**
  * Meta information for #MusicChunk.
  */
@@ -66,7 +88,7 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -116,8 +138,17 @@ struct MusicChunkInfo {
  * MusicPipe::Push() caller.
  */
 struct MusicChunk : MusicChunkInfo {
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE - sizeof(MusicChunkInfo)];
+	/**
+	 * The data (probably PCM).  This memory is owned by the
+	 * #MusicBuffer, which assigns it in MusicBuffer::Allocate().
+	 */
+	uint8_t *data;
+
+	/**
+	 * The size of the #data buffer.  All chunks of a
+	 * #MusicBuffer have the same capacity.
+	 */
+	size_t capacity;
 
 	/**
 	 * Prepares appending to the music chunk.  Returns a buffer
@@ -146,6 +177,4 @@ struct MusicChunk : MusicChunkInfo {
 	bool Expand(AudioFormat af, size_t length) noexcept;
 };
 
-static_assert(sizeof(MusicChunk) == CHUNK_SIZE, "Wrong size");
-
 #endif
@@ -25,6 +25,15 @@
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 {
+	if (IsLockFree()) {
+		bool found = false;
+		queue->ForEach([chunk, &found](const MusicChunkPtr &i){
+				if (i.get() == chunk)
+					found = true;
+			});
+		return found;
+	}
+
 	const std::lock_guard<Mutex> protect(mutex);
 
 	for (const MusicChunk *i = head.get(); i != nullptr; i = i->next.get())
@@ -39,6 +48,9 @@ MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 MusicChunkPtr
 MusicPipe::Shift() noexcept
 {
+	if (IsLockFree())
+		return queue->Shift();
+
 	const std::lock_guard<Mutex> protect(mutex);
 
 	auto chunk = std::move(head);
@@ -79,6 +91,14 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
+	if (IsLockFree()) {
+		gcc_unused bool success = queue->Push(std::move(chunk));
+		/* the pipe cannot be full, because it is at least as
+		   large as the MusicBuffer */
+		assert(success);
+		return;
+	}
+
 	const std::lock_guard<Mutex> protect(mutex);
 
 	assert(size > 0 || !audio_format.IsDefined());
@@ -22,6 +22,7 @@
 
 #include "MusicChunkPtr.hxx"
 #include "thread/Mutex.hxx"
+#include "util/SpscQueue.hxx"
 #include "util/Compiler.h"
 
 #ifndef NDEBUG
@@ -33,8 +34,21 @@
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * By default, the chunks are linked with #MusicChunkInfo::next and
+ * all operations are protected by a mutex; this mode is required if
+ * other threads walk the list (see #SharedPipeConsumer).  In
+ * lock-free mode, the chunks are stored in a bounded
+ * single-producer/single-consumer ring, and #MusicChunkInfo::next is
+ * not used.
  */
 class MusicPipe {
+	/**
+	 * The lock-free ring; if this is set, all other attributes
+	 * are unused.
+	 */
+	const std::unique_ptr<SpscQueue<MusicChunkPtr>> queue;
+
 	/** the first chunk */
 	MusicChunkPtr head;
 
@@ -52,10 +66,25 @@ class MusicPipe {
 #endif
 
 public:
+	MusicPipe() noexcept = default;
+
+	/**
+	 * Construct a lock-free pipe.
+	 *
+	 * @param capacity the maximum number of chunks; since all
+	 * chunks come from a #MusicBuffer, its size is a good choice
+	 */
+	explicit MusicPipe(unsigned capacity)
+		:queue(std::make_unique<SpscQueue<MusicChunkPtr>>(capacity)) {}
+
 	~MusicPipe() noexcept {
 		Clear();
 	}
 
+	bool IsLockFree() const noexcept {
+		return queue != nullptr;
+	}
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the specified
@@ -63,7 +92,7 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const noexcept {
-		return !audio_format.IsDefined() ||
+		return IsLockFree() || !audio_format.IsDefined() ||
 			audio_format == other;
 	}
 
@@ -76,10 +105,16 @@ public:
 
 	/**
 	 * Returns the first #MusicChunk from the pipe.  Returns
-	 * nullptr if the pipe is empty.
+	 * nullptr if the pipe is empty.  In lock-free mode, only the
+	 * consumer may call this.
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const noexcept {
+		if (IsLockFree()) {
+			const MusicChunkPtr *front = queue->Front();
+			return front != nullptr ? front->get() : nullptr;
+		}
+
 		const std::lock_guard<Mutex> protect(mutex);
 		return head.get();
 	}
@@ -104,6 +139,9 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
+		if (IsLockFree())
+			return queue->GetSize();
+
 		const std::lock_guard<Mutex> protect(mutex);
 		return size;
 	}
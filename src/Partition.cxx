@@ -29,6 +29,8 @@ Partition::Partition(Instance &_instance,
 		     const char *_name,
 		     unsigned max_length,
 		     unsigned buffer_chunks,
+		     size_t chunk_size,
+		     bool lock_free_buffer,
 		     AudioFormat configured_audio_format,
 		     const ReplayGainConfig &replay_gain_config)
 	:instance(_instance),
@@ -37,8 +39,9 @@ Partition::Partition(Instance &_instance,
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
 	 playlist(max_length, *this),
 	 outputs(*this),
-	 pc(*this, outputs, buffer_chunks,
-	    configured_audio_format, replay_gain_config)
+	 pc(*this, outputs, buffer_chunks, chunk_size, lock_free_buffer,
+	    configured_audio_format, replay_gain_config,
+	    instance.input_cache.get())
 {
 	UpdateEffectiveReplayGainMode();
 }
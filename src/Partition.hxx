@@ -70,6 +70,8 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 		  const char *_name,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
+		  size_t chunk_size,
+		  bool lock_free_buffer,
 		  AudioFormat configured_audio_format,
 		  const ReplayGainConfig &replay_gain_config);
 
@@ -90,6 +92,11 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 		return playlist.AppendURI(pc, loader, uri_utf8);
 	}
 
+	void AppendURIs(const SongLoader &loader,
+			ConstBuffer<const char *> uris) {
+		playlist.AppendURIs(pc, loader, uris);
+	}
+
 	void DeletePosition(unsigned position) {
 		playlist.DeletePosition(pc, position);
 	}
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "PlaylistFile.hxx"
+#include "PlaylistFileIndex.hxx"
 #include "PlaylistSave.hxx"
 #include "PlaylistError.hxx"
 #include "db/PlaylistInfo.hxx"
@@ -39,15 +40,19 @@
 #include "fs/FileSystem.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "system/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
 #include "util/Macros.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriUtil.hxx"
 
+#include <list>
 #include <memory>
 
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 
 static const char PLAYLIST_COMMENT = '#';
 
@@ -174,23 +179,173 @@ ListPlaylistFiles()
 	return list;
 }
 
+/**
+ * The index of a stored playlist file, see #PlaylistFileIndex.
+ */
+struct CachedPlaylistIndex {
+	std::string name;
+
+	/**
+	 * The modification time of the file when the index was last
+	 * updated; used (together with the file size) to detect
+	 * modifications by others.
+	 */
+	std::chrono::system_clock::time_point mtime;
+
+#ifndef _WIN32
+	ino_t inode;
+#endif
+
+	PlaylistFileIndex index;
+
+	explicit CachedPlaylistIndex(const char *_name):name(_name) {}
+
+	gcc_pure
+	bool IsValid(const FileInfo &fi) const noexcept {
+		return fi.GetSize() == index.GetFileSize() &&
+			fi.GetModificationTime() == mtime
+#ifndef _WIN32
+			&& fi.GetInode() == inode
+#endif
+			;
+	}
+
+	void UpdateStamp(Path path_fs) {
+		FileInfo fi(path_fs);
+		mtime = fi.GetModificationTime();
+#ifndef _WIN32
+		inode = fi.GetInode();
+#endif
+	}
+
+	void Load(Path path_fs, FileDescriptor fd) {
+		index.Load(fd, playlist_max_length);
+		UpdateStamp(path_fs);
+	}
+};
+
+/**
+ * The most recently used playlist indexes (most recent first).
+ * Only accessed by the main thread.
+ */
+static std::list<CachedPlaylistIndex> playlist_index_cache;
+
+static constexpr size_t PLAYLIST_INDEX_CACHE_SIZE = 8;
+
 static void
-SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
+InvalidatePlaylistIndex(const char *utf8path) noexcept
 {
-	assert(utf8path != nullptr);
+	playlist_index_cache.remove_if([utf8path](const CachedPlaylistIndex &i){
+			return i.name == utf8path;
+		});
+}
 
+/**
+ * Look up the index of the specified playlist file in the cache.
+ * Returns nullptr (and removes the cache item) if it is not cached or
+ * if the file has been modified since.
+ */
+static CachedPlaylistIndex *
+FindPlaylistIndex(const char *utf8path, Path path_fs) noexcept
+{
+	for (auto i = playlist_index_cache.begin();
+	     i != playlist_index_cache.end(); ++i) {
+		if (i->name != utf8path)
+			continue;
+
+		FileInfo fi;
+		if (!GetFileInfo(path_fs, fi) || !i->IsValid(fi)) {
+			playlist_index_cache.erase(i);
+			return nullptr;
+		}
+
+		playlist_index_cache.splice(playlist_index_cache.begin(),
+					    playlist_index_cache, i);
+		return &playlist_index_cache.front();
+	}
+
+	return nullptr;
+}
+
+static CachedPlaylistIndex &
+MakePlaylistIndex(const char *utf8path, Path path_fs, FileDescriptor fd)
+{
+	auto *cached = FindPlaylistIndex(utf8path, path_fs);
+	if (cached != nullptr)
+		return *cached;
+
+	if (playlist_index_cache.size() >= PLAYLIST_INDEX_CACHE_SIZE)
+		playlist_index_cache.pop_back();
+
+	playlist_index_cache.emplace_front(utf8path);
+	auto &i = playlist_index_cache.front();
+
+	try {
+		i.Load(path_fs, fd);
+	} catch (...) {
+		playlist_index_cache.pop_front();
+		throw;
+	}
+
+	return i;
+}
+
+static UniqueFileDescriptor
+OpenPlaylistFile(Path path_fs, int flags)
+{
+#ifdef _WIN32
+	/* the index contains byte offsets; disable newline
+	   translation */
+	flags |= O_BINARY;
+#endif
+
+	UniqueFileDescriptor fd;
+	if (!fd.Open(path_fs.c_str(), flags)) {
+		if (errno == ENOENT)
+			throw PlaylistError::NoSuchList();
+
+		throw FormatErrno("Failed to open %s",
+				  path_fs.ToUTF8().c_str());
+	}
+
+	return fd;
+}
+
+/**
+ * Open the playlist file, obtain its index and invoke the given
+ * function.  If the index turns out to be stale, it is rebuilt and
+ * the function is invoked again.
+ *
+ * @param write open the file for writing?
+ */
+template<typename F>
+static void
+WithPlaylistIndex(const char *utf8path, bool write, F &&f)
+{
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
-	FileOutputStream fos(path_fs);
-	BufferedOutputStream bos(fos);
+	auto fd = OpenPlaylistFile(path_fs, write ? O_RDWR : O_RDONLY);
+	auto &cached = MakePlaylistIndex(utf8path, path_fs, fd);
 
-	for (const auto &uri_utf8 : contents)
-		playlist_print_uri(bos, uri_utf8.c_str());
-
-	bos.Flush();
+	try {
+		try {
+			f(cached.index, FileDescriptor(fd));
+		} catch (const PlaylistFileIndex::Stale &) {
+			cached.Load(path_fs, fd);
+			f(cached.index, FileDescriptor(fd));
+		}
 
-	fos.Commit();
+		if (write)
+			cached.UpdateStamp(path_fs);
+	} catch (const PlaylistError &) {
+		/* thrown by the function before touching the file
+		   (e.g. "Bad range"); the index is still valid */
+		throw;
+	} catch (...) {
+		InvalidatePlaylistIndex(utf8path);
+		throw;
+	}
 }
 
 PlaylistFileContents
@@ -253,6 +408,55 @@ try {
 	throw;
 }
 
+bool
+ReadPlaylistFileRange(const char *utf8path, unsigned start, unsigned end,
+		      std::string &dest)
+{
+	bool complete = true;
+
+	WithPlaylistIndex(utf8path, false,
+			  [&](const PlaylistFileIndex &index,
+			      FileDescriptor fd){
+				  if (end > index.GetCount() &&
+				      !index.IsComplete()) {
+					  /* the index ends at
+					     playlist_max_length */
+					  complete = false;
+					  return;
+				  }
+
+				  dest = index.Read(fd, start, end);
+			  });
+
+	return complete;
+}
+
+/**
+ * Moves which would rewrite more than this number of bytes in place
+ * replace the file instead.  Editing the file in place is not
+ * atomic: if MPD crashes in the middle of a large write, songs may be
+ * duplicated or lost.  Writes of up to one page are (almost always)
+ * atomic in practice.
+ */
+static constexpr uint64_t MAX_IN_PLACE_MOVE = 4096;
+
+/**
+ * Replace the playlist file with a copy without tombstones, see
+ * PlaylistFileIndex::Copy().  The index must be invalidated
+ * afterwards.
+ */
+static void
+RewritePlaylistFile(const char *utf8path, PlaylistFileIndex &index,
+		    FileDescriptor fd, unsigned from, unsigned to)
+{
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
+
+	FileOutputStream fos(path_fs);
+	index.Copy(fd, fos, from, to);
+	fos.Commit();
+}
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 {
@@ -261,19 +465,26 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 		   what the hell.. */
 		return;
 
-	auto contents = LoadPlaylistFile(utf8path);
-
-	if (src >= contents.size() || dest >= contents.size())
-		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
+	bool rewritten = false;
 
-	const auto src_i = std::next(contents.begin(), src);
-	auto value = std::move(*src_i);
-	contents.erase(src_i);
+	WithPlaylistIndex(utf8path, true,
+			  [utf8path, src, dest, &rewritten](PlaylistFileIndex &index,
+							    FileDescriptor fd){
+				  if (src >= index.GetCount() ||
+				      dest >= index.GetCount())
+					  throw PlaylistError(PlaylistResult::BAD_RANGE,
+							      "Bad range");
 
-	const auto dest_i = std::next(contents.begin(), dest);
-	contents.insert(dest_i, std::move(value));
+				  if (index.GetMoveSize(src, dest) > MAX_IN_PLACE_MOVE) {
+					  RewritePlaylistFile(utf8path, index, fd,
+							      src, dest);
+					  rewritten = true;
+				  } else
+					  index.Move(fd, src, dest);
+			  });
 
-	SavePlaylistFile(contents, utf8path);
+	if (rewritten)
+		InvalidatePlaylistIndex(utf8path);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 }
@@ -284,6 +495,8 @@ spl_clear(const char *utf8path)
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	InvalidatePlaylistIndex(utf8path);
+
 	try {
 		TruncateFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -303,6 +516,8 @@ spl_delete(const char *name_utf8)
 	const auto path_fs = spl_map_to_fs(name_utf8);
 	assert(!path_fs.IsNull());
 
+	InvalidatePlaylistIndex(name_utf8);
+
 	try {
 		RemoveFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -319,14 +534,28 @@ spl_delete(const char *name_utf8)
 void
 spl_remove_index(const char *utf8path, unsigned pos)
 {
-	auto contents = LoadPlaylistFile(utf8path);
+	bool compacted = false;
+
+	WithPlaylistIndex(utf8path, true,
+			  [utf8path, pos, &compacted](PlaylistFileIndex &index,
+						      FileDescriptor fd){
+				  if (pos >= index.GetCount())
+					  throw PlaylistError(PlaylistResult::BAD_RANGE,
+							      "Bad range");
 
-	if (pos >= contents.size())
-		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
+				  index.Remove(fd, pos);
 
-	contents.erase(std::next(contents.begin(), pos));
+				  if (index.NeedsCompaction()) {
+					  /* get rid of the tombstones */
+					  RewritePlaylistFile(utf8path, index, fd,
+							      0, 0);
+					  compacted = true;
+				  }
+			  });
+
+	if (compacted)
+		InvalidatePlaylistIndex(utf8path);
 
-	SavePlaylistFile(contents, utf8path);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -336,19 +565,44 @@ try {
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	auto *cached = FindPlaylistIndex(utf8path, path_fs);
+
 	FileOutputStream fos(path_fs, FileOutputStream::Mode::APPEND_OR_CREATE);
 
-	if (fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length)
+	const uint64_t offset = fos.Tell();
+	if (cached != nullptr && offset != cached->index.GetFileSize()) {
+		InvalidatePlaylistIndex(utf8path);
+		cached = nullptr;
+	}
+
+	if (cached != nullptr
+	    ? cached->index.GetCount() >= playlist_max_length
+	    : offset / (MPD_PATH_MAX + 1) >= playlist_max_length)
 		throw PlaylistError(PlaylistResult::TOO_LARGE,
 				    "Stored playlist is too large");
 
 	BufferedOutputStream bos(fos);
 
+	if (cached != nullptr && !cached->index.IsTerminated())
+		/* don't merge the new song into the last line */
+		bos.Write('\n');
+
 	playlist_print_song(bos, song);
 
 	bos.Flush();
+	const uint64_t new_size = fos.Tell();
 	fos.Commit();
 
+	if (cached != nullptr) {
+		/* keep the index up to date */
+		try {
+			cached->index.Appended(new_size);
+			cached->UpdateStamp(path_fs);
+		} catch (...) {
+			InvalidatePlaylistIndex(utf8path);
+		}
+	}
+
 	idle_add(IDLE_STORED_PLAYLIST);
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
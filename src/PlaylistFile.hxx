@@ -58,6 +58,24 @@ ListPlaylistFiles();
 PlaylistFileContents
 LoadPlaylistFile(const char *utf8path);
 
+/**
+ * Read a range of entries from a stored playlist file, together with
+ * their comment lines (e.g. "#EXTINF") and the "#EXTM3U" header.
+ * This uses an index of the file (built on first access) and reads
+ * only the requested entries.  The result can be parsed by the
+ * playlist plugins just like the whole file.  The range is clipped
+ * to the playlist length.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @return false if the range extends beyond the part of the file
+ * which is indexed (see #playlist_max_length); the caller must parse
+ * the whole file then
+ */
+bool
+ReadPlaylistFileRange(const char *utf8path, unsigned start, unsigned end,
+		      std::string &dest);
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest);
 
@@ -0,0 +1,491 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PlaylistFileIndex.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "system/FileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/CharUtil.hxx"
+
+#include <algorithm>
+#include <memory>
+
+#include <assert.h>
+#include <string.h>
+
+static void
+ReadAt(FileDescriptor fd, uint64_t offset, char *buffer, size_t size)
+{
+	if (fd.Seek(offset) < 0)
+		throw MakeErrno("Failed to seek");
+
+	while (size > 0) {
+		ssize_t nbytes = fd.Read(buffer, size);
+		if (nbytes < 0)
+			throw MakeErrno("Failed to read");
+
+		if (nbytes == 0)
+			/* the file is shorter than we expected */
+			throw PlaylistFileIndex::Stale();
+
+		buffer += nbytes;
+		size -= nbytes;
+	}
+}
+
+static void
+WriteAt(FileDescriptor fd, uint64_t offset, const char *data, size_t size)
+{
+	if (fd.Seek(offset) < 0)
+		throw MakeErrno("Failed to seek");
+
+	while (size > 0) {
+		ssize_t nbytes = fd.Write(data, size);
+		if (nbytes <= 0)
+			throw MakeErrno("Failed to write");
+
+		data += nbytes;
+		size -= nbytes;
+	}
+}
+
+/**
+ * Is this a line (without the newline character) which the m3u
+ * playlist plugins see as a song?
+ */
+gcc_pure
+static bool
+IsEntryLine(const char *p, const char *end) noexcept
+{
+	while (p != end && IsWhitespaceOrNull(*p))
+		++p;
+
+	return p != end && *p != '#';
+}
+
+/**
+ * Is this line (without the newline character) a tombstone?
+ */
+gcc_pure
+static bool
+IsTombstone(const char *p, const char *end) noexcept
+{
+	if (end != p && end[-1] == '\r')
+		--end;
+
+	return p != end &&
+		std::all_of(p, end, [](char ch){ return ch == '#'; });
+}
+
+/**
+ * Is this line the header which makes the extm3u playlist plugin
+ * parse the file?
+ */
+gcc_pure
+static bool
+IsExtM3uHeader(const char *p, const char *end) noexcept
+{
+	while (end != p && IsWhitespaceOrNull(end[-1]))
+		--end;
+
+	return size_t(end - p) == 7 && memcmp(p, "#EXTM3U", 7) == 0;
+}
+
+/**
+ * Append the lines of the given buffer to a string, omitting
+ * tombstones.
+ */
+static void
+AppendWithoutTombstones(std::string &dest, const char *p, const char *end)
+{
+	while (p != end) {
+		const char *newline = (const char *)memchr(p, '\n', end - p);
+		const char *next = newline != nullptr ? newline + 1 : end;
+
+		if (!IsTombstone(p, newline != nullptr ? newline : end))
+			dest.append(p, next);
+
+		p = next;
+	}
+}
+
+void
+PlaylistFileIndex::Load(FileDescriptor fd, unsigned max_length)
+{
+	entries.clear();
+	header = tail = garbage = 0;
+	complete = true;
+
+	if (fd.Seek(0) < 0)
+		throw MakeErrno("Failed to seek");
+
+	/* the current line and its offset */
+	std::string line;
+	uint64_t line_offset = 0;
+
+	const auto handle_line = [&](uint64_t line_end, bool newline){
+		const char *p = line.data(), *end = p + line.length();
+
+		if (line_offset == 0 && IsExtM3uHeader(p, end)) {
+			/* the header stays where it is; it does not
+			   belong to the first entry */
+			header = tail = line_end;
+			return;
+		}
+
+		if (!IsEntryLine(p, end)) {
+			/* a comment which belongs to the next entry */
+			if (newline && IsTombstone(p, end))
+				garbage += line_end - line_offset;
+			return;
+		}
+
+		if (entries.size() >= max_length) {
+			complete = false;
+			return;
+		}
+
+		entries.push_back({tail, line_offset, line_end});
+		tail = line_end;
+	};
+
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+	std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+	uint64_t position = 0;
+
+	while (true) {
+		ssize_t nbytes = fd.Read(buffer.get(), BUFFER_SIZE);
+		if (nbytes < 0)
+			throw MakeErrno("Failed to read");
+
+		if (nbytes == 0)
+			break;
+
+		const char *p = buffer.get(), *const end = p + nbytes;
+		while (p < end) {
+			const char *newline = (const char *)
+				memchr(p, '\n', end - p);
+			if (newline == nullptr) {
+				line.append(p, end);
+				break;
+			}
+
+			line.append(p, newline);
+			p = newline + 1;
+
+			const uint64_t line_end =
+				position + (p - buffer.get());
+			handle_line(line_end, true);
+			line.clear();
+
+			line_offset = line_end;
+		}
+
+		position += nbytes;
+	}
+
+	size = position;
+
+	/* the last line may not be terminated */
+	terminated = line.empty();
+	if (!terminated)
+		handle_line(size, false);
+}
+
+void
+PlaylistFileIndex::CheckEntry(const char *buffer, uint64_t buffer_offset,
+			      uint64_t buffer_size, unsigned i) const
+{
+	const Entry &e = entries[i];
+	assert(e.start == 0 || e.start > buffer_offset);
+	assert(e.start >= buffer_offset);
+	assert(e.end <= buffer_offset + buffer_size);
+	(void)buffer_size;
+
+	const auto at = [buffer, buffer_offset](uint64_t offset){
+		return buffer + (offset - buffer_offset);
+	};
+
+	if (e.start > 0 && at(e.start)[-1] != '\n')
+		throw Stale();
+
+	if (e.offset > e.start && at(e.offset)[-1] != '\n')
+		throw Stale();
+
+	const char *line = at(e.offset), *line_end = at(e.end);
+	if (line_end > line && line_end[-1] == '\n')
+		--line_end;
+	else if (e.end != size || terminated)
+		/* only the last line may lack the newline */
+		throw Stale();
+
+	if (memchr(line, '\n', line_end - line) != nullptr ||
+	    !IsEntryLine(line, line_end))
+		throw Stale();
+}
+
+std::string
+PlaylistFileIndex::Read(FileDescriptor fd, unsigned start, unsigned end) const
+{
+	std::string result;
+
+	end = std::min<unsigned>(end, entries.size());
+	if (start >= end)
+		return result;
+
+	if (header > 0) {
+		result.resize(header);
+		ReadAt(fd, 0, &result.front(), header);
+
+		if (!IsExtM3uHeader(result.data(),
+				    result.data() + result.length()))
+			throw Stale();
+	}
+
+	/* include the byte before the first entry, to verify that it
+	   is really the beginning of a line */
+	const uint64_t region_start = entries[start].start > 0
+		? entries[start].start - 1
+		: 0;
+	const uint64_t region_end = entries[end - 1].end;
+	const size_t region_size = region_end - region_start;
+
+	std::unique_ptr<char[]> buffer(new char[region_size]);
+	ReadAt(fd, region_start, buffer.get(), region_size);
+
+	for (unsigned i = start; i < end; ++i)
+		CheckEntry(buffer.get(), region_start, region_size, i);
+
+	const size_t skip = entries[start].start - region_start;
+	result.append(buffer.get() + skip, region_size - skip);
+	return result;
+}
+
+void
+PlaylistFileIndex::NewlineAppended() noexcept
+{
+	assert(!terminated);
+
+	/* the last line (the header, an entry or a comment) ends
+	   after the new newline character */
+	if (header == size)
+		++header;
+
+	if (tail == size)
+		++tail;
+
+	if (!entries.empty() && entries.back().end == size)
+		++entries.back().end;
+
+	++size;
+	terminated = true;
+}
+
+void
+PlaylistFileIndex::Terminate(FileDescriptor fd)
+{
+	if (terminated)
+		return;
+
+	WriteAt(fd, size, "\n", 1);
+	NewlineAppended();
+}
+
+void
+PlaylistFileIndex::Remove(FileDescriptor fd, unsigned i)
+{
+	assert(i < entries.size());
+
+	Terminate(fd);
+
+	const Entry e = entries[i];
+	const uint64_t region_start = e.start > 0 ? e.start - 1 : 0;
+	const size_t region_size = e.end - region_start;
+
+	std::unique_ptr<char[]> buffer(new char[region_size]);
+	ReadAt(fd, region_start, buffer.get(), region_size);
+
+	CheckEntry(buffer.get(), region_start, region_size, i);
+
+	/* overwrite everything but the newlines with '#', including
+	   the entry's comment lines (e.g. "#EXTINF"), which would
+	   otherwise be attributed to the next entry */
+	char *const block = buffer.get() + (e.start - region_start);
+	char *p = block, *const end = buffer.get() + region_size;
+	while (p != end) {
+		char *newline = (char *)memchr(p, '\n', end - p);
+		assert(newline != nullptr);
+
+		if (newline > p && !IsTombstone(p, newline)) {
+			std::fill(p, newline, '#');
+			garbage += newline + 1 - p;
+		}
+
+		p = newline + 1;
+	}
+
+	WriteAt(fd, e.start, block, end - block);
+
+	/* the tombstones are now comment lines of the next entry */
+	entries.erase(std::next(entries.begin(), i));
+	if (i < entries.size())
+		entries[i].start = e.start;
+	else
+		tail = e.start;
+}
+
+uint64_t
+PlaylistFileIndex::GetMoveSize(unsigned from, unsigned to) const noexcept
+{
+	assert(from < entries.size());
+	assert(to < entries.size());
+
+	const unsigned lo = std::min(from, to), hi = std::max(from, to);
+	return entries[hi].end - entries[lo].start;
+}
+
+std::string
+PlaylistFileIndex::Rotate(const char *span, unsigned from, unsigned to) const
+{
+	assert(terminated);
+
+	const unsigned lo = std::min(from, to), hi = std::max(from, to);
+	const uint64_t base = entries[lo].start;
+	const size_t span_size = entries[hi].end - base;
+
+	/* the entries are contiguous (each one begins where the
+	   previous one ends), so moving one entry means rotating the
+	   span by its size */
+	const size_t split = from < to
+		? entries[from].end - base
+		: entries[from].start - base;
+
+	std::string rotated;
+	rotated.reserve(span_size);
+	rotated.append(span + split, span_size - split);
+	rotated.append(span, split);
+	return rotated;
+}
+
+void
+PlaylistFileIndex::Move(FileDescriptor fd, unsigned from, unsigned to)
+{
+	assert(from < entries.size());
+	assert(to < entries.size());
+
+	if (from == to)
+		return;
+
+	Terminate(fd);
+
+	const unsigned lo = std::min(from, to), hi = std::max(from, to);
+
+	/* read all entries from "lo" to "hi"; the size of the file
+	   does not change */
+	const uint64_t base = entries[lo].start;
+	const uint64_t region_start = base > 0 ? base - 1 : 0;
+	const uint64_t region_end = entries[hi].end;
+	const size_t region_size = region_end - region_start;
+
+	std::unique_ptr<char[]> buffer(new char[region_size]);
+	ReadAt(fd, region_start, buffer.get(), region_size);
+
+	for (unsigned i = lo; i <= hi; ++i)
+		CheckEntry(buffer.get(), region_start, region_size, i);
+
+	const auto rotated = Rotate(buffer.get() + (base - region_start),
+				    from, to);
+	WriteAt(fd, base, rotated.data(), rotated.length());
+
+	Entry moved = entries[from];
+	const int64_t length = moved.end - moved.start;
+
+	if (from < to) {
+		moved.Shift(region_end - length - base);
+
+		for (unsigned i = from; i < to; ++i) {
+			entries[i] = entries[i + 1];
+			entries[i].Shift(-length);
+		}
+	} else {
+		moved.Shift(-int64_t(moved.start - base));
+
+		for (unsigned i = from; i > to; --i) {
+			entries[i] = entries[i - 1];
+			entries[i].Shift(length);
+		}
+	}
+
+	entries[to] = moved;
+}
+
+void
+PlaylistFileIndex::Copy(FileDescriptor fd, OutputStream &os,
+			unsigned from, unsigned to)
+{
+	assert(from == to || from < entries.size());
+	assert(from == to || to < entries.size());
+
+	Terminate(fd);
+
+	std::unique_ptr<char[]> buffer(new char[size]);
+	ReadAt(fd, 0, buffer.get(), size);
+
+	const char *const b = buffer.get();
+	for (unsigned i = 0; i < entries.size(); ++i)
+		CheckEntry(b, 0, size, i);
+
+	std::string result;
+	result.reserve(size - garbage);
+
+	if (from != to) {
+		const unsigned lo = std::min(from, to), hi = std::max(from, to);
+		const uint64_t base = entries[lo].start;
+		const uint64_t span_end = entries[hi].end;
+
+		AppendWithoutTombstones(result, b, b + base);
+
+		const auto rotated = Rotate(b + base, from, to);
+		AppendWithoutTombstones(result, rotated.data(),
+					rotated.data() + rotated.length());
+
+		AppendWithoutTombstones(result, b + span_end, b + size);
+	} else
+		AppendWithoutTombstones(result, b, b + size);
+
+	os.Write(result.data(), result.length());
+}
+
+void
+PlaylistFileIndex::Appended(uint64_t new_size) noexcept
+{
+	if (!terminated)
+		NewlineAppended();
+
+	assert(new_size >= size);
+
+	if (new_size > size) {
+		/* the comment lines after the last entry belong to
+		   the new one */
+		entries.push_back({tail, size, new_size});
+		tail = new_size;
+	}
+
+	size = new_size;
+}
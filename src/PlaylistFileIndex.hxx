@@ -0,0 +1,253 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PLAYLIST_FILE_INDEX_HXX
+#define MPD_PLAYLIST_FILE_INDEX_HXX
+
+#include "util/Compiler.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class FileDescriptor;
+class OutputStream;
+
+/**
+ * An index of the entries of a stored playlist file (m3u).  It
+ * remembers the byte offset of each entry line, which allows reading
+ * a range of entries without parsing the whole file, and editing the
+ * file in place:
+ *
+ * - removed entries are overwritten with a "tombstone" (a comment
+ *   line consisting only of '#' characters, which is ignored by all
+ *   m3u parsers)
+ *
+ * - moving an entry rewrites only the lines between the old and the
+ *   new position
+ *
+ * - new entries are appended to the end of the file
+ *
+ * An entry line is a line which is not empty and does not begin with
+ * '#' (ignoring whitespace), just like the m3u playlist plugins see
+ * it.  The comment lines preceding an entry line (e.g. "#EXTINF")
+ * belong to the entry; they are moved and removed together with it.
+ * Only the "#EXTM3U" header line stays where it is.
+ *
+ * The file remains a plain m3u file all the time.  All methods which
+ * access the file throw on I/O error, and throw
+ * #PlaylistFileIndex::Stale if the file does not match the index
+ * (e.g. because it was modified by somebody else).
+ */
+class PlaylistFileIndex {
+	struct Entry {
+		/**
+		 * The offset of the first comment line belonging to
+		 * this entry, or #offset if there is none.
+		 */
+		uint64_t start;
+
+		/**
+		 * The offset of the entry line.
+		 */
+		uint64_t offset;
+
+		/**
+		 * The offset after the newline character of the
+		 * entry line.
+		 */
+		uint64_t end;
+
+		void Shift(int64_t delta) noexcept {
+			start += delta;
+			offset += delta;
+			end += delta;
+		}
+	};
+
+	std::vector<Entry> entries;
+
+	/**
+	 * The size of the file in bytes.
+	 */
+	uint64_t size = 0;
+
+	/**
+	 * The size of the "#EXTM3U" header line (including the
+	 * newline character), or 0 if there is none.
+	 */
+	uint64_t header = 0;
+
+	/**
+	 * The offset of the comment lines after the last entry; they
+	 * will belong to the next appended entry.
+	 */
+	uint64_t tail = 0;
+
+	/**
+	 * The number of bytes occupied by tombstones.
+	 */
+	uint64_t garbage = 0;
+
+	/**
+	 * Is the file empty or does it end with a newline?
+	 */
+	bool terminated = true;
+
+	/**
+	 * Have all entries of the file been indexed, or was the
+	 * maximum length reached?
+	 */
+	bool complete = true;
+
+public:
+	/**
+	 * Thrown if the file does not match the index.
+	 */
+	struct Stale : std::runtime_error {
+		Stale():std::runtime_error("Playlist file has been modified") {}
+	};
+
+	/**
+	 * Scan the whole file and build the index.
+	 *
+	 * @param max_length the maximum number of entries; all lines
+	 * after that are ignored
+	 */
+	void Load(FileDescriptor fd, unsigned max_length);
+
+	gcc_pure
+	unsigned GetCount() const noexcept {
+		return entries.size();
+	}
+
+	/**
+	 * Have all entries of the file been indexed?  If not, the
+	 * file has more entries than the "max_length" parameter
+	 * passed to Load().
+	 */
+	gcc_pure
+	bool IsComplete() const noexcept {
+		return complete;
+	}
+
+	gcc_pure
+	uint64_t GetFileSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Should the file be rewritten because tombstones occupy
+	 * more than half of it?
+	 */
+	gcc_pure
+	bool NeedsCompaction() const noexcept {
+		return garbage >= 4096 && garbage * 2 > size;
+	}
+
+	/**
+	 * Read the entries in the range [start, end) together with
+	 * their comment lines, preceded by the "#EXTM3U" header line
+	 * (if any).  The result can be parsed by a playlist plugin
+	 * just like the whole file.  The range is clipped to the
+	 * number of entries.
+	 */
+	std::string Read(FileDescriptor fd, unsigned start,
+			 unsigned end) const;
+
+	/**
+	 * Remove the specified entry by overwriting it (and its
+	 * comment lines) with tombstones.
+	 */
+	void Remove(FileDescriptor fd, unsigned i);
+
+	/**
+	 * Determine the number of bytes which Move() would rewrite.
+	 */
+	gcc_pure
+	uint64_t GetMoveSize(unsigned from, unsigned to) const noexcept;
+
+	/**
+	 * Move an entry to a new position, shifting all entries in
+	 * between by one.
+	 */
+	void Move(FileDescriptor fd, unsigned from, unsigned to);
+
+	/**
+	 * Write a copy of the file without the tombstones to the
+	 * given stream, with the entry at position "from" moved to
+	 * position "to" (pass the same value twice to move nothing).
+	 * This is used to rewrite the file instead of editing it in
+	 * place; the index must be loaded again from the new file.
+	 */
+	void Copy(FileDescriptor fd, OutputStream &os,
+		  unsigned from, unsigned to);
+
+	/**
+	 * Does the file end with a newline (or is it empty)?  If not,
+	 * a newline must be written before appending a new line.
+	 */
+	gcc_pure
+	bool IsTerminated() const noexcept {
+		return terminated;
+	}
+
+	/**
+	 * Update the index after one entry line has been appended to
+	 * the file (preceded by a newline if the file was not
+	 * terminated).
+	 *
+	 * @param new_size the new size of the file; if it has not
+	 * grown by more than the newline, no entry was appended
+	 */
+	void Appended(uint64_t new_size) noexcept;
+
+private:
+	/**
+	 * Update the index after a newline character has been
+	 * appended to a file which was not terminated.
+	 */
+	void NewlineAppended() noexcept;
+
+	void Terminate(FileDescriptor fd);
+
+	/**
+	 * Verify the line boundaries of the specified entry within a
+	 * buffer read from the file, which must contain the byte
+	 * before the entry's start (if any) and its end.
+	 */
+	void CheckEntry(const char *buffer, uint64_t buffer_offset,
+			uint64_t buffer_size, unsigned i) const;
+
+	/**
+	 * Rotate the bytes of the entries between "from" and "to"
+	 * as specified by Move(), without modifying the index.  The
+	 * file must be terminated.
+	 *
+	 * @param span the file contents from the start of the lower
+	 * entry to the end of the higher entry
+	 * @return the rotated contents
+	 */
+	std::string Rotate(const char *span,
+			   unsigned from, unsigned to) const;
+};
+
+#endif
@@ -21,9 +21,11 @@
 #include "LocateUri.hxx"
 #include "client/Client.hxx"
 #include "db/DatabaseSong.hxx"
+#include "db/Interface.hxx"
 #include "storage/StorageInterface.hxx"
 #include "song/DetachedSong.hxx"
 #include "PlaylistError.hxx"
+#include "util/ConstBuffer.hxx"
 #include "config.h"
 
 #include <assert.h>
@@ -101,3 +103,54 @@ SongLoader::LoadSong(const char *uri_utf8) const
 					   );
 	return LoadSong(located_uri);
 }
+
+std::vector<DetachedSong>
+SongLoader::LoadSongs(ConstBuffer<const char *> uris) const
+{
+	std::vector<DetachedSong> result;
+	result.reserve(uris.size);
+
+#ifdef ENABLE_DATABASE
+	/* a run of database URIs which have not been looked up
+	   yet */
+	std::vector<const char *> batch;
+
+	const auto flush = [this, &batch, &result](){
+		if (batch.empty())
+			return;
+
+		db->VisitSongs({batch.data(), batch.size()},
+			       [this, &result](const LightSong &song){
+				       result.emplace_back(DatabaseDetachSong(storage,
+									      song));
+			       });
+		batch.clear();
+	};
+#endif
+
+	for (const char *uri : uris) {
+		const auto located_uri = LocateUri(uri, client
+#ifdef ENABLE_DATABASE
+						   , storage
+#endif
+						   );
+
+#ifdef ENABLE_DATABASE
+		if (located_uri.type == LocatedUri::Type::RELATIVE &&
+		    db != nullptr) {
+			batch.push_back(located_uri.canonical_uri);
+			continue;
+		}
+
+		flush();
+#endif
+
+		result.emplace_back(LoadSong(located_uri));
+	}
+
+#ifdef ENABLE_DATABASE
+	flush();
+#endif
+
+	return result;
+}
@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include <cstddef>
+#include <vector>
 
 class Client;
 class Database;
@@ -31,6 +32,7 @@ class Storage;
 class DetachedSong;
 class Path;
 struct LocatedUri;
+template<typename T> struct ConstBuffer;
 
 /**
  * A utility class that loads a #DetachedSong object by its URI.  If
@@ -75,6 +77,15 @@ public:
 	gcc_nonnull_all
 	DetachedSong LoadSong(const char *uri_utf8) const;
 
+	/**
+	 * Load several songs at once.  Consecutive database songs are
+	 * looked up with one Database::VisitSongs() call.
+	 *
+	 * Throws #std::runtime_error on error; in that case, no song
+	 * is returned.
+	 */
+	std::vector<DetachedSong> LoadSongs(ConstBuffer<const char *> uris) const;
+
 private:
 	gcc_nonnull_all
 	DetachedSong LoadFromDatabase(const char *uri) const;
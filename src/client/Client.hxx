@@ -22,18 +22,23 @@
 
 #include "ClientMessage.hxx"
 #include "command/CommandListBuilder.hxx"
+#include "command/CommandResult.hxx"
 #include "tag/Mask.hxx"
 #include "event/FullyBufferedSocket.hxx"
-#include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Compiler.h"
 
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
+#include <atomic>
 #include <set>
 #include <string>
 #include <list>
 
+#include <stdarg.h>
 #include <stddef.h>
 
 struct ConfigData;
@@ -51,10 +56,104 @@ class Storage;
 class Client final
 	: FullyBufferedSocket,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
-	TimerEvent timeout_event;
+	CoarseTimerEvent timeout_event;
 
 	Partition *partition;
 
+	/**
+	 * Is this client served by one of the "client_threads"?
+	 * Then its socket is owned by that worker thread, and all
+	 * commands except for a few read-only database queries are
+	 * passed to the main thread; the fields below implement
+	 * this hand-over.
+	 */
+	const bool threaded;
+
+	/**
+	 * Only used if #threaded: set (by the worker thread) when the
+	 * client has expired, because the main thread may not
+	 * inspect the socket.
+	 */
+	std::atomic_bool expired{false};
+
+	/**
+	 * Runs in the main thread; executes #main_line or removes the
+	 * client from the #ClientList.
+	 */
+	DeferEvent main_event;
+
+	/**
+	 * Runs in the worker thread; consumes the results posted by
+	 * the main thread.
+	 */
+	DeferEvent worker_event;
+
+	/**
+	 * The command line to be executed by the main thread.  Owned
+	 * by the main thread while #main_pending is set.
+	 */
+	std::string main_line;
+
+	/**
+	 * If true, then #main_event removes this client instead of
+	 * executing #main_line.
+	 */
+	bool main_remove = false;
+
+	/* the following fields are owned by the worker thread */
+
+	/**
+	 * Is the main thread currently processing a request?  While
+	 * this is set, socket input is paused.
+	 */
+	bool main_pending = false;
+
+	/**
+	 * Was Close() called while #main_pending was set?
+	 */
+	bool close_pending = false;
+
+	/**
+	 * Has the main thread been asked to remove this client?
+	 */
+	bool removing = false;
+
+	/**
+	 * The worker thread's copy of #idle_waiting.
+	 */
+	bool worker_idle = false;
+
+	/**
+	 * Protects the fields below, which are written by the main
+	 * thread and consumed by the worker thread.
+	 */
+	Mutex worker_mutex;
+
+	/**
+	 * Response data generated by the main thread.
+	 */
+	std::string worker_output;
+
+	bool has_main_result = false;
+
+	/**
+	 * The value of #idle_waiting after the command.
+	 */
+	bool main_result_idle;
+
+	/**
+	 * Has the client been woken up from "idle" asynchronously?
+	 */
+	bool idle_left = false;
+
+	/**
+	 * Has the main thread removed this client from the
+	 * #ClientList?  The worker thread shall delete it now.
+	 */
+	bool removed = false;
+
+	CommandResult main_result;
+
 public:
 	unsigned permission;
 
@@ -112,12 +211,20 @@ public:
 
 	gcc_pure
 	bool IsExpired() const noexcept {
-		return !FullyBufferedSocket::IsDefined();
+		return threaded
+			? expired.load(std::memory_order_relaxed)
+			: !FullyBufferedSocket::IsDefined();
 	}
 
 	void Close() noexcept;
 	void SetExpired() noexcept;
 
+	/**
+	 * Delete this object after it has been removed from the
+	 * #ClientList.  Must be called from the main thread.
+	 */
+	void Dispose() noexcept;
+
 	bool Write(const void *data, size_t length);
 
 	/**
@@ -125,6 +232,11 @@ public:
 	 */
 	bool Write(const char *data);
 
+	/**
+	 * Format a string directly into the output buffer.
+	 */
+	bool FormatV(const char *fmt, va_list args);
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -227,12 +339,52 @@ public:
 	const Storage *GetStorage() const noexcept;
 
 private:
+	/**
+	 * Is this method being called by the main thread on a
+	 * #threaded client, i.e. not by the thread which owns the
+	 * socket?
+	 */
+	gcc_pure
+	bool IsMainThread() noexcept;
+
+	/**
+	 * Append data to #worker_output (called by the main thread
+	 * on a #threaded client).
+	 */
+	bool WriteFromMain(const void *data, size_t length) noexcept;
+
+	/**
+	 * Can the given command line be executed right here in the
+	 * worker thread (i.e. without passing it to the main
+	 * thread)?
+	 */
+	gcc_pure
+	bool CanRunInWorker(const char *line) const noexcept;
+
+	/**
+	 * Pass a command line to the main thread (called by the
+	 * worker thread).
+	 */
+	void SubmitToMain(const char *line) noexcept;
+
+	/**
+	 * Handle a #CommandResult in the thread which owns the
+	 * socket.
+	 *
+	 * @return false if the client has been closed
+	 */
+	bool HandleResult(CommandResult r) noexcept;
+
+	/* callbacks for DeferEvent */
+	void OnMainEvent() noexcept;
+	void OnWorkerEvent() noexcept;
+
 	/* virtual methods from class BufferedSocket */
 	InputResult OnSocketInput(void *data, size_t length) noexcept override;
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
-	/* callback for TimerEvent */
+	/* callback for CoarseTimerEvent */
 	void OnTimeout() noexcept;
 };
 
@@ -23,9 +23,12 @@
 void
 Client::SetExpired() noexcept
 {
-	if (IsExpired())
+	if (!FullyBufferedSocket::IsDefined())
 		return;
 
+	if (threaded)
+		expired.store(true, std::memory_order_relaxed);
+
 	FullyBufferedSocket::Close();
 	timeout_event.Schedule(std::chrono::steady_clock::duration::zero());
 }
@@ -34,7 +37,7 @@ void
 Client::OnTimeout() noexcept
 {
 	if (!IsExpired()) {
-		assert(!idle_waiting);
+		assert(threaded ? !worker_idle : !idle_waiting);
 		FormatDebug(client_domain, "[%u] timeout", num);
 	}
 
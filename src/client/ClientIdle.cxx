@@ -47,7 +47,14 @@ Client::IdleNotify() noexcept
 	Response r(*this, 0);
 	WriteIdleResponse(r, flags);
 
-	timeout_event.Schedule(client_timeout);
+	if (IsMainThread()) {
+		/* the worker thread owns the timer; let it send the
+		   response and re-enable the timeout */
+		const std::lock_guard<Mutex> lock(worker_mutex);
+		idle_left = true;
+		worker_event.Schedule();
+	} else
+		timeout_event.Schedule(client_timeout);
 }
 
 void
@@ -73,8 +80,11 @@ Client::IdleWait(unsigned flags) noexcept
 		IdleNotify();
 		return true;
 	} else {
-		/* disable timeouts while in "idle" */
-		timeout_event.Cancel();
+		/* disable timeouts while in "idle" (the worker
+		   thread of a "threaded" client does this when it
+		   receives the result) */
+		if (!IsMainThread())
+			timeout_event.Cancel();
 		return false;
 	}
 }
@@ -19,7 +19,6 @@
 
 #include "ClientList.hxx"
 #include "ClientInternal.hxx"
-#include "util/DeleteDisposer.hxx"
 
 #include <assert.h>
 
@@ -34,7 +33,9 @@ ClientList::Remove(Client &client)
 void
 ClientList::CloseAll()
 {
-	list.clear_and_dispose(DeleteDisposer());
+	list.clear_and_dispose([](Client *client){
+			client->Dispose();
+		});
 }
 
 void
@@ -26,6 +26,7 @@
 #include "net/SocketAddress.hxx"
 #include "net/ToString.hxx"
 #include "Permission.hxx"
+#include "event/Call.hxx"
 #include "Log.hxx"
 
 #include <assert.h>
@@ -42,9 +43,13 @@ Client::Client(EventLoop &_loop, Partition &_partition,
 	       int _uid, unsigned _permission,
 	       int _num) noexcept
 	:FullyBufferedSocket(_fd.Release(), _loop,
-			     16384, client_max_output_buffer_size),
+			     client_max_output_buffer_size),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
 	 partition(&_partition),
+	 threaded(&_loop != &_partition.instance.event_loop),
+	 main_event(_partition.instance.event_loop,
+		    BIND_THIS_METHOD(OnMainEvent)),
+	 worker_event(_loop, BIND_THIS_METHOD(OnWorkerEvent)),
 	 permission(_permission),
 	 uid(_uid),
 	 num(_num)
@@ -70,9 +75,24 @@ client_new(EventLoop &loop, Partition &partition,
 
 	(void)fd.Write(GREETING, sizeof(GREETING) - 1);
 
-	Client *client = new Client(loop, partition, std::move(fd), uid,
+	EventLoop &client_loop = partition.instance.GetClientEventLoop();
+
+	Client *client;
+	if (&client_loop != &loop)
+		/* the Client must be constructed inside its worker
+		   thread, because that registers the socket */
+		BlockingCall(client_loop, [&](){
+				client = new Client(client_loop, partition,
+						    std::move(fd), uid,
+						    permission,
+						    next_client_num);
+			});
+	else
+		client = new Client(loop, partition, std::move(fd), uid,
 				    permission,
-				    next_client_num++);
+				    next_client_num);
+
+	++next_client_num;
 
 	client_list.Add(*client);
 
@@ -83,6 +103,27 @@ client_new(EventLoop &loop, Partition &partition,
 void
 Client::Close() noexcept
 {
+	if (threaded) {
+		/* only the main thread may modify the ClientList;
+		   ask it to remove this client, and delete it when
+		   that is done (see OnWorkerEvent()) */
+		SetExpired();
+
+		if (main_pending) {
+			close_pending = true;
+			return;
+		}
+
+		if (removing)
+			return;
+
+		removing = true;
+		timeout_event.Cancel();
+		main_remove = true;
+		main_event.Schedule();
+		return;
+	}
+
 	partition->instance.client_list->Remove(*this);
 
 	SetExpired();
@@ -25,26 +25,10 @@
 
 #include <string.h>
 
-BufferedSocket::InputResult
-Client::OnSocketInput(void *data, size_t length) noexcept
+bool
+Client::HandleResult(CommandResult r) noexcept
 {
-	char *p = (char *)data;
-	char *newline = (char *)memchr(p, '\n', length);
-	if (newline == nullptr)
-		return InputResult::MORE;
-
-	timeout_event.Schedule(client_timeout);
-
-	BufferedSocket::ConsumeInput(newline + 1 - p);
-
-	/* skip whitespace at the end of the line */
-	char *end = StripRight(p, newline);
-
-	/* terminate the string at the end of the line */
-	*end = 0;
-
-	CommandResult result = client_process_line(*this, p);
-	switch (result) {
+	switch (r) {
 	case CommandResult::OK:
 	case CommandResult::IDLE:
 	case CommandResult::ERROR:
@@ -53,22 +37,55 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 	case CommandResult::KILL:
 		partition->instance.Break();
 		Close();
-		return InputResult::CLOSED;
+		return false;
 
 	case CommandResult::FINISH:
 		if (Flush())
 			Close();
-		return InputResult::CLOSED;
+		return false;
 
 	case CommandResult::CLOSE:
 		Close();
-		return InputResult::CLOSED;
+		return false;
 	}
 
 	if (IsExpired()) {
 		Close();
-		return InputResult::CLOSED;
+		return false;
+	}
+
+	return true;
+}
+
+BufferedSocket::InputResult
+Client::OnSocketInput(void *data, size_t length) noexcept
+{
+	if (main_pending)
+		/* wait for the main thread to finish the previous
+		   command */
+		return InputResult::PAUSE;
+
+	char *p = (char *)data;
+	char *newline = (char *)memchr(p, '\n', length);
+	if (newline == nullptr)
+		return InputResult::MORE;
+
+	timeout_event.Schedule(client_timeout);
+
+	BufferedSocket::ConsumeInput(newline + 1 - p);
+
+	/* skip whitespace at the end of the line */
+	char *end = StripRight(p, newline);
+
+	/* terminate the string at the end of the line */
+	*end = 0;
+
+	if (threaded && !CanRunInWorker(p)) {
+		SubmitToMain(p);
+		return InputResult::PAUSE;
 	}
 
-	return InputResult::AGAIN;
+	return HandleResult(client_process_line(*this, p))
+		? InputResult::AGAIN
+		: InputResult::CLOSED;
 }
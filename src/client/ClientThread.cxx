@@ -0,0 +1,189 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Support for clients served by one of the "client_threads".  The
+ * worker thread owns the socket and executes read-only database
+ * queries itself; all other command lines are passed to the main
+ * thread (#main_event), which executes them and passes the response
+ * back (#worker_event).  The worker thread never waits for the main
+ * thread.
+ */
+
+#include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "command/AllCommands.hxx"
+#include "event/Call.hxx"
+#include "event/Loop.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#endif
+
+#include <assert.h>
+
+bool
+Client::IsMainThread() noexcept
+{
+	return threaded && !worker_event.GetEventLoop().IsInside();
+}
+
+bool
+Client::WriteFromMain(const void *data, size_t length) noexcept
+{
+	assert(threaded);
+
+	const std::lock_guard<Mutex> lock(worker_mutex);
+
+	if (worker_output.size() + length > client_max_output_buffer_size) {
+		FormatError(client_domain,
+			    "[%u] output buffer is full", num);
+		expired.store(true, std::memory_order_relaxed);
+		return false;
+	}
+
+	worker_output.append((const char *)data, length);
+	return true;
+}
+
+bool
+Client::CanRunInWorker(const char *line) const noexcept
+{
+#ifdef ENABLE_DATABASE
+	if (worker_idle || cmd_list.IsActive())
+		return false;
+
+	const Database *db = GetDatabase();
+	return db != nullptr && db->GetPlugin().IsConcurrentRead() &&
+		command_is_concurrent(line);
+#else
+	(void)line;
+	return false;
+#endif
+}
+
+void
+Client::SubmitToMain(const char *line) noexcept
+{
+	assert(threaded);
+	assert(!main_pending);
+	assert(!removing);
+
+	main_line = line;
+	main_pending = true;
+	main_event.Schedule();
+}
+
+void
+Client::OnMainEvent() noexcept
+{
+	assert(threaded);
+
+	if (main_remove) {
+		partition->instance.client_list->Remove(*this);
+		FormatInfo(client_domain, "[%u] closed", num);
+
+		/* schedule while holding the mutex, because the
+		   worker thread may delete this object as soon as it
+		   sees #removed */
+		const std::lock_guard<Mutex> lock(worker_mutex);
+		removed = true;
+		worker_event.Schedule();
+	} else {
+		const auto r = client_process_line(*this, &main_line.front());
+
+		const std::lock_guard<Mutex> lock(worker_mutex);
+		has_main_result = true;
+		main_result = r;
+		main_result_idle = idle_waiting;
+		worker_event.Schedule();
+	}
+}
+
+void
+Client::OnWorkerEvent() noexcept
+{
+	assert(threaded);
+
+	std::string data;
+	bool has_result, left_idle, is_removed, result_idle;
+	CommandResult result;
+
+	{
+		const std::lock_guard<Mutex> lock(worker_mutex);
+		data.swap(worker_output);
+		has_result = std::exchange(has_main_result, false);
+		result = main_result;
+		result_idle = main_result_idle;
+		left_idle = std::exchange(idle_left, false);
+		is_removed = removed;
+	}
+
+	if (is_removed) {
+		delete this;
+		return;
+	}
+
+	if (has_result) {
+		assert(main_pending);
+		main_pending = false;
+		worker_idle = result_idle;
+	} else if (left_idle)
+		worker_idle = false;
+
+	if (!data.empty() && IsConnected())
+		FullyBufferedSocket::Write(data.data(), data.size());
+
+	if (has_result) {
+		if (close_pending) {
+			Close();
+			return;
+		}
+
+		if (!HandleResult(result))
+			return;
+	} else if (IsExpired()) {
+		Close();
+		return;
+	}
+
+	if (has_result || left_idle) {
+		if (worker_idle)
+			/* disable timeouts while in "idle" */
+			timeout_event.Cancel();
+		else
+			timeout_event.Schedule(client_timeout);
+	}
+
+	if (has_result)
+		ResumeInput();
+}
+
+void
+Client::Dispose() noexcept
+{
+	if (threaded)
+		BlockingCall(worker_event.GetEventLoop(), [this](){ delete this; });
+	else
+		delete this;
+}
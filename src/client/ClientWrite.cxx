@@ -18,14 +18,23 @@
  */
 
 #include "Client.hxx"
+#include "util/FormatString.hxx"
+#include "util/AllocatedString.hxx"
 
+#include <stdio.h>
 #include <string.h>
 
 bool
 Client::Write(const void *data, size_t length)
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+	if (IsMainThread())
+		return WriteFromMain(data, length);
+
+	return FullyBufferedSocket::Write(data, length);
 }
 
 bool
@@ -33,3 +42,33 @@ Client::Write(const char *data)
 {
 	return Write(data, strlen(data));
 }
+
+bool
+Client::FormatV(const char *fmt, va_list args)
+{
+	if (IsExpired())
+		return false;
+
+	/* try to format into the free space at the end of the
+	   output buffer, to avoid allocating and copying a
+	   temporary string for each response line */
+	auto w = IsMainThread()
+		? WritableBuffer<void>(nullptr)
+		: PrepareWrite();
+	if (!w.empty()) {
+		va_list args2;
+		va_copy(args2, args);
+		const int length = vsnprintf((char *)w.data, w.size,
+					     fmt, args2);
+		va_end(args2);
+
+		if (length >= 0 && size_t(length) < w.size) {
+			CommitWrite(length);
+			return true;
+		}
+	}
+
+	/* it doesn't fit (the segment is nearly full, or the output
+	   buffer is full); fall back to a temporary string */
+	return Write(FormatStringV(fmt, args).c_str());
+}
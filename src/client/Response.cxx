@@ -19,8 +19,6 @@
 
 #include "Response.hxx"
 #include "Client.hxx"
-#include "util/FormatString.hxx"
-#include "util/AllocatedString.hxx"
 
 TagMask
 Response::GetTagMask() const noexcept
@@ -43,7 +41,7 @@ Response::Write(const char *data)
 bool
 Response::FormatV(const char *fmt, va_list args)
 {
-	return Write(FormatStringV(fmt, args).c_str());
+	return client.FormatV(fmt, args);
 }
 
 bool
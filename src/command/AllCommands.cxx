@@ -48,15 +48,19 @@
 #include "sticker/StickerDatabase.hxx"
 #endif
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
 /*
- * The most we ever use is for search/find, and that limits it to the
- * number of tags we can have.  Add one for the command, and one extra
- * to catch errors clients may send us
+ * The most we ever use is for "addmulti" (up to 256 URIs) and for
+ * search/find, which is limited by the number of tags we can have.
+ * Add one for the command, and one extra to catch errors clients may
+ * send us
  */
-#define COMMAND_ARGV_MAX	(2+(TAG_NUM_OF_ITEM_TYPES*2))
+#define COMMAND_ARGV_MAX	std::max<size_t>(2+(TAG_NUM_OF_ITEM_TYPES*2), \
+						 2+256)
 
 /* if min: -1 don't check args *
  * if max: -1 no max args      */
@@ -83,6 +87,7 @@ handle_not_commands(Client &client, Request request, Response &response);
 static constexpr struct command commands[] = {
 	{ "add", PERMISSION_ADD, 1, 1, handle_add },
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
+	{ "addmulti", PERMISSION_ADD, 1, -1, handle_addmulti },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
 	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
@@ -122,8 +127,8 @@ static constexpr struct command commands[] = {
 	{ "listneighbors", PERMISSION_READ, 0, 0, handle_listneighbors },
 #endif
 	{ "listpartitions", PERMISSION_READ, 0, 0, handle_listpartitions },
-	{ "listplaylist", PERMISSION_READ, 1, 1, handle_listplaylist },
-	{ "listplaylistinfo", PERMISSION_READ, 1, 1, handle_listplaylistinfo },
+	{ "listplaylist", PERMISSION_READ, 1, 2, handle_listplaylist },
+	{ "listplaylistinfo", PERMISSION_READ, 1, 2, handle_listplaylistinfo },
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
@@ -193,6 +198,7 @@ static constexpr struct command commands[] = {
 	{ "subscribe", PERMISSION_READ, 1, 1, handle_subscribe },
 	{ "swap", PERMISSION_CONTROL, 2, 2, handle_swap },
 	{ "swapid", PERMISSION_CONTROL, 2, 2, handle_swapid },
+	{ "tagpoolstats", PERMISSION_READ, 0, 0, handle_tagpoolstats },
 	{ "tagtypes", PERMISSION_READ, 0, -1, handle_tagtypes },
 	{ "toggleoutput", PERMISSION_ADMIN, 1, 1, handle_toggleoutput },
 #ifdef ENABLE_DATABASE
@@ -364,6 +370,33 @@ command_checked_lookup(Response &r, unsigned permission,
 	return cmd;
 }
 
+bool
+command_is_concurrent(const char *line) noexcept
+{
+#ifdef ENABLE_DATABASE
+	/* these commands only read from the #Database and write to
+	   the #Response; they do not touch any other state owned by
+	   the main thread */
+	static constexpr const char *concurrent_commands[] = {
+		"count",
+		"find",
+		"list",
+		"listall",
+		"listallinfo",
+		"search",
+	};
+
+	const size_t length = strcspn(line, " \t");
+	for (const char *i : concurrent_commands)
+		if (strncmp(line, i, length) == 0 && i[length] == 0)
+			return true;
+#else
+	(void)line;
+#endif
+
+	return false;
+}
+
 CommandResult
 command_process(Client &client, unsigned num, char *line)
 try {
@@ -21,6 +21,7 @@
 #define MPD_ALL_COMMANDS_HXX
 
 #include "CommandResult.hxx"
+#include "util/Compiler.h"
 
 class Client;
 
@@ -33,4 +34,13 @@ command_finish();
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
+/**
+ * Does the given command line invoke a read-only database query
+ * which may be executed outside of the main thread, concurrently
+ * with other commands?
+ */
+gcc_pure
+bool
+command_is_concurrent(const char *line) noexcept;
+
 #endif
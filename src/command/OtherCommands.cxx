@@ -31,6 +31,7 @@
 #include "TagPrint.hxx"
 #include "TagStream.hxx"
 #include "tag/Handler.hxx"
+#include "tag/Pool.hxx"
 #include "TimePrint.hxx"
 #include "decoder/DecoderPrint.hxx"
 #include "ls.hxx"
@@ -367,6 +368,35 @@ handle_stats(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_tagpoolstats(gcc_unused Client &client, gcc_unused Request args,
+		    Response &r)
+{
+	const auto stats = tag_pool_stats();
+
+	r.Format("shards: %u\n"
+		 "slots: %zu\n"
+		 "buckets: %zu\n"
+		 "used_buckets: %zu\n"
+		 "max_chain: %zu\n"
+		 "avg_chain: %.2f\n"
+		 "references: %llu\n"
+		 "dedup_ratio: %.2f\n"
+		 "value_bytes: %zu\n"
+		 "referenced_bytes: %llu\n",
+		 stats.shards,
+		 stats.slots,
+		 stats.buckets,
+		 stats.used_buckets,
+		 stats.max_chain,
+		 stats.GetAverageChain(),
+		 (unsigned long long)stats.references,
+		 stats.GetDedupRatio(),
+		 stats.value_bytes,
+		 (unsigned long long)stats.referenced_bytes);
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, gcc_unused Request args, Response &r)
 {
@@ -82,9 +82,10 @@ CommandResult
 handle_listplaylist(Client &client, Request args, Response &r)
 {
 	const char *const name = args.front();
+	const auto range = args.ParseOptional(1, RangeArg::All());
 
 	if (playlist_file_print(r, client.GetPartition(), SongLoader(client),
-				name, false))
+				name, range, false))
 		return CommandResult::OK;
 
 	throw PlaylistError::NoSuchList();
@@ -94,9 +95,10 @@ CommandResult
 handle_listplaylistinfo(Client &client, Request args, Response &r)
 {
 	const char *const name = args.front();
+	const auto range = args.ParseOptional(1, RangeArg::All());
 
 	if (playlist_file_print(r, client.GetPartition(), SongLoader(client),
-				name, true))
+				name, range, true))
 		return CommandResult::OK;
 
 	throw PlaylistError::NoSuchList();
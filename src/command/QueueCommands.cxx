@@ -132,6 +132,19 @@ handle_addid(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_addmulti(Client &client, Request args, gcc_unused Response &r)
+{
+	auto &partition = client.GetPartition();
+	const SongLoader loader(client);
+	partition.AppendURIs(loader, args);
+
+	for (const char *uri : args)
+		partition.instance.LookupRemoteTag(uri);
+
+	return CommandResult::OK;
+}
+
 /**
  * Parse a string in the form "START:END", both being (optional)
  * fractional non-negative time offsets in seconds.  Returns both in
@@ -32,6 +32,9 @@ handle_add(Client &client, Request request, Response &response);
 CommandResult
 handle_addid(Client &client, Request request, Response &response);
 
+CommandResult
+handle_addmulti(Client &client, Request request, Response &response);
+
 CommandResult
 handle_rangeid(Client &client, Request request, Response &response);
 
@@ -33,6 +33,7 @@ enum class ConfigOption {
 	PLAYLIST_DIR,
 	FOLLOW_INSIDE_SYMLINKS,
 	FOLLOW_OUTSIDE_SYMLINKS,
+	UPDATE_THREADS,
 	DB_FILE,
 	STICKER_FILE,
 	LOG_FILE,
@@ -57,8 +58,11 @@ enum class ConfigOption {
 	REPLAYGAIN_MISSING_PREAMP,
 	REPLAYGAIN_LIMIT,
 	VOLUME_NORMALIZATION,
+	SHARE_OUTPUT_FILTERS,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_BUFFER_LOCK_FREE,
+	AUDIO_CHUNK_SIZE,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
@@ -66,6 +70,7 @@ enum class ConfigOption {
 	HTTP_PROXY_PASSWORD,
 	CONN_TIMEOUT,
 	MAX_CONN,
+	CLIENT_THREADS,
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
@@ -86,6 +91,7 @@ enum class ConfigBlockOption {
 	AUDIO_OUTPUT,
 	DECODER,
 	INPUT,
+	INPUT_CACHE,
 	PLAYLIST_PLUGIN,
 	RESAMPLER,
 	AUDIO_FILTER,
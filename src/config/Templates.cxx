@@ -28,6 +28,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "playlist_directory" },
 	{ "follow_inside_symlinks" },
 	{ "follow_outside_symlinks" },
+	{ "update_threads" },
 	{ "db_file" },
 	{ "sticker_file" },
 	{ "log_file" },
@@ -52,8 +53,11 @@ const ConfigTemplate config_param_templates[] = {
 	{ "replaygain_missing_preamp" },
 	{ "replaygain_limit" },
 	{ "volume_normalization" },
+	{ "share_output_filters" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "audio_buffer_lock_free" },
+	{ "audio_chunk_size" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -61,6 +65,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "http_proxy_password", false, true },
 	{ "connection_timeout" },
 	{ "max_connections" },
+	{ "client_threads" },
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
@@ -86,6 +91,7 @@ const ConfigTemplate config_block_templates[] = {
 	{ "audio_output", true },
 	{ "decoder", true },
 	{ "input", true },
+	{ "input_cache" },
 	{ "playlist_plugin", true },
 	{ "resampler" },
 	{ "filter", true },
@@ -26,12 +26,18 @@
 #ifndef MPD_DB_LOCK_HXX
 #define MPD_DB_LOCK_HXX
 
-#include "thread/Mutex.hxx"
 #include "util/Compiler.h"
 
+#include <shared_mutex>
+
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  It may be held exclusively (by
+ * db_lock(), for modifications) or shared (by db_lock_shared(), for
+ * read-only access by several threads at the same time).
+ */
+extern std::shared_timed_mutex db_mutex;
 
 #ifndef NDEBUG
 
@@ -40,13 +46,19 @@ extern Mutex db_mutex;
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold a shared database lock?
+ */
+extern thread_local bool db_mutex_shared;
+
+/**
+ * Does the current thread hold the database lock (exclusive or
+ * shared)?
  */
 gcc_pure
 static inline bool
 holding_db_lock() noexcept
 {
-	return db_mutex_holder.IsInside();
+	return db_mutex_holder.IsInside() || db_mutex_shared;
 }
 
 #endif
@@ -106,6 +118,61 @@ public:
 	}
 };
 
+/**
+ * Obtain a shared database lock.  This is enough for read-only
+ * access to a #song or #directory; several threads may hold it at
+ * the same time.  It is not recursive.
+ */
+static inline void
+db_lock_shared()
+{
+	assert(!holding_db_lock());
+
+	db_mutex.lock_shared();
+
+#ifndef NDEBUG
+	db_mutex_shared = true;
+#endif
+}
+
+/**
+ * Release the shared database lock.
+ */
+static inline void
+db_unlock_shared()
+{
+#ifndef NDEBUG
+	assert(db_mutex_shared);
+	db_mutex_shared = false;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
+class ScopeDatabaseSharedLock {
+	bool locked = true;
+
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		if (locked)
+			db_unlock_shared();
+	}
+
+	/**
+	 * Unlock the mutex now, making the destructor a no-op.
+	 */
+	void unlock() {
+		assert(locked);
+
+		db_unlock_shared();
+		locked = false;
+	}
+};
+
 /**
  * Unlock the database while in the current scope.
  */
@@ -120,4 +187,18 @@ public:
 	}
 };
 
+/**
+ * Release the shared database lock while in the current scope.
+ */
+class ScopeDatabaseSharedUnlock {
+public:
+	ScopeDatabaseSharedUnlock() {
+		db_unlock_shared();
+	}
+
+	~ScopeDatabaseSharedUnlock() {
+		db_lock_shared();
+	}
+};
+
 #endif
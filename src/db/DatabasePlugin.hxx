@@ -38,6 +38,13 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * The #Database may be queried by (const) methods from
+	 * several threads concurrently, even while the main thread
+	 * modifies it.
+	 */
+	static constexpr unsigned FLAG_CONCURRENT_READ = 0x2;
+
 	const char *name;
 
 	unsigned flags;
@@ -60,6 +67,10 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool IsConcurrentRead() const {
+		return flags & FLAG_CONCURRENT_READ;
+	}
 };
 
 #endif
@@ -22,6 +22,8 @@
 
 #include "Visitor.hxx"
 #include "tag/Type.h"
+#include "util/ConstBuffer.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/Compiler.h"
 
 #include <chrono>
@@ -84,6 +86,24 @@ public:
 	 */
 	virtual void ReturnSong(const LightSong *song) const noexcept = 0;
 
+	/**
+	 * Look up several songs and pass them to the visitor in the
+	 * given order.  Implementations may share work between
+	 * lookups; the default implementation calls GetSong() for
+	 * each URI.
+	 *
+	 * Throws on error.  "Not found" is an error that throws
+	 * DatabaseErrorCode::NOT_FOUND.
+	 */
+	virtual void VisitSongs(ConstBuffer<const char *> uris,
+				VisitSong visit_song) const {
+		for (const char *uri : uris) {
+			const LightSong *song = GetSong(uri);
+			AtScopeExit(this, song) { ReturnSong(song); };
+			visit_song(*song);
+		}
+	}
+
 	/**
 	 * Visit the selected entities.
 	 *
@@ -18,10 +18,11 @@
  */
 
 #include "VHelper.hxx"
-#include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "song/Filter.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -33,7 +34,17 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(const DatabaseSelection &_selection
 	assert(selection.uri.empty());
 	assert(selection.filter == nullptr);
 
-	if (selection.sort != TAG_NUM_OF_ITEM_TYPES) {
+	if (selection.sort != TAG_NUM_OF_ITEM_TYPES &&
+	    selection.window.end != RangeArg::All().end) {
+		/* the client has asked us to sort the result, but
+		   wants only the beginning of it: keep only the best
+		   "window.end" songs */
+
+		original_visit_song = std::move(visit_song);
+		visit_song = [this](const auto &song){
+			AddTopSong(song);
+		};
+	} else if (selection.sort != TAG_NUM_OF_ITEM_TYPES) {
 		/* the client has asked us to sort the result; this is
 		   pretty expensive, because instead of streaming the
 		   result to the client, we need to copy it all into
@@ -41,7 +52,7 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(const DatabaseSelection &_selection
 
 		original_visit_song = std::move(visit_song);
 		visit_song = [this](const auto &song){
-			songs.emplace_back(song);
+			songs.emplace_back(song, counter++);
 		};
 	} else if (selection.window != RangeArg::All()) {
 		original_visit_song = std::move(visit_song);
@@ -86,6 +97,70 @@ CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
 	}
 }
 
+gcc_pure
+static bool
+CompareSongs(TagType sort, bool descending,
+	     const Tag &a_tag, std::chrono::system_clock::time_point a_mtime,
+	     const Tag &b_tag, std::chrono::system_clock::time_point b_mtime) noexcept
+{
+	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
+		return descending
+			? a_mtime > b_mtime
+			: a_mtime < b_mtime;
+
+	return CompareTags(sort, descending, a_tag, b_tag);
+}
+
+inline bool
+DatabaseVisitorHelper::Less(const SortEntry &a,
+			    const SortEntry &b) const noexcept
+{
+	if (CompareSongs(selection.sort, selection.descending,
+			 a.song.GetTag(), a.song.GetLastModified(),
+			 b.song.GetTag(), b.song.GetLastModified()))
+		return true;
+
+	if (CompareSongs(selection.sort, selection.descending,
+			 b.song.GetTag(), b.song.GetLastModified(),
+			 a.song.GetTag(), a.song.GetLastModified()))
+		return false;
+
+	return a.position < b.position;
+}
+
+inline bool
+DatabaseVisitorHelper::Less(const LightSong &a,
+			    const SortEntry &b) const noexcept
+{
+	/* no tie breaker needed: "a" is the most recent song, and
+	   on a tie, the older one comes first */
+	return CompareSongs(selection.sort, selection.descending,
+			    a.tag, a.mtime,
+			    b.song.GetTag(), b.song.GetLastModified());
+}
+
+void
+DatabaseVisitorHelper::AddTopSong(const LightSong &song)
+{
+	const auto less = [this](const SortEntry &a, const SortEntry &b){
+		return Less(a, b);
+	};
+
+	const unsigned position = counter++;
+
+	if (songs.size() < selection.window.end) {
+		songs.emplace_back(song, position);
+		std::push_heap(songs.begin(), songs.end(), less);
+	} else if (!songs.empty() && Less(song, songs.front())) {
+		/* the new song replaces the last one; it is compared
+		   without copying it first, because most songs are
+		   rejected here */
+		std::pop_heap(songs.begin(), songs.end(), less);
+		songs.back() = SortEntry(song, position);
+		std::push_heap(songs.begin(), songs.end(), less);
+	}
+}
+
 void
 DatabaseVisitorHelper::Commit()
 {
@@ -96,24 +171,15 @@ DatabaseVisitorHelper::Commit()
 	assert(original_visit_song);
 
 	/* sort the song collection */
-	const auto sort = selection.sort;
-	const auto descending = selection.descending;
+	const auto less = [this](const SortEntry &a, const SortEntry &b){
+		return Less(a, b);
+	};
 
-	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetLastModified() > b.GetLastModified()
-						 : a.GetLastModified() < b.GetLastModified();
-				 });
+	if (selection.window.end != RangeArg::All().end)
+		/* it's already a heap (see AddTopSong()) */
+		std::sort_heap(songs.begin(), songs.end(), less);
 	else
-		std::stable_sort(songs.begin(), songs.end(),
-				 [sort, descending](const DetachedSong &a,
-						    const DetachedSong &b){
-					 return CompareTags(sort, descending,
-							    a.GetTag(),
-							    b.GetTag());
-				 });
+		std::sort(songs.begin(), songs.end(), less);
 
 	/* apply the "window" */
 	if (selection.window.end < songs.size())
@@ -127,6 +193,6 @@ DatabaseVisitorHelper::Commit()
 		    std::next(songs.begin(), selection.window.start));
 
 	/* now pass all songs to the original visitor callback */
-	for (const auto &song : songs)
-		original_visit_song((LightSong)song);
+	for (const auto &i : songs)
+		original_visit_song((LightSong)i.song);
 }
@@ -22,11 +22,11 @@
 
 #include "Visitor.hxx"
 #include "Selection.hxx"
+#include "song/DetachedSong.hxx"
+#include "util/Compiler.h"
 
 #include <vector>
 
-class DetachedSong;
-
 /**
  * This class helps implementing Database::Visit() by emulating
  * #DatabaseSelection features that the #Database implementation
@@ -39,17 +39,37 @@ class DetachedSong;
 class DatabaseVisitorHelper {
 	const DatabaseSelection selection;
 
+	struct SortEntry {
+		DetachedSong song;
+
+		/**
+		 * The position in which the song was visited; it
+		 * breaks ties to make the sort stable.
+		 */
+		unsigned position;
+
+		template<typename S>
+		SortEntry(S &&_song, unsigned _position)
+			:song(std::forward<S>(_song)), position(_position) {}
+	};
+
 	/**
 	 * If the plugin can't sort, then this container will collect
-	 * all songs, sort them and report them to the visitor in
+	 * the songs, sort them and report them to the visitor in
 	 * Commit().
+	 *
+	 * If the "window" has an end, only the first "window.end"
+	 * songs can ever be reported, and this container is a
+	 * bounded max-heap (its front is the last of these songs), so
+	 * only that many songs are copied and kept in memory.
 	 */
-	std::vector<DetachedSong> songs;
+	std::vector<SortEntry> songs;
 
 	VisitSong original_visit_song;
 
 	/**
-	 * Used to emulate the "window".
+	 * Used to emulate the "window" and to number the songs for
+	 * sorting.
 	 */
 	unsigned counter = 0;
 
@@ -65,6 +85,18 @@ public:
 	~DatabaseVisitorHelper() noexcept;
 
 	void Commit();
+
+private:
+	gcc_pure
+	bool Less(const SortEntry &a, const SortEntry &b) const noexcept;
+
+	gcc_pure
+	bool Less(const LightSong &a, const SortEntry &b) const noexcept;
+
+	/**
+	 * Add a song to the bounded heap (see #songs).
+	 */
+	void AddTopSong(const LightSong &song);
 };
 
 #endif
@@ -0,0 +1,692 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BinaryDatabase.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/PlaylistVector.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Item.hxx"
+#include "tag/Pool.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
+#include "util/ChronoUtil.hxx"
+#include "util/StringView.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr char BINARY_DB_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', 'D', 'B',
+};
+
+static constexpr uint32_t BINARY_DB_FORMAT = 3;
+
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/**
+ * All records are aligned to this many bytes, so the image can be
+ * accessed directly once it is mapped.
+ */
+static constexpr size_t ALIGNMENT = 8;
+
+static constexpr int64_t NO_MTIME = std::numeric_limits<int64_t>::min();
+
+/* the values of DirectoryRecord::type */
+static constexpr uint32_t DIRECTORY_TYPE_REGULAR = 0;
+static constexpr uint32_t DIRECTORY_TYPE_ARCHIVE = 1;
+static constexpr uint32_t DIRECTORY_TYPE_CONTAINER = 2;
+
+/* bits for SongRecord::flags */
+static constexpr uint32_t SONG_FLAG_HAS_PLAYLIST = 0x1;
+
+namespace {
+
+/*
+ * The image layout:
+ *
+ * - #Header
+ * - string table: for each string, a 32 bit length followed by the
+ *   null-terminated string, padded to #ALIGNMENT
+ * - tag type table: one #TagTypeRecord for each tag type known to
+ *   the writer
+ * - tag item table: one #TagItemRecord per distinct tag item
+ * - the root directory: a #DirectoryRecord followed by its playlists
+ *   (#PlaylistRecord), songs (#SongRecord, each followed by its tag
+ *   item indexes, padded to #ALIGNMENT) and its child directories
+ *   (recursively in the same layout)
+ */
+
+struct Header {
+	char magic[sizeof(BINARY_DB_MAGIC)];
+	uint32_t byte_order;
+	uint32_t format;
+
+	/* string table indexes */
+	uint32_t mpd_version, fs_charset;
+
+	uint32_t n_strings, n_tag_types, n_tag_items;
+	uint32_t reserved;
+};
+
+struct TagTypeRecord {
+	uint32_t name;
+	uint32_t enabled;
+};
+
+struct TagItemRecord {
+	uint32_t type;
+	uint32_t value;
+};
+
+struct DirectoryRecord {
+	uint32_t name;
+	uint32_t type;
+	int64_t mtime;
+	uint32_t n_playlists, n_songs, n_children;
+	uint32_t reserved;
+};
+
+struct SongRecord {
+	uint32_t name;
+	uint32_t n_items;
+	int64_t mtime;
+	uint32_t start_ms, end_ms;
+	int32_t duration_ms;
+	uint32_t flags;
+	uint32_t sample_rate;
+	uint8_t format, channels;
+	uint8_t reserved[2];
+};
+
+struct PlaylistRecord {
+	uint32_t name;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+static_assert(sizeof(Header) % ALIGNMENT == 0, "Bad alignment");
+static_assert(sizeof(TagTypeRecord) % ALIGNMENT == 0, "Bad alignment");
+static_assert(sizeof(TagItemRecord) % ALIGNMENT == 0, "Bad alignment");
+static_assert(sizeof(DirectoryRecord) % ALIGNMENT == 0, "Bad alignment");
+static_assert(sizeof(SongRecord) % ALIGNMENT == 0, "Bad alignment");
+static_assert(sizeof(PlaylistRecord) % ALIGNMENT == 0, "Bad alignment");
+
+static constexpr size_t
+PadSize(size_t size) noexcept
+{
+	return (ALIGNMENT - size % ALIGNMENT) % ALIGNMENT;
+}
+
+static int64_t
+ExportTime(std::chrono::system_clock::time_point t) noexcept
+{
+	return IsNegative(t)
+		? NO_MTIME
+		: int64_t(std::chrono::system_clock::to_time_t(t));
+}
+
+static std::chrono::system_clock::time_point
+ImportTime(int64_t t) noexcept
+{
+	return t == NO_MTIME
+		? std::chrono::system_clock::time_point::min()
+		: std::chrono::system_clock::from_time_t(time_t(t));
+}
+
+class BinaryDatabaseWriter {
+	BufferedOutputStream &os;
+
+	std::unordered_map<std::string, uint32_t> string_map;
+
+	/**
+	 * Pointers to the keys of #string_map in the order of their
+	 * indexes.
+	 */
+	std::vector<const std::string *> strings;
+
+	std::unordered_map<const TagItem *, uint32_t> item_map;
+	std::vector<const TagItem *> items;
+
+public:
+	explicit BinaryDatabaseWriter(BufferedOutputStream &_os) noexcept
+		:os(_os) {}
+
+	void Save(const Directory &root);
+
+private:
+	uint32_t Intern(const char *s);
+	uint32_t Intern(const TagItem &item);
+
+	void Collect(const Directory &directory);
+
+	template<typename T>
+	void WriteRecord(const T &t) {
+		os.Write(&t, sizeof(t));
+	}
+
+	void WritePadding(size_t size) {
+		static constexpr char zero[ALIGNMENT] = {};
+		os.Write(zero, PadSize(size));
+	}
+
+	void WriteStrings();
+	void WriteTagTypes();
+	void WriteTagItems();
+	void WriteSong(const Song &song);
+	void WriteDirectory(const Directory &directory);
+};
+
+uint32_t
+BinaryDatabaseWriter::Intern(const char *s)
+{
+	auto i = string_map.emplace(s, strings.size());
+	if (i.second)
+		strings.push_back(&i.first->first);
+	return i.first->second;
+}
+
+uint32_t
+BinaryDatabaseWriter::Intern(const TagItem &item)
+{
+	auto i = item_map.emplace(&item, items.size());
+	if (i.second) {
+		items.push_back(&item);
+		Intern(item.value);
+	}
+
+	return i.first->second;
+}
+
+void
+BinaryDatabaseWriter::Collect(const Directory &directory)
+{
+	if (!directory.IsRoot())
+		Intern(directory.GetName());
+
+	for (const auto &pi : directory.playlists)
+		Intern(pi.name.c_str());
+
+	for (const auto &song : directory.songs) {
+		Intern(song.uri);
+
+		for (const auto &item : song.tag)
+			Intern(item);
+	}
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			Collect(child);
+}
+
+void
+BinaryDatabaseWriter::WriteStrings()
+{
+	for (const std::string *s : strings) {
+		const uint32_t length = s->length();
+		WriteRecord(length);
+		os.Write(s->c_str(), length + 1);
+		WritePadding(sizeof(length) + length + 1);
+	}
+}
+
+void
+BinaryDatabaseWriter::WriteTagTypes()
+{
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		TagTypeRecord r;
+		r.name = string_map.at(tag_item_names[i]);
+		r.enabled = IsTagEnabled(i);
+		WriteRecord(r);
+	}
+}
+
+void
+BinaryDatabaseWriter::WriteTagItems()
+{
+	for (const TagItem *item : items) {
+		TagItemRecord r;
+		r.type = item->type;
+		r.value = string_map.at(item->value);
+		WriteRecord(r);
+	}
+}
+
+void
+BinaryDatabaseWriter::WriteSong(const Song &song)
+{
+	SongRecord r;
+	memset(&r, 0, sizeof(r));
+	r.name = string_map.at(song.uri);
+	r.n_items = song.tag.num_items;
+	r.mtime = ExportTime(song.mtime);
+	r.start_ms = song.start_time.ToMS();
+	r.end_ms = song.end_time.ToMS();
+	r.duration_ms = song.tag.duration.ToMS();
+	r.flags = song.tag.has_playlist ? SONG_FLAG_HAS_PLAYLIST : 0;
+	r.sample_rate = song.audio_format.sample_rate;
+	r.format = uint8_t(song.audio_format.format);
+	r.channels = song.audio_format.channels;
+	WriteRecord(r);
+
+	for (const auto &item : song.tag)
+		WriteRecord(item_map.at(&item));
+
+	WritePadding(song.tag.num_items * sizeof(uint32_t));
+}
+
+gcc_const
+static uint32_t
+DeviceToType(uint64_t device) noexcept
+{
+	switch (device) {
+	case DEVICE_INARCHIVE:
+		return DIRECTORY_TYPE_ARCHIVE;
+
+	case DEVICE_CONTAINER:
+		return DIRECTORY_TYPE_CONTAINER;
+
+	default:
+		return DIRECTORY_TYPE_REGULAR;
+	}
+}
+
+void
+BinaryDatabaseWriter::WriteDirectory(const Directory &directory)
+{
+	DirectoryRecord r;
+	memset(&r, 0, sizeof(r));
+	r.name = directory.IsRoot()
+		? 0
+		: string_map.at(directory.GetName());
+	r.type = DeviceToType(directory.device);
+	r.mtime = ExportTime(directory.mtime);
+
+	for (gcc_unused const auto &pi : directory.playlists)
+		++r.n_playlists;
+	for (gcc_unused const auto &song : directory.songs)
+		++r.n_songs;
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			++r.n_children;
+
+	WriteRecord(r);
+
+	for (const auto &pi : directory.playlists) {
+		PlaylistRecord p;
+		memset(&p, 0, sizeof(p));
+		p.name = string_map.at(pi.name);
+		p.mtime = ExportTime(pi.mtime);
+		WriteRecord(p);
+	}
+
+	for (const auto &song : directory.songs)
+		WriteSong(song);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			WriteDirectory(child);
+}
+
+void
+BinaryDatabaseWriter::Save(const Directory &root)
+{
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.byte_order = BYTE_ORDER_MARK;
+	header.format = BINARY_DB_FORMAT;
+	header.mpd_version = Intern(VERSION);
+	header.fs_charset = Intern(GetFSCharset());
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		Intern(tag_item_names[i]);
+
+	Collect(root);
+
+	header.n_strings = strings.size();
+	header.n_tag_types = TAG_NUM_OF_ITEM_TYPES;
+	header.n_tag_items = items.size();
+
+	WriteRecord(header);
+	WriteStrings();
+	WriteTagTypes();
+	WriteTagItems();
+	WriteDirectory(root);
+}
+
+class BinaryDatabaseReader {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+	std::vector<StringView> strings;
+
+	/**
+	 * The distinct tag items; this object holds one reference to
+	 * each of them, which is released by the destructor.
+	 */
+	std::vector<TagItem *> items;
+
+public:
+	explicit BinaryDatabaseReader(ConstBuffer<void> image) noexcept
+		:p((const uint8_t *)image.data),
+		 end(p + image.size) {}
+
+	~BinaryDatabaseReader() noexcept {
+		for (TagItem *item : items)
+			tag_pool_put_item(item);
+	}
+
+	BinaryDatabaseReader(const BinaryDatabaseReader &) = delete;
+	BinaryDatabaseReader &operator=(const BinaryDatabaseReader &) = delete;
+
+	void Load(Directory &root);
+
+private:
+	[[noreturn]]
+	static void Corrupt() {
+		throw std::runtime_error("Database corrupted");
+	}
+
+	void Need(size_t size) const {
+		if (size_t(end - p) < size)
+			Corrupt();
+	}
+
+	template<typename T>
+	const T &Read() {
+		Need(sizeof(T));
+		const T &t = *(const T *)(const void *)p;
+		p += sizeof(T);
+		return t;
+	}
+
+	const uint32_t *ReadArray(size_t n) {
+		if (n > size_t(end - p) / sizeof(uint32_t))
+			Corrupt();
+
+		const uint32_t *result = (const uint32_t *)(const void *)p;
+		p += n * sizeof(uint32_t);
+		Skip(PadSize(n * sizeof(uint32_t)));
+		return result;
+	}
+
+	void Skip(size_t size) {
+		Need(size);
+		p += size;
+	}
+
+	StringView GetString(uint32_t i) const {
+		if (i >= strings.size())
+			Corrupt();
+
+		return strings[i];
+	}
+
+	TagItem *GetItem(uint32_t i) const {
+		if (i >= items.size())
+			Corrupt();
+
+		return items[i];
+	}
+
+	void ReadHeader();
+	void ReadStrings(size_t n);
+	void ReadTagTypes(size_t n, std::vector<TagType> &types);
+	void ReadTagItems(size_t n, const std::vector<TagType> &types);
+	void ReadSong(Directory &directory);
+	void ReadDirectoryContents(Directory &directory,
+				   const DirectoryRecord &r);
+};
+
+void
+BinaryDatabaseReader::ReadStrings(size_t n)
+{
+	strings.reserve(n);
+
+	for (size_t i = 0; i < n; ++i) {
+		const uint32_t length = Read<uint32_t>();
+		Need(size_t(length) + 1);
+		const char *value = (const char *)p;
+		if (value[length] != 0)
+			Corrupt();
+
+		strings.emplace_back(value, length);
+		Skip(length + 1);
+		Skip(PadSize(sizeof(length) + length + 1));
+	}
+}
+
+void
+BinaryDatabaseReader::ReadTagTypes(size_t n, std::vector<TagType> &types)
+{
+	bool present[TAG_NUM_OF_ITEM_TYPES];
+	std::fill_n(present, TAG_NUM_OF_ITEM_TYPES, false);
+
+	types.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+		const auto &r = Read<TagTypeRecord>();
+		const char *name = GetString(r.name).data;
+		const TagType type = tag_name_parse(name);
+		if (type == TAG_NUM_OF_ITEM_TYPES)
+			throw FormatRuntimeError("Unrecognized tag '%s', "
+						 "discarding database file",
+						 name);
+
+		if (r.enabled)
+			present[type] = true;
+
+		types.push_back(type);
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i) && !present[i])
+			throw std::runtime_error("Tag list mismatch, "
+						 "discarding database file");
+}
+
+void
+BinaryDatabaseReader::ReadTagItems(size_t n, const std::vector<TagType> &types)
+{
+	items.reserve(n);
+
+	for (size_t i = 0; i < n; ++i) {
+		const auto &r = Read<TagItemRecord>();
+		if (r.type >= types.size())
+			Corrupt();
+
+		items.push_back(tag_pool_get_item(types[r.type],
+						  GetString(r.value)));
+	}
+}
+
+gcc_pure
+static AudioFormat
+ImportAudioFormat(const SongRecord &r) noexcept
+{
+	const AudioFormat af(r.sample_rate, SampleFormat(r.format),
+			     r.channels);
+	return af.IsValid()
+		? af
+		: AudioFormat::Undefined();
+}
+
+void
+BinaryDatabaseReader::ReadSong(Directory &directory)
+{
+	const auto &r = Read<SongRecord>();
+	const StringView name = GetString(r.name);
+	if (name.empty() ||
+	    r.n_items > std::numeric_limits<decltype(Tag::num_items)>::max())
+		Corrupt();
+
+	const uint32_t *ids = ReadArray(r.n_items);
+	for (size_t i = 0; i < r.n_items; ++i)
+		if (ids[i] >= items.size())
+			Corrupt();
+
+	Song *song = Song::NewFile(name.data, directory);
+	song->mtime = ImportTime(r.mtime);
+	song->start_time = SongTime::FromMS(r.start_ms);
+	song->end_time = SongTime::FromMS(r.end_ms);
+	song->audio_format = ImportAudioFormat(r);
+
+	Tag &tag = song->tag;
+	tag.duration = SignedSongTime::FromMS(r.duration_ms);
+	tag.has_playlist = (r.flags & SONG_FLAG_HAS_PLAYLIST) != 0;
+
+	if (r.n_items > 0) {
+		/* share the pooled items instead of looking up each
+		   value again; this is what makes loading cheap */
+		tag.items = new TagItem *[r.n_items];
+		tag.num_items = r.n_items;
+		for (size_t i = 0; i < r.n_items; ++i)
+			tag.items[i] = tag_pool_dup_item(items[ids[i]]);
+	}
+
+	directory.AddSong(song);
+}
+
+gcc_const
+static uint64_t
+TypeToDevice(uint32_t type) noexcept
+{
+	switch (type) {
+	case DIRECTORY_TYPE_ARCHIVE:
+		return DEVICE_INARCHIVE;
+
+	case DIRECTORY_TYPE_CONTAINER:
+		return DEVICE_CONTAINER;
+
+	default:
+		return 0;
+	}
+}
+
+void
+BinaryDatabaseReader::ReadDirectoryContents(Directory &directory,
+					    const DirectoryRecord &r)
+{
+	directory.mtime = ImportTime(r.mtime);
+	directory.device = TypeToDevice(r.type);
+
+	for (size_t i = 0; i < r.n_playlists; ++i) {
+		const auto &pr = Read<PlaylistRecord>();
+		directory.playlists.push_back(PlaylistInfo(GetString(pr.name).data,
+							   ImportTime(pr.mtime)));
+	}
+
+	for (size_t i = 0; i < r.n_songs; ++i)
+		ReadSong(directory);
+
+	for (size_t i = 0; i < r.n_children; ++i) {
+		const auto &cr = Read<DirectoryRecord>();
+		const StringView name = GetString(cr.name);
+		if (name.empty())
+			Corrupt();
+
+		Directory *child = directory.CreateChild(name.data);
+		ReadDirectoryContents(*child, cr);
+	}
+}
+
+void
+BinaryDatabaseReader::ReadHeader()
+{
+	const auto &header = Read<Header>();
+	if (memcmp(header.magic, BINARY_DB_MAGIC, sizeof(header.magic)) != 0)
+		Corrupt();
+
+	if (header.byte_order != BYTE_ORDER_MARK)
+		throw std::runtime_error("Database byte order mismatch, "
+					 "discarding database file");
+
+	if (header.format != BINARY_DB_FORMAT)
+		throw std::runtime_error("Database format mismatch, "
+					 "discarding database file");
+
+	ReadStrings(header.n_strings);
+
+	const char *new_charset = GetString(header.fs_charset).data;
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0)
+		throw FormatRuntimeError("Existing database has charset "
+					 "\"%s\" instead of \"%s\"; "
+					 "discarding database file",
+					 new_charset, old_charset);
+
+	std::vector<TagType> types;
+	ReadTagTypes(header.n_tag_types, types);
+	ReadTagItems(header.n_tag_items, types);
+}
+
+void
+BinaryDatabaseReader::Load(Directory &root)
+{
+	assert(root.IsEmpty());
+
+	ReadHeader();
+
+	const auto &r = Read<DirectoryRecord>();
+
+	const ScopeDatabaseLock protect;
+	ReadDirectoryContents(root, r);
+
+	if (p != end)
+		Corrupt();
+}
+
+} // namespace
+
+bool
+db_is_binary(ConstBuffer<void> head) noexcept
+{
+	return head.size >= sizeof(BINARY_DB_MAGIC) &&
+		memcmp(head.data, BINARY_DB_MAGIC,
+		       sizeof(BINARY_DB_MAGIC)) == 0;
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root)
+{
+	BinaryDatabaseWriter writer(os);
+	writer.Save(root);
+}
+
+void
+db_load_binary(ConstBuffer<void> image, Directory &root)
+{
+	if ((uintptr_t)image.data % ALIGNMENT != 0)
+		throw std::runtime_error("Misaligned database image");
+
+	BinaryDatabaseReader reader(image);
+	reader.Load(root);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BINARY_DATABASE_HXX
+#define MPD_BINARY_DATABASE_HXX
+
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+struct Directory;
+class BufferedOutputStream;
+
+/*
+ * The binary database format (version 3) is an alternative to the
+ * line based text format.  It is a memory image which can be mapped
+ * and walked without parsing: all strings (names, paths, tag values)
+ * are stored once in a string table and referenced by index, and
+ * each distinct tag item is stored once and referenced by songs.
+ *
+ * The image is written in host byte order; a file written on a host
+ * with a different byte order is rejected (and regenerated by the
+ * next database update).
+ */
+
+/**
+ * Does the given buffer (the beginning of a database file) contain a
+ * binary database?
+ */
+gcc_pure
+bool
+db_is_binary(ConstBuffer<void> head) noexcept;
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Load a binary database image into the given (empty) root
+ * directory.  The image may be released afterwards; nothing refers
+ * to it.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_binary(ConstBuffer<void> image, Directory &root);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongSave.hxx"
+#include "PlaylistDatabase.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/Path.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringAPI.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <set>
+#include <string>
+
+#include <assert.h>
+
+#define JOURNAL_BASE "journal_base: "
+#define JOURNAL_DIRECTORY "journal_directory: "
+#define JOURNAL_CHILD "child: "
+#define JOURNAL_END "journal_end"
+
+void
+db_journal_begin(BufferedOutputStream &os, const char *base)
+{
+	os.Format(JOURNAL_BASE "%s\n", base);
+}
+
+static void
+SaveRecord(BufferedOutputStream &os, const Directory &directory)
+{
+	os.Format(JOURNAL_DIRECTORY "%s\n", directory.GetPath());
+
+	if (!directory.IsRoot())
+		directory_save_attributes(os, directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			os.Format(JOURNAL_CHILD "%s\n", child.GetName());
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Format("%s\n", JOURNAL_END);
+}
+
+unsigned
+db_journal_save(BufferedOutputStream &os, Directory &directory)
+{
+	assert(holding_db_lock());
+
+	unsigned n = 0;
+
+	if (directory.dirty) {
+		SaveRecord(os, directory);
+		directory.dirty = false;
+		++n;
+	}
+
+	/* parents are written before their children, because
+	   replaying a parent record creates new children */
+	for (auto &child : directory.children)
+		if (!child.IsMount())
+			n += db_journal_save(os, child);
+
+	return n;
+}
+
+void
+db_journal_clear(Directory &directory) noexcept
+{
+	assert(holding_db_lock());
+
+	directory.dirty = false;
+
+	for (auto &child : directory.children)
+		db_journal_clear(child);
+}
+
+/**
+ * Replace the contents of the given directory with the record.
+ */
+static void
+LoadRecord(TextFile &file, Directory &directory)
+{
+	if (!directory.IsRoot()) {
+		directory.mtime = std::chrono::system_clock::time_point::min();
+		directory.device = 0;
+	}
+
+	directory.ForEachSongSafe([&directory](Song &song){
+			directory.RemoveSong(&song);
+			song.Free();
+		});
+
+	directory.playlists.clear();
+
+	std::set<std::string> children;
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr &&
+	       !StringIsEqual(line, JOURNAL_END)) {
+		const char *p;
+		if ((p = StringAfterPrefix(line, JOURNAL_CHILD))) {
+			children.emplace(p);
+			directory.MakeChild(p);
+		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+			directory_load_song(file, directory, p);
+		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
+			const char *name = p;
+			playlist_metadata_load(file, directory.playlists, name);
+		} else if (directory.IsRoot() ||
+			   !directory_load_attribute(directory, line)) {
+			throw FormatRuntimeError("Malformed line: %s", line);
+		}
+	}
+
+	if (line == nullptr)
+		throw std::runtime_error("Unexpected end of file");
+
+	/* delete the children which were not listed */
+	directory.ForEachChildSafe([&children](Directory &child){
+			if (!child.IsMount() &&
+			    children.find(child.GetName()) == children.end())
+				child.Delete();
+		});
+}
+
+/**
+ * Read and check the journal header.
+ *
+ * @return 1 if the journal applies to the given database file, 0 if
+ * it is empty, -1 if it is stale
+ */
+static int
+CheckHeader(TextFile &file, const char *base)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr)
+		/* empty journal */
+		return 0;
+
+	const char *p = StringAfterPrefix(line, JOURNAL_BASE);
+	if (p == nullptr)
+		throw std::runtime_error("Database journal corrupted");
+
+	return StringIsEqual(p, base) ? 1 : -1;
+}
+
+/**
+ * Count the complete records, i.e. those which are terminated with
+ * #JOURNAL_END.  (No other line can be equal to #JOURNAL_END,
+ * because all other lines begin with a keyword.)
+ *
+ * @param truncated set to true if there is an incomplete record
+ * after the last complete one
+ */
+static unsigned
+CountCompleteRecords(TextFile &file, bool &truncated)
+{
+	unsigned n = 0;
+	truncated = false;
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (StringIsEqual(line, JOURNAL_END)) {
+			++n;
+			truncated = false;
+		} else
+			truncated = true;
+	}
+
+	return n;
+}
+
+int
+db_journal_load(Path path_fs, Directory &root, const char *base,
+		bool &truncated)
+{
+	unsigned n_complete;
+
+	{
+		/* first pass: find out where the last complete
+		   record ends; an interrupted write may have left an
+		   incomplete one behind */
+		TextFile file(path_fs);
+		const int result = CheckHeader(file, base);
+		if (result <= 0) {
+			truncated = false;
+			return result;
+		}
+
+		n_complete = CountCompleteRecords(file, truncated);
+	}
+
+	TextFile file(path_fs);
+	if (CheckHeader(file, base) <= 0)
+		throw std::runtime_error("Database journal modified while loading");
+
+	const ScopeDatabaseLock protect;
+
+	for (unsigned n = 0; n < n_complete; ++n) {
+		const char *line = file.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of file");
+
+		const char *p = StringAfterPrefix(line, JOURNAL_DIRECTORY);
+		if (p == nullptr)
+			throw FormatRuntimeError("Malformed line: %s", line);
+
+		const auto lr = root.LookupDirectory(p);
+		if (lr.uri != nullptr)
+			/* the parent record should have created
+			   it */
+			throw FormatRuntimeError("No such directory: %s", p);
+
+		LoadRecord(file, *lr.directory);
+	}
+
+	return n_complete;
+}
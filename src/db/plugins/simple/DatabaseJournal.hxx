@@ -0,0 +1,87 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+struct Directory;
+class Path;
+class BufferedOutputStream;
+
+/*
+ * The database journal is a text file next to the database file.
+ * After each update, a record is appended for each directory which
+ * is marked "dirty" (see Directory::dirty); it contains the
+ * complete contents of that directory (but not of its children),
+ * so the I/O of a small update is proportional to the number of
+ * modified directories, not to the size of the database.
+ *
+ * The journal begins with an identifier of the database file it
+ * applies to; a journal which does not match the database file is
+ * ignored.
+ */
+
+/**
+ * Write the journal header.
+ *
+ * @param base an identifier of the database file this journal
+ * applies to
+ */
+void
+db_journal_begin(BufferedOutputStream &os, const char *base);
+
+/**
+ * Append a record for each "dirty" directory and clear the flags.
+ * Mount points are skipped.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @return the number of records written
+ */
+unsigned
+db_journal_save(BufferedOutputStream &os, Directory &root);
+
+/**
+ * Clear the "dirty" flag of all directories, e.g. after the whole
+ * database has been written or loaded.
+ *
+ * Caller must lock the #db_mutex.
+ */
+void
+db_journal_clear(Directory &root) noexcept;
+
+/**
+ * Replay a journal.  The directories are not sorted.
+ *
+ * An incomplete record at the end (left behind by an interrupted
+ * write) is ignored; all complete records before it are replayed.
+ * New records must not be appended after it.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param base the identifier of the database file which was loaded
+ * @param truncated set to true if an incomplete record was ignored
+ * @return the number of records, or -1 if the journal does not
+ * apply to this database file
+ */
+int
+db_journal_load(Path path_fs, Directory &root, const char *base,
+		bool &truncated);
+
+#endif
@@ -21,8 +21,12 @@
 #include "db/DatabaseLock.hxx"
 #include "Directory.hxx"
 #include "DirectorySave.hxx"
+#include "BinaryDatabase.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/TextFile.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/Path.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Settings.hxx"
 #include "fs/Charset.hxx"
@@ -129,3 +133,38 @@ db_load_internal(TextFile &file, Directory &music_root)
 	const ScopeDatabaseLock protect;
 	directory_load(file, music_root);
 }
+
+/**
+ * Read the first bytes of the file, to determine its format.
+ */
+static bool
+IsBinaryDatabaseFile(Path path)
+{
+	FileReader reader(path);
+
+	char head[16];
+	size_t length = 0;
+	while (length < sizeof(head)) {
+		size_t nbytes = reader.Read(head + length,
+					    sizeof(head) - length);
+		if (nbytes == 0)
+			break;
+
+		length += nbytes;
+	}
+
+	return db_is_binary({head, length});
+}
+
+void
+db_load_file(Path path, Directory &root)
+{
+	if (IsBinaryDatabaseFile(path)) {
+		const MappedFile image(path);
+		db_load_binary(image.GetBuffer(), root);
+		return;
+	}
+
+	TextFile file(path);
+	db_load_internal(file, root);
+}
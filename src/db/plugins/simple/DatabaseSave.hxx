@@ -23,6 +23,7 @@
 struct Directory;
 class BufferedOutputStream;
 class TextFile;
+class Path;
 
 void
 db_save_internal(BufferedOutputStream &os, const Directory &root);
@@ -33,4 +34,15 @@ db_save_internal(BufferedOutputStream &os, const Directory &root);
 void
 db_load_internal(TextFile &file, Directory &root);
 
+/**
+ * Load a database file into the given (empty) root directory,
+ * auto-detecting its format: the binary format (see
+ * BinaryDatabase.hxx) is mapped into memory, the text format
+ * (optionally gzip-compressed) is parsed line by line.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_file(Path path, Directory &root);
+
 #endif
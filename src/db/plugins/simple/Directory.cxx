@@ -37,6 +37,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+unsigned Directory::serial;
+
 Directory::Directory(std::string &&_path_utf8, Directory *_parent)
 	:parent(_parent),
 	 path(std::move(_path_utf8))
@@ -47,6 +49,10 @@ Directory::~Directory()
 {
 	delete mounted_database;
 
+	/* drop the indexes first, they refer to the list items */
+	song_index.reset();
+	child_index.reset();
+
 	songs.clear_and_dispose(Song::Disposer());
 	children.clear_and_dispose(DeleteDisposer());
 }
@@ -57,8 +63,21 @@ Directory::Delete()
 	assert(holding_db_lock());
 	assert(parent != nullptr);
 
-	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
-					   DeleteDisposer());
+	parent->DeleteChild(*this);
+}
+
+Directory::List::iterator
+Directory::DeleteChild(Directory &child) noexcept
+{
+	assert(child.parent == this);
+
+	MarkDirty();
+
+	if (child_index)
+		child_index->Erase(child);
+
+	return children.erase_and_dispose(children.iterator_to(child),
+					  DeleteDisposer());
 }
 
 const char *
@@ -82,6 +101,13 @@ Directory::CreateChild(const char *name_utf8)
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	MarkDirty();
+
+	if (child_index)
+		child_index->Insert(*child);
+	else if (ChildIndex::IsWorthwhile(children))
+		child_index.reset(new ChildIndex(children));
+
 	return child;
 }
 
@@ -90,6 +116,9 @@ Directory::FindChild(const char *name) const noexcept
 {
 	assert(holding_db_lock());
 
+	if (child_index)
+		return child_index->Find(name);
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -107,8 +136,7 @@ Directory::PruneEmpty() noexcept
 		child->PruneEmpty();
 
 		if (child->IsEmpty() && !child->IsMount())
-			child = children.erase_and_dispose(child,
-							   DeleteDisposer());
+			child = DeleteChild(*child);
 		else
 			++child;
 	}
@@ -167,6 +195,12 @@ Directory::AddSong(Song *song)
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+	MarkDirty();
+
+	if (song_index)
+		song_index->Insert(*song);
+	else if (SongIndex::IsWorthwhile(songs))
+		song_index.reset(new SongIndex(songs));
 }
 
 void
@@ -176,7 +210,11 @@ Directory::RemoveSong(Song *song) noexcept
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	if (song_index)
+		song_index->Erase(*song);
+
 	songs.erase(songs.iterator_to(*song));
+	MarkDirty();
 }
 
 const Song *
@@ -185,6 +223,9 @@ Directory::FindSong(const char *name_utf8) const noexcept
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index)
+		return song_index->Find(name_utf8);
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -207,6 +248,8 @@ Directory::Sort() noexcept
 {
 	assert(holding_db_lock());
 
+	++serial;
+
 	children.sort(directory_cmp);
 	song_list_sort(songs);
 
@@ -225,7 +268,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		const ScopeDatabaseUnlock unlock;
+		const ScopeDatabaseSharedUnlock unlock;
 		WalkMount(GetPath(), *mounted_database,
 			  "", DatabaseSelection("", recursive, filter),
 			  visit_directory, visit_song,
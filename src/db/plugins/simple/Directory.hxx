@@ -24,9 +24,11 @@
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "Song.hxx"
+#include "NameIndex.hxx"
 
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
 #include <string>
 
 /**
@@ -49,6 +51,7 @@ struct Directory {
 	static constexpr auto link_mode = boost::intrusive::normal_link;
 	typedef boost::intrusive::link_mode<link_mode> LinkMode;
 	typedef boost::intrusive::list_member_hook<LinkMode> Hook;
+	typedef boost::intrusive::unordered_set_member_hook<LinkMode> IndexHook;
 
 	/**
 	 * Pointers to the siblings of this directory within the
@@ -56,20 +59,49 @@ struct Directory {
 	 * directory.
 	 *
 	 * This attribute is protected with the global #db_mutex.
-	 * Read access in the update thread does not need protection.
+	 * Modifications need an exclusive lock; the update job which
+	 * scans the directory may read it without the lock.
 	 */
 	Hook siblings;
 
+	/**
+	 * The hook for the parent's #child_index.  It is unused if
+	 * the parent directory has no index.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Modifications need an exclusive lock; the update job which
+	 * scans the directory may read it without the lock.
+	 */
+	IndexHook index_hook;
+
 	typedef boost::intrusive::member_hook<Directory, Hook,
 					      &Directory::siblings> SiblingsHook;
 	typedef boost::intrusive::list<Directory, SiblingsHook,
 				       boost::intrusive::constant_time_size<false>> List;
 
+	struct GetChildName {
+		const char *operator()(const Directory &directory) const noexcept {
+			return directory.GetName();
+		}
+	};
+
+	struct GetSongName {
+		const char *operator()(const Song &song) const noexcept {
+			return song.uri;
+		}
+	};
+
+	typedef NameIndex<Directory, IndexHook, &Directory::index_hook,
+			  GetChildName> ChildIndex;
+	typedef NameIndex<Song, Song::IndexHook, &Song::index_hook,
+			  GetSongName> SongIndex;
+
 	/**
 	 * A doubly linked list of child directories.
 	 *
 	 * This attribute is protected with the global #db_mutex.
-	 * Read access in the update thread does not need protection.
+	 * Modifications need an exclusive lock; the update job which
+	 * scans the directory may read it without the lock.
 	 */
 	List children;
 
@@ -77,10 +109,26 @@ struct Directory {
 	 * A doubly linked list of songs within this directory.
 	 *
 	 * This attribute is protected with the global #db_mutex.
-	 * Read access in the update thread does not need protection.
+	 * Modifications need an exclusive lock; the update job which
+	 * scans the directory may read it without the lock.
 	 */
 	SongList songs;
 
+	/**
+	 * Hash indexes for FindChild() and FindSong(), which are
+	 * created by CreateChild() and AddSong() as soon as the
+	 * respective list grows beyond NameIndex::THRESHOLD.  The
+	 * lists remain authoritative for the order of the entries.
+	 *
+	 * These attributes are protected with the global #db_mutex:
+	 * lookups need at least a shared lock, modifications an
+	 * exclusive one.  This applies to the update workers as
+	 * well, because several of them may run at the same time
+	 * (see "update_threads").
+	 */
+	std::unique_ptr<ChildIndex> child_index;
+	std::unique_ptr<SongIndex> song_index;
+
 	PlaylistVector playlists;
 
 	Directory *const parent;
@@ -90,6 +138,19 @@ struct Directory {
 
 	uint64_t inode = 0, device = 0;
 
+	/**
+	 * Was the contents of this directory (its attributes, the
+	 * list of child directories, its songs or playlists) modified
+	 * since the database file or its journal was written?  This
+	 * flag is set by the methods of this class which modify the
+	 * directory; code which modifies attributes directly must set
+	 * it manually, and code which modifies songs directly must
+	 * call MarkDirty().
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	bool dirty = true;
+
 	const std::string path;
 
 	/**
@@ -98,6 +159,16 @@ struct Directory {
 	 */
 	Database *mounted_database = nullptr;
 
+	/**
+	 * A counter which is incremented each time any directory tree
+	 * is modified (songs added, removed, modified or reordered).
+	 * It allows caches such as #TagIndex to detect that they are
+	 * stale.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	static unsigned serial;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent);
 	~Directory();
@@ -114,6 +185,17 @@ public:
 		return mounted_database != nullptr;
 	}
 
+	/**
+	 * Set the #dirty flag and invalidate caches after modifying
+	 * this directory or one of its songs.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void MarkDirty() noexcept {
+		dirty = true;
+		++serial;
+	}
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
@@ -264,7 +346,7 @@ public:
 	void Sort() noexcept;
 
 	/**
-	 * Caller must lock #db_mutex.
+	 * Caller must hold a shared lock on #db_mutex.
 	 */
 	void Walk(bool recursive, const SongFilter *match,
 		  VisitDirectory visit_directory, VisitSong visit_song,
@@ -272,6 +354,15 @@ public:
 
 	gcc_pure
 	LightDirectory Export() const noexcept;
+
+private:
+	/**
+	 * Remove the given child directory from this directory's list
+	 * (and the index) and free it.
+	 *
+	 * @return an iterator to the next child
+	 */
+	List::iterator DeleteChild(Directory &child) noexcept;
 };
 
 #endif
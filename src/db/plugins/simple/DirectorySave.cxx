@@ -67,17 +67,23 @@ ParseTypeString(const char *type) noexcept
 }
 
 void
-directory_save(BufferedOutputStream &os, const Directory &directory)
+directory_save_attributes(BufferedOutputStream &os,
+			  const Directory &directory)
 {
-	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Format(DIRECTORY_TYPE "%s\n", type);
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Format(DIRECTORY_TYPE "%s\n", type);
 
-		if (!IsNegative(directory.mtime))
-			os.Format(DIRECTORY_MTIME "%lu\n",
-				  (unsigned long)std::chrono::system_clock::to_time_t(directory.mtime));
+	if (!IsNegative(directory.mtime))
+		os.Format(DIRECTORY_MTIME "%lu\n",
+			  (unsigned long)std::chrono::system_clock::to_time_t(directory.mtime));
+}
 
+void
+directory_save(BufferedOutputStream &os, const Directory &directory)
+{
+	if (!directory.IsRoot()) {
+		directory_save_attributes(os, directory);
 		os.Format("%s%s\n", DIRECTORY_BEGIN, directory.GetPath());
 	}
 
@@ -98,8 +104,8 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 		os.Format(DIRECTORY_END "%s\n", directory.GetPath());
 }
 
-static bool
-ParseLine(Directory &directory, const char *line)
+bool
+directory_load_attribute(Directory &directory, const char *line)
 {
 	const char *p;
 	if ((p = StringAfterPrefix(line, DIRECTORY_MTIME))) {
@@ -131,7 +137,7 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 			if (StringStartsWith(line, DIRECTORY_BEGIN))
 				break;
 
-			if (!ParseLine(*directory, line))
+			if (!directory_load_attribute(*directory, line))
 				throw FormatRuntimeError("Malformed line: %s", line);
 		}
 
@@ -144,6 +150,21 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name)
 	return directory;
 }
 
+void
+directory_load_song(TextFile &file, Directory &directory, const char *name)
+{
+	if (directory.FindSong(name) != nullptr)
+		throw FormatRuntimeError("Duplicate song '%s'", name);
+
+	auto audio_format = AudioFormat::Undefined();
+	auto detached_song = song_load(file, name, &audio_format);
+
+	auto song = Song::NewFrom(std::move(*detached_song), directory);
+	song->audio_format = audio_format;
+
+	directory.AddSong(song);
+}
+
 void
 directory_load(TextFile &file, Directory &directory)
 {
@@ -155,20 +176,7 @@ directory_load(TextFile &file, Directory &directory)
 		if ((p = StringAfterPrefix(line, DIRECTORY_DIR))) {
 			directory_load_subdir(file, directory, p);
 		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
-			const char *name = p;
-
-			if (directory.FindSong(name) != nullptr)
-				throw FormatRuntimeError("Duplicate song '%s'", name);
-
-			auto audio_format = AudioFormat::Undefined();
-			auto detached_song = song_load(file, name,
-						       &audio_format);
-
-			auto song = Song::NewFrom(std::move(*detached_song),
-						  directory);
-			song->audio_format = audio_format;
-
-			directory.AddSong(song);
+			directory_load_song(file, directory, p);
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
 			const char *name = p;
 			playlist_metadata_load(file, directory.playlists, name);
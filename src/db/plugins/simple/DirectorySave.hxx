@@ -27,10 +27,35 @@ class BufferedOutputStream;
 void
 directory_save(BufferedOutputStream &os, const Directory &directory);
 
+/**
+ * Write the attributes (type and modification time) of a directory,
+ * but not its contents.
+ */
+void
+directory_save_attributes(BufferedOutputStream &os,
+			  const Directory &directory);
+
+/**
+ * Parse a line written by directory_save_attributes().
+ *
+ * @return false if this is not an attribute line
+ */
+bool
+directory_load_attribute(Directory &directory, const char *line);
+
 /**
  * Throws #std::runtime_error on error.
  */
 void
 directory_load(TextFile &file, Directory &directory);
 
+/**
+ * Load one song (after the "song_begin" line) and add it to the
+ * directory.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+directory_load_song(TextFile &file, Directory &directory, const char *name);
+
 #endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_NAME_INDEX_HXX
+#define MPD_NAME_INDEX_HXX
+
+#include "util/Compiler.h"
+
+#include <boost/intrusive/unordered_set.hpp>
+
+#include <memory>
+
+#include <string.h>
+
+/**
+ * A hash index which allows looking up the entries of a
+ * boost::intrusive::list (e.g. the songs of a #Directory) by name.
+ * The list remains the owner of the objects and determines their
+ * order; this class only provides an additional access path.
+ *
+ * @param T the indexed type
+ * @param Hook the type of the unordered_set member hook in #T
+ * @param hook a pointer to the hook in #T
+ * @param GetName a function object type returning the name of a #T
+ */
+template<typename T, typename Hook, Hook T::*hook, typename GetName>
+class NameIndex {
+	struct Hash {
+		gcc_pure
+		size_t operator()(const char *p) const noexcept {
+			size_t hash = 5381;
+			while (*p != 0)
+				hash = (hash << 5) + hash + (unsigned char)*p++;
+			return hash;
+		}
+
+		gcc_pure
+		size_t operator()(const T &t) const noexcept {
+			return (*this)(GetName()(t));
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const T &a, const T &b) const noexcept {
+			return strcmp(GetName()(a), GetName()(b)) == 0;
+		}
+
+		gcc_pure
+		bool operator()(const char *a, const T &b) const noexcept {
+			return strcmp(a, GetName()(b)) == 0;
+		}
+	};
+
+	/* a multiset, because nothing prevents a list from
+	   containing duplicate names */
+	typedef boost::intrusive::unordered_multiset<T,
+						     boost::intrusive::member_hook<T, Hook, hook>,
+						     boost::intrusive::hash<Hash>,
+						     boost::intrusive::equal<Equal>,
+						     boost::intrusive::constant_time_size<true>,
+						     boost::intrusive::power_2_buckets<true>> Set;
+
+	typedef typename Set::bucket_type Bucket;
+	typedef typename Set::bucket_traits BucketTraits;
+
+	static constexpr size_t INITIAL_BUCKETS = 64;
+
+	std::unique_ptr<Bucket[]> buckets;
+
+	Set set;
+
+public:
+	/**
+	 * Lists shorter than this are searched linearly; an index is
+	 * only created once a list grows beyond this size.
+	 */
+	static constexpr size_t THRESHOLD = 32;
+
+	/**
+	 * Create an index for all items of the given list.
+	 */
+	template<typename List>
+	explicit NameIndex(List &list)
+		:buckets(new Bucket[INITIAL_BUCKETS]),
+		 set(BucketTraits(buckets.get(), INITIAL_BUCKETS)) {
+		for (auto &i : list)
+			Insert(i);
+	}
+
+	~NameIndex() noexcept {
+		set.clear();
+	}
+
+	NameIndex(const NameIndex &) = delete;
+	NameIndex &operator=(const NameIndex &) = delete;
+
+	size_t size() const noexcept {
+		return set.size();
+	}
+
+	void Insert(T &t) {
+		set.insert(t);
+
+		if (set.size() > set.bucket_count())
+			Grow();
+	}
+
+	void Erase(T &t) noexcept {
+		set.erase(set.iterator_to(t));
+	}
+
+	gcc_pure
+	const T *Find(const char *name) const noexcept {
+		auto i = set.find(name, Hash(), Equal());
+		return i != set.end()
+			? &*i
+			: nullptr;
+	}
+
+	/**
+	 * Returns true if the given list (which has no index yet)
+	 * has grown large enough to deserve one.
+	 */
+	template<typename List>
+	gcc_pure
+	static bool IsWorthwhile(const List &list) noexcept {
+		size_t n = 0;
+		for (auto i = list.begin(), end = list.end(); i != end; ++i)
+			if (++n > THRESHOLD)
+				return true;
+
+		return false;
+	}
+
+private:
+	void Grow() {
+		const size_t n = set.bucket_count() * 2;
+		std::unique_ptr<Bucket[]> new_buckets(new Bucket[n]);
+		set.rehash(BucketTraits(new_buckets.get(), n));
+		buckets = std::move(new_buckets);
+	}
+};
+
+#endif
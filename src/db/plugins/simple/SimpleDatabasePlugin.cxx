@@ -31,16 +31,22 @@
 #include "Directory.hxx"
 #include "Song.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseJournal.hxx"
+#include "BinaryDatabase.hxx"
+#include "TagIndex.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
+#include "thread/Name.hxx"
 #include "tag/Mask.hxx"
-#include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
 #include "util/CharUtil.hxx"
+#include "util/StringAPI.hxx"
+#include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -51,37 +57,102 @@
 #include <memory>
 
 #include <errno.h>
+#include <stdio.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * The journal is compacted (i.e. the whole database file is
+ * rewritten) when it grows beyond 1/JOURNAL_COMPACT_RATIO of the
+ * database file size.
+ */
+static constexpr unsigned JOURNAL_COMPACT_RATIO = 2;
+
+/**
+ * Journals smaller than this are never compacted.
+ */
+static constexpr uint64_t JOURNAL_COMPACT_MIN = 256 * 1024;
+
+static bool
+ParseFormat(const char *format)
+{
+	if (StringIsEqual(format, "text"))
+		return false;
+	else if (StringIsEqual(format, "binary"))
+		return true;
+	else
+		throw FormatRuntimeError("Unknown database format: %s",
+					 format);
+}
+
+static AllocatedPath
+MakeJournalPath(Path path) noexcept
+{
+	return AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+				     PATH_LITERAL(".journal"));
+}
+
+/**
+ * Build a string which identifies this version of the database
+ * file.
+ */
+static std::string
+MakeJournalBase(const FileInfo &fi) noexcept
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%llu %llu %lld",
+#ifdef _WIN32
+		 0ULL,
+#else
+		 (unsigned long long)fi.GetInode(),
+#endif
+		 (unsigned long long)fi.GetSize(),
+		 (long long)std::chrono::system_clock::to_time_t(fi.GetModificationTime()));
+	return buffer;
+}
+
 inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 	:Database(simple_db_plugin),
 	 path(block.GetPath("path")),
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
+	 binary(ParseFormat(block.GetBlockValue("format", "text"))),
+	 journal(block.GetBlockValue("journal", false)),
+	 journal_path(nullptr),
+	 use_tag_index(block.GetBlockValue("tag_index", true)),
 	 cache_path(block.GetPath("cache_directory")),
-	 prefixed_light_song(nullptr)
+	 prefixed_light_song(nullptr),
+	 tag_index_thread(BIND_THIS_METHOD(RunTagIndexThread))
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
 
 	path_utf8 = path.ToUTF8();
+
+	if (journal)
+		journal_path = MakeJournalPath(path);
 }
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef ENABLE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress) noexcept
+				      bool _compress,
+				      bool _binary) noexcept
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
+	 binary(_binary),
+	 journal(false),
+	 journal_path(nullptr),
+	 use_tag_index(true),
 	 cache_path(nullptr),
-	 prefixed_light_song(nullptr) {
+	 prefixed_light_song(nullptr),
+	 tag_index_thread(BIND_THIS_METHOD(RunTagIndexThread)) {
 }
 
 Database *
@@ -151,15 +222,66 @@ SimpleDatabase::Load()
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path);
-
 	LogDebug(simple_db_domain, "reading DB");
 
-	db_load_internal(file, *root);
+	db_load_file(path, *root);
+
+	{
+		const ScopeDatabaseLock protect;
+		db_journal_clear(*root);
+	}
 
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(path, fi)) {
 		mtime = fi.GetModificationTime();
+
+		if (journal)
+			LoadJournal(fi);
+	}
+}
+
+inline void
+SimpleDatabase::LoadJournal(const FileInfo &fi)
+{
+	journal_base = MakeJournalBase(fi);
+
+	FileInfo journal_fi;
+	if (!GetFileInfo(journal_path, journal_fi))
+		return;
+
+	LogDebug(simple_db_domain, "reading DB journal");
+
+	bool truncated;
+	const int n = db_journal_load(journal_path, *root,
+				      journal_base.c_str(), truncated);
+
+	if (n < 0) {
+		LogDefault(simple_db_domain,
+			   "Discarding stale database journal");
+		RemoveFile(journal_path);
+		return;
+	}
+
+	if (truncated) {
+		LogDefault(simple_db_domain,
+			   "Ignoring incomplete database journal record");
+
+		/* appending to this journal would leave the
+		   incomplete record in the middle; rewrite the whole
+		   database file next time (which removes the
+		   journal) */
+		journal_base.clear();
+	}
+
+	{
+		const ScopeDatabaseLock protect;
+		root->Sort();
+		db_journal_clear(*root);
+	}
+
+	mtime = journal_fi.GetModificationTime();
+
+	FormatDebug(simple_db_domain, "replayed %d DB journal records", n);
 }
 
 void
@@ -181,10 +303,16 @@ SimpleDatabase::Open()
 
 		delete root;
 
+		/* rewrite the whole database file next time */
+		journal_base.clear();
+
 		Check();
 
 		root = Directory::NewRoot();
 	}
+
+	if (use_tag_index)
+		StartTagIndexThread();
 }
 
 void
@@ -194,6 +322,10 @@ SimpleDatabase::Close() noexcept
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	if (tag_index_thread.IsDefined())
+		tag_index_thread.Join();
+
+	tag_index.reset();
 	delete root;
 }
 
@@ -266,6 +398,60 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const noexcept
 	}
 }
 
+void
+SimpleDatabase::VisitSongs(ConstBuffer<const char *> uris,
+			   VisitSong visit_song) const
+{
+	assert(root != nullptr);
+
+	ScopeDatabaseSharedLock protect;
+
+	/* consecutive songs are usually in the same directory;
+	   remember it to avoid looking it up again */
+	std::string parent_uri;
+	const Directory *parent = nullptr;
+
+	for (const char *uri : uris) {
+		const char *slash = strrchr(uri, '/');
+		const char *name = slash != nullptr ? slash + 1 : uri;
+		const size_t parent_length = slash != nullptr
+			? size_t(slash - uri)
+			: 0;
+
+		if (parent == nullptr ||
+		    parent_uri.compare(0, std::string::npos,
+				       uri, parent_length) != 0) {
+			parent_uri.assign(uri, parent_length);
+
+			auto r = root->LookupDirectory(parent_uri.c_str());
+			if (r.directory->IsMount()) {
+				/* pass the request to the mounted
+				   database */
+				parent = nullptr;
+
+				const ScopeDatabaseSharedUnlock unlock;
+				const LightSong *song = GetSong(uri);
+				AtScopeExit(this, song) { ReturnSong(song); };
+				visit_song(*song);
+				continue;
+			}
+
+			if (r.uri != nullptr)
+				throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+						    "No such song");
+
+			parent = r.directory;
+		}
+
+		const Song *song = parent->FindSong(name);
+		if (song == nullptr)
+			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+					    "No such song");
+
+		visit_song(song->Export());
+	}
+}
+
 gcc_const
 static DatabaseSelection
 CheckSelection(DatabaseSelection selection) noexcept
@@ -281,7 +467,7 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitSong visit_song,
 		      VisitPlaylist visit_playlist) const
 {
-	ScopeDatabaseLock protect;
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 
@@ -301,6 +487,18 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	if (r.uri == nullptr) {
 		/* it's a directory */
 
+		if (selection.filter != nullptr && visit_song &&
+		    !visit_directory && !visit_playlist &&
+		    TagIndex::CanVisit(*selection.filter)) {
+			const auto index = GetTagIndex();
+			if (index != nullptr &&
+			    index->Visit(*r.directory, selection.recursive,
+					 *selection.filter, visit_song)) {
+				helper.Commit();
+				return;
+			}
+		}
+
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
@@ -333,9 +531,86 @@ std::map<std::string, std::set<std::string>>
 SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				  TagType tag_type, TagType group) const
 {
+	if (selection.IsEmpty() && selection.recursive &&
+	    tag_type != TAG_NUM_OF_ITEM_TYPES &&
+	    group == TAG_NUM_OF_ITEM_TYPES) {
+		/* the whole database without a filter: take the
+		   values from the index instead of visiting each
+		   song */
+		const ScopeDatabaseSharedLock protect;
+
+		const auto index = GetTagIndex();
+		if (index != nullptr) {
+			std::map<std::string, std::set<std::string>> result;
+			index->CollectValues(tag_type, result[""]);
+			return result;
+		}
+	}
+
 	return ::CollectUniqueTags(*this, selection, tag_type, group);
 }
 
+void
+SimpleDatabase::BuildTagIndex() noexcept
+{
+	try {
+		/* the tree cannot be modified while we hold the
+		   shared lock, so the new index is still valid when
+		   it gets installed */
+		const ScopeDatabaseSharedLock protect;
+
+		std::shared_ptr<const TagIndex> index =
+			std::make_shared<TagIndex>(*root);
+
+		const std::lock_guard<Mutex> lock(tag_index_mutex);
+		tag_index = std::move(index);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to build the tag index");
+	}
+}
+
+void
+SimpleDatabase::StartTagIndexThread() noexcept
+{
+	/* wait for the previous build, which was started from the
+	   same thread */
+	if (tag_index_thread.IsDefined())
+		tag_index_thread.Join();
+
+	try {
+		tag_index_thread.Start();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to build the tag index");
+	}
+}
+
+void
+SimpleDatabase::RunTagIndexThread() noexcept
+{
+	SetThreadName("tag_index");
+
+	BuildTagIndex();
+}
+
+std::shared_ptr<const TagIndex>
+SimpleDatabase::GetTagIndex() const noexcept
+{
+	assert(holding_db_lock());
+
+	/* the tree cannot be modified while we hold the (shared)
+	   db_mutex, so the index returned here stays valid until the
+	   caller releases it */
+	const std::lock_guard<Mutex> protect(tag_index_mutex);
+
+	if (tag_index == nullptr || !tag_index->IsValid() ||
+	    tag_index->HasMounts())
+		return nullptr;
+
+	return tag_index;
+}
+
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
@@ -355,10 +630,100 @@ SimpleDatabase::Save()
 		root->Sort();
 	}
 
+	/* the update is finished; replace the stale TagIndex while
+	   we're still in the update thread */
+	if (use_tag_index)
+		BuildTagIndex();
+
+	if (journal && !journal_base.empty()) {
+		try {
+			if (SaveJournal())
+				return;
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to write database journal");
+		}
+	}
+
 	LogDebug(simple_db_domain, "writing DB");
 
 	FileOutputStream fos(path);
 
+	if (binary)
+		SaveBinary(fos);
+	else
+		SaveText(fos);
+
+	fos.Commit();
+
+	{
+		const ScopeDatabaseLock protect;
+		db_journal_clear(*root);
+	}
+
+	FileInfo fi;
+	if (GetFileInfo(path, fi))
+		mtime = fi.GetModificationTime();
+
+	if (journal) {
+		/* the new database file contains everything; the
+		   journal is obsolete (and would be recognized as
+		   stale anyway) */
+		journal_base = MakeJournalBase(fi);
+
+		try {
+			RemoveFile(journal_path);
+		} catch (...) {
+		}
+	}
+}
+
+inline bool
+SimpleDatabase::SaveJournal()
+{
+	FileInfo fi;
+	const bool exists = GetFileInfo(journal_path, fi);
+
+	LogDebug(simple_db_domain, "writing DB journal");
+
+	FileOutputStream fos(journal_path,
+			     FileOutputStream::Mode::APPEND_OR_CREATE);
+	BufferedOutputStream bos(fos);
+
+	if (!exists || fi.GetSize() == 0)
+		db_journal_begin(bos, journal_base.c_str());
+
+	unsigned n;
+
+	{
+		const ScopeDatabaseLock protect;
+		n = db_journal_save(bos, *root);
+	}
+
+	bos.Flush();
+	fos.Commit();
+
+	FormatDebug(simple_db_domain, "wrote %u DB journal records", n);
+
+	if (!GetFileInfo(journal_path, fi))
+		return false;
+
+	mtime = fi.GetModificationTime();
+
+	const uint64_t journal_size = fi.GetSize();
+	if (journal_size >= JOURNAL_COMPACT_MIN &&
+	    (!GetFileInfo(path, fi) ||
+	     journal_size * JOURNAL_COMPACT_RATIO > fi.GetSize())) {
+		LogDebug(simple_db_domain, "compacting DB journal");
+		return false;
+	}
+
+	return true;
+}
+
+inline void
+SimpleDatabase::SaveText(OutputStream &fos)
+{
 	OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
@@ -371,7 +736,12 @@ SimpleDatabase::Save()
 
 	BufferedOutputStream bos(*os);
 
-	db_save_internal(bos, *root);
+	{
+		/* the main thread may mount or unmount while we
+		   write */
+		const ScopeDatabaseSharedLock protect;
+		db_save_internal(bos, *root);
+	}
 
 	bos.Flush();
 
@@ -381,12 +751,21 @@ SimpleDatabase::Save()
 		gzip.reset();
 	}
 #endif
+}
 
-	fos.Commit();
+inline void
+SimpleDatabase::SaveBinary(OutputStream &os)
+{
+	/* the binary format is never compressed, because it is
+	   meant to be mapped into memory */
+	BufferedOutputStream bos(os);
 
-	FileInfo fi;
-	if (GetFileInfo(path, fi))
-		mtime = fi.GetModificationTime();
+	{
+		const ScopeDatabaseSharedLock protect;
+		db_save_binary(bos, *root);
+	}
+
+	bos.Flush();
 }
 
 void
@@ -399,19 +778,25 @@ SimpleDatabase::Mount(const char *uri, Database *db)
 #endif
 	assert(*uri != 0);
 
-	ScopeDatabaseLock protect;
+	{
+		ScopeDatabaseLock protect;
 
-	auto r = root->LookupDirectory(uri);
-	if (r.uri == nullptr)
-		throw DatabaseError(DatabaseErrorCode::CONFLICT,
-				    "Already exists");
+		auto r = root->LookupDirectory(uri);
+		if (r.uri == nullptr)
+			throw DatabaseError(DatabaseErrorCode::CONFLICT,
+					    "Already exists");
 
-	if (strchr(r.uri, '/') != nullptr)
-		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
-				    "Parent not found");
+		if (strchr(r.uri, '/') != nullptr)
+			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+					    "Parent not found");
+
+		Directory *mnt = r.directory->CreateChild(r.uri);
+		mnt->mounted_database = db;
+	}
 
-	Directory *mnt = r.directory->CreateChild(r.uri);
-	mnt->mounted_database = db;
+	/* the new directory has made the TagIndex stale */
+	if (use_tag_index)
+		StartTagIndexThread();
 }
 
 static constexpr bool
@@ -442,7 +827,7 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	constexpr bool compress = false;
 #endif
 	auto db = new SimpleDatabase(cache_path / name_fs,
-				     compress);
+				     compress, binary);
 	try {
 		db->Open();
 	} catch (...) {
@@ -486,11 +871,17 @@ SimpleDatabase::Unmount(const char *uri) noexcept
 
 	db->Close();
 	delete db;
+
+	/* the TagIndex is stale now, and without this mount, it may
+	   become usable again */
+	if (use_tag_index)
+		StartTagIndexThread();
+
 	return true;
 }
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_CONCURRENT_READ,
 	SimpleDatabase::Create,
 };
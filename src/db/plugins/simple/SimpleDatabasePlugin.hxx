@@ -23,18 +23,24 @@
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "song/LightSong.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
 #include "util/Manual.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <cassert>
+#include <memory>
 
 struct ConfigBlock;
+class FileInfo;
 struct Directory;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
 class PrefixedLightSong;
+class OutputStream;
+class TagIndex;
 
 class SimpleDatabase : public Database {
 	AllocatedPath path;
@@ -44,6 +50,34 @@ class SimpleDatabase : public Database {
 	bool compress;
 #endif
 
+	/**
+	 * Save the database in the binary format (see
+	 * BinaryDatabase.hxx) instead of the text format?  Loading
+	 * detects the format automatically.
+	 */
+	bool binary;
+
+	/**
+	 * Append changes to a journal file (see DatabaseJournal.hxx)
+	 * instead of rewriting the whole database file after each
+	 * update?
+	 */
+	bool journal;
+
+	AllocatedPath journal_path;
+
+	/**
+	 * Identifies the database file which the journal applies to
+	 * (see MakeJournalBase()).  If this is empty, the next Save()
+	 * writes the whole database file.
+	 */
+	std::string journal_base;
+
+	/**
+	 * Answer queries from a #TagIndex?
+	 */
+	bool use_tag_index;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
@@ -68,9 +102,39 @@ class SimpleDatabase : public Database {
 	mutable unsigned borrowed_song_count;
 #endif
 
+	/**
+	 * Protects #tag_index, because GetTagIndex() may be called by
+	 * several threads holding a shared #db_mutex while
+	 * BuildTagIndex() replaces it.
+	 */
+	mutable Mutex tag_index_mutex;
+
+	/**
+	 * Built by BuildTagIndex() after loading the database,
+	 * after each update and after (un)mounting, never by a
+	 * query.  Between a
+	 * modification of the tree and the end of the update, it is
+	 * stale and queries walk the tree instead.
+	 *
+	 * This is a std::shared_ptr because a query may still be
+	 * using the old index while BuildTagIndex() installs a new
+	 * one.
+	 *
+	 * Protected with #tag_index_mutex.
+	 */
+	std::shared_ptr<const TagIndex> tag_index;
+
+	/**
+	 * Builds the #TagIndex after Open(), Mount() and Unmount(),
+	 * so neither these nor the following queries have to wait
+	 * for it.
+	 */
+	Thread tag_index_thread;
+
 	SimpleDatabase(const ConfigBlock &block);
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress) noexcept;
+	SimpleDatabase(AllocatedPath &&_path, bool _compress,
+		       bool _binary) noexcept;
 
 public:
 	static Database *Create(EventLoop &main_event_loop,
@@ -117,6 +181,9 @@ public:
 	const LightSong *GetSong(const char *uri_utf8) const override;
 	void ReturnSong(const LightSong *song) const noexcept override;
 
+	void VisitSongs(ConstBuffer<const char *> uris,
+			VisitSong visit_song) const override;
+
 	void Visit(const DatabaseSelection &selection,
 		   VisitDirectory visit_directory,
 		   VisitSong visit_song,
@@ -142,6 +209,49 @@ private:
 	 */
 	void Load();
 
+	/**
+	 * Replay the journal after the database file has been
+	 * loaded.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	void LoadJournal(const FileInfo &fi);
+
+	/**
+	 * Append the modified directories to the journal.
+	 *
+	 * Throws #std::runtime_error on error.
+	 *
+	 * @return false if the journal has grown too large and the
+	 * whole database file shall be written instead
+	 */
+	bool SaveJournal();
+
+	/**
+	 * Build a new #TagIndex from the current tree and install
+	 * it.  This holds a shared #db_mutex while it runs.
+	 */
+	void BuildTagIndex() noexcept;
+
+	/**
+	 * Run BuildTagIndex() in #tag_index_thread.  Must always be
+	 * called from the same thread (the main thread).
+	 */
+	void StartTagIndexThread() noexcept;
+
+	void RunTagIndexThread() noexcept;
+
+	/**
+	 * Returns the #TagIndex, or nullptr if there is none which
+	 * is up to date.  This never builds an index.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	std::shared_ptr<const TagIndex> GetTagIndex() const noexcept;
+
+	void SaveText(OutputStream &os);
+	void SaveBinary(OutputStream &os);
+
 	Database *LockUmountSteal(const char *uri) noexcept;
 };
 
@@ -27,6 +27,7 @@
 #include "config.h"
 
 #include <boost/intrusive/list.hpp>
+#include <boost/intrusive/unordered_set_hook.hpp>
 
 #include <string>
 
@@ -46,6 +47,7 @@ struct Song {
 	static constexpr auto link_mode = boost::intrusive::normal_link;
 	typedef boost::intrusive::link_mode<link_mode> LinkMode;
 	typedef boost::intrusive::list_member_hook<LinkMode> Hook;
+	typedef boost::intrusive::unordered_set_member_hook<LinkMode> IndexHook;
 
 	struct Disposer {
 		void operator()(Song *song) const {
@@ -59,10 +61,21 @@ struct Song {
 	 * not in the database.
 	 *
 	 * This attribute is protected with the global #db_mutex.
-	 * Read access in the update thread does not need protection.
+	 * Modifications need an exclusive lock; the update job which
+	 * scans the song's directory may read it without the lock.
 	 */
 	Hook siblings;
 
+	/**
+	 * The hook for Directory::song_index.  It is unused if the
+	 * parent directory has no index.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Modifications need an exclusive lock; the update job which
+	 * scans the song's directory may read it without the lock.
+	 */
+	IndexHook index_hook;
+
 	Tag tag;
 
 	/**
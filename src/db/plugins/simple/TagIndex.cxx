@@ -0,0 +1,226 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Tag.hxx"
+#include "tag/VisitFallback.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+TagIndex::TagIndex(const Directory &root)
+	:serial(Directory::serial)
+{
+	n_tagged.fill(0);
+	AddDirectory(root);
+}
+
+bool
+TagIndex::IsValid() const noexcept
+{
+	return serial == Directory::serial;
+}
+
+void
+TagIndex::AddDirectory(const Directory &directory)
+{
+	if (directory.IsMount())
+		has_mounts = true;
+
+	/* references to std::unordered_map elements remain valid
+	   while more elements are inserted by the recursion */
+	Range &range = directories[&directory];
+
+	range.begin = songs.size();
+	for (const auto &song : directory.songs)
+		AddSong(song);
+	range.own_end = songs.size();
+
+	for (const auto &child : directory.children)
+		AddDirectory(child);
+	range.end = songs.size();
+}
+
+void
+TagIndex::AddSong(const Song &song)
+{
+	const uint32_t i = songs.size();
+	songs.push_back(&song);
+
+	bool seen[TAG_NUM_OF_ITEM_TYPES];
+	std::fill_n(seen, size_t(TAG_NUM_OF_ITEM_TYPES), false);
+
+	for (const auto &item : song.tag) {
+		auto &list = values[item.type][item.value];
+		if (list.empty() || list.back() != i)
+			list.push_back(i);
+
+		if (!seen[item.type]) {
+			seen[item.type] = true;
+			++n_tagged[item.type];
+		}
+	}
+}
+
+const TagIndex::PostingList *
+TagIndex::Find(TagType type, const char *value) const noexcept
+{
+	const auto &map = values[type];
+	auto i = map.find(value);
+	return i != map.end()
+		? &i->second
+		: nullptr;
+}
+
+/**
+ * Can this filter item be answered by looking up its value in the
+ * index?
+ */
+gcc_pure
+static const TagSongFilter *
+GetIndexableFilter(const ISongFilter &f) noexcept
+{
+	const auto *tf = dynamic_cast<const TagSongFilter *>(&f);
+	if (tf == nullptr || tf->IsNegated() || tf->GetFoldCase() ||
+	    tf->IsSubstring() || tf->IsRegex() ||
+	    /* an empty value also matches songs without this tag */
+	    tf->GetValue().empty() ||
+	    /* "any" */
+	    tf->GetTagType() == TAG_NUM_OF_ITEM_TYPES)
+		return nullptr;
+
+	return tf;
+}
+
+bool
+TagIndex::CanVisit(const SongFilter &filter) noexcept
+{
+	for (const auto &i : filter.GetItems())
+		if (GetIndexableFilter(*i) != nullptr)
+			return true;
+
+	return false;
+}
+
+bool
+TagIndex::Visit(const Directory &directory, bool recursive,
+		const SongFilter &filter,
+		const VisitSong &visit_song) const
+{
+	const auto d = directories.find(&directory);
+	if (d == directories.end())
+		return false;
+
+	const uint32_t begin = d->second.begin;
+	const uint32_t end = recursive ? d->second.end : d->second.own_end;
+
+	/* find the most selective condition; a song may match
+	   through a fallback tag (e.g. "Artist" instead of
+	   "AlbumArtist"), therefore the candidates are the union of
+	   up to four posting lists */
+
+	static constexpr unsigned MAX_LISTS = 4;
+	const PostingList *best[MAX_LISTS];
+	unsigned n_best = 0;
+	bool found = false;
+	size_t best_size = 0;
+
+	for (const auto &i : filter.GetItems()) {
+		const auto *tf = GetIndexableFilter(*i);
+		if (tf == nullptr)
+			continue;
+
+		const char *value = tf->GetValue().c_str();
+		const PostingList *lists[MAX_LISTS];
+		unsigned n = 0;
+		size_t size = 0;
+
+		ApplyTagWithFallback(tf->GetTagType(), [&](TagType type){
+				const auto *list = Find(type, value);
+				if (list != nullptr) {
+					assert(n < MAX_LISTS);
+					lists[n++] = list;
+					size += list->size();
+				}
+
+				return false;
+			});
+
+		if (!found || size < best_size) {
+			found = true;
+			best_size = size;
+			n_best = n;
+			std::copy_n(lists, n, best);
+		}
+	}
+
+	if (!found)
+		return false;
+
+	std::vector<uint32_t> matches;
+	for (unsigned i = 0; i < n_best; ++i) {
+		const PostingList &list = *best[i];
+		matches.insert(matches.end(),
+			       std::lower_bound(list.begin(), list.end(),
+						begin),
+			       std::lower_bound(list.begin(), list.end(),
+						end));
+	}
+
+	if (n_best > 1) {
+		std::sort(matches.begin(), matches.end());
+		matches.erase(std::unique(matches.begin(), matches.end()),
+			      matches.end());
+	}
+
+	for (uint32_t i : matches) {
+		const LightSong song = songs[i]->Export();
+		if (filter.Match(song))
+			visit_song(song);
+	}
+
+	return true;
+}
+
+void
+TagIndex::CollectValues(TagType type, std::set<std::string> &result) const
+{
+	assert(type < TAG_NUM_OF_ITEM_TYPES);
+
+	for (const auto &i : values[type])
+		result.emplace(i.first);
+
+	if (n_tagged[type] == songs.size())
+		return;
+
+	/* some songs don't have this tag; apply the fallback rules
+	   to them */
+	for (const Song *song : songs)
+		if (!song->tag.HasType(type))
+			VisitTagWithFallbackOrEmpty(song->tag, type,
+						    [&result](const char *value){
+							    result.emplace(value);
+						    });
+}
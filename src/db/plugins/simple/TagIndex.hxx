@@ -0,0 +1,174 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "db/Visitor.hxx"
+#include "tag/Type.h"
+#include "util/Compiler.h"
+
+#include <array>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * An in-memory inverted index which maps tag values to the songs
+ * carrying them.  It is built from a #Directory tree in one pass and
+ * becomes stale as soon as the tree is modified (see
+ * Directory::serial); it is never updated incrementally, but rebuilt
+ * by the database after each update.
+ *
+ * Songs are numbered in the order in which Directory::Walk() visits
+ * them, and the songs of each directory (recursively) occupy a
+ * contiguous range of numbers.  This allows answering queries in the
+ * same order as a tree walk would, and restricting them to a sub
+ * directory cheaply.
+ *
+ * The keys point to the (pooled) tag values owned by the songs; all
+ * methods must be called while holding #db_mutex, and only while
+ * IsValid() returns true.
+ */
+class TagIndex {
+	struct Hash {
+		gcc_pure
+		size_t operator()(const char *p) const noexcept {
+			size_t hash = 5381;
+			while (*p != 0)
+				hash = (hash << 5) + hash + (unsigned char)*p++;
+			return hash;
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const char *a, const char *b) const noexcept {
+			return strcmp(a, b) == 0;
+		}
+	};
+
+	/**
+	 * A sorted list of song numbers.
+	 */
+	typedef std::vector<uint32_t> PostingList;
+
+	typedef std::unordered_map<const char *, PostingList,
+				   Hash, Equal> ValueMap;
+
+	struct Range {
+		/**
+		 * The first song of the directory.
+		 */
+		uint32_t begin;
+
+		/**
+		 * The end of the directory's own songs, excluding
+		 * its sub directories.
+		 */
+		uint32_t own_end;
+
+		/**
+		 * The end of the songs of the directory and all of
+		 * its sub directories.
+		 */
+		uint32_t end;
+	};
+
+	/**
+	 * The value of Directory::serial when this index was built.
+	 */
+	const unsigned serial;
+
+	/**
+	 * Does the tree contain mount points?  The index knows
+	 * nothing about the songs of mounted databases, so it cannot
+	 * be used then.
+	 */
+	bool has_mounts = false;
+
+	std::vector<const Song *> songs;
+
+	std::unordered_map<const Directory *, Range> directories;
+
+	std::array<ValueMap, TAG_NUM_OF_ITEM_TYPES> values;
+
+	/**
+	 * The number of songs which have at least one value of the
+	 * given tag type.
+	 */
+	std::array<uint32_t, TAG_NUM_OF_ITEM_TYPES> n_tagged;
+
+public:
+	explicit TagIndex(const Directory &root);
+
+	TagIndex(const TagIndex &) = delete;
+	TagIndex &operator=(const TagIndex &) = delete;
+
+	gcc_pure
+	bool IsValid() const noexcept;
+
+	bool HasMounts() const noexcept {
+		return has_mounts;
+	}
+
+	/**
+	 * Does the filter contain a condition which can be looked up
+	 * in the index?  If not, Visit() would return false, and
+	 * there is no point in getting an index.
+	 */
+	gcc_pure
+	static bool CanVisit(const SongFilter &filter) noexcept;
+
+	/**
+	 * Visit all songs of the given directory which match the
+	 * filter, in the same order as Directory::Walk().
+	 *
+	 * @return false if the filter contains no condition which
+	 * can be looked up in the index; the caller must walk the
+	 * tree then
+	 */
+	bool Visit(const Directory &directory, bool recursive,
+		   const SongFilter &filter,
+		   const VisitSong &visit_song) const;
+
+	/**
+	 * Collect the values of the given tag type of all songs,
+	 * with the same fallback rules as CollectUniqueTags().
+	 */
+	void CollectValues(TagType type, std::set<std::string> &result) const;
+
+private:
+	void AddDirectory(const Directory &directory);
+	void AddSong(const Song &song);
+
+	gcc_pure
+	const PostingList *Find(TagType type,
+				const char *value) const noexcept;
+};
+
+#endif
@@ -44,11 +44,17 @@ LockFindChild(Directory &directory, const char *name) noexcept
 	return directory.FindChild(name);
 }
 
+/**
+ * Find or create a sub directory of an archive, and mark it as
+ * such.
+ */
 static Directory *
-LockMakeChild(Directory &directory, const char *name) noexcept
+LockMakeArchiveChild(Directory &directory, const char *name) noexcept
 {
 	const ScopeDatabaseLock protect;
-	return directory.MakeChild(name);
+	Directory *child = directory.MakeChild(name);
+	child->device = DEVICE_INARCHIVE;
+	return child;
 }
 
 static Song *
@@ -66,9 +72,8 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 	if (tmp) {
 		const std::string child_name(name, tmp);
 		//add dir is not there already
-		Directory *subdir = LockMakeChild(directory,
-						  child_name.c_str());
-		subdir->device = DEVICE_INARCHIVE;
+		Directory *subdir = LockMakeArchiveChild(directory,
+							 child_name.c_str());
 
 		//create directories first
 		UpdateArchiveTree(archive, *subdir, tmp + 1);
@@ -94,11 +99,26 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 					      directory.GetPath(), name);
 			}
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			/* scan into a temporary object, because other
+			   threads may be reading the tag of the existing
+			   one; it is updated in place (with the lock),
+			   because replacing it would remove the song
+			   from the queue */
+			Song *new_song = Song::LoadFromArchive(archive, name,
+							       directory);
+			if (new_song == nullptr) {
 				FormatDebug(update_domain,
 					    "deleting unrecognized file %s/%s",
 					    directory.GetPath(), name);
 				editor.LockDeleteSong(directory, song);
+			} else {
+				{
+					const ScopeDatabaseLock protect;
+					song->tag = std::move(new_song->tag);
+					directory.MarkDirty();
+				}
+
+				new_song->Free();
 			}
 		}
 	}
@@ -172,7 +192,11 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 		directory->device = DEVICE_INARCHIVE;
 	}
 
-	directory->mtime = info.mtime;
+	{
+		const ScopeDatabaseLock protect;
+		directory->mtime = info.mtime;
+		directory->dirty = true;
+	}
 
 	UpdateArchiveVisitor visitor(*this, *file, directory);
 	file->Visit(visitor);
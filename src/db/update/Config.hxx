@@ -23,6 +23,14 @@
 struct ConfigData;
 
 struct UpdateConfig {
+	static constexpr unsigned DEFAULT_THREADS = 1;
+
+	/**
+	 * The number of threads which scan directories and read
+	 * tags concurrently.
+	 */
+	unsigned n_threads = DEFAULT_THREADS;
+
 #ifndef _WIN32
 	static constexpr bool DEFAULT_FOLLOW_INSIDE_SYMLINKS = true;
 	static constexpr bool DEFAULT_FOLLOW_OUTSIDE_SYMLINKS = true;
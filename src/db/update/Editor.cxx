@@ -107,7 +107,8 @@ DatabaseEditor::DeleteNameIn(Directory &parent, const char *name)
 		modified = true;
 	}
 
-	parent.playlists.erase(name);
+	if (parent.playlists.erase(name))
+		parent.dirty = true;
 
 	return modified;
 }
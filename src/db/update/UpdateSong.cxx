@@ -32,7 +32,8 @@
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
 			    const char *name, const char *suffix,
-			    const StorageFileInfo &info) noexcept
+			    const StorageFileInfo &info,
+			    Batch &batch) noexcept
 {
 	Song *song;
 	{
@@ -61,44 +62,90 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
-		if (song == nullptr) {
-			FormatDebug(update_domain,
-				    "ignoring unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			return;
-		}
-
-		{
-			const ScopeDatabaseLock protect;
-			directory.AddSong(song);
-		}
-
-		modified = true;
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), name);
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FormatDefault(update_domain, "updating %s/%s",
 			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
+	} else
+		/* not modified */
+		return;
+
+	/* read the tags in a worker thread; the result is merged
+	   by FlushBatch() */
+	batch.songs.emplace_back(name, song);
+	auto &pending = batch.songs.back();
+
+	pool->Push(batch.song_group, [this, &directory, &pending](){
+			if (cancel)
+				return;
+
+			pending.result = Song::LoadFile(storage,
+							pending.name.c_str(),
+							directory);
+			pending.scanned = true;
+		});
+}
+
+void
+UpdateWalk::FlushBatch(Directory &directory, Batch &batch) noexcept
+{
+	pool->Wait(batch.song_group);
+
+	if (!batch.songs.empty()) {
+		const ScopeDatabaseLock protect;
+
+		for (auto &i : batch.songs) {
+			if (!i.scanned)
+				continue;
+
+			if (i.existing == nullptr) {
+				if (i.result == nullptr) {
+					FormatDebug(update_domain,
+						    "ignoring unrecognized file %s/%s",
+						    directory.GetPath(),
+						    i.name.c_str());
+					continue;
+				}
+
+				directory.AddSong(i.result);
+				FormatDefault(update_domain, "added %s/%s",
+					      directory.GetPath(),
+					      i.name.c_str());
+			} else if (i.result == nullptr) {
+				FormatDebug(update_domain,
+					    "deleting unrecognized file %s/%s",
+					    directory.GetPath(),
+					    i.name.c_str());
+				editor.DeleteSong(directory, i.existing);
+			} else {
+				/* update the existing object in place;
+				   replacing it would remove the song
+				   from the queue */
+				Song &song = *i.existing;
+				song.tag = std::move(i.result->tag);
+				song.mtime = i.result->mtime;
+				song.audio_format = i.result->audio_format;
+				i.result->Free();
+				directory.MarkDirty();
+			}
+
+			modified = true;
 		}
 
-		modified = true;
+		batch.songs.clear();
 	}
+
+	pool->Wait(batch.directory_group);
 }
 
 bool
 UpdateWalk::UpdateSongFile(Directory &directory,
 			   const char *name, const char *suffix,
-			   const StorageFileInfo &info) noexcept
+			   const StorageFileInfo &info,
+			   Batch &batch) noexcept
 {
 	if (!decoder_plugins_supports_suffix(suffix))
 		return false;
 
-	UpdateSongFile2(directory, name, suffix, info);
+	UpdateSongFile2(directory, name, suffix, info, batch);
 	return true;
 }
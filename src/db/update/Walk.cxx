@@ -60,6 +60,7 @@ UpdateWalk::UpdateWalk(const UpdateConfig &_config,
 static void
 directory_set_stat(Directory &dir, const StorageFileInfo &info)
 {
+	const ScopeDatabaseLock protect;
 	dir.inode = info.inode;
 	dir.device = info.device;
 }
@@ -94,6 +95,10 @@ UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 inline void
 UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 {
+	/* no lock for the iteration: nobody else modifies this
+	   directory while its job runs (the jobs for its children
+	   have not been started yet), and the I/O must not block
+	   other threads; removals take the lock */
 	directory.ForEachChildSafe([&](Directory &child){
 			if (child.IsMount() || DirectoryExists(storage, child))
 				return;
@@ -119,6 +124,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 						i->name.c_str())) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			directory.dirty = true;
 		} else
 			++i;
 	}
@@ -126,9 +132,9 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 
 #ifndef _WIN32
 static bool
-update_directory_stat(Storage &storage, Directory &directory) noexcept
+update_directory_stat(Storage &storage, Directory &directory,
+		      StorageFileInfo &info) noexcept
 {
-	StorageFileInfo info;
 	if (!GetInfo(storage, directory.GetPath(), info))
 		return false;
 
@@ -141,6 +147,9 @@ update_directory_stat(Storage &storage, Directory &directory) noexcept
  * Check the ancestors of the given #Directory and see if there's one
  * with the same device/inode number, building a loop.
  *
+ * The ancestors may be scanned by other update jobs concurrently,
+ * therefore their fields are only accessed with the #db_mutex.
+ *
  * @return 1 if a loop was found, 0 if not, -1 on I/O error
  */
 static int
@@ -154,11 +163,19 @@ FindAncestorLoop(Storage &storage, Directory *parent,
 		return 0;
 
 	while (parent) {
-		if (parent->device == 0 && parent->inode == 0 &&
-		    !update_directory_stat(storage, *parent))
+		StorageFileInfo info;
+
+		{
+			const ScopeDatabaseSharedLock protect;
+			info.inode = parent->inode;
+			info.device = parent->device;
+		}
+
+		if (info.device == 0 && info.inode == 0 &&
+		    !update_directory_stat(storage, *parent, info))
 			return -1;
 
-		if (parent->inode == inode && parent->device == device) {
+		if (info.inode == inode && info.device == device) {
 			LogDebug(update_domain, "recursive directory found");
 			return 1;
 		}
@@ -186,21 +203,24 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		directory.dirty = true;
 		modified = true;
+	}
 	return true;
 }
 
 inline bool
 UpdateWalk::UpdateRegularFile(Directory &directory,
 			      const char *name,
-			      const StorageFileInfo &info) noexcept
+			      const StorageFileInfo &info,
+			      Batch &batch) noexcept
 {
 	const char *suffix = uri_get_suffix(name);
 	if (suffix == nullptr)
 		return false;
 
-	return UpdateSongFile(directory, name, suffix, info) ||
+	return UpdateSongFile(directory, name, suffix, info, batch) ||
 		UpdateArchiveFile(directory, name, suffix, info) ||
 		UpdatePlaylistFile(directory, name, suffix, info);
 }
@@ -208,12 +228,13 @@ UpdateWalk::UpdateRegularFile(Directory &directory,
 void
 UpdateWalk::UpdateDirectoryChild(Directory &directory,
 				 const ExcludeList &exclude_list,
-				 const char *name, const StorageFileInfo &info) noexcept
+				 const char *name, const StorageFileInfo &info,
+				 Batch &batch) noexcept
 try {
 	assert(strchr(name, '/') == nullptr);
 
 	if (info.IsRegular()) {
-		UpdateRegularFile(directory, name, info);
+		UpdateRegularFile(directory, name, info, batch);
 	} else if (info.IsDirectory()) {
 		if (FindAncestorLoop(storage, &directory,
 					info.inode, info.device))
@@ -227,8 +248,17 @@ try {
 
 		assert(&directory == subdir->parent);
 
-		if (!UpdateDirectory(*subdir, exclude_list, info))
-			editor.LockDeleteDirectory(subdir);
+		/* scan the sub directory in a worker thread; the
+		   #ExcludeList lives until FlushBatch() returns */
+		pool->Push(batch.directory_group,
+			   [this, subdir, &exclude_list, info](){
+				   if (cancel)
+					   return;
+
+				   if (!UpdateDirectory(*subdir, exclude_list,
+							info))
+					   editor.LockDeleteDirectory(subdir);
+			   });
 	} else {
 		FormatDebug(update_domain,
 			    "%s is not a directory, archive or music", name);
@@ -355,6 +385,8 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	PurgeDeletedFromDirectory(directory);
 
+	Batch batch;
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
@@ -367,20 +399,29 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 		}
 
 		if (SkipSymlink(&directory, name_utf8)) {
-			modified |= editor.DeleteNameIn(directory, name_utf8);
+			if (editor.DeleteNameIn(directory, name_utf8))
+				modified = true;
 			continue;
 		}
 
 		StorageFileInfo info2;
 		if (!GetInfo(*reader, info2)) {
-			modified |= editor.DeleteNameIn(directory, name_utf8);
+			if (editor.DeleteNameIn(directory, name_utf8))
+				modified = true;
 			continue;
 		}
 
-		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
+		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2,
+				     batch);
 	}
 
-	directory.mtime = info.mtime;
+	FlushBatch(directory, batch);
+
+	if (directory.mtime != info.mtime) {
+		const ScopeDatabaseLock protect;
+		directory.mtime = info.mtime;
+		directory.dirty = true;
+	}
 
 	return true;
 }
@@ -390,17 +431,11 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 				      const char *uri_utf8,
 				      const char *name_utf8) noexcept
 {
-	Directory *directory;
 	{
 		const ScopeDatabaseLock protect;
-		directory = parent.FindChild(name_utf8);
-	}
-
-	if (directory != nullptr) {
-		if (directory->IsMount())
-			directory = nullptr;
-
-		return directory;
+		Directory *directory = parent.FindChild(name_utf8);
+		if (directory != nullptr)
+			return directory->IsMount() ? nullptr : directory;
 	}
 
 	StorageFileInfo info;
@@ -413,16 +448,14 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 
 	/* if we're adding directory paths, make sure to delete filenames
 	   with potentially the same name */
-	{
-		const ScopeDatabaseLock protect;
-		Song *conflicting = parent.FindSong(name_utf8);
-		if (conflicting)
-			editor.DeleteSong(parent, conflicting);
-
-		directory = parent.CreateChild(name_utf8);
-	}
+	const ScopeDatabaseLock protect;
+	Song *conflicting = parent.FindSong(name_utf8);
+	if (conflicting)
+		editor.DeleteSong(parent, conflicting);
 
-	directory_set_stat(*directory, info);
+	Directory *directory = parent.CreateChild(name_utf8);
+	directory->inode = info.inode;
+	directory->device = info.device;
 	return directory;
 }
 
@@ -463,29 +496,54 @@ try {
 	const char *name = PathTraitsUTF8::GetBase(uri);
 
 	if (SkipSymlink(parent, name)) {
-		modified |= editor.DeleteNameIn(*parent, name);
+		if (editor.DeleteNameIn(*parent, name))
+			modified = true;
 		return;
 	}
 
 	StorageFileInfo info;
 	if (!GetInfo(storage, uri, info)) {
-		modified |= editor.DeleteNameIn(*parent, name);
+		if (editor.DeleteNameIn(*parent, name))
+			modified = true;
 		return;
 	}
 
 	ExcludeList exclude_list;
+	Batch batch;
 
-	UpdateDirectoryChild(*parent, exclude_list, name, info);
+	UpdateDirectoryChild(*parent, exclude_list, name, info, batch);
+	FlushBatch(*parent, batch);
 } catch (...) {
 	LogError(std::current_exception());
 }
 
+/**
+ * Create the #WorkerPool for UpdateWalk::Walk().  The calling thread
+ * participates, therefore one thread less is started.
+ */
+static std::unique_ptr<WorkerPool>
+MakeWorkerPool(unsigned n_threads) noexcept
+{
+	assert(n_threads > 0);
+
+	try {
+		return std::make_unique<WorkerPool>("update", n_threads - 1,
+						    true);
+	} catch (...) {
+		LogError(std::current_exception());
+		return std::make_unique<WorkerPool>("update", 0);
+	}
+}
+
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 {
 	walk_discard = discard;
 	modified = false;
 
+	const auto worker_pool = MakeWorkerPool(config.n_threads);
+	pool = worker_pool.get();
+
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
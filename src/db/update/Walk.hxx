@@ -22,13 +22,17 @@
 
 #include "Config.hxx"
 #include "Editor.hxx"
+#include "thread/WorkerPool.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <atomic>
+#include <deque>
+#include <string>
 
 struct StorageFileInfo;
 struct Directory;
+struct Song;
 struct ArchivePlugin;
 class ArchiveFile;
 class Storage;
@@ -42,7 +46,12 @@ class UpdateWalk final {
 	const UpdateConfig config;
 
 	bool walk_discard;
-	bool modified;
+
+	/**
+	 * Set to true when the database was modified.  This may be
+	 * written by several worker threads.
+	 */
+	std::atomic_bool modified;
 
 	/**
 	 * Set to true by the main thread when the update thread shall
@@ -55,6 +64,53 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * The threads which scan directories and read tags; only
+	 * valid while Walk() runs.
+	 */
+	WorkerPool *pool = nullptr;
+
+	/**
+	 * A song file whose tags are being read by a #WorkerPool job.
+	 */
+	struct PendingSong {
+		const std::string name;
+
+		/**
+		 * The existing #Song object which shall be updated, or
+		 * nullptr if this is a new file.
+		 */
+		Song *const existing;
+
+		/**
+		 * The newly loaded #Song (not yet attached to its
+		 * #Directory), or nullptr if the file was not
+		 * recognized.
+		 */
+		Song *result = nullptr;
+
+		/**
+		 * Was the file scanned?  This is false if the update
+		 * was canceled before the job ran.
+		 */
+		bool scanned = false;
+
+		PendingSong(const char *_name, Song *_existing) noexcept
+			:name(_name), existing(_existing) {}
+	};
+
+	/**
+	 * The jobs submitted while scanning one directory.  Song
+	 * results are merged into the #Directory by FlushBatch() in
+	 * the order of the directory listing, which makes the
+	 * resulting database independent of thread scheduling.
+	 */
+	struct Batch {
+		WorkerPool::Group song_group, directory_group;
+
+		std::deque<PendingSong> songs;
+	};
+
 public:
 	UpdateWalk(const UpdateConfig &_config,
 		   EventLoop &_loop, DatabaseListener &_listener,
@@ -85,11 +141,19 @@ private:
 
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
-			     const StorageFileInfo &info) noexcept;
+			     const StorageFileInfo &info,
+			     Batch &batch) noexcept;
 
 	bool UpdateSongFile(Directory &directory,
 			    const char *name, const char *suffix,
-			    const StorageFileInfo &info) noexcept;
+			    const StorageFileInfo &info,
+			    Batch &batch) noexcept;
+
+	/**
+	 * Wait for all jobs of the #Batch, and merge the songs into
+	 * the #Directory.
+	 */
+	void FlushBatch(Directory &directory, Batch &batch) noexcept;
 
 	bool UpdateContainerFile(Directory &directory,
 				 const char *name, const char *suffix,
@@ -123,12 +187,14 @@ private:
 				const StorageFileInfo &info) noexcept;
 
 	bool UpdateRegularFile(Directory &directory,
-			       const char *name, const StorageFileInfo &info) noexcept;
+			       const char *name, const StorageFileInfo &info,
+			       Batch &batch) noexcept;
 
 	void UpdateDirectoryChild(Directory &directory,
 				  const ExcludeList &exclude_list,
 				  const char *name,
-				  const StorageFileInfo &info) noexcept;
+				  const StorageFileInfo &info,
+				  Batch &batch) noexcept;
 
 	bool UpdateDirectory(Directory &directory,
 			     const ExcludeList &exclude_list,
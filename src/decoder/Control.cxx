@@ -27,11 +27,13 @@
 
 DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond,
 			       const AudioFormat _configured_audio_format,
-			       const ReplayGainConfig &_replay_gain_config) noexcept
+			       const ReplayGainConfig &_replay_gain_config,
+			       InputCacheManager *_input_cache) noexcept
 	:thread(BIND_THIS_METHOD(RunThread)),
 	 mutex(_mutex), client_cond(_client_cond),
 	 configured_audio_format(_configured_audio_format),
-	 replay_gain_config(_replay_gain_config) {}
+	 replay_gain_config(_replay_gain_config),
+	 input_cache(_input_cache) {}
 
 DecoderControl::~DecoderControl() noexcept
 {
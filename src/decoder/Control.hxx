@@ -45,6 +45,7 @@
 
 class DetachedSong;
 class MusicBuffer;
+class InputCacheManager;
 class MusicPipe;
 
 enum class DecoderState : uint8_t {
@@ -169,6 +170,12 @@ public:
 	const ReplayGainConfig replay_gain_config;
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
+	/**
+	 * The global input cache (see "input_cache"); nullptr if
+	 * disabled.
+	 */
+	InputCacheManager *const input_cache;
+
 	float replay_gain_db = 0;
 	float replay_gain_prev_db = 0;
 
@@ -182,7 +189,8 @@ public:
 	 */
 	DecoderControl(Mutex &_mutex, Cond &_client_cond,
 		       const AudioFormat _configured_audio_format,
-		       const ReplayGainConfig &_replay_gain_config) noexcept;
+		       const ReplayGainConfig &_replay_gain_config,
+		       InputCacheManager *_input_cache) noexcept;
 	~DecoderControl() noexcept;
 
 	/**
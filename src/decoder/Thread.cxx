@@ -29,6 +29,7 @@
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
 #include "input/Registry.hxx"
+#include "input/cache/Manager.hxx"
 #include "DecoderList.hxx"
 #include "system/Error.hxx"
 #include "util/MimeType.hxx"
@@ -48,15 +49,18 @@
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
 /**
- * Opens the input stream with InputStream::Open(), and waits until
- * the stream gets ready.
+ * Opens the input stream with InputStream::Open() (or through the
+ * #InputCacheManager), and waits until the stream gets ready.
  *
  * Unlock the decoder before calling this function.
  */
 static InputStreamPtr
 decoder_input_stream_open(DecoderControl &dc, const char *uri)
 {
-	auto is = InputStream::Open(uri, dc.mutex);
+	auto is = dc.input_cache != nullptr
+		? dc.input_cache->Open(uri, dc.song->GetLastModified(),
+				       dc.mutex)
+		: InputStream::Open(uri, dc.mutex);
 	is->SetHandler(&dc);
 
 	/* wait for the input stream to become ready; its metadata
@@ -24,7 +24,7 @@
 #include "util/StringAPI.hxx"
 #include "util/RuntimeError.hxx"
 
-static const EncoderPlugin &
+const EncoderPlugin &
 GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 {
 	const char *name = block.GetBlockValue("encoder", nullptr);
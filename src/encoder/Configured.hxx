@@ -21,8 +21,19 @@
 #define MPD_ENCODER_CONFIGURED_HXX
 
 struct ConfigBlock;
+struct EncoderPlugin;
 class PreparedEncoder;
 
+/**
+ * Look up the encoder plugin selected by the "encoder" setting.
+ *
+ * Throws an exception on error.
+ *
+ * @param shout_legacy see CreateConfiguredEncoder()
+ */
+const EncoderPlugin &
+GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy=false);
+
 /**
  * Create a #PreparedEncoder instance from the settings in the
  * #ConfigBlock.  Its "encoder" setting is used to choose the encoder
@@ -0,0 +1,635 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Shared.hxx"
+#include "Configured.hxx"
+#include "EncoderPlugin.hxx"
+#include "AudioFormat.hxx"
+#include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+#include "util/StringAPI.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Encoded data which is older than this is discarded even if an
+ * output has not read it yet (e.g. a "httpd" output without
+ * clients).  This is larger than the encoded size of a full
+ * #MusicBuffer, which limits how far outputs can drift apart.
+ */
+static constexpr size_t MAX_ENCODER_BUS_BACKLOG = 4 * 1024 * 1024;
+
+/**
+ * If another output writes this much PCM data while the feeder
+ * doesn't write anything, it takes over the feeder role.
+ */
+static constexpr std::chrono::seconds MAX_FEEDER_STALL(1);
+
+class EncoderBus;
+
+/**
+ * The #Encoder proxy returned to each output.
+ */
+class SharedEncoder final
+	: public Encoder,
+	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	friend class EncoderBus;
+
+	EncoderBus &bus;
+
+	/**
+	 * The read position in the bus log.
+	 */
+	uint64_t cursor;
+
+	/**
+	 * The number of PCM bytes written by this output since the
+	 * feeder's last Write() call.
+	 */
+	size_t starved = 0;
+
+	/**
+	 * Was encoded data discarded before this output has read it?
+	 * The next Read() call reports this as an error.
+	 */
+	bool overrun = false;
+
+	/**
+	 * The part of the stream header which has not yet been
+	 * read.
+	 */
+	std::vector<uint8_t> header;
+	size_t header_position = 0;
+
+public:
+	SharedEncoder(EncoderBus &_bus, bool _implements_tag,
+		      uint64_t _cursor,
+		      const std::vector<uint8_t> &_header) noexcept
+		:Encoder(_implements_tag), bus(_bus),
+		 cursor(_cursor), header(_header) {}
+
+	~SharedEncoder() noexcept override;
+
+	/* virtual methods from class Encoder */
+	void End() override;
+	void Flush() override;
+	void PreTag() override;
+	void SendTag(const Tag &tag) override;
+	void Write(const void *data, size_t length) override;
+	size_t Read(void *dest, size_t length) override;
+};
+
+/**
+ * The state shared by all outputs with the same encoder settings.
+ * Only one subscriber (the "feeder") passes its input to the
+ * encoder; the input of all others is ignored, because their
+ * streams may differ (e.g. silence written by Pause()).  Encoded
+ * data is kept in a log until all subscribers have read it.
+ */
+class EncoderBus {
+	Mutex mutex;
+
+	typedef boost::intrusive::list<SharedEncoder,
+				       boost::intrusive::constant_time_size<true>> SubscriberList;
+
+	/**
+	 * The outputs which currently have the shared encoder open.
+	 */
+	SubscriberList subscribers;
+
+	/**
+	 * The subscriber whose input is passed to #encoder; nullptr
+	 * if there are no subscribers.
+	 */
+	SharedEncoder *feeder = nullptr;
+
+	std::unique_ptr<Encoder> encoder;
+
+	/**
+	 * The input and output audio format of #encoder.
+	 */
+	AudioFormat in_format, out_format;
+
+	/**
+	 * #MAX_FEEDER_STALL converted to bytes of #in_format.
+	 */
+	size_t max_feeder_stall;
+
+	/**
+	 * The stream header: the first data after opening the
+	 * encoder or after a new tag.  It is sent to new subscribers
+	 * first.
+	 */
+	std::vector<uint8_t> header;
+
+	struct Segment {
+		uint64_t offset;
+		std::vector<uint8_t> data;
+
+		uint64_t GetEnd() const noexcept {
+			return offset + data.size();
+		}
+	};
+
+	/**
+	 * Encoded data which has not yet been read by all
+	 * subscribers.
+	 */
+	std::deque<Segment> log;
+
+	/**
+	 * The offset of the end of #log.
+	 */
+	uint64_t log_end = 0;
+
+	size_t log_size = 0;
+
+public:
+	EncoderBus() = default;
+	~EncoderBus() noexcept;
+
+	EncoderBus(const EncoderBus &) = delete;
+	EncoderBus &operator=(const EncoderBus &) = delete;
+
+	gcc_pure
+	bool IsShared() noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		return subscribers.size() > 1;
+	}
+
+	/**
+	 * Open the shared encoder (if it is not already) and return
+	 * a new subscriber; returns a private encoder if the shared
+	 * one is open with a different audio format.
+	 */
+	Encoder *Open(PreparedEncoder &prepared, AudioFormat &audio_format);
+
+	void Close(SharedEncoder &s) noexcept;
+
+	void Write(SharedEncoder &s, const void *data, size_t length);
+	void Flush(SharedEncoder &s);
+	void PreTag(SharedEncoder &s);
+	void SendTag(SharedEncoder &s, const Tag &tag);
+	void End(SharedEncoder &s);
+
+	/**
+	 * Throws std::runtime_error if the subscriber has fallen
+	 * too far behind (see #MAX_ENCODER_BUS_BACKLOG).
+	 */
+	size_t Read(SharedEncoder &s, void *dest, size_t length);
+
+private:
+	/**
+	 * Move all available encoder output to the log.
+	 *
+	 * @param is_header copy the data to #header, too
+	 */
+	void Drain(bool is_header=false);
+
+	/**
+	 * Discard log segments which have been read by all
+	 * subscribers, and enforce #MAX_ENCODER_BUS_BACKLOG.
+	 * Subscribers which lose unread data are marked as
+	 * "overrun".
+	 */
+	void Trim() noexcept;
+};
+
+EncoderBus::~EncoderBus() noexcept
+{
+	assert(subscribers.empty());
+	assert(encoder == nullptr);
+}
+
+Encoder *
+EncoderBus::Open(PreparedEncoder &prepared, AudioFormat &audio_format)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (encoder == nullptr) {
+		assert(subscribers.empty());
+
+		in_format = audio_format;
+		encoder.reset(prepared.Open(audio_format));
+		out_format = audio_format;
+
+		max_feeder_stall = in_format.TimeToSize(MAX_FEEDER_STALL);
+
+		header.clear();
+
+		try {
+			Drain(true);
+		} catch (...) {
+			encoder.reset();
+			throw;
+		}
+	} else if (audio_format != in_format) {
+		/* can't share this one */
+		return prepared.Open(audio_format);
+	} else
+		audio_format = out_format;
+
+	auto *s = new SharedEncoder(*this, encoder->ImplementsTag(),
+				    log_end, header);
+	subscribers.push_back(*s);
+	if (feeder == nullptr)
+		feeder = s;
+	return s;
+}
+
+void
+EncoderBus::Close(SharedEncoder &s) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	subscribers.erase(subscribers.iterator_to(s));
+
+	if (feeder == &s) {
+		/* hand over to the oldest remaining subscriber; its
+		   position in the song may differ a bit from the old
+		   feeder's, which the listeners hear as a small skip
+		   or repetition */
+		feeder = subscribers.empty()
+			? nullptr
+			: &subscribers.front();
+		if (feeder != nullptr)
+			feeder->starved = 0;
+	}
+
+	if (subscribers.empty()) {
+		encoder.reset();
+		header.clear();
+		log.clear();
+		log_size = 0;
+	} else
+		Trim();
+}
+
+void
+EncoderBus::Drain(bool is_header)
+{
+	while (true) {
+		uint8_t buffer[32768];
+		size_t nbytes = encoder->Read(buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		if (is_header) {
+			header.insert(header.end(), buffer, buffer + nbytes);
+
+			if (subscribers.empty())
+				/* nobody needs this in the log */
+				continue;
+		}
+
+		log.push_back({log_end, {buffer, buffer + nbytes}});
+		log_end += nbytes;
+		log_size += nbytes;
+	}
+
+	Trim();
+}
+
+void
+EncoderBus::Trim() noexcept
+{
+	uint64_t min_cursor = log_end;
+	for (const auto &i : subscribers)
+		min_cursor = std::min(min_cursor, i.cursor);
+
+	while (!log.empty() &&
+	       (log.front().GetEnd() <= min_cursor ||
+		log_size > MAX_ENCODER_BUS_BACKLOG)) {
+		log_size -= log.front().data.size();
+		log.pop_front();
+	}
+
+	/* subscribers which have fallen too far behind have lost
+	   data; their stream is broken, and the next Read() call
+	   tells them */
+	const uint64_t start = log.empty() ? log_end : log.front().offset;
+	for (auto &i : subscribers) {
+		if (i.cursor < start) {
+			i.cursor = start;
+			i.overrun = true;
+		}
+	}
+}
+
+void
+EncoderBus::Write(SharedEncoder &s, const void *data, size_t length)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (&s != feeder) {
+		/* the feeder has written (or will write) the same
+		   song data; take over only if it has stopped
+		   writing, e.g. a paused "httpd" output without
+		   clients while a "shout" output sends silence */
+		s.starved += length;
+		if (s.starved <= max_feeder_stall)
+			return;
+
+		feeder = &s;
+	}
+
+	for (auto &i : subscribers)
+		i.starved = 0;
+
+	encoder->Write(data, length);
+	Drain();
+}
+
+void
+EncoderBus::Flush(SharedEncoder &s)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (&s != feeder)
+		return;
+
+	encoder->Flush();
+	Drain();
+}
+
+void
+EncoderBus::PreTag(SharedEncoder &s)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (&s != feeder)
+		return;
+
+	encoder->PreTag();
+	Drain();
+}
+
+void
+EncoderBus::SendTag(SharedEncoder &s, const Tag &tag)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (&s != feeder)
+		return;
+
+	encoder->SendTag(tag);
+
+	/* the encoder starts a new stream now; its first page is
+	   the new header for subscribers which join later */
+	encoder->Flush();
+	header.clear();
+	Drain(true);
+}
+
+void
+EncoderBus::End(SharedEncoder &s)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	assert(!subscribers.empty());
+
+	if (subscribers.size() > 1)
+		/* other outputs still use the encoder; this one just
+		   stops reading */
+		return;
+
+	assert(&subscribers.front() == &s);
+	(void)s;
+
+	encoder->End();
+	Drain();
+}
+
+size_t
+EncoderBus::Read(SharedEncoder &s, void *_dest, size_t length)
+{
+	uint8_t *dest = (uint8_t *)_dest;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (s.overrun)
+		throw std::runtime_error("Output has fallen too far behind the shared encoder");
+
+	if (s.header_position < s.header.size()) {
+		/* the stream header comes first */
+		const size_t n = std::min(length,
+					  s.header.size() - s.header_position);
+		memcpy(dest, &s.header[s.header_position], n);
+		s.header_position += n;
+
+		if (s.header_position == s.header.size()) {
+			s.header.clear();
+			s.header.shrink_to_fit();
+			s.header_position = 0;
+		}
+
+		return n;
+	}
+
+	size_t result = 0;
+	for (const auto &segment : log) {
+		if (result == length)
+			break;
+
+		if (segment.GetEnd() <= s.cursor)
+			continue;
+
+		const size_t offset = s.cursor - segment.offset;
+		const size_t n = std::min(length - result,
+					  segment.data.size() - offset);
+		memcpy(dest + result, &segment.data[offset], n);
+		result += n;
+		s.cursor += n;
+	}
+
+	Trim();
+	return result;
+}
+
+SharedEncoder::~SharedEncoder() noexcept
+{
+	bus.Close(*this);
+}
+
+void
+SharedEncoder::End()
+{
+	bus.End(*this);
+}
+
+void
+SharedEncoder::Flush()
+{
+	bus.Flush(*this);
+}
+
+void
+SharedEncoder::PreTag()
+{
+	bus.PreTag(*this);
+}
+
+void
+SharedEncoder::SendTag(const Tag &tag)
+{
+	bus.SendTag(*this, tag);
+}
+
+void
+SharedEncoder::Write(const void *data, size_t length)
+{
+	bus.Write(*this, data, length);
+}
+
+size_t
+SharedEncoder::Read(void *dest, size_t length)
+{
+	return bus.Read(*this, dest, length);
+}
+
+static Mutex encoder_bus_mutex;
+
+/**
+ * All buses which are used by at least one output, indexed by
+ * their key.
+ */
+static std::map<std::string, std::weak_ptr<EncoderBus>> encoder_buses;
+
+static std::shared_ptr<EncoderBus>
+GetEncoderBus(const std::string &key) noexcept
+{
+	const std::lock_guard<Mutex> protect(encoder_bus_mutex);
+
+	auto &weak = encoder_buses[key];
+	auto bus = weak.lock();
+	if (!bus) {
+		bus = std::make_shared<EncoderBus>();
+		weak = bus;
+	}
+
+	return bus;
+}
+
+SharedPreparedEncoder::SharedPreparedEncoder(std::unique_ptr<PreparedEncoder> &&_inner,
+					     const std::string &key)
+	:inner(std::move(_inner))
+{
+	if (!key.empty())
+		bus = GetEncoderBus(key);
+}
+
+SharedPreparedEncoder::~SharedPreparedEncoder() noexcept
+{
+	if (bus == nullptr)
+		return;
+
+	bus.reset();
+
+	/* remove map entries which are not used anymore */
+	const std::lock_guard<Mutex> protect(encoder_bus_mutex);
+	for (auto i = encoder_buses.begin(); i != encoder_buses.end();) {
+		if (i->second.expired())
+			i = encoder_buses.erase(i);
+		else
+			++i;
+	}
+}
+
+bool
+SharedPreparedEncoder::IsShared() const noexcept
+{
+	return bus != nullptr && bus->IsShared();
+}
+
+Encoder *
+SharedPreparedEncoder::Open(AudioFormat &audio_format)
+{
+	return bus != nullptr
+		? bus->Open(*inner, audio_format)
+		: inner->Open(audio_format);
+}
+
+/**
+ * Settings which must be equal for outputs to share an encoder:
+ * the encoder plugin settings, and the output settings which
+ * affect the encoder's input.
+ */
+static constexpr const char *shared_encoder_settings[] = {
+	"quality",
+	"bitrate",
+	"complexity",
+	"signal",
+	"compression",
+	"opustags",
+	"format",
+	"filters",
+	"replay_gain_handler",
+	"tags",
+};
+
+static std::string
+MakeSharedEncoderKey(const ConfigBlock &block, const EncoderPlugin &plugin)
+{
+	if (!block.GetBlockValue("share_encoder", true))
+		return std::string();
+
+	const char *mixer_type = block.GetBlockValue("mixer_type");
+	if (mixer_type != nullptr && StringIsEqual(mixer_type, "software"))
+		/* the volume of this output is independent of all
+		   others */
+		return std::string();
+
+	std::string key = plugin.name;
+	for (const char *name : shared_encoder_settings) {
+		key.push_back('\n');
+		key += name;
+
+		/* don't use GetBlockValue(), because it would mark
+		   settings of other encoder plugins as "used" */
+		for (const auto &i : block.block_params) {
+			if (i.name == name) {
+				key.push_back('=');
+				key += i.value;
+			}
+		}
+	}
+
+	return key;
+}
+
+std::unique_ptr<SharedPreparedEncoder>
+CreateSharedEncoder(const ConfigBlock &block, bool shout_legacy)
+{
+	const auto &plugin = GetConfiguredEncoderPlugin(block, shout_legacy);
+	std::unique_ptr<PreparedEncoder> inner(encoder_init(plugin, block));
+	return std::make_unique<SharedPreparedEncoder>(std::move(inner),
+						       MakeSharedEncoderKey(block,
+									    plugin));
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ENCODER_SHARED_HXX
+#define MPD_ENCODER_SHARED_HXX
+
+#include "EncoderInterface.hxx"
+#include "util/Compiler.h"
+
+#include <memory>
+#include <string>
+
+struct ConfigBlock;
+class EncoderBus;
+
+/**
+ * A #PreparedEncoder wrapper which allows several outputs with the
+ * same encoder settings to share one #Encoder instance (an "encoder
+ * bus").  Each output gets its own #Encoder proxy object with its
+ * own read position in the encoded data.  Only the input and the
+ * tags of one output (the "feeder") are passed to the shared
+ * encoder; another output takes over if the feeder stops writing.
+ * An output which falls too far behind gets an error from Read().
+ *
+ * The first output which opens the encoder determines the audio
+ * format; an output which opens it with a different format gets
+ * its own private #Encoder.
+ */
+class SharedPreparedEncoder final : public PreparedEncoder {
+	std::unique_ptr<PreparedEncoder> inner;
+
+	/**
+	 * The bus shared with all other outputs with the same key;
+	 * nullptr if sharing is disabled for this output.
+	 */
+	std::shared_ptr<EncoderBus> bus;
+
+public:
+	/**
+	 * @param key all outputs with the same key share one
+	 * encoder; an empty string disables sharing
+	 */
+	SharedPreparedEncoder(std::unique_ptr<PreparedEncoder> &&_inner,
+			      const std::string &key);
+	~SharedPreparedEncoder() noexcept;
+
+	/**
+	 * Is the encoder currently open for other outputs, too?
+	 */
+	gcc_pure
+	bool IsShared() const noexcept;
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override;
+
+	const char *GetMimeType() const override {
+		return inner->GetMimeType();
+	}
+};
+
+/**
+ * Create a #SharedPreparedEncoder from the settings in the
+ * #ConfigBlock (see CreateConfiguredEncoder()).  Outputs share an
+ * encoder only if all settings which affect the encoder and its
+ * input are equal, and if they don't use software volume.  The
+ * setting "share_encoder" can disable this.
+ *
+ * Throws an exception on error.
+ */
+std::unique_ptr<SharedPreparedEncoder>
+CreateSharedEncoder(const ConfigBlock &block, bool shout_legacy=false);
+
+#endif
@@ -119,8 +119,9 @@ BufferedSocket::OnSocketReady(unsigned flags) noexcept
 			   Cancel() on a freed object */
 			return true;
 
-		if (!input.IsFull())
-			ScheduleRead();
+		/* no ScheduleRead() here: ResumeInput() has already
+		   done that, unless OnSocketInput() has returned
+		   PAUSE */
 	}
 
 	return true;
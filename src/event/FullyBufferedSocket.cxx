@@ -21,13 +21,39 @@
 #include "net/SocketError.hxx"
 #include "util/Compiler.h"
 
+#include <new>
+#include <stdexcept>
+
 #include <assert.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+/**
+ * The maximum number of segments passed to one sendmsg() call.
+ */
+static constexpr size_t MAX_SEND_SEGMENTS = 32;
+
 FullyBufferedSocket::ssize_t
-FullyBufferedSocket::DirectWrite(const void *data, size_t length) noexcept
+FullyBufferedSocket::DirectWrite() noexcept
 {
-	const auto nbytes = GetSocket().Write((const char *)data, length);
+#ifdef _WIN32
+	const auto data = output.Read();
+	const auto nbytes = GetSocket().Write(data.data, data.size);
+#else
+	ConstBuffer<void> segments[MAX_SEND_SEGMENTS];
+	const size_t n = output.Read(segments, MAX_SEND_SEGMENTS);
+
+	struct iovec v[MAX_SEND_SEGMENTS];
+	for (size_t i = 0; i < n; ++i) {
+		v[i].iov_base = const_cast<void *>(segments[i].data);
+		v[i].iov_len = segments[i].size;
+	}
+
+	const auto nbytes = GetSocket().Write(v, n);
+#endif
 	if (gcc_unlikely(nbytes < 0)) {
 		const auto code = GetSocketError();
 		if (IsSocketErrorAgain(code))
@@ -50,14 +76,13 @@ FullyBufferedSocket::Flush() noexcept
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.empty()) {
+	if (output.empty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
+	auto nbytes = DirectWrite();
 	if (gcc_unlikely(nbytes <= 0))
 		return nbytes == 0;
 
@@ -81,8 +106,13 @@ FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 
 	const bool was_empty = output.empty();
 
-	if (!output.Append(data, length)) {
-		OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+	try {
+		if (!output.Append(data, length)) {
+			OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+			return false;
+		}
+	} catch (const std::bad_alloc &) {
+		OnSocketError(std::current_exception());
 		return false;
 	}
 
@@ -91,6 +121,32 @@ FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 	return true;
 }
 
+WritableBuffer<void>
+FullyBufferedSocket::PrepareWrite() noexcept
+{
+	try {
+		return output.Write();
+	} catch (const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+void
+FullyBufferedSocket::CommitWrite(size_t length) noexcept
+{
+	assert(IsDefined());
+
+	if (length == 0)
+		return;
+
+	const bool was_empty = output.empty();
+
+	output.Append(length);
+
+	if (was_empty)
+		IdleMonitor::Schedule();
+}
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 {
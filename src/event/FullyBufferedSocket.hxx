@@ -22,19 +22,19 @@
 
 #include "BufferedSocket.hxx"
 #include "IdleMonitor.hxx"
-#include "util/PeakBuffer.hxx"
+#include "util/SegmentBuffer.hxx"
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
  */
 class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
-	PeakBuffer output;
+	SegmentBuffer output;
 
 public:
 	FullyBufferedSocket(SocketDescriptor _fd, EventLoop &_loop,
-			    size_t normal_size, size_t peak_size=0) noexcept
+			    size_t max_output_size) noexcept
 		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
+		 output(max_output_size) {
 	}
 
 	using BufferedSocket::IsDefined;
@@ -45,7 +45,13 @@ public:
 	}
 
 private:
-	ssize_t DirectWrite(const void *data, size_t length) noexcept;
+	/**
+	 * Send as much of the output buffer as possible.
+	 *
+	 * @return the number of bytes sent, 0 if the socket is
+	 * not ready, or -1 if the socket has been closed
+	 */
+	ssize_t DirectWrite() noexcept;
 
 protected:
 	/**
@@ -60,6 +66,23 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+	/**
+	 * Obtain a pointer to the end of the output buffer, to be
+	 * filled by the caller and committed with CommitWrite().
+	 * This avoids copying data which is generated on the fly.
+	 *
+	 * @return a writable buffer; empty if the output buffer is
+	 * full or if no memory could be allocated (the caller shall
+	 * then fall back to Write(), which reports the error)
+	 */
+	WritableBuffer<void> PrepareWrite() noexcept;
+
+	/**
+	 * Commit data written into the buffer returned by
+	 * PrepareWrite().
+	 */
+	void CommitWrite(size_t length) noexcept;
+
 	/* virtual methods from class SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
@@ -35,6 +35,7 @@ EventLoop::~EventLoop() noexcept
 {
 	assert(idle.empty());
 	assert(timers.empty());
+	assert(coarse_timers.IsEmpty());
 }
 
 void
@@ -99,10 +100,20 @@ EventLoop::CancelTimer(TimerEvent &t) noexcept
 	timers.erase(timers.iterator_to(t));
 }
 
+void
+EventLoop::AddCoarseTimer(CoarseTimerEvent &t,
+			  std::chrono::steady_clock::duration d) noexcept
+{
+	assert(IsInside());
+
+	coarse_timers.Insert(t, now + d);
+	again = true;
+}
+
 inline std::chrono::steady_clock::duration
 EventLoop::HandleTimers() noexcept
 {
-	std::chrono::steady_clock::duration timeout;
+	std::chrono::steady_clock::duration timeout(-1);
 
 	while (!quit) {
 		auto i = timers.begin();
@@ -110,16 +121,26 @@ EventLoop::HandleTimers() noexcept
 			break;
 
 		TimerEvent &t = *i;
-		timeout = t.due - now;
-		if (timeout > timeout.zero())
-			return timeout;
+		const auto t_timeout = t.due - now;
+		if (t_timeout > t_timeout.zero()) {
+			timeout = t_timeout;
+			break;
+		}
 
 		timers.erase(i);
 
 		t.Run();
 	}
 
-	return std::chrono::steady_clock::duration(-1);
+	if (quit)
+		return timeout;
+
+	const auto coarse_timeout = coarse_timers.Run(now);
+	if (coarse_timeout >= coarse_timeout.zero() &&
+	    (timeout < timeout.zero() || coarse_timeout < timeout))
+		timeout = coarse_timeout;
+
+	return timeout;
 }
 
 /**
@@ -178,13 +199,18 @@ EventLoop::Run() noexcept
 		{
 			const std::lock_guard<Mutex> lock(mutex);
 			HandleDeferred();
-			busy = false;
 
 			if (again)
 				/* re-evaluate timers because one of
 				   the IdleMonitors may have added a
-				   new timeout */
+				   new timeout; this jumps to the loop
+				   condition, which may leave the loop
+				   if another thread has called
+				   Break(), therefore #busy must still
+				   be set */
 				continue;
+
+			busy = false;
 		}
 
 		/* wait for new event */
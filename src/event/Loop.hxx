@@ -28,6 +28,7 @@
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
 #include "TimerEvent.hxx"
+#include "TimerWheel.hxx"
 #include "IdleMonitor.hxx"
 #include "DeferEvent.hxx"
 
@@ -46,7 +47,8 @@
  * thread that runs it, except where explicitly documented as
  * thread-safe.
  *
- * @see SocketMonitor, MultiSocketMonitor, TimerEvent, IdleMonitor
+ * @see SocketMonitor, MultiSocketMonitor, TimerEvent,
+ * CoarseTimerEvent, IdleMonitor
  */
 class EventLoop final : SocketMonitor
 {
@@ -85,6 +87,11 @@ class EventLoop final : SocketMonitor
 
 	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
+	/**
+	 * The #CoarseTimerEvent instances.
+	 */
+	TimerWheel coarse_timers{now};
+
 	std::atomic_bool quit;
 
 	/**
@@ -168,6 +175,9 @@ public:
 		      std::chrono::steady_clock::duration d) noexcept;
 	void CancelTimer(TimerEvent &t) noexcept;
 
+	void AddCoarseTimer(CoarseTimerEvent &t,
+			    std::chrono::steady_clock::duration d) noexcept;
+
 	/**
 	 * Schedule a call to DeferEvent::RunDeferred().
 	 *
@@ -198,7 +208,8 @@ private:
 	void HandleDeferred() noexcept;
 
 	/**
-	 * Invoke all expired #TimerEvent instances and return the
+	 * Invoke all expired #TimerEvent and #CoarseTimerEvent
+	 * instances and return the
 	 * duration until the next timer expires.  Returns a negative
 	 * duration if there is no timeout.
 	 */
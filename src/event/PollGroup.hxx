@@ -22,7 +22,11 @@
 
 #include "config.h"
 
-#ifdef USE_EPOLL
+#ifdef USE_IO_URING
+#include "PollGroupUring.hxx"
+typedef PollResultGeneric PollResult;
+typedef PollGroupUring PollGroup;
+#elif defined(USE_EPOLL)
 #include "PollGroupEpoll.hxx"
 typedef PollResultEpoll PollResult;
 typedef PollGroupEpoll PollGroup;
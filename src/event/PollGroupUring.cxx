@@ -0,0 +1,230 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#ifdef USE_IO_URING
+
+#include "PollGroupUring.hxx"
+#include "PollGroupEpoll.hxx"
+#include "system/IoUring.hxx"
+
+#include <assert.h>
+
+/**
+ * The size of the submission queue.  If it is full, requests are
+ * submitted early with an extra system call.
+ */
+static constexpr unsigned URING_ENTRIES = 256;
+
+static constexpr uint64_t
+MakeUserData(int fd, uint32_t generation) noexcept
+{
+	return uint64_t(generation) << 32 | uint32_t(fd);
+}
+
+/**
+ * Convert a poll() event mask for io_uring_sqe::poll32_events,
+ * which is word-reversed on big-endian machines.
+ */
+static constexpr uint32_t
+ToPoll32(unsigned events) noexcept
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return (events << 16) | (events >> 16);
+#else
+	return events;
+#endif
+}
+
+PollGroupUring::PollGroupUring()
+{
+	try {
+		uring.reset(new IoUring(URING_ENTRIES));
+	} catch (...) {
+		/* io_uring not supported by this kernel (or
+		   disabled) */
+		epoll.reset(new PollGroupEpoll());
+	}
+}
+
+PollGroupUring::~PollGroupUring() noexcept = default;
+
+uint64_t
+PollGroupUring::GetEnterCount() const noexcept
+{
+	return uring != nullptr
+		? uring->GetEnterCount()
+		: 0;
+}
+
+io_uring_sqe &
+PollGroupUring::GetSubmitEntry() noexcept
+{
+	while (true) {
+		auto *sqe = uring->GetSubmitEntry();
+		if (sqe != nullptr)
+			return *sqe;
+
+		/* the queue is full: submit now, without waiting */
+		uring->Submit(0);
+	}
+}
+
+void
+PollGroupUring::Arm(int fd, Item &item) noexcept
+{
+	assert(!item.armed);
+	assert(item.events != 0);
+
+	item.generation = next_generation++;
+	if (item.generation == 0)
+		/* skip zero, which is the user_data of
+		   IORING_OP_POLL_REMOVE */
+		item.generation = next_generation++;
+
+	auto &sqe = GetSubmitEntry();
+	sqe.opcode = IORING_OP_POLL_ADD;
+	sqe.fd = fd;
+	sqe.poll32_events = ToPoll32(item.events);
+	sqe.user_data = MakeUserData(fd, item.generation);
+
+	item.armed = true;
+}
+
+void
+PollGroupUring::Disarm(int fd, Item &item) noexcept
+{
+	if (!item.armed)
+		return;
+
+	/* the request is identified by its user_data; the fd may
+	   have been closed already */
+	auto &sqe = GetSubmitEntry();
+	sqe.opcode = IORING_OP_POLL_REMOVE;
+	sqe.fd = -1;
+	sqe.addr = MakeUserData(fd, item.generation);
+	sqe.user_data = 0;
+
+	item.armed = false;
+}
+
+bool
+PollGroupUring::Add(int fd, unsigned events, void *obj) noexcept
+{
+	if (epoll != nullptr)
+		return epoll->Add(fd, events, obj);
+
+	auto i = items.emplace(fd, Item{obj, events, 0, false});
+	assert(i.second);
+
+	Arm(fd, i.first->second);
+	return true;
+}
+
+bool
+PollGroupUring::Modify(int fd, unsigned events, void *obj) noexcept
+{
+	if (epoll != nullptr)
+		return epoll->Modify(fd, events, obj);
+
+	auto i = items.find(fd);
+	assert(i != items.end());
+	auto &item = i->second;
+
+	item.obj = obj;
+	if (events == item.events)
+		return true;
+
+	item.events = events;
+
+	if (item.armed) {
+		/* replace the poll request; if it is not armed, it
+		   will be re-armed with the new mask by
+		   ReadEvents() */
+		Disarm(fd, item);
+		Arm(fd, item);
+	}
+
+	return true;
+}
+
+bool
+PollGroupUring::Remove(int fd) noexcept
+{
+	if (epoll != nullptr)
+		return epoll->Remove(fd);
+
+	auto i = items.find(fd);
+	assert(i != items.end());
+
+	Disarm(fd, i->second);
+	items.erase(i);
+	return true;
+}
+
+void
+PollGroupUring::ReadEvents(PollResultGeneric &result, int timeout_ms) noexcept
+{
+	if (epoll != nullptr) {
+		PollResultEpoll tmp;
+		epoll->ReadEvents(tmp, timeout_ms);
+		for (size_t i = 0; i < tmp.GetSize(); ++i)
+			result.Add(tmp.GetEvents(i), tmp.GetObject(i));
+		return;
+	}
+
+	/* re-arm the requests which have completed last time and are
+	   still wanted */
+	for (int fd : rearm) {
+		auto i = items.find(fd);
+		if (i != items.end() && !i->second.armed)
+			Arm(fd, i->second);
+	}
+
+	rearm.clear();
+
+	uring->Submit(timeout_ms);
+
+	uring->ForEachCompletion([this, &result](const io_uring_cqe &cqe){
+			if (cqe.user_data == 0)
+				/* completion of IORING_OP_POLL_REMOVE */
+				return;
+
+			const int fd = int(uint32_t(cqe.user_data));
+			const uint32_t generation = cqe.user_data >> 32;
+
+			auto i = items.find(fd);
+			if (i == items.end())
+				return;
+
+			auto &item = i->second;
+			if (!item.armed || item.generation != generation)
+				/* an obsolete request */
+				return;
+
+			item.armed = false;
+			rearm.push_back(fd);
+
+			result.Add(cqe.res >= 0 ? unsigned(cqe.res) : ERROR,
+				   item.obj);
+		});
+}
+
+#endif
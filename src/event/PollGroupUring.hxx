@@ -0,0 +1,123 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EVENT_POLLGROUP_URING_HXX
+#define MPD_EVENT_POLLGROUP_URING_HXX
+
+#include "PollResultGeneric.hxx"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/poll.h>
+
+class IoUring;
+class PollGroupEpoll;
+
+/**
+ * A #PollGroup implementation based on io_uring.  Each registered
+ * file descriptor gets a one-shot IORING_OP_POLL_ADD request, which
+ * is re-armed after its completion has been handled; this emulates
+ * the level-triggered semantics of epoll.  All changes are queued
+ * and submitted with the same io_uring_enter() system call which
+ * waits for completions, so registering, modifying and removing
+ * file descriptors costs no extra system call.
+ *
+ * If the kernel does not support io_uring, this class falls back to
+ * epoll.
+ */
+class PollGroupUring
+{
+	struct Item {
+		void *obj;
+
+		unsigned events;
+
+		/**
+		 * Identifies the current poll request; completions of
+		 * older requests are ignored.
+		 */
+		uint32_t generation;
+
+		/**
+		 * Is there a poll request in the kernel?
+		 */
+		bool armed;
+	};
+
+	std::unique_ptr<IoUring> uring;
+
+	/**
+	 * Used instead of #uring if io_uring is not available.
+	 */
+	std::unique_ptr<PollGroupEpoll> epoll;
+
+	std::unordered_map<int, Item> items;
+
+	/**
+	 * File descriptors whose poll request has completed and needs
+	 * to be re-armed before the next wait.
+	 */
+	std::vector<int> rearm;
+
+	uint32_t next_generation = 1;
+
+	PollGroupUring(PollGroupUring &) = delete;
+	PollGroupUring &operator=(PollGroupUring &) = delete;
+public:
+	static constexpr unsigned READ = POLLIN;
+	static constexpr unsigned WRITE = POLLOUT;
+	static constexpr unsigned ERROR = POLLERR;
+	static constexpr unsigned HANGUP = POLLHUP;
+
+	PollGroupUring();
+	~PollGroupUring() noexcept;
+
+	/**
+	 * Is io_uring used, or did this object fall back to epoll?
+	 */
+	bool IsUring() const noexcept {
+		return uring != nullptr;
+	}
+
+	/**
+	 * Returns the number of io_uring_enter() calls so far (for
+	 * benchmarks).
+	 */
+	uint64_t GetEnterCount() const noexcept;
+
+	void ReadEvents(PollResultGeneric &result, int timeout_ms) noexcept;
+	bool Add(int fd, unsigned events, void *obj) noexcept;
+	bool Modify(int fd, unsigned events, void *obj) noexcept;
+	bool Remove(int fd) noexcept;
+	bool Abandon(int fd) noexcept {
+		/* the poll request holds a reference to the file, so
+		   it needs to be removed explicitly */
+		return Remove(fd);
+	}
+
+private:
+	struct io_uring_sqe &GetSubmitEntry() noexcept;
+	void Arm(int fd, Item &item) noexcept;
+	void Disarm(int fd, Item &item) noexcept;
+};
+
+#endif
@@ -43,7 +43,9 @@ EventThread::Stop() noexcept
 void
 EventThread::Run() noexcept
 {
-	SetThreadName(realtime ? "rtio" : "io");
+	SetThreadName(name != nullptr
+		      ? name
+		      : (realtime ? "rtio" : "io"));
 
 	if (realtime) {
 		SetThreadTimerSlackUS(10);
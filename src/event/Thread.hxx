@@ -33,10 +33,17 @@ class EventThread final {
 
 	const bool realtime;
 
+	/**
+	 * The thread name; nullptr means the default ("io" or
+	 * "rtio").
+	 */
+	const char *const name;
+
 public:
-	explicit EventThread(bool _realtime=false)
+	explicit EventThread(bool _realtime=false,
+			     const char *_name=nullptr)
 		:event_loop(ThreadId::Null()), thread(BIND_THIS_METHOD(Run)),
-		 realtime(_realtime) {}
+		 realtime(_realtime), name(_name) {}
 
 	~EventThread() noexcept {
 		Stop();
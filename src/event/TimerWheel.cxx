@@ -0,0 +1,205 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "TimerWheel.hxx"
+
+#include <assert.h>
+
+constexpr TimerWheel::Duration TimerWheel::RESOLUTION;
+
+/**
+ * Rotate the bits right, so the given bit becomes bit 0.
+ */
+static constexpr uint64_t
+RotateRight(uint64_t bits, unsigned n) noexcept
+{
+	return n == 0
+		? bits
+		: (bits >> n) | (bits << (64 - n));
+}
+
+TimerWheel::TimerWheel(TimePoint now) noexcept
+	:occupied(), next_tick(FloorTick(now))
+{
+}
+
+TimerWheel::~TimerWheel() noexcept
+{
+	for (auto &level : slots)
+		for (auto &slot : level)
+			slot.clear();
+
+	expired.clear();
+}
+
+bool
+TimerWheel::IsEmpty() const noexcept
+{
+	for (const auto &level : slots)
+		for (const auto &slot : level)
+			if (!slot.empty())
+				return false;
+
+	return expired.empty();
+}
+
+void
+TimerWheel::Insert(CoarseTimerEvent &t, TimePoint due) noexcept
+{
+	assert(!t.IsActive());
+
+	t.due = due;
+	Insert(t);
+}
+
+void
+TimerWheel::Insert(CoarseTimerEvent &t) noexcept
+{
+	uint64_t tick = CeilTick(t.due);
+	if (tick < next_tick)
+		/* already due: invoke it at the next tick */
+		tick = next_tick;
+
+	const uint64_t delta = tick - next_tick;
+
+	unsigned level = 0;
+	while (level < LEVELS - 1 &&
+	       delta >= uint64_t(1) << ((level + 1) * SLOT_BITS))
+		++level;
+
+	if (level == LEVELS - 1 &&
+	    delta >= uint64_t(1) << (LEVELS * SLOT_BITS))
+		/* too far in the future: park it in the last slot; it
+		   will be re-inserted when that slot gets cascaded */
+		tick = next_tick + (uint64_t(1) << (LEVELS * SLOT_BITS)) - 1;
+
+	const unsigned slot = GetSlot(tick, level);
+	slots[level][slot].push_back(t);
+	occupied[level] |= uint64_t(1) << slot;
+}
+
+uint64_t
+TimerWheel::FindNextTick() noexcept
+{
+	uint64_t result = NO_TICK;
+
+	for (unsigned level = 0; level < LEVELS; ++level) {
+		const unsigned shift = level * SLOT_BITS;
+		const uint64_t period = next_tick >> shift;
+		const unsigned start = period & (SLOTS - 1);
+
+		/* on levels above 0, the slot of the current period
+		   has already been cascaded (unless next_tick is at
+		   the start of the period); timers in it belong to
+		   the period SLOTS periods later */
+		const bool current_done = level > 0 &&
+			(next_tick & ((uint64_t(1) << shift) - 1)) != 0;
+
+		while (occupied[level] != 0) {
+			uint64_t bits = RotateRight(occupied[level], start);
+			if (current_done && bits != 1)
+				/* look at the other slots first */
+				bits &= ~uint64_t(1);
+
+			const unsigned i = __builtin_ctzll(bits);
+			const unsigned slot = (start + i) & (SLOTS - 1);
+			if (slots[level][slot].empty()) {
+				/* all timers have been cancelled */
+				occupied[level] &= ~(uint64_t(1) << slot);
+				continue;
+			}
+
+			const uint64_t tick = i == 0 && current_done
+				? (period + SLOTS) << shift
+				: (period + i) << shift;
+			if (tick < result)
+				result = tick;
+			break;
+		}
+	}
+
+	return result;
+}
+
+void
+TimerWheel::Cascade(unsigned level, unsigned slot) noexcept
+{
+	occupied[level] &= ~(uint64_t(1) << slot);
+
+	List tmp;
+	tmp.splice(tmp.end(), slots[level][slot]);
+
+	while (!tmp.empty()) {
+		auto &t = tmp.front();
+		tmp.pop_front();
+		Insert(t);
+	}
+}
+
+void
+TimerWheel::HandleTick() noexcept
+{
+	/* cascade from the highest affected level down, so timers
+	   moved from level N+1 to level N are cascaded again if
+	   they are due in this period */
+	unsigned n_cascade = 0;
+	while (n_cascade < LEVELS - 1 &&
+	       GetSlot(next_tick, n_cascade) == 0)
+		++n_cascade;
+
+	for (unsigned level = n_cascade; level > 0; --level)
+		Cascade(level, GetSlot(next_tick, level));
+
+	const unsigned slot = GetSlot(next_tick, 0);
+	occupied[0] &= ~(uint64_t(1) << slot);
+	expired.splice(expired.end(), slots[0][slot]);
+
+	++next_tick;
+}
+
+TimerWheel::Duration
+TimerWheel::Run(TimePoint now) noexcept
+{
+	const uint64_t now_tick = FloorTick(now);
+
+	while (next_tick <= now_tick) {
+		const uint64_t tick = FindNextTick();
+		if (tick > now_tick) {
+			/* nothing happens until now: skip the empty
+			   ticks */
+			next_tick = now_tick + 1;
+			break;
+		}
+
+		next_tick = tick;
+		HandleTick();
+
+		while (!expired.empty()) {
+			auto &t = expired.front();
+			expired.pop_front();
+			t.Run();
+		}
+	}
+
+	const uint64_t tick = FindNextTick();
+	if (tick == NO_TICK)
+		return Duration(-1);
+
+	return TickToTime(tick) - now;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TIMER_WHEEL_HXX
+#define MPD_TIMER_WHEEL_HXX
+
+#include "CoarseTimerEvent.hxx"
+#include "util/Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * A hierarchical timing wheel for #CoarseTimerEvent instances.
+ *
+ * Time is divided into ticks of #RESOLUTION.  Level 0 has one slot
+ * per tick for the next #SLOTS ticks; each higher level has one slot
+ * for #SLOTS ticks of the level below.  A timer is inserted into the
+ * lowest level which covers its due time, and is moved ("cascaded")
+ * to a lower level when the clock reaches its slot.  Inserting and
+ * cancelling a timer is O(1).
+ *
+ * Timers due beyond the range of the highest level are inserted into
+ * its last slot and re-inserted when that slot is cascaded.
+ *
+ * This class is not thread-safe.
+ */
+class TimerWheel final {
+public:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	typedef std::chrono::steady_clock::duration Duration;
+
+	static constexpr Duration RESOLUTION = std::chrono::milliseconds(100);
+
+private:
+	static constexpr unsigned LEVELS = 4;
+	static constexpr unsigned SLOT_BITS = 6;
+	static constexpr unsigned SLOTS = 1 << SLOT_BITS;
+
+	static constexpr uint64_t NO_TICK = ~uint64_t(0);
+
+	typedef boost::intrusive::list<CoarseTimerEvent,
+				       boost::intrusive::member_hook<CoarseTimerEvent,
+								     CoarseTimerEvent::ListHook,
+								     &CoarseTimerEvent::list_hook>,
+				       boost::intrusive::constant_time_size<false>> List;
+
+	List slots[LEVELS][SLOTS];
+
+	/**
+	 * One bit per slot which may be non-empty.  Since
+	 * CoarseTimerEvent::Cancel() unlinks the timer without
+	 * telling this class, a bit may be set for an empty slot;
+	 * it is cleared lazily by FindNextTick().
+	 */
+	uint64_t occupied[LEVELS];
+
+	/**
+	 * Expired timers which are about to be invoked.
+	 */
+	List expired;
+
+	/**
+	 * All ticks before this one have been handled.
+	 */
+	uint64_t next_tick;
+
+public:
+	explicit TimerWheel(TimePoint now) noexcept;
+	~TimerWheel() noexcept;
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const noexcept;
+
+	void Insert(CoarseTimerEvent &t, TimePoint due) noexcept;
+
+	/**
+	 * Invoke all timers which are due at the given time.
+	 *
+	 * @return the duration until the next timer may be due (or
+	 * until the next cascade which is necessary to find out); a
+	 * negative value if there are no timers
+	 */
+	Duration Run(TimePoint now) noexcept;
+
+private:
+	/**
+	 * The tick which starts at (or after) the given time.
+	 */
+	static constexpr uint64_t CeilTick(TimePoint t) noexcept {
+		return (t.time_since_epoch() + RESOLUTION - Duration(1)) / RESOLUTION;
+	}
+
+	/**
+	 * The tick which contains the given time.
+	 */
+	static constexpr uint64_t FloorTick(TimePoint t) noexcept {
+		return t.time_since_epoch() / RESOLUTION;
+	}
+
+	static constexpr TimePoint TickToTime(uint64_t tick) noexcept {
+		return TimePoint(tick * RESOLUTION);
+	}
+
+	static constexpr unsigned GetSlot(uint64_t tick,
+					  unsigned level) noexcept {
+		return (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+	}
+
+	void Insert(CoarseTimerEvent &t) noexcept;
+
+	/**
+	 * Returns the first tick at which a timer may expire or a
+	 * slot needs to be cascaded, or #NO_TICK if the wheel is
+	 * empty.
+	 */
+	uint64_t FindNextTick() noexcept;
+
+	/**
+	 * Move all timers of the given slot to lower levels.
+	 */
+	void Cascade(unsigned level, unsigned slot) noexcept;
+
+	/**
+	 * Handle the tick #next_tick: cascade higher levels if
+	 * needed and move expired timers to #expired.
+	 */
+	void HandleTick() noexcept;
+};
+
+#endif
@@ -43,8 +43,14 @@ class ConvertFilter final : public Filter {
 	 */
 	PcmConvert state;
 
+	/**
+	 * The number of threads used for converting DSD to PCM.
+	 */
+	const unsigned dsd_threads;
+
 public:
-	ConvertFilter(const AudioFormat &audio_format);
+	ConvertFilter(const AudioFormat &audio_format,
+		      unsigned _dsd_threads=1);
 	~ConvertFilter();
 
 	void Set(const AudioFormat &_out_audio_format);
@@ -69,7 +75,12 @@ private:
 };
 
 class PreparedConvertFilter final : public PreparedFilter {
+	const unsigned dsd_threads;
+
 public:
+	explicit PreparedConvertFilter(unsigned _dsd_threads) noexcept
+		:dsd_threads(_dsd_threads) {}
+
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
 
@@ -92,13 +103,15 @@ ConvertFilter::Set(const AudioFormat &_out_audio_format)
 		/* optimized special case: no-op */
 		return;
 
-	state.Open(in_audio_format, _out_audio_format);
+	state.Open(in_audio_format, _out_audio_format, dsd_threads);
 
 	out_audio_format = _out_audio_format;
 }
 
-ConvertFilter::ConvertFilter(const AudioFormat &audio_format)
-	:Filter(audio_format), in_audio_format(audio_format)
+ConvertFilter::ConvertFilter(const AudioFormat &audio_format,
+			     unsigned _dsd_threads)
+	:Filter(audio_format), in_audio_format(audio_format),
+	 dsd_threads(_dsd_threads)
 {
 }
 
@@ -107,7 +120,7 @@ PreparedConvertFilter::Open(AudioFormat &audio_format)
 {
 	assert(audio_format.IsValid());
 
-	return std::make_unique<ConvertFilter>(audio_format);
+	return std::make_unique<ConvertFilter>(audio_format, dsd_threads);
 }
 
 ConvertFilter::~ConvertFilter()
@@ -130,9 +143,9 @@ ConvertFilter::FilterPCM(ConstBuffer<void> src)
 }
 
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept
+convert_filter_prepare(unsigned dsd_threads) noexcept
 {
-	return std::make_unique<PreparedConvertFilter>();
+	return std::make_unique<PreparedConvertFilter>(dsd_threads);
 }
 
 Filter *
@@ -26,8 +26,12 @@ class PreparedFilter;
 class Filter;
 struct AudioFormat;
 
+/**
+ * @param dsd_threads the number of threads used for converting DSD
+ * to PCM
+ */
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept;
+convert_filter_prepare(unsigned dsd_threads=1) noexcept;
 
 Filter *
 convert_filter_new(AudioFormat in_audio_format,
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/Path.hxx"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <stdint.h>
+#else
+#include "system/Error.hxx"
+
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile(Path path)
+{
+	FileReader reader(path);
+
+	const uint64_t file_size = reader.GetSize();
+	if (file_size == 0)
+		return;
+
+	if (file_size != size_t(file_size))
+		throw std::runtime_error("File is too large");
+
+	size = file_size;
+
+#ifdef _WIN32
+	uint8_t *buffer = new uint8_t[size];
+
+	try {
+		for (size_t position = 0; position < size;) {
+			size_t nbytes = reader.Read(buffer + position,
+						    size - position);
+			if (nbytes == 0)
+				throw std::runtime_error("Unexpected end of file");
+
+			position += nbytes;
+		}
+	} catch (...) {
+		delete[] buffer;
+		throw;
+	}
+
+	data = buffer;
+#else
+	data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE,
+		    reader.GetFD().Get(), 0);
+	if (data == MAP_FAILED) {
+		data = nullptr;
+		throw FormatErrno("Failed to map %s", path.ToUTF8().c_str());
+	}
+
+	/* the whole file is usually read sequentially */
+	madvise(data, size, MADV_SEQUENTIAL);
+	madvise(data, size, MADV_WILLNEED);
+#endif
+}
+
+MappedFile::~MappedFile() noexcept
+{
+#ifdef _WIN32
+	delete[] (uint8_t *)data;
+#else
+	if (data != nullptr)
+		munmap(data, size);
+#endif
+}
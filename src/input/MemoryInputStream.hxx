@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MEMORY_INPUT_STREAM_HXX
+#define MPD_MEMORY_INPUT_STREAM_HXX
+
+#include "InputStream.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+
+/**
+ * An #InputStream which reads from a string in memory.  This is
+ * useful for passing a portion of a file to a parser which expects
+ * an #InputStream.
+ */
+class MemoryInputStream final : public InputStream {
+	const std::string data;
+
+public:
+	MemoryInputStream(const char *_uri, Mutex &_mutex,
+			  std::string &&_data) noexcept
+		:InputStream(_uri, _mutex), data(std::move(_data)) {
+		size = data.length();
+		seekable = true;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	void Seek(offset_type new_offset) override {
+		if (new_offset > size)
+			throw std::runtime_error("Invalid offset");
+
+		offset = new_offset;
+	}
+
+	bool IsEOF() noexcept override {
+		return offset >= size;
+	}
+
+	size_t Read(void *ptr, size_t read_size) override {
+		const size_t nbytes =
+			std::min<offset_type>(read_size, size - offset);
+		memcpy(ptr, data.data() + offset, nbytes);
+		offset += nbytes;
+		return nbytes;
+	}
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ParallelInputStream.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+ParallelInputStream::ParallelInputStream(const char *_uri, Mutex &_mutex,
+					 offset_type _size,
+					 offset_type _range_size) noexcept
+	:InputStream(_uri, _mutex),
+	 range_size(_range_size),
+	 buffer(_size)
+{
+	assert(range_size > 0);
+
+	size = _size;
+	seekable = true;
+}
+
+void
+ParallelInputStream::Append(Range &range, ConstBuffer<void> data) noexcept
+{
+	auto *src = (const uint8_t *)data.data;
+	size_t remaining = data.size;
+
+	while (remaining > 0 && range.position < range.end) {
+		const size_t max_size =
+			std::min<offset_type>(remaining,
+					      range.end - range.position);
+
+		size_t nbytes;
+		auto w = buffer.Write(range.position);
+		if (w.empty()) {
+			/* already known, skip it */
+			const auto r = buffer.Read(range.position);
+			nbytes = std::min(max_size, r.defined_buffer.size);
+		} else {
+			nbytes = std::min(max_size, w.size);
+			memcpy(w.data, src, nbytes);
+			buffer.Commit(range.position,
+				      range.position + nbytes);
+		}
+
+		src += nbytes;
+		remaining -= nbytes;
+		range.position += nbytes;
+	}
+
+	/* excess data is ignored */
+
+	read_cond.broadcast();
+	InvokeOnAvailable();
+}
+
+void
+ParallelInputStream::SetSequential(Range &range) noexcept
+{
+	sequential = true;
+	range.position = 0;
+	range.end = size;
+}
+
+void
+ParallelInputStream::Check()
+{
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+}
+
+void
+ParallelInputStream::Seek(offset_type new_offset)
+{
+	if (new_offset > size)
+		throw std::runtime_error("Invalid offset");
+
+	offset = new_offset;
+
+	if (!IsAvailable())
+		DoSchedule();
+}
+
+bool
+ParallelInputStream::IsEOF() noexcept
+{
+	/* this check must come before any SparseBuffer::Read()
+	   call, because the buffer does not accept offsets beyond
+	   its end */
+	return offset >= size;
+}
+
+bool
+ParallelInputStream::IsAvailable() noexcept
+{
+	return IsEOF() || postponed_exception ||
+		buffer.Read(offset).HasData();
+}
+
+size_t
+ParallelInputStream::Read(void *ptr, size_t read_size)
+{
+	if (IsEOF())
+		return 0;
+
+	while (true) {
+		auto r = buffer.Read(offset);
+		if (r.HasData()) {
+			size_t nbytes = std::min(read_size,
+						 r.defined_buffer.size);
+			memcpy(ptr, r.defined_buffer.data, nbytes);
+			offset += nbytes;
+			return nbytes;
+		}
+
+		if (postponed_exception)
+			std::rethrow_exception(postponed_exception);
+
+		DoSchedule();
+		read_cond.wait(mutex);
+	}
+}
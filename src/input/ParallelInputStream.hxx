@@ -0,0 +1,248 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PARALLEL_INPUT_STREAM_HXX
+#define MPD_PARALLEL_INPUT_STREAM_HXX
+
+#include "InputStream.hxx"
+#include "thread/Cond.hxx"
+#include "util/SparseBuffer.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+
+#include <stdint.h>
+
+/**
+ * Helper class for #InputStream implementations which fetch a
+ * resource of known size with several concurrent range requests.
+ * The received data is written into a #SparseBuffer, from which the
+ * regular #InputStream API is served.
+ *
+ * This class decides which ranges shall be fetched; the derived
+ * class owns a list of #Range objects (or subclasses) and performs
+ * the actual I/O.  All methods must be called with the mutex locked.
+ */
+class ParallelInputStream : public InputStream {
+public:
+	/**
+	 * The state of one range request.
+	 */
+	struct Range {
+		/**
+		 * The offset of the next byte to be received.
+		 */
+		offset_type position;
+
+		/**
+		 * The end offset of the requested range (excluding).
+		 */
+		offset_type end;
+
+		/**
+		 * Is a request running for this range?
+		 */
+		bool busy = false;
+
+		bool IsBusy() const noexcept {
+			return busy;
+		}
+
+		bool Contains(offset_type o) const noexcept {
+			return IsBusy() && o >= position && o < end;
+		}
+	};
+
+private:
+	/**
+	 * The maximum size of a new range.
+	 */
+	const offset_type range_size;
+
+protected:
+	/**
+	 * Signalled when new data has arrived or an error has
+	 * occurred.
+	 */
+	Cond read_cond;
+
+	SparseBuffer<uint8_t> buffer;
+
+	std::exception_ptr postponed_exception;
+
+	/**
+	 * Has the server ignored a range request and sent the whole
+	 * resource?  In that case, no new ranges are started, and
+	 * the reader waits for that one response.
+	 */
+	bool sequential = false;
+
+public:
+	ParallelInputStream(const char *_uri, Mutex &_mutex,
+			    offset_type _size,
+			    offset_type _range_size) noexcept;
+
+	/**
+	 * Is a #Range currently fetching the given offset?
+	 */
+	template<typename L>
+	gcc_pure
+	static bool IsInFlight(const L &ranges, offset_type o) noexcept {
+		return std::any_of(ranges.begin(), ranges.end(),
+				   [o](const Range &range){
+					   return range.Contains(o);
+				   });
+	}
+
+	/**
+	 * Does the reader wait for data which no #Range is fetching?
+	 */
+	template<typename L>
+	gcc_pure
+	bool IsStalled(const L &ranges) const noexcept {
+		/* check the end first, because the buffer does not
+		   accept offsets beyond its end */
+		return offset < size && !buffer.Read(offset).HasData() &&
+			!IsInFlight(ranges, offset);
+	}
+
+	/**
+	 * Find the next portion of the buffer which is neither known
+	 * nor being fetched, starting at the read offset.  It ends
+	 * at the next hole boundary, at the position of the next busy
+	 * #Range or after #range_size bytes, whichever comes first.
+	 *
+	 * @return false if there is nothing left to be fetched (or
+	 * if the stream has fallen back to #sequential)
+	 */
+	template<typename L>
+	gcc_pure
+	bool FindNextRange(const L &ranges, offset_type &start_r,
+			   offset_type &end_r) const noexcept {
+		if (sequential)
+			return false;
+
+		offset_type p = offset;
+
+		while (p < size) {
+			const auto r = buffer.Read(p);
+			if (r.undefined_size == 0) {
+				/* already known, skip it */
+				p += r.defined_buffer.size;
+				continue;
+			}
+
+			offset_type end = std::min<offset_type>(p + r.undefined_size,
+								p + range_size);
+
+			bool in_flight = false;
+			for (const Range &range : ranges) {
+				if (range.Contains(p)) {
+					/* another request is already
+					   fetching this; continue
+					   after it */
+					p = range.end;
+					in_flight = true;
+					break;
+				}
+
+				if (range.IsBusy() && range.position > p &&
+				    range.position < end)
+					end = range.position;
+			}
+
+			if (in_flight)
+				continue;
+
+			start_r = p;
+			end_r = end;
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Pick the busy #Range with the lowest priority: one which is
+	 * behind the read offset, or else the one farthest ahead of
+	 * it.
+	 *
+	 * @return nullptr if no #Range is busy
+	 */
+	template<typename L>
+	gcc_pure
+	static auto FindVictim(L &ranges, offset_type offset) noexcept
+		-> decltype(&*ranges.begin()) {
+		decltype(&*ranges.begin()) victim = nullptr;
+		offset_type victim_distance = 0;
+
+		for (auto &range : ranges) {
+			if (!range.IsBusy())
+				continue;
+
+			/* a request behind the read offset is useless
+			   for now */
+			const offset_type distance = range.position >= offset
+				? range.position - offset
+				: std::numeric_limits<offset_type>::max();
+			if (victim == nullptr || distance > victim_distance) {
+				victim = &range;
+				victim_distance = distance;
+			}
+		}
+
+		return victim;
+	}
+
+	/**
+	 * Store data received for the given #Range and advance its
+	 * position.  Data beyond the end of the #Range is ignored,
+	 * and so is data which is already known.
+	 */
+	void Append(Range &range, ConstBuffer<void> data) noexcept;
+
+	/**
+	 * The server has ignored a range request and is sending the
+	 * whole resource with the given #Range: let it continue from
+	 * the beginning to the end of the resource, and don't start
+	 * any more ranges.
+	 */
+	void SetSequential(Range &range) noexcept;
+
+	/* virtual methods from class InputStream */
+	void Check() override;
+	void Seek(offset_type new_offset) override;
+	bool IsEOF() noexcept override;
+	bool IsAvailable() noexcept override;
+	size_t Read(void *ptr, size_t read_size) override;
+
+protected:
+	/**
+	 * The reader needs data at the read offset which is not
+	 * available yet.  The implementation shall (asynchronously)
+	 * assign ranges; see FindNextRange().  Called with the
+	 * mutex locked.
+	 */
+	virtual void DoSchedule() noexcept = 0;
+};
+
+#endif
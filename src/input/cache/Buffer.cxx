@@ -0,0 +1,99 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Buffer.hxx"
+#include "fs/Path.hxx"
+#include "system/Error.hxx"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static uint8_t *
+AllocateSpill(size_t size, Path directory)
+{
+#if defined(__linux__) && defined(O_TMPFILE)
+	/* the file is anonymous; it disappears when the mapping is
+	   released */
+	int fd = open(directory.c_str(), O_TMPFILE|O_RDWR|O_CLOEXEC, 0600);
+	if (fd < 0)
+		throw FormatErrno("Failed to create temporary file in %s",
+				  directory.c_str());
+
+	if (ftruncate(fd, size) < 0) {
+		const int e = errno;
+		close(fd);
+		throw MakeErrno(e, "Failed to resize temporary file");
+	}
+
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		       fd, 0);
+	const int e = errno;
+	close(fd);
+	if (p == MAP_FAILED)
+		throw MakeErrno(e, "Failed to map temporary file");
+
+	return (uint8_t *)p;
+#else
+	(void)size;
+	(void)directory;
+	throw std::runtime_error("The input cache spill directory is not supported on this platform");
+#endif
+}
+
+InputCacheBuffer::InputCacheBuffer(size_t _size, Path spill_directory)
+	:data(spill_directory.IsNull()
+	      ? (uint8_t *)HugeAllocate(_size).data
+	      : AllocateSpill(_size, spill_directory)),
+	 size(_size), spill(!spill_directory.IsNull()),
+	 map(_size)
+{
+	if (!spill)
+		HugeForkCow(data, size, false);
+}
+
+InputCacheBuffer::~InputCacheBuffer() noexcept
+{
+#ifndef _WIN32
+	if (spill) {
+		munmap(data, size);
+		return;
+	}
+#endif
+
+	HugeFree(data, size);
+}
+
+size_t
+InputCacheBuffer::FindHole(size_t offset) const noexcept
+{
+	while (offset < size) {
+		auto c = map.Check(offset);
+		if (c.undefined_size > 0)
+			return offset;
+
+		offset += c.defined_size;
+	}
+
+	return size;
+}
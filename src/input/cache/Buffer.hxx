@@ -0,0 +1,94 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_BUFFER_HXX
+#define MPD_INPUT_CACHE_BUFFER_HXX
+
+#include "util/SparseBuffer.hxx"
+
+#include <stdint.h>
+
+class Path;
+
+/**
+ * The contents of one #InputCacheItem, and a map of which portions
+ * are known already.
+ *
+ * The memory is either anonymous (see #HugeAllocate()), or a shared
+ * mapping of an unlinked temporary file in the "spill" directory.  In
+ * the latter case, the kernel may write cold pages to that file
+ * instead of keeping them in RAM.
+ */
+class InputCacheBuffer {
+	uint8_t *const data;
+
+	const size_t size;
+
+	const bool spill;
+
+	SparseMap map;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param spill_directory the directory for the temporary
+	 * file; "null" to use anonymous memory
+	 */
+	InputCacheBuffer(size_t _size, Path spill_directory);
+	~InputCacheBuffer() noexcept;
+
+	InputCacheBuffer(const InputCacheBuffer &) = delete;
+	InputCacheBuffer &operator=(const InputCacheBuffer &) = delete;
+
+	/**
+	 * Returns the known data at the given offset (which may be
+	 * empty).
+	 */
+	ConstBuffer<uint8_t> Read(size_t offset) const noexcept {
+		auto c = map.Check(offset);
+		if (c.undefined_size > 0)
+			return nullptr;
+
+		return {data + offset, c.defined_size};
+	}
+
+	/**
+	 * Returns the unknown data at the given offset (which may be
+	 * empty) which may be written to.  Call Commit() afterwards.
+	 */
+	WritableBuffer<uint8_t> Write(size_t offset) noexcept {
+		auto c = map.Check(offset);
+		return {data + offset, c.undefined_size};
+	}
+
+	void Commit(size_t start_offset, size_t end_offset) noexcept {
+		map.Commit(start_offset, end_offset);
+	}
+
+	/**
+	 * Find the first unknown byte at or after the given offset.
+	 * Returns the buffer size if everything after that offset is
+	 * known.
+	 */
+	gcc_pure
+	size_t FindHole(size_t offset) const noexcept;
+};
+
+#endif
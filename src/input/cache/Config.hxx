@@ -0,0 +1,54 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_CONFIG_HXX
+#define MPD_INPUT_CACHE_CONFIG_HXX
+
+#include "fs/AllocatedPath.hxx"
+
+#include <stddef.h>
+
+struct ConfigBlock;
+
+struct InputCacheConfig {
+	/**
+	 * The maximum total size of all cached files [bytes].
+	 */
+	size_t size;
+
+	/**
+	 * The number of upcoming songs (starting with the one queued
+	 * in the player) which shall be prefetched.
+	 */
+	unsigned prefetch;
+
+	/**
+	 * If not "null", then cached files are stored in (unlinked)
+	 * temporary files in this directory, which allows the kernel
+	 * to spill them to disk instead of keeping them in RAM.
+	 */
+	AllocatedPath spill_directory;
+
+	/**
+	 * Throws on error.
+	 */
+	explicit InputCacheConfig(const ConfigBlock &block);
+};
+
+#endif
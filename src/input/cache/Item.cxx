@@ -0,0 +1,295 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Item.hxx"
+#include "Manager.hxx"
+#include "Domain.hxx"
+#include "Buffer.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+InputCacheItem::InputCacheItem(InputCacheManager &_manager,
+			       const char *_uri,
+			       std::chrono::system_clock::time_point _mtime) noexcept
+	:manager(_manager), uri(_uri), mtime(_mtime),
+	 thread(BIND_THIS_METHOD(RunThread))
+{
+}
+
+InputCacheItem::~InputCacheItem() noexcept
+{
+	assert(n_leases == 0);
+	assert(listeners.empty());
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		stop = true;
+		wake_cond.signal();
+	}
+
+	if (thread.IsDefined())
+		thread.Join();
+}
+
+void
+InputCacheItem::AddListener(InputCacheListener &listener) noexcept
+{
+	const std::lock_guard<Mutex> lock(listeners_mutex);
+	listeners.push_back(listener);
+}
+
+void
+InputCacheItem::RemoveListener(InputCacheListener &listener) noexcept
+{
+	const std::lock_guard<Mutex> lock(listeners_mutex);
+	listeners.erase(listeners.iterator_to(listener));
+}
+
+void
+InputCacheItem::NotifyListeners() noexcept
+{
+	const std::lock_guard<Mutex> lock(listeners_mutex);
+	for (auto &i : listeners)
+		i.OnInputCacheAvailable();
+}
+
+bool
+InputCacheItem::LockGetAttributes(Attributes &attributes,
+				  bool &usable) const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	usable = true;
+
+	if (!buffer) {
+		if (state == State::FAILED || state == State::UNSUITABLE)
+			usable = false;
+		return false;
+	}
+
+	attributes.mime_type = mime_type;
+	attributes.size = size;
+	return true;
+}
+
+bool
+InputCacheItem::LockIsAvailable(offset_type offset) const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	assert(buffer);
+	assert(offset < size);
+
+	return !buffer->Read(offset).empty() || error;
+}
+
+size_t
+InputCacheItem::LockRead(offset_type offset, void *dest, size_t length)
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	assert(buffer);
+	assert(offset < size);
+
+	auto r = buffer->Read(offset);
+	if (!r.empty()) {
+		size_t nbytes = std::min(length, r.size);
+		memcpy(dest, r.data, nbytes);
+		return nbytes;
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+
+	if (want_offset != offset) {
+		want_offset = offset;
+		wake_cond.signal();
+	}
+
+	return 0;
+}
+
+void
+InputCacheItem::LockSetWantOffset(offset_type offset) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (buffer && offset < size && buffer->Read(offset).empty()) {
+		want_offset = offset;
+		wake_cond.signal();
+	}
+}
+
+inline void
+InputCacheItem::FillLoop(InputStream &is)
+{
+	while (!stop) {
+		offset_type position = is.GetOffset();
+
+		if (want_offset != UNKNOWN_OFFSET) {
+			/* a reader needs data at this position;
+			   fetch it before anything else */
+			const auto hole = buffer->FindHole(want_offset);
+			want_offset = UNKNOWN_OFFSET;
+			if (hole < size && hole != position &&
+			    is.IsSeekable()) {
+				is.Seek(hole);
+				continue;
+			}
+		}
+
+		auto hole = position < size
+			? buffer->FindHole(position)
+			: size;
+		if (hole == size)
+			/* no gaps after the current position; fill
+			   the gaps before it */
+			hole = buffer->FindHole(0);
+
+		if (hole == size) {
+			state = State::COMPLETE;
+			FormatDebug(input_cache_domain, "Cached %s",
+				    uri.c_str());
+			return;
+		}
+
+		if (hole != position) {
+			if (!is.IsSeekable())
+				throw std::runtime_error("Cannot seek to the missing portion");
+
+			is.Seek(hole);
+			continue;
+		}
+
+		if (!is.IsAvailable()) {
+			wake_cond.wait(mutex);
+			continue;
+		}
+
+		if (is.IsEOF())
+			throw std::runtime_error("Premature end of file");
+
+		auto w = buffer->Write(hole);
+		assert(!w.empty());
+
+		const size_t nbytes = is.Read(w.data, w.size);
+		if (nbytes > 0) {
+			buffer->Commit(hole, hole + nbytes);
+
+			const ScopeUnlock unlock(mutex);
+			NotifyListeners();
+		}
+	}
+}
+
+inline void
+InputCacheItem::Fill(InputStream &is) noexcept
+{
+	try {
+		while (true) {
+			if (stop)
+				return;
+
+			is.Update();
+			if (is.IsReady())
+				break;
+
+			wake_cond.wait(mutex);
+		}
+
+		is.Check();
+
+		if (!is.KnownSize() || is.GetSize() == 0) {
+			state = State::UNSUITABLE;
+			const ScopeUnlock unlock(mutex);
+			manager.MarkUnsuitable(*this);
+			return;
+		}
+
+		const offset_type _size = is.GetSize();
+		bool reserved;
+
+		{
+			const ScopeUnlock unlock(mutex);
+			reserved = manager.Reserve(*this, _size);
+		}
+
+		if (!reserved) {
+			state = State::UNSUITABLE;
+			return;
+		}
+
+		/* Reserve() has verified that the size fits into
+		   size_t */
+		buffer = std::make_unique<InputCacheBuffer>(size_t(_size),
+							   manager.GetSpillDirectory());
+		size = _size;
+		if (is.HasMimeType())
+			mime_type = is.GetMimeType();
+
+		state = State::FILL;
+
+		{
+			/* wake up readers waiting for the item to
+			   become ready */
+			const ScopeUnlock unlock(mutex);
+			NotifyListeners();
+		}
+
+		FillLoop(is);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to cache %s", uri.c_str());
+
+		error = std::current_exception();
+		state = State::FAILED;
+	}
+}
+
+void
+InputCacheItem::RunThread() noexcept
+{
+	SetThreadName("input_cache");
+
+	InputStreamPtr is;
+
+	try {
+		is = InputStream::Open(uri.c_str(), mutex);
+		is->SetHandler(this);
+	} catch (...) {
+		const std::lock_guard<Mutex> lock(mutex);
+		error = std::current_exception();
+		state = State::FAILED;
+	}
+
+	if (is) {
+		const std::lock_guard<Mutex> lock(mutex);
+		Fill(*is);
+	}
+
+	NotifyListeners();
+
+	/* the InputStream must be destroyed without holding its
+	   mutex */
+	is.reset();
+}
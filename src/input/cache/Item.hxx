@@ -0,0 +1,285 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_ITEM_HXX
+#define MPD_INPUT_CACHE_ITEM_HXX
+
+#include "input/Offset.hxx"
+#include "input/Handler.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+#include <boost/intrusive/unordered_set.hpp>
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+
+class InputStream;
+class InputCacheManager;
+class InputCacheBuffer;
+
+/**
+ * Receives notifications from an #InputCacheItem.
+ */
+class InputCacheListener
+	: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+public:
+	/**
+	 * The #InputCacheItem has become ready (or has failed), or
+	 * new data is available.  This is called from the item's
+	 * thread without holding any lock, and must not block.
+	 */
+	virtual void OnInputCacheAvailable() noexcept = 0;
+};
+
+/**
+ * One file in the #InputCacheManager.  A private thread opens the
+ * #InputStream and copies it into an #InputCacheBuffer; data which is
+ * needed by a reader (see SetWantOffset()) is fetched first, and the
+ * rest afterwards.
+ */
+class InputCacheItem final : InputStreamHandler {
+	friend class InputCacheManager;
+	friend class InputCacheLease;
+
+	/* the following fields are protected by the manager's
+	   mutex */
+
+	boost::intrusive::list_member_hook<> lru_hook;
+	boost::intrusive::unordered_set_member_hook<> map_hook;
+
+	/**
+	 * The number of #InputCacheLease instances referring to this
+	 * item.  While this is non-zero, the item is not evicted.
+	 */
+	unsigned n_leases = 0;
+
+	/**
+	 * The number of bytes accounted in
+	 * InputCacheManager::total_size.
+	 */
+	size_t reserved_size = 0;
+
+	/**
+	 * This item cannot be cached (e.g. because its size is
+	 * unknown or too large).  It is kept as a marker for
+	 * InputCacheManager::Open().
+	 */
+	bool unsuitable = false;
+
+	InputCacheManager &manager;
+
+	const std::string uri;
+	const std::chrono::system_clock::time_point mtime;
+
+	/**
+	 * Protects the fields below; this is also the mutex of the
+	 * #InputStream.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * Wakes up the #thread.
+	 */
+	Cond wake_cond;
+
+	Thread thread;
+
+	enum class State {
+		/**
+		 * Waiting for the #InputStream to become ready.
+		 */
+		OPEN,
+
+		/**
+		 * The #buffer is being filled.
+		 */
+		FILL,
+
+		/**
+		 * The whole file is in the #buffer.
+		 */
+		COMPLETE,
+
+		/**
+		 * An error has occurred (see #error).  The #buffer
+		 * may contain partial data.
+		 */
+		FAILED,
+
+		/**
+		 * The file cannot be cached.
+		 */
+		UNSUITABLE,
+	} state = State::OPEN;
+
+	bool stop = false;
+
+	std::string mime_type;
+
+	offset_type size;
+
+	static constexpr offset_type UNKNOWN_OFFSET = ~offset_type(0);
+
+	/**
+	 * A reader is waiting for data at this offset.  Fill the
+	 * buffer from here first.
+	 */
+	offset_type want_offset = UNKNOWN_OFFSET;
+
+	std::unique_ptr<InputCacheBuffer> buffer;
+
+	std::exception_ptr error;
+
+	/**
+	 * Protects #listeners.  It is separate from #mutex, because
+	 * the listeners lock their own #InputStream mutex, which is
+	 * held while calling into this object.
+	 */
+	Mutex listeners_mutex;
+
+	boost::intrusive::list<InputCacheListener,
+			       boost::intrusive::constant_time_size<false>> listeners;
+
+public:
+	InputCacheItem(InputCacheManager &_manager,
+		       const char *_uri,
+		       std::chrono::system_clock::time_point _mtime) noexcept;
+	~InputCacheItem() noexcept;
+
+	InputCacheItem(const InputCacheItem &) = delete;
+	InputCacheItem &operator=(const InputCacheItem &) = delete;
+
+	const std::string &GetUri() const noexcept {
+		return uri;
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Start() {
+		thread.Start();
+	}
+
+	void AddListener(InputCacheListener &listener) noexcept;
+	void RemoveListener(InputCacheListener &listener) noexcept;
+
+	struct Attributes {
+		std::string mime_type;
+		offset_type size;
+	};
+
+	/**
+	 * Is the #buffer available for reading?  Then copy the
+	 * stream attributes to the given object and return true.
+	 * Sets #usable to false if this item has failed before it
+	 * became ready, i.e. the caller shall open the resource
+	 * directly.
+	 */
+	bool LockGetAttributes(Attributes &attributes,
+			       bool &usable) const noexcept;
+
+	/**
+	 * Is there data at the given offset (or an error which will
+	 * be thrown by LockRead())?
+	 */
+	gcc_pure
+	bool LockIsAvailable(offset_type offset) const noexcept;
+
+	/**
+	 * Copy data from the given offset.  If no data is available
+	 * yet, returns 0 and asks the thread to fill this position
+	 * next.
+	 *
+	 * Throws if no data is available because filling the cache
+	 * has failed.
+	 */
+	size_t LockRead(offset_type offset, void *dest, size_t length);
+
+	/**
+	 * A reader is going to read from this offset.
+	 */
+	void LockSetWantOffset(offset_type offset) noexcept;
+
+	gcc_pure
+	bool LockIsFailed() const noexcept {
+		const std::lock_guard<Mutex> lock(mutex);
+		return state == State::FAILED;
+	}
+
+	struct Hash {
+		gcc_pure
+		std::size_t operator()(const std::string &u) const noexcept {
+			return std::hash<std::string>()(u);
+		}
+
+		gcc_pure
+		std::size_t operator()(const InputCacheItem &item) const noexcept {
+			return std::hash<std::string>()(item.uri);
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const InputCacheItem &a,
+				const InputCacheItem &b) const noexcept {
+			return a.uri == b.uri;
+		}
+
+		gcc_pure
+		bool operator()(const std::string &a,
+				const InputCacheItem &b) const noexcept {
+			return a == b.uri;
+		}
+	};
+
+private:
+	void NotifyListeners() noexcept;
+
+	/**
+	 * Wait for the #InputStream to become ready, and fill the
+	 * #buffer.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Fill(InputStream &is) noexcept;
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void FillLoop(InputStream &is);
+
+	void RunThread() noexcept;
+
+	/* virtual methods from class InputStreamHandler */
+	void OnInputStreamReady() noexcept override {
+		wake_cond.signal();
+	}
+
+	void OnInputStreamAvailable() noexcept override {
+		wake_cond.signal();
+	}
+};
+
+#endif
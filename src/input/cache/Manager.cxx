@@ -0,0 +1,240 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Manager.hxx"
+#include "Config.hxx"
+#include "Stream.hxx"
+#include "Domain.hxx"
+#include "input/InputStream.hxx"
+#include "util/UriUtil.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+InputCacheManager::InputCacheManager(const InputCacheConfig &config) noexcept
+	:max_total_size(config.size),
+	 prefetch(config.prefetch),
+	 spill_directory(config.spill_directory),
+	 map(ItemMap::bucket_traits(&buckets.front(), buckets.size()))
+{
+}
+
+InputCacheManager::~InputCacheManager() noexcept
+{
+	map.clear();
+	lru.clear_and_dispose(DeleteDisposer());
+}
+
+bool
+InputCacheManager::IsEligible(const char *uri,
+			      std::chrono::system_clock::time_point mtime) noexcept
+{
+	return uri_has_scheme(uri) &&
+		mtime != std::chrono::system_clock::time_point::min();
+}
+
+InputCacheItem *
+InputCacheManager::Make(const char *uri,
+			std::chrono::system_clock::time_point mtime,
+			ItemList &garbage) noexcept
+{
+	ItemMap::insert_commit_data hint;
+	auto result = map.insert_check(uri, InputCacheItem::Hash(),
+				       InputCacheItem::Equal(), hint);
+	if (!result.second) {
+		auto &item = *result.first;
+		if (item.mtime == mtime && !item.LockIsFailed()) {
+			/* cache hit: move to the front of the LRU
+			   list */
+			lru.erase(lru.iterator_to(item));
+			lru.push_front(item);
+			return item.unsuitable ? nullptr : &item;
+		}
+
+		/* the file has been modified or fetching it has
+		   failed; replace the item */
+		Remove(item, garbage);
+
+		result = map.insert_check(uri, InputCacheItem::Hash(),
+					  InputCacheItem::Equal(), hint);
+		assert(result.second);
+	}
+
+	auto *item = new InputCacheItem(*this, uri, mtime);
+	map.insert_commit(*item, hint);
+	lru.push_front(*item);
+
+	try {
+		item->Start();
+	} catch (...) {
+		LogError(std::current_exception());
+		Remove(*item, garbage);
+		return nullptr;
+	}
+
+	return item;
+}
+
+void
+InputCacheManager::Remove(InputCacheItem &item, ItemList &garbage) noexcept
+{
+	assert(item.map_hook.is_linked());
+
+	map.erase(map.iterator_to(item));
+	lru.erase(lru.iterator_to(item));
+
+	assert(total_size >= item.reserved_size);
+	total_size -= item.reserved_size;
+	item.reserved_size = 0;
+
+	if (item.n_leases == 0)
+		garbage.push_back(item);
+}
+
+void
+InputCacheManager::EvictIfFull(const InputCacheItem *except,
+			       ItemList &garbage) noexcept
+{
+	for (auto i = lru.end(); total_size > max_total_size &&
+		     i != lru.begin();) {
+		auto &item = *std::prev(i);
+		if (&item == except || item.n_leases > 0) {
+			--i;
+			continue;
+		}
+
+		FormatDebug(input_cache_domain, "Evicting %s",
+			    item.uri.c_str());
+		Remove(item, garbage);
+	}
+}
+
+void
+InputCacheManager::Dispose(ItemList &garbage) noexcept
+{
+	garbage.clear_and_dispose(DeleteDisposer());
+}
+
+InputStreamPtr
+InputCacheManager::Open(const char *uri,
+			std::chrono::system_clock::time_point mtime,
+			Mutex &_mutex)
+{
+	if (IsEligible(uri, mtime)) {
+		ItemList garbage;
+		InputCacheLease lease;
+
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			auto *item = Make(uri, mtime, garbage);
+			if (item != nullptr)
+				lease = InputCacheLease(*item);
+		}
+
+		Dispose(garbage);
+
+		if (lease)
+			return std::make_unique<CacheInputStream>(std::move(lease),
+								  _mutex);
+	}
+
+	return InputStream::Open(uri, _mutex);
+}
+
+void
+InputCacheManager::Prefetch(const char *uri,
+			    std::chrono::system_clock::time_point mtime) noexcept
+{
+	if (!IsEligible(uri, mtime))
+		return;
+
+	ItemList garbage;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		Make(uri, mtime, garbage);
+	}
+
+	Dispose(garbage);
+}
+
+bool
+InputCacheManager::Reserve(InputCacheItem &item, offset_type size) noexcept
+{
+	ItemList garbage;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+
+		if (!item.map_hook.is_linked())
+			/* this item has been removed meanwhile */
+			return false;
+
+		/* this check also rejects files whose size does
+		   not fit into size_t */
+		if (size > max_total_size) {
+			FormatDebug(input_cache_domain,
+				    "Too large for the cache: %s",
+				    item.uri.c_str());
+			item.unsuitable = true;
+			return false;
+		}
+
+		item.reserved_size = size_t(size);
+		total_size += item.reserved_size;
+
+		EvictIfFull(&item, garbage);
+	}
+
+	Dispose(garbage);
+	return true;
+}
+
+void
+InputCacheManager::MarkUnsuitable(InputCacheItem &item) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	item.unsuitable = true;
+}
+
+void
+InputCacheManager::Release(InputCacheItem &item) noexcept
+{
+	ItemList garbage;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+
+		assert(item.n_leases > 0);
+		if (--item.n_leases > 0)
+			return;
+
+		if (!item.map_hook.is_linked())
+			/* this item has been removed while it was
+			   in use */
+			garbage.push_back(item);
+		else
+			/* evictions may have been postponed
+			   because this item was in use */
+			EvictIfFull(nullptr, garbage);
+	}
+
+	Dispose(garbage);
+}
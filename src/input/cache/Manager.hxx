@@ -0,0 +1,247 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_MANAGER_HXX
+#define MPD_INPUT_CACHE_MANAGER_HXX
+
+#include "Item.hxx"
+#include "input/Ptr.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+
+#include <array>
+#include <chrono>
+
+struct InputCacheConfig;
+class InputCacheLease;
+
+/**
+ * A global cache for the contents of remote files (e.g. on NFS, SMB
+ * or HTTP servers).  Items are keyed by URI and modification time,
+ * and the least recently used ones are evicted when the configured
+ * size is exceeded.
+ *
+ * This class is thread-safe.
+ */
+class InputCacheManager {
+	friend class InputCacheItem;
+	friend class InputCacheLease;
+
+	const size_t max_total_size;
+
+	const unsigned prefetch;
+
+	const AllocatedPath spill_directory;
+
+	/**
+	 * Protects all fields below and the "manager" fields of all
+	 * #InputCacheItem instances.  InputCacheItem::mutex may be
+	 * locked while holding this one (see Make()), but not the
+	 * other way round.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The sum of all InputCacheItem::reserved_size values.
+	 */
+	size_t total_size = 0;
+
+	using ItemList =
+		boost::intrusive::list<InputCacheItem,
+				       boost::intrusive::member_hook<InputCacheItem,
+								     boost::intrusive::list_member_hook<>,
+								     &InputCacheItem::lru_hook>,
+				       boost::intrusive::constant_time_size<false>>;
+
+	/**
+	 * All items, the most recently used first.
+	 */
+	ItemList lru;
+
+	using ItemMap =
+		boost::intrusive::unordered_set<InputCacheItem,
+						boost::intrusive::member_hook<InputCacheItem,
+									      boost::intrusive::unordered_set_member_hook<>,
+									      &InputCacheItem::map_hook>,
+						boost::intrusive::hash<InputCacheItem::Hash>,
+						boost::intrusive::equal<InputCacheItem::Equal>,
+						boost::intrusive::constant_time_size<false>>;
+
+	std::array<ItemMap::bucket_type, 127> buckets;
+
+	ItemMap map;
+
+public:
+	explicit InputCacheManager(const InputCacheConfig &config) noexcept;
+	~InputCacheManager() noexcept;
+
+	InputCacheManager(const InputCacheManager &) = delete;
+	InputCacheManager &operator=(const InputCacheManager &) = delete;
+
+	/**
+	 * The number of upcoming songs (starting with the one queued
+	 * in the player) which shall be prefetched.
+	 */
+	unsigned GetPrefetchCount() const noexcept {
+		return prefetch;
+	}
+
+	/**
+	 * Is caching the given resource worth a try?  This is only the
+	 * case for remote files (with a URI scheme) whose modification
+	 * time is known, i.e. not for radio streams.
+	 */
+	gcc_pure
+	static bool IsEligible(const char *uri,
+			       std::chrono::system_clock::time_point mtime) noexcept;
+
+	/**
+	 * Open an #InputStream which reads from the cache (and fills
+	 * it).  Falls back to InputStream::Open() if the resource
+	 * cannot be cached.
+	 *
+	 * Throws on error.
+	 */
+	InputStreamPtr Open(const char *uri,
+			    std::chrono::system_clock::time_point mtime,
+			    Mutex &mutex);
+
+	/**
+	 * Start filling the cache with the given resource in the
+	 * background (if it is eligible).
+	 */
+	void Prefetch(const char *uri,
+		      std::chrono::system_clock::time_point mtime) noexcept;
+
+private:
+	/**
+	 * Returns the configured spill directory or a "nulled"
+	 * #Path if there is none.
+	 */
+	Path GetSpillDirectory() const noexcept {
+		return spill_directory.IsNull()
+			? Path(nullptr)
+			: Path(spill_directory);
+	}
+
+	/**
+	 * Look up (or create) the item for the given resource and
+	 * move it to the front of the LRU list.  Returns nullptr if
+	 * the resource is not cacheable (or on error).
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @param garbage stale items are moved to this list; the
+	 * caller shall dispose them after releasing the mutex
+	 */
+	InputCacheItem *Make(const char *uri,
+			     std::chrono::system_clock::time_point mtime,
+			     ItemList &garbage) noexcept;
+
+	/**
+	 * Remove the item from the cache.  If it has no leases, it
+	 * is moved to the given garbage list.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Remove(InputCacheItem &item, ItemList &garbage) noexcept;
+
+	/**
+	 * Remove least recently used items without leases until
+	 * #total_size fits.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void EvictIfFull(const InputCacheItem *except,
+			 ItemList &garbage) noexcept;
+
+	/**
+	 * Delete the given items.  Caller must not lock the mutex,
+	 * because InputCacheItem::RunThread() may need it.
+	 */
+	static void Dispose(ItemList &garbage) noexcept;
+
+	/**
+	 * Called by #InputCacheItem's thread when it knows the file
+	 * size.  Returns false if the item shall not be cached,
+	 * e.g. because it is larger than the cache (or does not fit
+	 * into the address space).
+	 */
+	bool Reserve(InputCacheItem &item, offset_type size) noexcept;
+
+	/**
+	 * Called by #InputCacheItem's thread when the file cannot be
+	 * cached.
+	 */
+	void MarkUnsuitable(InputCacheItem &item) noexcept;
+
+	/**
+	 * Called by #InputCacheLease.
+	 */
+	void Release(InputCacheItem &item) noexcept;
+};
+
+/**
+ * A reference to an #InputCacheItem which protects it from being
+ * evicted.
+ */
+class InputCacheLease {
+	friend class InputCacheManager;
+
+	InputCacheItem *item = nullptr;
+
+	/**
+	 * Caller must lock the manager's mutex.
+	 */
+	explicit InputCacheLease(InputCacheItem &_item) noexcept
+		:item(&_item) {
+		++item->n_leases;
+	}
+
+public:
+	InputCacheLease() = default;
+
+	InputCacheLease(InputCacheLease &&src) noexcept
+		:item(std::exchange(src.item, nullptr)) {}
+
+	~InputCacheLease() noexcept {
+		if (item != nullptr)
+			item->manager.Release(*item);
+	}
+
+	InputCacheLease &operator=(InputCacheLease &&src) noexcept {
+		using std::swap;
+		swap(item, src.item);
+		return *this;
+	}
+
+	operator bool() const noexcept {
+		return item != nullptr;
+	}
+
+	InputCacheItem &operator*() const noexcept {
+		return *item;
+	}
+
+	InputCacheItem *operator->() const noexcept {
+		return item;
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Stream.hxx"
+
+#include <stdexcept>
+
+CacheInputStream::CacheInputStream(InputCacheLease &&_lease,
+				   Mutex &_mutex) noexcept
+	:ProxyInputStream(_lease->GetUri().c_str(), _mutex),
+	 lease(std::move(_lease))
+{
+	lease->AddListener(*this);
+}
+
+CacheInputStream::~CacheInputStream() noexcept
+{
+	lease->RemoveListener(*this);
+}
+
+void
+CacheInputStream::Check()
+{
+	if (open_error)
+		std::rethrow_exception(open_error);
+
+	ProxyInputStream::Check();
+}
+
+void
+CacheInputStream::Update() noexcept
+{
+	if (input) {
+		ProxyInputStream::Update();
+		return;
+	}
+
+	if (IsReady())
+		return;
+
+	InputCacheItem::Attributes attributes;
+	bool usable;
+	if (lease->LockGetAttributes(attributes, usable)) {
+		if (!attributes.mime_type.empty())
+			SetMimeType(std::move(attributes.mime_type));
+
+		size = attributes.size;
+		seekable = true;
+		SetReady();
+	} else if (!usable) {
+		/* the resource cannot be cached; open it directly
+		   (without holding the mutex, because the input
+		   plugin may need it) */
+		InputStreamPtr is;
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			is = InputStream::Open(GetURI(), mutex);
+		} catch (...) {
+			open_error = std::current_exception();
+			SetReady();
+			return;
+		}
+
+		SetInput(std::move(is));
+		input->Update();
+		CopyAttributes();
+	}
+}
+
+void
+CacheInputStream::Seek(offset_type new_offset)
+{
+	if (input) {
+		ProxyInputStream::Seek(new_offset);
+		return;
+	}
+
+	if (new_offset > size)
+		throw std::runtime_error("Invalid offset");
+
+	offset = new_offset;
+
+	if (offset < size)
+		lease->LockSetWantOffset(offset);
+}
+
+bool
+CacheInputStream::IsEOF() noexcept
+{
+	if (input)
+		return ProxyInputStream::IsEOF();
+
+	return IsReady() && offset == size;
+}
+
+bool
+CacheInputStream::IsAvailable() noexcept
+{
+	if (input)
+		return ProxyInputStream::IsAvailable();
+
+	return IsReady() &&
+		(offset >= size || lease->LockIsAvailable(offset));
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size)
+{
+	if (input)
+		return ProxyInputStream::Read(ptr, read_size);
+
+	assert(IsReady());
+
+	if (offset >= size)
+		return 0;
+
+	while (true) {
+		size_t nbytes = lease->LockRead(offset, ptr, read_size);
+		if (nbytes > 0) {
+			offset += nbytes;
+			return nbytes;
+		}
+
+		read_cond.wait(mutex);
+	}
+}
+
+void
+CacheInputStream::OnInputCacheAvailable() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	read_cond.broadcast();
+
+	if (IsReady())
+		InvokeOnAvailable();
+	else
+		InvokeOnReady();
+}
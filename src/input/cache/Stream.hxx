@@ -0,0 +1,65 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CACHE_INPUT_STREAM_HXX
+#define MPD_CACHE_INPUT_STREAM_HXX
+
+#include "Manager.hxx"
+#include "input/ProxyInputStream.hxx"
+
+#include <exception>
+
+/**
+ * An #InputStream which reads from an #InputCacheItem.  If the item
+ * turns out to be unusable before it became ready, this falls back to
+ * opening the resource directly (using the #ProxyInputStream base
+ * class).
+ */
+class CacheInputStream final : public ProxyInputStream, InputCacheListener {
+	InputCacheLease lease;
+
+	/**
+	 * Signalled by OnInputCacheAvailable() for Read(); protected
+	 * by #mutex.
+	 */
+	Cond read_cond;
+
+	/**
+	 * An error from the fallback InputStream::Open() call.
+	 */
+	std::exception_ptr open_error;
+
+public:
+	CacheInputStream(InputCacheLease &&_lease, Mutex &_mutex) noexcept;
+	~CacheInputStream() noexcept override;
+
+	/* virtual methods from InputStream */
+	void Check() override;
+	void Update() noexcept override;
+	void Seek(offset_type new_offset) override;
+	bool IsEOF() noexcept override;
+	bool IsAvailable() noexcept override;
+	size_t Read(void *ptr, size_t read_size) override;
+
+private:
+	/* virtual methods from class InputCacheListener */
+	void OnInputCacheAvailable() noexcept override;
+};
+
+#endif
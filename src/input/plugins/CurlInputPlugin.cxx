@@ -26,7 +26,10 @@
 #include "lib/curl/Handler.hxx"
 #include "lib/curl/Slist.hxx"
 #include "../MaybeBufferedInputStream.hxx"
+#include "../BufferedInputStream.hxx"
+#include "../ProxyInputStream.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../ParallelInputStream.hxx"
 #include "../IcyInputStream.hxx"
 #include "IcyMetaDataParser.hxx"
 #include "../InputPlugin.hxx"
@@ -35,6 +38,7 @@
 #include "tag/Tag.hxx"
 #include "event/Call.hxx"
 #include "event/Loop.hxx"
+#include "event/DeferEvent.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringUtil.hxx"
 #include "util/StringFormat.hxx"
@@ -45,6 +49,9 @@
 #include "PluginUnavailable.hxx"
 
 #include <cinttypes>
+#include <algorithm>
+#include <forward_list>
+#include <stdexcept>
 
 #include <assert.h>
 #include <string.h>
@@ -67,6 +74,12 @@ static const size_t CURL_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t CURL_RESUME_AT = 384 * 1024;
 
+/**
+ * The size of one "Range" request in parallel mode (see
+ * #CurlParallelInputStream).
+ */
+static constexpr size_t CURL_RANGE_SIZE = 512 * 1024;
+
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
 	   too free */
@@ -140,6 +153,115 @@ private:
 	virtual void DoSeek(offset_type new_offset) override;
 };
 
+/**
+ * Fetches a resource of known size with several concurrent "Range"
+ * requests; see #ParallelInputStream.  If a seek lands in a hole
+ * which no request is fetching, the request with the lowest priority
+ * is cancelled in favor of the new position.  If the server ignores
+ * "Range" and sends the whole resource, that response is used and no
+ * more requests are started.
+ *
+ * All #CurlRequest instances are owned by the I/O thread; the buffer,
+ * the read offset and the error are protected by the mutex.
+ */
+class CurlParallelInputStream final : public ParallelInputStream {
+	struct RangeRequest final : Range, CurlResponseHandler {
+		CurlParallelInputStream &parent;
+
+		CurlRequest *request = nullptr;
+
+		explicit RangeRequest(CurlParallelInputStream &_parent) noexcept
+			:parent(_parent) {}
+
+		~RangeRequest() noexcept {
+			delete request;
+		}
+
+		/**
+		 * Abort the request (if any).  Data which has already
+		 * been received stays in the buffer.
+		 */
+		void Cancel() noexcept {
+			delete request;
+			request = nullptr;
+			busy = false;
+		}
+
+		/* virtual methods from CurlResponseHandler */
+		void OnHeaders(unsigned status,
+			       std::multimap<std::string, std::string> &&headers) override;
+		void OnData(ConstBuffer<void> data) override;
+		void OnEnd() override;
+		void OnError(std::exception_ptr e) noexcept override;
+	};
+
+	EventLoop &event_loop;
+
+	CurlSlist request_headers;
+
+	/**
+	 * Schedules ScheduleRanges() in the I/O thread.
+	 */
+	DeferEvent defer_schedule;
+
+	std::forward_list<RangeRequest> ranges;
+
+public:
+	CurlParallelInputStream(const InputStream &src,
+				const std::multimap<std::string, std::string> &headers,
+				unsigned n_ranges);
+	~CurlParallelInputStream() noexcept override;
+
+	/**
+	 * Check whether the given (ready) #InputStream can be
+	 * replaced by an instance of this class.
+	 */
+	static bool IsEligible(const InputStream &input) noexcept {
+		return BufferedInputStream::IsEligible(input) &&
+			input.GetSize() > CURL_RANGE_SIZE;
+	}
+
+private:
+	/**
+	 * Start a request for the given #RangeRequest.  Runs in the
+	 * I/O thread.
+	 */
+	void StartRange(RangeRequest &range,
+			offset_type start, offset_type end);
+
+	/**
+	 * Assign holes to idle #RangeRequest instances and start
+	 * their requests.  Runs in the I/O thread.
+	 */
+	void ScheduleRanges() noexcept;
+
+	void RangeFinished(RangeRequest &range,
+			   std::exception_ptr e) noexcept;
+
+	/* virtual methods from class ParallelInputStream */
+	void DoSchedule() noexcept override {
+		defer_schedule.Schedule();
+	}
+};
+
+/**
+ * A proxy which replaces its #CurlInputStream with a
+ * #CurlParallelInputStream once the response headers show that the
+ * resource is eligible, and falls back to the behavior of
+ * #MaybeBufferedInputStream otherwise.
+ */
+class MaybeParallelInputStream final : public ProxyInputStream {
+	const std::multimap<std::string, std::string> headers;
+
+public:
+	MaybeParallelInputStream(InputStreamPtr _input,
+				 const std::multimap<std::string, std::string> &_headers) noexcept
+		:ProxyInputStream(std::move(_input)), headers(_headers) {}
+
+	/* virtual methods from class InputStream */
+	void Update() noexcept override;
+};
+
 /** libcurl should accept "ICY 200 OK" */
 static struct curl_slist *http_200_aliases;
 
@@ -149,6 +271,12 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
+/**
+ * The number of concurrent "Range" requests for one resource; 1
+ * disables #CurlParallelInputStream.
+ */
+static unsigned parallel_requests;
+
 static CurlInit *curl_init;
 
 static constexpr Domain curl_domain("curl");
@@ -328,6 +456,8 @@ input_curl_init(EventLoop &event_loop, const ConfigBlock &block)
 
 	verify_peer = block.GetBlockValue("verify_peer", true);
 	verify_host = block.GetBlockValue("verify_host", true);
+
+	parallel_requests = block.GetPositiveValue("parallel_requests", 1u);
 }
 
 static void
@@ -361,30 +491,38 @@ CurlInputStream::~CurlInputStream() noexcept
 	FreeEasyIndirect();
 }
 
-void
-CurlInputStream::InitEasy()
+/**
+ * Apply the plugin settings to a new #CurlRequest.
+ */
+static void
+ConfigureRequest(CurlRequest &request, CurlSlist &request_headers)
 {
-	request = new CurlRequest(**curl_init, GetURI(), *this);
-
-	request->SetOption(CURLOPT_HTTP200ALIASES, http_200_aliases);
-	request->SetOption(CURLOPT_FOLLOWLOCATION, 1l);
-	request->SetOption(CURLOPT_MAXREDIRS, 5l);
-	request->SetOption(CURLOPT_FAILONERROR, 1l);
+	request.SetOption(CURLOPT_HTTP200ALIASES, http_200_aliases);
+	request.SetOption(CURLOPT_FOLLOWLOCATION, 1l);
+	request.SetOption(CURLOPT_MAXREDIRS, 5l);
+	request.SetOption(CURLOPT_FAILONERROR, 1l);
 
 	if (proxy != nullptr)
-		request->SetOption(CURLOPT_PROXY, proxy);
+		request.SetOption(CURLOPT_PROXY, proxy);
 
 	if (proxy_port > 0)
-		request->SetOption(CURLOPT_PROXYPORT, (long)proxy_port);
+		request.SetOption(CURLOPT_PROXYPORT, (long)proxy_port);
 
 	if (proxy_user != nullptr && proxy_password != nullptr)
-		request->SetOption(CURLOPT_PROXYUSERPWD,
-				   StringFormat<1024>("%s:%s", proxy_user,
-						      proxy_password).c_str());
+		request.SetOption(CURLOPT_PROXYUSERPWD,
+				  StringFormat<1024>("%s:%s", proxy_user,
+						     proxy_password).c_str());
+
+	request.SetOption(CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
+	request.SetOption(CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
+	request.SetOption(CURLOPT_HTTPHEADER, request_headers.Get());
+}
 
-	request->SetOption(CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
-	request->SetOption(CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
-	request->SetOption(CURLOPT_HTTPHEADER, request_headers.Get());
+void
+CurlInputStream::InitEasy()
+{
+	request = new CurlRequest(**curl_init, GetURI(), *this);
+	ConfigureRequest(*request, request_headers);
 }
 
 void
@@ -451,7 +589,229 @@ CurlInputStream::Open(const char *url,
 			c->StartRequest();
 		});
 
-	return std::make_unique<MaybeBufferedInputStream>(std::make_unique<IcyInputStream>(std::move(c), std::move(icy)));
+	auto i = std::make_unique<IcyInputStream>(std::move(c), std::move(icy));
+	if (parallel_requests > 1)
+		return std::make_unique<MaybeParallelInputStream>(std::move(i),
+								  headers);
+
+	return std::make_unique<MaybeBufferedInputStream>(std::move(i));
+}
+
+CurlParallelInputStream::CurlParallelInputStream(const InputStream &src,
+						 const std::multimap<std::string, std::string> &headers,
+						 unsigned n_ranges)
+	:ParallelInputStream(src.GetURI(), src.mutex, src.GetSize(),
+			     CURL_RANGE_SIZE),
+	 event_loop((*curl_init)->GetEventLoop()),
+	 defer_schedule(event_loop, BIND_THIS_METHOD(ScheduleRanges))
+{
+	for (unsigned i = 0; i < n_ranges; ++i)
+		ranges.emplace_front(*this);
+
+	for (const auto &i : headers)
+		request_headers.Append((i.first + ":" + i.second).c_str());
+
+	if (src.HasMimeType())
+		SetMimeType(src.GetMimeType());
+
+	offset = src.GetOffset();
+
+	SetReady();
+
+	FormatDebug(curl_domain, "fetching %s with %u parallel requests",
+		    GetURI(), n_ranges);
+
+	defer_schedule.Schedule();
+}
+
+CurlParallelInputStream::~CurlParallelInputStream() noexcept
+{
+	BlockingCall(event_loop, [this](){
+			defer_schedule.Cancel();
+
+			for (auto &range : ranges)
+				range.Cancel();
+
+			(*curl_init)->InvalidateSockets();
+		});
+}
+
+void
+CurlParallelInputStream::StartRange(RangeRequest &range,
+				    offset_type start, offset_type end)
+{
+	assert(event_loop.IsInside());
+	assert(!range.IsBusy());
+	assert(start < end);
+
+	range.position = start;
+	range.end = end;
+	range.request = new CurlRequest(**curl_init, GetURI(), range);
+	range.busy = true;
+	ConfigureRequest(*range.request, request_headers);
+	range.request->SetOption(CURLOPT_RANGE,
+				 StringFormat<64>("%" PRIoffset "-%" PRIoffset,
+						  start, end - 1).c_str());
+	range.request->Start();
+}
+
+void
+CurlParallelInputStream::ScheduleRanges() noexcept
+{
+	assert(event_loop.IsInside());
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (postponed_exception)
+		return;
+
+	for (auto &range : ranges)
+		if (range.IsBusy() && range.position >= range.end)
+			/* a surplus response to a range request which
+			   was ignored by the server (see
+			   SetSequential()) */
+			range.Cancel();
+
+	if (!sequential && IsStalled(ranges)) {
+		/* the reader will stall; if all requests are busy,
+		   cancel the one with the lowest priority to make
+		   room for the read offset */
+		const bool idle = std::any_of(ranges.begin(), ranges.end(),
+					      [](const RangeRequest &range){
+						      return !range.IsBusy();
+					      });
+		if (!idle)
+			FindVictim(ranges, offset)->Cancel();
+	}
+
+	for (auto &range : ranges) {
+		if (range.IsBusy())
+			continue;
+
+		offset_type start, end;
+		if (!FindNextRange(ranges, start, end))
+			break;
+
+		try {
+			/* libcurl does not invoke any callbacks from
+			   within curl_multi_add_handle(), therefore
+			   it is safe to keep the mutex locked */
+			StartRange(range, start, end);
+		} catch (...) {
+			range.Cancel();
+
+			postponed_exception = std::current_exception();
+			read_cond.broadcast();
+			InvokeOnAvailable();
+			break;
+		}
+	}
+}
+
+void
+CurlParallelInputStream::RangeFinished(RangeRequest &range,
+				       std::exception_ptr e) noexcept
+{
+	assert(event_loop.IsInside());
+
+	range.Cancel();
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		if (e && !postponed_exception)
+			postponed_exception = std::move(e);
+
+		read_cond.broadcast();
+		InvokeOnAvailable();
+	}
+
+	defer_schedule.Schedule();
+}
+
+void
+CurlParallelInputStream::RangeRequest::OnHeaders(unsigned status,
+						 std::multimap<std::string, std::string> &&)
+{
+	if (status == 206)
+		return;
+
+	if (status != 200)
+		throw HttpStatusError(status,
+				      StringFormat<64>("got HTTP status %u on Range request",
+						       status).c_str());
+
+	/* the server ignores "Range" and sends the whole resource;
+	   fetch it sequentially with this request instead of
+	   failing */
+
+	const std::lock_guard<Mutex> protect(parent.mutex);
+
+	if (parent.sequential) {
+		/* another request is already doing this; ignore
+		   this response, ScheduleRanges() will cancel it */
+		end = position;
+		parent.defer_schedule.Schedule();
+		return;
+	}
+
+	FormatDebug(curl_domain,
+		    "server ignores Range requests, fetching %s sequentially",
+		    parent.GetURI());
+
+	parent.SetSequential(*this);
+}
+
+void
+CurlParallelInputStream::RangeRequest::OnData(ConstBuffer<void> data)
+{
+	assert(data.size > 0);
+
+	const std::lock_guard<Mutex> protect(parent.mutex);
+
+	parent.Append(*this, data);
+}
+
+void
+CurlParallelInputStream::RangeRequest::OnEnd()
+{
+	std::exception_ptr e;
+	if (position < end)
+		e = std::make_exception_ptr(std::runtime_error("Premature end of Range response"));
+
+	parent.RangeFinished(*this, std::move(e));
+}
+
+void
+CurlParallelInputStream::RangeRequest::OnError(std::exception_ptr e) noexcept
+{
+	parent.RangeFinished(*this, std::move(e));
+}
+
+void
+MaybeParallelInputStream::Update() noexcept
+{
+	const bool was_ready = IsReady();
+
+	ProxyInputStream::Update();
+
+	if (was_ready || !IsReady())
+		return;
+
+	/* our input has just become ready - check if we should
+	   fetch it with parallel requests or buffer it */
+
+	if (CurlParallelInputStream::IsEligible(*input)) {
+		auto old = std::move(input);
+		SetInput(std::make_unique<CurlParallelInputStream>(*old, headers,
+								   parallel_requests));
+
+		/* the CurlInputStream destructor blocks on the I/O
+		   thread, which may be waiting for our mutex */
+		const ScopeUnlock unlock(mutex);
+		old.reset();
+	} else if (BufferedInputStream::IsEligible(*input))
+		SetInput(std::make_unique<BufferedInputStream>(std::move(input)));
 }
 
 InputStreamPtr
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ChunkFilter.hxx"
+#include "MusicChunk.hxx"
+#include "filter/Filter.hxx"
+#include "filter/Prepared.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "pcm/PcmMix.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+ChunkFilter::ChunkFilter() noexcept {}
+ChunkFilter::~ChunkFilter() noexcept = default;
+
+AudioFormat
+ChunkFilter::Open(AudioFormat audio_format,
+		  PreparedFilter *prepared_replay_gain_filter,
+		  PreparedFilter *prepared_other_replay_gain_filter,
+		  PreparedFilter &prepared_filter)
+try {
+	assert(audio_format.IsValid());
+	assert(!IsOpen());
+
+	/* the replay_gain filter cannot fail here */
+	if (prepared_replay_gain_filter) {
+		replay_gain_serial = 0;
+		replay_gain_filter =
+			prepared_replay_gain_filter->Open(audio_format);
+	}
+
+	if (prepared_other_replay_gain_filter) {
+		other_replay_gain_serial = 0;
+		other_replay_gain_filter =
+			prepared_other_replay_gain_filter->Open(audio_format);
+	}
+
+	filter = prepared_filter.Open(audio_format);
+	in_audio_format = audio_format;
+	return filter->GetOutAudioFormat();
+} catch (...) {
+	Close();
+	throw;
+}
+
+AudioFormat
+ChunkFilter::GetOutAudioFormat() const noexcept
+{
+	assert(IsOpen());
+
+	return filter->GetOutAudioFormat();
+}
+
+void
+ChunkFilter::Close() noexcept
+{
+	replay_gain_filter.reset();
+	other_replay_gain_filter.reset();
+	filter.reset();
+}
+
+void
+ChunkFilter::Reset() noexcept
+{
+	if (replay_gain_filter)
+		replay_gain_filter->Reset();
+
+	if (other_replay_gain_filter)
+		other_replay_gain_filter->Reset();
+
+	if (filter)
+		filter->Reset();
+}
+
+ConstBuffer<void>
+ChunkFilter::GetChunkData(const MusicChunk &chunk,
+			  Filter *current_replay_gain_filter,
+			  unsigned *replay_gain_serial_p,
+			  ReplayGainMode replay_gain_mode)
+{
+	assert(!chunk.IsEmpty());
+	assert(chunk.CheckFormat(in_audio_format));
+
+	ConstBuffer<void> data(chunk.data, chunk.length);
+
+	assert(data.size % in_audio_format.GetFrameSize() == 0);
+
+	if (!data.empty() && current_replay_gain_filter != nullptr) {
+		replay_gain_filter_set_mode(*current_replay_gain_filter,
+					    replay_gain_mode);
+
+		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
+			replay_gain_filter_set_info(*current_replay_gain_filter,
+						    chunk.replay_gain_serial != 0
+						    ? &chunk.replay_gain_info
+						    : nullptr);
+			*replay_gain_serial_p = chunk.replay_gain_serial;
+		}
+
+		data = current_replay_gain_filter->FilterPCM(data);
+	}
+
+	return data;
+}
+
+ConstBuffer<void>
+ChunkFilter::FilterChunk(const MusicChunk &chunk,
+			 ReplayGainMode replay_gain_mode)
+{
+	assert(IsOpen());
+
+	auto data = GetChunkData(chunk, replay_gain_filter.get(),
+				 &replay_gain_serial, replay_gain_mode);
+	if (data.empty())
+		return data;
+
+	/* cross-fade */
+
+	if (chunk.other != nullptr) {
+		auto other_data = GetChunkData(*chunk.other,
+					       other_replay_gain_filter.get(),
+					       &other_replay_gain_serial,
+					       replay_gain_mode);
+		if (other_data.empty())
+			return data;
+
+		/* if the "other" chunk is longer, then that trailer
+		   is used as-is, without mixing; it is part of the
+		   "next" song being faded in, and if there's a rest,
+		   it means cross-fading ends here */
+
+		if (data.size > other_data.size)
+			data.size = other_data.size;
+
+		float mix_ratio = chunk.mix_ratio;
+		if (mix_ratio >= 0)
+			/* reverse the mix ratio (because the
+			   arguments to pcm_mix() are reversed), but
+			   only if the mix ratio is non-negative; a
+			   negative mix ratio is a MixRamp special
+			   case */
+			mix_ratio = 1.0 - mix_ratio;
+
+		void *dest = cross_fade_buffer.Get(other_data.size);
+		memcpy(dest, other_data.data, other_data.size);
+		if (!pcm_mix(cross_fade_dither, dest, data.data, data.size,
+			     in_audio_format.format,
+			     mix_ratio))
+			throw FormatRuntimeError("Cannot cross-fade format %s",
+						 sample_format_to_string(in_audio_format.format));
+
+		data.data = dest;
+		data.size = other_data.size;
+	}
+
+	/* apply filter chain */
+
+	return filter->FilterPCM(data);
+}
+
+ConstBuffer<void>
+ChunkFilter::Flush()
+{
+	return filter
+		? filter->Flush()
+		: nullptr;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_CHUNK_FILTER_HXX
+#define MPD_OUTPUT_CHUNK_FILTER_HXX
+
+#include "AudioFormat.hxx"
+#include "ReplayGainMode.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDither.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <memory>
+
+struct MusicChunk;
+class Filter;
+class PreparedFilter;
+
+/**
+ * Applies ReplayGain, cross-fading and a filter chain to
+ * #MusicChunk instances.  This is the filtering part of
+ * #AudioOutputSource, which is also used by #SharedOutputFilter.
+ *
+ * This class is not thread-safe.
+ */
+class ChunkFilter {
+	/**
+	 * The #AudioFormat of the #MusicChunk instances passed to
+	 * FilterChunk().
+	 */
+	AudioFormat in_audio_format;
+
+	/**
+	 * The serial number of the last replay gain info.  0 means no
+	 * replay gain info was available.
+	 */
+	unsigned replay_gain_serial;
+
+	/**
+	 * The serial number of the last replay gain info by the
+	 * "other" chunk during cross-fading.
+	 */
+	unsigned other_replay_gain_serial;
+
+	/**
+	 * The replay_gain_filter_plugin instance of this audio
+	 * output.
+	 */
+	std::unique_ptr<Filter> replay_gain_filter;
+
+	/**
+	 * The replay_gain_filter_plugin instance of this audio
+	 * output, to be applied to the second chunk during
+	 * cross-fading.
+	 */
+	std::unique_ptr<Filter> other_replay_gain_filter;
+
+	/**
+	 * The buffer used to allocate the cross-fading result.
+	 */
+	PcmBuffer cross_fade_buffer;
+
+	/**
+	 * The dithering state for cross-fading two streams.
+	 */
+	PcmDither cross_fade_dither;
+
+	/**
+	 * The filter object of this audio output.  This is an
+	 * instance of chain_filter_plugin.
+	 */
+	std::unique_ptr<Filter> filter;
+
+public:
+	ChunkFilter() noexcept;
+	~ChunkFilter() noexcept;
+
+	bool IsOpen() const noexcept {
+		return filter != nullptr;
+	}
+
+	const AudioFormat &GetInputAudioFormat() const noexcept {
+		return in_audio_format;
+	}
+
+	/**
+	 * Returns the #AudioFormat emitted by the filter chain.
+	 */
+	gcc_pure
+	AudioFormat GetOutAudioFormat() const noexcept;
+
+	/**
+	 * Open the filters.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the #AudioFormat emitted by the filter chain
+	 */
+	AudioFormat Open(AudioFormat audio_format,
+			 PreparedFilter *prepared_replay_gain_filter,
+			 PreparedFilter *prepared_other_replay_gain_filter,
+			 PreparedFilter &prepared_filter);
+
+	void Close() noexcept;
+
+	/**
+	 * Reset the state of all filters, e.g. after seeking.
+	 */
+	void Reset() noexcept;
+
+	/**
+	 * Apply ReplayGain, cross-fading and the filter chain to the
+	 * given chunk.  The returned buffer is owned by this object
+	 * and is valid until the next call.
+	 *
+	 * Throws on error.
+	 */
+	ConstBuffer<void> FilterChunk(const MusicChunk &chunk,
+				      ReplayGainMode replay_gain_mode);
+
+	/**
+	 * Wrapper for Filter::Flush().
+	 */
+	ConstBuffer<void> Flush();
+
+private:
+	ConstBuffer<void> GetChunkData(const MusicChunk &chunk,
+				       Filter *replay_gain_filter,
+				       unsigned *replay_gain_serial_p,
+				       ReplayGainMode replay_gain_mode);
+};
+
+#endif
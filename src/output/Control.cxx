@@ -60,6 +60,12 @@ AudioOutputControl::GetName() const noexcept
 	return output->GetName();
 }
 
+const AudioOutputFilterSettings &
+AudioOutputControl::GetFilterSettings() const noexcept
+{
+	return output->filter_settings;
+}
+
 const char *
 AudioOutputControl::GetPluginName() const noexcept
 {
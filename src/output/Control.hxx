@@ -42,12 +42,14 @@
 
 enum class ReplayGainMode : uint8_t;
 struct FilteredAudioOutput;
+struct AudioOutputFilterSettings;
 struct MusicChunk;
 struct ConfigBlock;
 class MusicPipe;
 class Mutex;
 class Mixer;
 class AudioOutputClient;
+class SharedOutputFilter;
 
 /**
  * Controller for an #AudioOutput and its output thread.
@@ -370,6 +372,17 @@ public:
 		source.SetReplayGainMode(_mode);
 	}
 
+	gcc_pure
+	const AudioOutputFilterSettings &GetFilterSettings() const noexcept;
+
+	/**
+	 * See AudioOutputSource::SetSharedFilter().  This must be
+	 * called before the output thread is started.
+	 */
+	void SetSharedFilter(SharedOutputFilter *shared_filter) noexcept {
+		source.SetSharedFilter(shared_filter);
+	}
+
 	/**
 	 * Caller must lock the mutex.
 	 *
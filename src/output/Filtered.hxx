@@ -22,6 +22,7 @@
 
 #include "AudioFormat.hxx"
 #include "filter/Observer.hxx"
+#include "util/Compiler.h"
 
 #include <memory>
 #include <string>
@@ -42,6 +43,52 @@ struct AudioOutputDefaults;
 struct ReplayGainConfig;
 struct Tag;
 
+/**
+ * The settings which determine the filters applied to the data of a
+ * #FilteredAudioOutput (except for the final #ConvertFilter).
+ * Outputs with equal settings may share one #SharedOutputFilter.
+ */
+struct AudioOutputFilterSettings {
+	/**
+	 * The configured audio format.
+	 */
+	AudioFormat config_audio_format;
+
+	/**
+	 * The "filters" setting.
+	 */
+	std::string filters;
+
+	bool normalize = false;
+
+	/**
+	 * The number of threads used for converting DSD to PCM.
+	 */
+	unsigned dsd_threads = 1;
+
+	/**
+	 * Is the software ReplayGain filter enabled?
+	 */
+	bool replay_gain = false;
+
+	/**
+	 * Can the filters be shared with other outputs?  This is not
+	 * possible if they are controlled by this output's mixer
+	 * (software volume or ReplayGain applied by the mixer).
+	 */
+	bool shareable = false;
+
+	gcc_pure
+	bool operator==(const AudioOutputFilterSettings &other) const noexcept {
+		return shareable && other.shareable &&
+			config_audio_format == other.config_audio_format &&
+			normalize == other.normalize &&
+			dsd_threads == other.dsd_threads &&
+			replay_gain == other.replay_gain &&
+			filters == other.filters;
+	}
+};
+
 struct FilteredAudioOutput {
 	const char *const plugin_name;
 
@@ -124,6 +171,12 @@ public:
 	 */
 	FilterObserver convert_filter;
 
+	/**
+	 * A copy of the settings which were used to set up
+	 * #prepared_filter and the ReplayGain filters.
+	 */
+	AudioOutputFilterSettings filter_settings;
+
 	/**
 	 * Throws #std::runtime_error on error.
 	 */
@@ -26,6 +26,7 @@
 #include "mixer/MixerList.hxx"
 #include "mixer/MixerType.hxx"
 #include "mixer/MixerControl.hxx"
+#include "mixer/MixerInternal.hxx"
 #include "mixer/plugins/SoftwareMixerPlugin.hxx"
 #include "filter/LoadChain.hxx"
 #include "filter/Prepared.hxx"
@@ -38,6 +39,7 @@
 #include "config/Domain.hxx"
 #include "config/Option.hxx"
 #include "config/Block.hxx"
+#include "pcm/PcmDsd.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/StringFormat.hxx"
 #include "Log.hxx"
@@ -171,6 +173,9 @@ FilteredAudioOutput::Configure(const ConfigBlock &block,
 
 	log_name = StringFormat<256>("\"%s\" (%s)", name, plugin_name);
 
+	filter_settings.config_audio_format = config_audio_format;
+	filter_settings.normalize = defaults.normalize;
+
 	/* set up the filter chain */
 
 	prepared_filter = filter_chain_new();
@@ -184,9 +189,14 @@ FilteredAudioOutput::Configure(const ConfigBlock &block,
 	}
 
 	try {
-		if (filter_factory != nullptr)
+		if (filter_factory != nullptr) {
+			const char *filters =
+				block.GetBlockValue(AUDIO_FILTERS, "");
 			filter_chain_parse(*prepared_filter, *filter_factory,
-					   block.GetBlockValue(AUDIO_FILTERS, ""));
+					   filters);
+			filter_settings.filters = filters;
+			filter_settings.shareable = true;
+		}
 	} catch (...) {
 		/* It's not really fatal - Part of the filter chain
 		   has been set up already and even an empty one will
@@ -222,6 +232,8 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		prepared_other_replay_gain_filter =
 			NewReplayGainFilter(replay_gain_config);
 		assert(prepared_other_replay_gain_filter != nullptr);
+
+		filter_settings.replay_gain = true;
 	}
 
 	/* set up the mixer */
@@ -240,7 +252,13 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 
 	/* use the hardware mixer for replay gain? */
 
+	if (mixer != nullptr && mixer->IsPlugin(software_mixer_plugin))
+		/* the VolumeFilter belongs to this output's mixer */
+		filter_settings.shareable = false;
+
 	if (strcmp(replay_gain_handler, "mixer") == 0) {
+		filter_settings.shareable = false;
+
 		if (mixer != nullptr)
 			replay_gain_filter_set_mixer(*prepared_replay_gain_filter,
 						     mixer, 100);
@@ -254,8 +272,14 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 
 	/* the "convert" filter must be the last one in the chain */
 
+	filter_settings.dsd_threads =
+		block.GetPositiveValue("dsd_threads", 1u);
+	if (filter_settings.dsd_threads > PcmDsd::MAX_THREADS)
+		throw FormatRuntimeError("\"dsd_threads\" must not be larger than %u",
+					 unsigned(PcmDsd::MAX_THREADS));
+
 	filter_chain_append(*prepared_filter, "convert",
-			    convert_filter.Set(convert_filter_prepare()));
+			    convert_filter.Set(convert_filter_prepare(filter_settings.dsd_threads)));
 }
 
 std::unique_ptr<FilteredAudioOutput>
@@ -19,6 +19,7 @@
 
 #include "MultipleOutputs.hxx"
 #include "Filtered.hxx"
+#include "SharedFilter.hxx"
 #include "Defaults.hxx"
 #include "Domain.hxx"
 #include "MusicPipe.hxx"
@@ -28,6 +29,7 @@
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "util/RuntimeError.hxx"
+#include "Log.hxx"
 
 #include <stdexcept>
 
@@ -125,6 +127,59 @@ MultipleOutputs::Configure(EventLoop &event_loop,
 						 nullptr);
 		outputs.push_back(output);
 	}
+
+	if (config.GetBool(ConfigOption::SHARE_OUTPUT_FILTERS, true))
+		CreateSharedFilters(replay_gain_config, filter_factory);
+}
+
+void
+MultipleOutputs::CreateSharedFilters(const ReplayGainConfig &replay_gain_config,
+				     FilterFactory &filter_factory) noexcept
+{
+	const size_t n = outputs.size();
+	std::vector<bool> grouped(n, false);
+
+	for (size_t i = 0; i < n; ++i) {
+		const auto &settings = outputs[i]->GetFilterSettings();
+		if (grouped[i] || !settings.shareable)
+			continue;
+
+		std::vector<AudioOutputControl *> group{outputs[i]};
+		for (size_t j = i + 1; j < n; ++j) {
+			if (!grouped[j] &&
+			    outputs[j]->GetFilterSettings() == settings) {
+				group.push_back(outputs[j]);
+				grouped[j] = true;
+			}
+		}
+
+		if (group.size() < 2)
+			continue;
+
+		try {
+			auto filter = std::make_unique<SharedOutputFilter>(settings,
+									   replay_gain_config,
+									   filter_factory);
+			for (auto *ao : group)
+				ao->SetSharedFilter(filter.get());
+
+			FormatDebug(output_domain,
+				    "%zu outputs share the filter chain of %s",
+				    group.size(), outputs[i]->GetLogName());
+
+			shared_filters.emplace_back(std::move(filter));
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to create shared filter");
+		}
+	}
+}
+
+void
+MultipleOutputs::CancelSharedFilters() noexcept
+{
+	for (auto &i : shared_filters)
+		i->Cancel();
 }
 
 void
@@ -328,6 +383,11 @@ MultipleOutputs::CheckPipe() noexcept
 			   provides a defined value */
 			elapsed_time = chunk->time;
 
+		/* release the filtered data before the chunk may be
+		   reused */
+		for (auto &i : shared_filters)
+			i->Forget(*chunk);
+
 		is_tail = chunk->next == nullptr;
 		if (is_tail)
 			/* this is the tail of the pipe - clear the
@@ -382,6 +442,8 @@ MultipleOutputs::Cancel() noexcept
 
 	WaitAll();
 
+	CancelSharedFilters();
+
 	/* clear the music pipe and return all chunks to the buffer */
 
 	if (pipe != nullptr)
@@ -403,6 +465,7 @@ MultipleOutputs::Close() noexcept
 	for (auto *ao : outputs)
 		ao->LockCloseWait();
 
+	CancelSharedFilters();
 	pipe.reset();
 
 	input_audio_format.Clear();
@@ -416,6 +479,7 @@ MultipleOutputs::Release() noexcept
 	for (auto *ao : outputs)
 		ao->LockRelease();
 
+	CancelSharedFilters();
 	pipe.reset();
 
 	input_audio_format.Clear();
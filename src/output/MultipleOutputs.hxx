@@ -34,11 +34,14 @@
 #include "Chrono.hxx"
 #include "util/Compiler.h"
 
+#include <memory>
 #include <vector>
 
 #include <assert.h>
 
 class MusicPipe;
+class SharedOutputFilter;
+class FilterFactory;
 class EventLoop;
 class MixerListener;
 class AudioOutputClient;
@@ -58,6 +61,12 @@ class MultipleOutputs final : public PlayerOutputs {
 	 */
 	std::unique_ptr<MusicPipe> pipe;
 
+	/**
+	 * Filter chains shared by outputs with equal filter
+	 * settings, see #SharedOutputFilter.
+	 */
+	std::vector<std::unique_ptr<SharedOutputFilter>> shared_filters;
+
 	/**
 	 * The "elapsed_time" stamp of the most recently finished
 	 * chunk.
@@ -146,6 +155,19 @@ public:
 	void SetSoftwareVolume(unsigned volume) noexcept;
 
 private:
+	/**
+	 * Create a #SharedOutputFilter for each group of outputs
+	 * with equal filter settings.
+	 */
+	void CreateSharedFilters(const ReplayGainConfig &replay_gain_config,
+				 FilterFactory &filter_factory) noexcept;
+
+	/**
+	 * Discard the data of all #SharedOutputFilter instances.
+	 * All outputs must have been canceled or closed.
+	 */
+	void CancelSharedFilters() noexcept;
+
 	/**
 	 * Wait until all (active) outputs have finished the current
 	 * command.
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SharedFilter.hxx"
+#include "Filtered.hxx"
+#include "filter/LoadChain.hxx"
+#include "filter/Prepared.hxx"
+#include "filter/plugins/AutoConvertFilterPlugin.hxx"
+#include "filter/plugins/ChainFilterPlugin.hxx"
+#include "filter/plugins/ConvertFilterPlugin.hxx"
+#include "filter/plugins/NormalizeFilterPlugin.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+SharedOutputFilter::SharedOutputFilter(const AudioOutputFilterSettings &settings,
+				       const ReplayGainConfig &replay_gain_config,
+				       FilterFactory &filter_factory)
+	:prepared_filter(filter_chain_new())
+{
+	assert(settings.shareable);
+
+	if (settings.replay_gain) {
+		prepared_replay_gain_filter =
+			NewReplayGainFilter(replay_gain_config);
+		prepared_other_replay_gain_filter =
+			NewReplayGainFilter(replay_gain_config);
+	}
+
+	/* this must build the same chain as
+	   FilteredAudioOutput::Configure() */
+
+	if (settings.normalize)
+		filter_chain_append(*prepared_filter, "normalize",
+				    autoconvert_filter_new(normalize_filter_prepare()));
+
+	filter_chain_parse(*prepared_filter, filter_factory,
+			   settings.filters.c_str());
+
+	filter_chain_append(*prepared_filter, "convert",
+			    convert_filter.Set(convert_filter_prepare(settings.dsd_threads)));
+}
+
+SharedOutputFilter::~SharedOutputFilter() noexcept = default;
+
+unsigned
+SharedOutputFilter::Open(AudioFormat in_audio_format,
+			 AudioFormat _out_audio_format)
+{
+	assert(in_audio_format.IsValid());
+	assert(_out_audio_format.IsValid());
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (filter.IsOpen() &&
+	    in_audio_format == filter.GetInputAudioFormat() &&
+	    _out_audio_format == out_audio_format)
+		/* already configured for this output */
+		return generation;
+
+	/* reconfigure; this invalidates the previous generation
+	   (outputs which still play its data hold references to
+	   the buffers) */
+
+	entries.clear();
+	ClearFlush();
+
+	if (++generation == 0)
+		++generation;
+
+	filter.Close();
+	out_audio_format.Clear();
+
+	filter.Open(in_audio_format,
+		    prepared_replay_gain_filter.get(),
+		    prepared_other_replay_gain_filter.get(),
+		    *prepared_filter);
+
+	try {
+		convert_filter_set(convert_filter.Get(), _out_audio_format);
+	} catch (...) {
+		filter.Close();
+		throw;
+	}
+
+	out_audio_format = _out_audio_format;
+	return generation;
+}
+
+SharedOutputFilter::Entry
+SharedOutputFilter::MakeEntry(const MusicChunk *chunk, ConstBuffer<void> data)
+{
+	/* buffers are never reused, because other outputs may still
+	   hold a reference */
+	auto *buffer = new uint8_t[data.size];
+	BufferRef ref(buffer, std::default_delete<uint8_t[]>());
+	if (!data.empty())
+		memcpy(buffer, data.data, data.size);
+
+	return Entry(chunk, std::move(ref), data.size);
+}
+
+void
+SharedOutputFilter::ClearFlush() noexcept
+{
+	flush_entries.clear();
+	flushed = false;
+}
+
+bool
+SharedOutputFilter::FilterChunk(unsigned _generation, const MusicChunk &chunk,
+				ReplayGainMode replay_gain_mode,
+				ConstBuffer<void> &result, BufferRef &ref)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (_generation != generation || !filter.IsOpen())
+		return false;
+
+	/* has another output filtered this chunk already?  The
+	   outputs are usually close together, so search from the
+	   newest entry */
+	for (auto i = entries.rbegin(), end = entries.rend(); i != end; ++i) {
+		if (i->chunk == &chunk) {
+			result = i->GetData(ref);
+			return true;
+		}
+	}
+
+	const auto data = filter.FilterChunk(chunk, replay_gain_mode);
+	ClearFlush();
+
+	entries.emplace_back(MakeEntry(&chunk, data));
+	result = entries.back().GetData(ref);
+	return true;
+}
+
+bool
+SharedOutputFilter::Flush(unsigned _generation, size_t &position,
+			  ConstBuffer<void> &result, BufferRef &ref)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (_generation != generation || !filter.IsOpen())
+		return false;
+
+	if (!flushed) {
+		while (true) {
+			const auto data = filter.Flush();
+			if (data.IsNull())
+				break;
+
+			flush_entries.emplace_back(MakeEntry(nullptr, data));
+		}
+
+		flushed = true;
+	}
+
+	if (position < flush_entries.size())
+		result = flush_entries[position++].GetData(ref);
+	else {
+		result = nullptr;
+		ref.reset();
+	}
+
+	return true;
+}
+
+void
+SharedOutputFilter::Forget(const MusicChunk &chunk) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	/* Forget() is called for each chunk which leaves the pipe,
+	   so matching by identity is enough to drop every entry
+	   eventually; the entries are not necessarily in pipe order
+	   (an output which reopens may be behind the others), so
+	   this must not assume that older entries are stale, too.
+	   It is usually the oldest entry. */
+	for (auto i = entries.begin(); i != entries.end(); ++i) {
+		if (i->chunk == &chunk) {
+			entries.erase(i);
+			break;
+		}
+	}
+}
+
+void
+SharedOutputFilter::Cancel() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	entries.clear();
+	ClearFlush();
+	filter.Reset();
+}
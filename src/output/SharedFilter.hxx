@@ -0,0 +1,205 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_OUTPUT_FILTER_HXX
+#define MPD_SHARED_OUTPUT_FILTER_HXX
+
+#include "ChunkFilter.hxx"
+#include "AudioFormat.hxx"
+#include "ReplayGainMode.hxx"
+#include "filter/Observer.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct MusicChunk;
+struct AudioOutputFilterSettings;
+struct ReplayGainConfig;
+class PreparedFilter;
+class FilterFactory;
+
+/**
+ * A filter chain (ReplayGain, cross-fading, the configured filters
+ * and the final conversion) which is shared by several audio outputs
+ * with the same filter settings and the same device #AudioFormat.
+ * Each #MusicChunk is filtered only once, by the first output which
+ * gets to it; the result is kept until the #MusicChunk is removed
+ * from the #MusicPipe, and the other outputs receive a reference
+ * to it.
+ *
+ * Whenever an output opens it with a different #AudioFormat, the
+ * filter is reconfigured and a new "generation" begins; outputs
+ * which still use an older generation are told to fall back to
+ * their own private filter chain.
+ *
+ * The filtered data is reference-counted (see #BufferRef): an
+ * output may still be playing data which this object has already
+ * discarded, e.g. because another output has reconfigured it.
+ *
+ * This class is thread-safe.
+ */
+class SharedOutputFilter {
+	std::unique_ptr<PreparedFilter> prepared_replay_gain_filter;
+	std::unique_ptr<PreparedFilter> prepared_other_replay_gain_filter;
+
+	/**
+	 * The filter chain; its last item is the #ConvertFilter
+	 * observed by #convert_filter.
+	 */
+	std::unique_ptr<PreparedFilter> prepared_filter;
+
+	FilterObserver convert_filter;
+
+	Mutex mutex;
+
+	ChunkFilter filter;
+
+	/**
+	 * The #AudioFormat emitted by the #ConvertFilter.
+	 */
+	AudioFormat out_audio_format = AudioFormat::Undefined();
+
+	/**
+	 * Incremented each time the filter is reconfigured.  0 is
+	 * never used.
+	 */
+	unsigned generation = 0;
+
+public:
+	/**
+	 * A reference to a buffer returned by FilterChunk() or
+	 * Flush(); the buffer remains valid as long as a copy of
+	 * this reference exists.
+	 */
+	typedef std::shared_ptr<const uint8_t> BufferRef;
+
+private:
+	struct Entry {
+		/**
+		 * The source chunk; nullptr for data returned by
+		 * Filter::Flush().
+		 */
+		const MusicChunk *chunk;
+
+		BufferRef buffer;
+
+		size_t size;
+
+		Entry(const MusicChunk *_chunk,
+		      BufferRef &&_buffer, size_t _size) noexcept
+			:chunk(_chunk), buffer(std::move(_buffer)), size(_size) {}
+
+		ConstBuffer<void> GetData(BufferRef &ref) const noexcept {
+			ref = buffer;
+			return {buffer.get(), size};
+		}
+	};
+
+	/**
+	 * The filtered data of chunks which are still in the
+	 * #MusicPipe, oldest first.
+	 */
+	std::deque<Entry> entries;
+
+	/**
+	 * The data returned by Filter::Flush() after the last
+	 * chunk.  It is only valid if #flushed is true.
+	 */
+	std::vector<Entry> flush_entries;
+
+	bool flushed = false;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	SharedOutputFilter(const AudioOutputFilterSettings &settings,
+			   const ReplayGainConfig &replay_gain_config,
+			   FilterFactory &filter_factory);
+
+	~SharedOutputFilter() noexcept;
+
+	SharedOutputFilter(const SharedOutputFilter &) = delete;
+	SharedOutputFilter &operator=(const SharedOutputFilter &) = delete;
+
+	/**
+	 * Prepare the filter for the given input and output
+	 * #AudioFormat, reconfiguring it if necessary.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the generation to be passed to FilterChunk() and
+	 * Flush()
+	 */
+	unsigned Open(AudioFormat in_audio_format,
+		      AudioFormat out_audio_format);
+
+	/**
+	 * Obtain the filtered data of the given #MusicChunk,
+	 * filtering it if this has not been done yet.  The returned
+	 * buffer is valid as long as the caller holds #ref.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if the given generation is obsolete; the
+	 * caller shall use its own filter
+	 */
+	bool FilterChunk(unsigned generation, const MusicChunk &chunk,
+			 ReplayGainMode replay_gain_mode,
+			 ConstBuffer<void> &result, BufferRef &ref);
+
+	/**
+	 * Obtain the data returned by Filter::Flush().  Each caller
+	 * shall start with #position=0; the method increments it
+	 * and returns nullptr in #result after the last buffer.  The
+	 * returned buffer is valid as long as the caller holds #ref.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if the given generation is obsolete
+	 */
+	bool Flush(unsigned generation, size_t &position,
+		   ConstBuffer<void> &result, BufferRef &ref);
+
+	/**
+	 * The given #MusicChunk is about to be removed from the
+	 * #MusicPipe; drop its filtered data.
+	 */
+	void Forget(const MusicChunk &chunk) noexcept;
+
+	/**
+	 * Discard all filtered data and reset the filter state.  This
+	 * must be called when the #MusicPipe gets cleared, after all
+	 * outputs have been canceled.
+	 */
+	void Cancel() noexcept;
+
+private:
+	static Entry MakeEntry(const MusicChunk *chunk,
+			       ConstBuffer<void> data);
+	void ClearFlush() noexcept;
+};
+
+#endif
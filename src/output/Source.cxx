@@ -18,16 +18,10 @@
  */
 
 #include "Source.hxx"
+#include "SharedFilter.hxx"
 #include "MusicChunk.hxx"
-#include "filter/Filter.hxx"
-#include "filter/Prepared.hxx"
-#include "filter/plugins/ReplayGainFilterPlugin.hxx"
-#include "pcm/PcmMix.hxx"
 #include "thread/Mutex.hxx"
 #include "util/ConstBuffer.hxx"
-#include "util/RuntimeError.hxx"
-
-#include <string.h>
 
 AudioOutputSource::AudioOutputSource() noexcept {}
 AudioOutputSource::~AudioOutputSource() noexcept = default;
@@ -45,22 +39,42 @@ AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
 		pipe.Init(_pipe);
 	}
 
+	/* the SharedOutputFilter is enabled again by OpenShared(),
+	   after the output has chosen its AudioFormat */
+	shared_generation = 0;
+
 	/* (re)open the filter */
 
-	if (filter && audio_format != in_audio_format)
+	if (filter.IsOpen() && audio_format != in_audio_format)
 		/* the filter must be reopened on all input format
 		   changes */
-		CloseFilter();
+		filter.Close();
 
-	if (filter == nullptr)
+	AudioFormat out_audio_format;
+	if (!filter.IsOpen())
 		/* open the filter */
-		OpenFilter(audio_format,
-			   prepared_replay_gain_filter,
-			   prepared_other_replay_gain_filter,
-			   prepared_filter);
+		out_audio_format = filter.Open(audio_format,
+					       prepared_replay_gain_filter,
+					       prepared_other_replay_gain_filter,
+					       prepared_filter);
+	else
+		out_audio_format = filter.GetOutAudioFormat();
 
 	in_audio_format = audio_format;
-	return filter->GetOutAudioFormat();
+	return out_audio_format;
+}
+
+void
+AudioOutputSource::OpenShared(AudioFormat out_audio_format)
+{
+	assert(IsOpen());
+
+	if (shared_filter == nullptr)
+		return;
+
+	shared_generation = shared_filter->Open(in_audio_format,
+						out_audio_format);
+	shared_flush_position = 0;
 }
 
 void
@@ -71,7 +85,8 @@ AudioOutputSource::Close() noexcept
 
 	Cancel();
 
-	CloseFilter();
+	shared_generation = 0;
+	filter.Close();
 }
 
 void
@@ -80,130 +95,31 @@ AudioOutputSource::Cancel() noexcept
 	current_chunk = nullptr;
 	pipe.Cancel();
 
-	if (replay_gain_filter)
-		replay_gain_filter->Reset();
-
-	if (other_replay_gain_filter)
-		other_replay_gain_filter->Reset();
-
-	if (filter)
-		filter->Reset();
-}
-
-void
-AudioOutputSource::OpenFilter(AudioFormat audio_format,
-			      PreparedFilter *prepared_replay_gain_filter,
-			      PreparedFilter *prepared_other_replay_gain_filter,
-			      PreparedFilter &prepared_filter)
-try {
-	assert(audio_format.IsValid());
-
-	/* the replay_gain filter cannot fail here */
-	if (prepared_replay_gain_filter) {
-		replay_gain_serial = 0;
-		replay_gain_filter =
-			prepared_replay_gain_filter->Open(audio_format);
-	}
-
-	if (prepared_other_replay_gain_filter) {
-		other_replay_gain_serial = 0;
-		other_replay_gain_filter =
-			prepared_other_replay_gain_filter->Open(audio_format);
-	}
-
-	filter = prepared_filter.Open(audio_format);
-} catch (...) {
-	CloseFilter();
-	throw;
-}
-
-void
-AudioOutputSource::CloseFilter() noexcept
-{
-	replay_gain_filter.reset();
-	other_replay_gain_filter.reset();
-	filter.reset();
-}
-
-ConstBuffer<void>
-AudioOutputSource::GetChunkData(const MusicChunk &chunk,
-				Filter *current_replay_gain_filter,
-				unsigned *replay_gain_serial_p)
-{
-	assert(!chunk.IsEmpty());
-	assert(chunk.CheckFormat(in_audio_format));
-
-	ConstBuffer<void> data(chunk.data, chunk.length);
-
-	assert(data.size % in_audio_format.GetFrameSize() == 0);
-
-	if (!data.empty() && current_replay_gain_filter != nullptr) {
-		replay_gain_filter_set_mode(*current_replay_gain_filter,
-					    replay_gain_mode);
-
-		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
-			replay_gain_filter_set_info(*current_replay_gain_filter,
-						    chunk.replay_gain_serial != 0
-						    ? &chunk.replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk.replay_gain_serial;
-		}
-
-		data = current_replay_gain_filter->FilterPCM(data);
-	}
-
-	return data;
+	/* the SharedOutputFilter is reset by MultipleOutputs */
+	shared_flush_position = 0;
+	pending_data_ref.reset();
+	flush_ref.reset();
+	filter.Reset();
 }
 
 ConstBuffer<void>
 AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 {
-	auto data = GetChunkData(chunk, replay_gain_filter.get(),
-				 &replay_gain_serial);
-	if (data.empty())
-		return data;
-
-	/* cross-fade */
-
-	if (chunk.other != nullptr) {
-		auto other_data = GetChunkData(*chunk.other,
-					       other_replay_gain_filter.get(),
-					       &other_replay_gain_serial);
-		if (other_data.empty())
-			return data;
-
-		/* if the "other" chunk is longer, then that trailer
-		   is used as-is, without mixing; it is part of the
-		   "next" song being faded in, and if there's a rest,
-		   it means cross-fading ends here */
-
-		if (data.size > other_data.size)
-			data.size = other_data.size;
-
-		float mix_ratio = chunk.mix_ratio;
-		if (mix_ratio >= 0)
-			/* reverse the mix ratio (because the
-			   arguments to pcm_mix() are reversed), but
-			   only if the mix ratio is non-negative; a
-			   negative mix ratio is a MixRamp special
-			   case */
-			mix_ratio = 1.0 - mix_ratio;
-
-		void *dest = cross_fade_buffer.Get(other_data.size);
-		memcpy(dest, other_data.data, other_data.size);
-		if (!pcm_mix(cross_fade_dither, dest, data.data, data.size,
-			     in_audio_format.format,
-			     mix_ratio))
-			throw FormatRuntimeError("Cannot cross-fade format %s",
-						 sample_format_to_string(in_audio_format.format));
-
-		data.data = dest;
-		data.size = other_data.size;
+	if (shared_generation != 0) {
+		ConstBuffer<void> result;
+		if (shared_filter->FilterChunk(shared_generation, chunk,
+					       replay_gain_mode, result,
+					       pending_data_ref))
+			return result;
+
+		/* the SharedOutputFilter has been reconfigured for
+		   a different AudioFormat; fall back to our own
+		   filter */
+		shared_generation = 0;
 	}
 
-	/* apply filter chain */
-
-	return filter->FilterPCM(data);
+	pending_data_ref.reset();
+	return filter.FilterChunk(chunk, replay_gain_mode);
 }
 
 bool
@@ -221,6 +137,7 @@ AudioOutputSource::Fill(Mutex &mutex)
 		return false;
 
 	pending_tag = current_chunk->tag.get();
+	shared_flush_position = 0;
 
 	try {
 		/* release the mutex while the filter runs, because
@@ -241,14 +158,25 @@ AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 {
 	pending_data.skip_front(nbytes);
 
-	if (pending_data.empty())
+	if (pending_data.empty()) {
+		pending_data_ref.reset();
 		pipe.Consume(*std::exchange(current_chunk, nullptr));
+	}
 }
 
 ConstBuffer<void>
 AudioOutputSource::Flush()
 {
-	return filter
-		? filter->Flush()
-		: nullptr;
+	if (shared_generation != 0) {
+		ConstBuffer<void> result;
+		if (shared_filter->Flush(shared_generation,
+					 shared_flush_position, result,
+					 flush_ref))
+			return result;
+
+		shared_generation = 0;
+	}
+
+	flush_ref.reset();
+	return filter.Flush();
 }
@@ -23,9 +23,8 @@
 #include "util/Compiler.h"
 #include "SharedPipeConsumer.hxx"
 #include "AudioFormat.hxx"
+#include "ChunkFilter.hxx"
 #include "ReplayGainMode.hxx"
-#include "pcm/PcmBuffer.hxx"
-#include "pcm/PcmDither.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <utility>
@@ -37,8 +36,8 @@
 struct MusicChunk;
 struct Tag;
 class Mutex;
-class Filter;
 class PreparedFilter;
+class SharedOutputFilter;
 
 /**
  * Source of audio data to be played by an #AudioOutput.  It receives
@@ -61,45 +60,29 @@ class AudioOutputSource {
 	SharedPipeConsumer pipe;
 
 	/**
-	 * The serial number of the last replay gain info.  0 means no
-	 * replay gain info was available.
+	 * ReplayGain, cross-fading and the filter chain of this
+	 * audio output.
 	 */
-	unsigned replay_gain_serial;
+	ChunkFilter filter;
 
 	/**
-	 * The serial number of the last replay gain info by the
-	 * "other" chunk during cross-fading.
+	 * The #SharedOutputFilter this output may use instead of
+	 * #filter (if it has other outputs with the same filter
+	 * configuration).  It is owned by #MultipleOutputs.
 	 */
-	unsigned other_replay_gain_serial;
+	SharedOutputFilter *shared_filter = nullptr;
 
 	/**
-	 * The replay_gain_filter_plugin instance of this audio
-	 * output.
+	 * The #SharedOutputFilter generation this object is
+	 * currently using, or 0 if #filter is used.
 	 */
-	std::unique_ptr<Filter> replay_gain_filter;
+	unsigned shared_generation = 0;
 
 	/**
-	 * The replay_gain_filter_plugin instance of this audio
-	 * output, to be applied to the second chunk during
-	 * cross-fading.
+	 * The position of this object in the flushed data of the
+	 * #SharedOutputFilter, see SharedOutputFilter::Flush().
 	 */
-	std::unique_ptr<Filter> other_replay_gain_filter;
-
-	/**
-	 * The buffer used to allocate the cross-fading result.
-	 */
-	PcmBuffer cross_fade_buffer;
-
-	/**
-	 * The dithering state for cross-fading two streams.
-	 */
-	PcmDither cross_fade_dither;
-
-	/**
-	 * The filter object of this audio output.  This is an
-	 * instance of chain_filter_plugin.
-	 */
-	std::unique_ptr<Filter> filter;
+	size_t shared_flush_position;
 
 	/**
 	 * The #MusicChunk currently being processed (see
@@ -118,6 +101,18 @@ class AudioOutputSource {
 	 */
 	ConstBuffer<uint8_t> pending_data;
 
+	/**
+	 * Keeps #pending_data alive if it was obtained from the
+	 * #SharedOutputFilter.
+	 */
+	std::shared_ptr<const uint8_t> pending_data_ref;
+
+	/**
+	 * Keeps the buffer returned by the last Flush() call alive
+	 * if it was obtained from the #SharedOutputFilter.
+	 */
+	std::shared_ptr<const uint8_t> flush_ref;
+
 public:
 	AudioOutputSource() noexcept;
 	~AudioOutputSource() noexcept;
@@ -126,6 +121,19 @@ public:
 		replay_gain_mode = _mode;
 	}
 
+	/**
+	 * Allow this object to use the given #SharedOutputFilter
+	 * (after OpenShared() has been called).  This must be called
+	 * before the output thread is started.
+	 */
+	void SetSharedFilter(SharedOutputFilter *_shared_filter) noexcept {
+		shared_filter = _shared_filter;
+	}
+
+	bool IsSharedFilterActive() const noexcept {
+		return shared_generation != 0;
+	}
+
 	bool IsOpen() const {
 		return in_audio_format.IsDefined();
 	}
@@ -141,6 +149,17 @@ public:
 			 PreparedFilter *prepared_other_replay_gain_filter,
 			 PreparedFilter &prepared_filter);
 
+	/**
+	 * Switch to the #SharedOutputFilter (if one was set with
+	 * SetSharedFilter()), after the output has been opened with
+	 * the given #AudioFormat.  If the #SharedOutputFilter
+	 * cannot produce this #AudioFormat, the private filter chain
+	 * remains in use.
+	 *
+	 * Throws on error.
+	 */
+	void OpenShared(AudioFormat out_audio_format);
+
 	void Close() noexcept;
 	void Cancel() noexcept;
 
@@ -200,17 +219,6 @@ public:
 	ConstBuffer<void> Flush();
 
 private:
-	void OpenFilter(AudioFormat audio_format,
-			PreparedFilter *prepared_replay_gain_filter,
-			PreparedFilter *prepared_other_replay_gain_filter,
-			PreparedFilter &prepared_filter);
-
-	void CloseFilter() noexcept;
-
-	ConstBuffer<void> GetChunkData(const MusicChunk &chunk,
-				       Filter *replay_gain_filter,
-				       unsigned *replay_gain_serial_p);
-
 	ConstBuffer<void> FilterChunk(const MusicChunk &chunk);
 };
 
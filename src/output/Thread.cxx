@@ -156,6 +156,16 @@ AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 			source.Close();
 			throw;
 		}
+
+		try {
+			source.OpenShared(output->out_audio_format);
+		} catch (...) {
+			/* not fatal: the private filter chain is used
+			   instead */
+			FormatError(std::current_exception(),
+				    "Failed to open shared filter for %s",
+				    GetLogName());
+		}
 	} catch (...) {
 		LogError(std::current_exception());
 		Failure(std::current_exception());
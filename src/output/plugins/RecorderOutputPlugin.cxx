@@ -23,6 +23,7 @@
 #include "encoder/ToOutputStream.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/Configured.hxx"
+#include "encoder/Shared.hxx"
 #include "config/Domain.hxx"
 #include "config/Path.hxx"
 #include "Log.hxx"
@@ -106,8 +107,7 @@ private:
 };
 
 RecorderOutput::RecorderOutput(const ConfigBlock &block)
-	:AudioOutput(0),
-	 prepared_encoder(CreateConfiguredEncoder(block))
+	:AudioOutput(0)
 {
 	/* read configuration */
 
@@ -122,6 +122,12 @@ RecorderOutput::RecorderOutput(const ConfigBlock &block)
 
 	if (!path.IsNull() && fmt != nullptr)
 		throw std::runtime_error("Cannot have both 'path' and 'format_path'");
+
+	if (HasDynamicPath())
+		/* each file needs a complete stream of its own */
+		prepared_encoder.reset(CreateConfiguredEncoder(block));
+	else
+		prepared_encoder = CreateSharedEncoder(block);
 }
 
 inline void
@@ -20,7 +20,7 @@
 #include "ShoutOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
 #include "encoder/EncoderInterface.hxx"
-#include "encoder/Configured.hxx"
+#include "encoder/Shared.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
@@ -97,7 +97,7 @@ ShoutSetAudioInfo(shout_t *shout_conn, const AudioFormat &audio_format)
 ShoutOutput::ShoutOutput(const ConfigBlock &block)
 	:AudioOutput(FLAG_PAUSE|FLAG_NEED_FULLY_DEFINED_AUDIO_FORMAT),
 	 shout_conn(shout_new()),
-	 prepared_encoder(CreateConfiguredEncoder(block, true))
+	 prepared_encoder(CreateSharedEncoder(block, true))
 {
 	const char *host = require_block_string(block, "host");
 	const char *mount = require_block_string(block, "mount");
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "FrameSync.hxx"
+
+#include <string.h>
+
+FrameFormat
+GetFrameFormat(const char *mime_type) noexcept
+{
+	if (mime_type == nullptr)
+		return FrameFormat::NONE;
+
+	if (strcmp(mime_type, "audio/mpeg") == 0)
+		return FrameFormat::MPEG;
+
+	if (strcmp(mime_type, "audio/aac") == 0 ||
+	    strcmp(mime_type, "audio/aacp") == 0)
+		return FrameFormat::ADTS;
+
+	return FrameFormat::NONE;
+}
+
+/**
+ * Bit rates in kbit/s, indexed by [MPEG-1?][layer - 1][index].
+ */
+static constexpr uint16_t mpeg_bitrates[2][3][15] = {
+	/* MPEG-2 and MPEG-2.5 */
+	{
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+		{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+	},
+
+	/* MPEG-1 */
+	{
+		{ 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+		{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+		{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+	},
+};
+
+/**
+ * Sample rates of MPEG-1; MPEG-2 has half of these, MPEG-2.5 a
+ * quarter.
+ */
+static constexpr unsigned mpeg_sample_rates[3] = { 44100, 48000, 32000 };
+
+gcc_pure
+static size_t
+GetMpegFrameSize(const uint8_t *p, size_t size) noexcept
+{
+	if (size < 4 || p[0] != 0xff || (p[1] & 0xe0) != 0xe0)
+		return 0;
+
+	/* 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5 */
+	const unsigned version = (p[1] >> 3) & 0x3;
+	/* 3 = layer I, 2 = layer II, 1 = layer III */
+	const unsigned layer_bits = (p[1] >> 1) & 0x3;
+	const unsigned bitrate_index = p[2] >> 4;
+	const unsigned sample_rate_index = (p[2] >> 2) & 0x3;
+	const unsigned padding = (p[2] >> 1) & 0x1;
+
+	if (version == 1 || layer_bits == 0 ||
+	    /* free format frames have no fixed size */
+	    bitrate_index == 0 || bitrate_index == 15 ||
+	    sample_rate_index == 3)
+		return 0;
+
+	const bool mpeg1 = version == 3;
+	const unsigned layer = 4 - layer_bits;
+	const unsigned long bitrate =
+		mpeg_bitrates[mpeg1][layer - 1][bitrate_index] * 1000ul;
+	const unsigned sample_rate = mpeg_sample_rates[sample_rate_index]
+		>> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+
+	if (layer == 1)
+		return (12 * bitrate / sample_rate + padding) * 4;
+
+	/* layer III of MPEG-2 and MPEG-2.5 has half as many samples
+	   per frame */
+	const unsigned factor = layer == 3 && !mpeg1 ? 72 : 144;
+	return factor * bitrate / sample_rate + padding;
+}
+
+gcc_pure
+static size_t
+GetAdtsFrameSize(const uint8_t *p, size_t size) noexcept
+{
+	/* syncword 0xfff, layer 0 */
+	if (size < 7 || p[0] != 0xff || (p[1] & 0xf6) != 0xf0)
+		return 0;
+
+	const unsigned sample_rate_index = (p[2] >> 2) & 0xf;
+	if (sample_rate_index >= 13)
+		return 0;
+
+	const bool has_crc = (p[1] & 0x1) == 0;
+	const size_t frame_size = ((p[3] & 0x3) << 11) | (p[4] << 3) |
+		(p[5] >> 5);
+	if (frame_size < (has_crc ? 9u : 7u))
+		return 0;
+
+	return frame_size;
+}
+
+size_t
+GetFrameSize(FrameFormat format, const uint8_t *data, size_t size) noexcept
+{
+	switch (format) {
+	case FrameFormat::NONE:
+		break;
+
+	case FrameFormat::MPEG:
+		return GetMpegFrameSize(data, size);
+
+	case FrameFormat::ADTS:
+		return GetAdtsFrameSize(data, size);
+	}
+
+	return 0;
+}
+
+/**
+ * The size of the largest frame header; a buffer tail shorter than
+ * this may be the beginning of a frame.
+ */
+static constexpr size_t MAX_HEADER_SIZE = 7;
+
+/**
+ * Is there a frame at the given position?  To avoid false positives
+ * (the sync word may appear inside a frame), the following frame
+ * header is checked, too, if it is within the buffer.
+ */
+gcc_pure
+static bool
+IsFrameStart(FrameFormat format, const uint8_t *p, size_t size) noexcept
+{
+	const size_t frame_size = GetFrameSize(format, p, size);
+	if (frame_size == 0)
+		return false;
+
+	return size - frame_size < MAX_HEADER_SIZE ||
+		frame_size > size ||
+		GetFrameSize(format, p + frame_size, size - frame_size) > 0;
+}
+
+size_t
+FindFramesEnd(FrameFormat format, const uint8_t *data, size_t size) noexcept
+{
+	const uint8_t *const end = data + size;
+	size_t position = 0;
+
+	while (size - position >= MAX_HEADER_SIZE) {
+		/* the first frame header may be a leftover from a
+		   resynchronization which could not be verified yet;
+		   all others follow a frame */
+		const size_t frame_size = position > 0 ||
+			IsFrameStart(format, data, size)
+			? GetFrameSize(format, data + position,
+				       size - position)
+			: 0;
+		if (frame_size > 0) {
+			if (frame_size > size - position)
+				/* incomplete */
+				break;
+
+			position += frame_size;
+			continue;
+		}
+
+		/* garbage: resynchronize at the next frame header */
+		const uint8_t *p = data + position + 1;
+		while ((p = (const uint8_t *)memchr(p, 0xff, end - p)) != nullptr &&
+		       size_t(end - p) >= MAX_HEADER_SIZE &&
+		       !IsFrameStart(format, p, end - p))
+			++p;
+
+		if (p == nullptr)
+			/* no frame header at all; send everything */
+			return size;
+
+		position = p - data;
+	}
+
+	return position;
+}
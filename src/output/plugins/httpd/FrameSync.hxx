@@ -0,0 +1,81 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_FRAME_SYNC_HXX
+#define MPD_OUTPUT_HTTPD_FRAME_SYNC_HXX
+
+#include "util/Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The framing of an encoded stream, as far as the "httpd" output
+ * needs to know it: a new client can only start decoding at the
+ * beginning of a frame.
+ */
+enum class FrameFormat : uint8_t {
+	/**
+	 * Nothing to do: Ogg encoders return whole pages, and PCM
+	 * pages are aligned by their size.
+	 */
+	NONE,
+
+	/**
+	 * MPEG audio frames (MP3, MP2).
+	 */
+	MPEG,
+
+	/**
+	 * AAC frames with ADTS headers.
+	 */
+	ADTS,
+};
+
+/**
+ * Determine the #FrameFormat from the MIME type of an encoder.
+ */
+gcc_pure
+FrameFormat
+GetFrameFormat(const char *mime_type) noexcept;
+
+/**
+ * Parse the frame header at the beginning of the buffer.
+ *
+ * @return the size of the frame in bytes (including the header), or
+ * 0 if there is no valid frame header
+ */
+gcc_pure
+size_t
+GetFrameSize(FrameFormat format, const uint8_t *data, size_t size) noexcept;
+
+/**
+ * Find the end of the last complete frame in the buffer, which
+ * should begin with a frame.  Everything before that may be sent as
+ * one page, and the next page will begin with a frame.  Garbage
+ * between frames is skipped by searching for the next frame header.
+ *
+ * @return the number of bytes to be sent; 0 if the buffer does not
+ * contain a complete frame yet
+ */
+gcc_pure
+size_t
+FindFramesEnd(FrameFormat format, const uint8_t *data, size_t size) noexcept;
+
+#endif
@@ -27,9 +27,24 @@
 #include "net/UniqueSocketDescriptor.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/uio.h>
+
+/**
+ * The maximum number of pages sent with one system call.
+ */
+static constexpr size_t MAX_WRITE_PAGES = 16;
+
+/**
+ * The maximum number of writes attempted by
+ * HttpdClient::OnNewPages() before falling back to waiting for the
+ * socket to become writable.
+ */
+static constexpr unsigned MAX_DIRECT_WRITES = 4;
 
 HttpdClient::~HttpdClient() noexcept
 {
@@ -57,6 +72,7 @@ HttpdClient::BeginResponse() noexcept
 
 	state = State::RESPONSE;
 	current_page = nullptr;
+	next_page = httpd.GetPageRing().GetHead();
 
 	if (!head_method)
 		httpd.SendHeader(*this);
@@ -170,31 +186,13 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, UniqueSocketDescriptor _fd,
 {
 }
 
-void
-HttpdClient::ClearQueue() noexcept
-{
-	assert(state == State::RESPONSE);
-
-	while (!pages.empty()) {
-#ifndef NDEBUG
-		auto &page = pages.front();
-		assert(queue_size >= page->GetSize());
-		queue_size -= page->GetSize();
-#endif
-
-		pages.pop();
-	}
-
-	assert(queue_size == 0);
-}
-
 void
 HttpdClient::CancelQueue() noexcept
 {
 	if (state != State::RESPONSE)
 		return;
 
-	ClearQueue();
+	next_page = httpd.GetPageRing().GetHead();
 
 	if (current_page == nullptr)
 		CancelWrite();
@@ -210,46 +208,102 @@ HttpdClient::TryWritePage(const Page &page, size_t position) noexcept
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page,
-			   size_t position, ssize_t n) noexcept
+HttpdClient::TryWritePages(ssize_t limit) noexcept
 {
-	return n >= 0
-		? GetSocket().Write(page.GetData() + position, n)
-		: TryWritePage(page, position);
+	assert(current_page != nullptr);
+	assert(current_position < current_page->GetSize());
+
+	const auto &ring = httpd.GetPageRing();
+	const uint64_t head = ring.GetHead();
+
+	struct iovec v[MAX_WRITE_PAGES];
+	size_t n = 0;
+	size_t remaining = limit >= 0 ? size_t(limit) : SIZE_MAX;
+
+	auto add = [&v, &n, &remaining](const Page &page, size_t position){
+		const size_t size = std::min(page.GetSize() - position,
+					     remaining);
+		v[n].iov_base = const_cast<uint8_t *>(page.GetData() + position);
+		v[n].iov_len = size;
+		++n;
+		remaining -= size;
+	};
+
+	add(*current_page, current_position);
+
+	for (uint64_t seq = next_page;
+	     seq != head && n < MAX_WRITE_PAGES && remaining > 0; ++seq)
+		add(*ring.Get(seq), 0);
+
+	return GetSocket().Write(v, n);
+}
+
+void
+HttpdClient::ConsumePages(size_t nbytes) noexcept
+{
+	const size_t rest = current_page->GetSize() - current_position;
+	if (nbytes < rest) {
+		current_position += nbytes;
+		return;
+	}
+
+	nbytes -= rest;
+	current_page.reset();
+
+	const auto &ring = httpd.GetPageRing();
+	while (nbytes > 0) {
+		const auto &page = ring.Get(next_page++);
+		if (nbytes < page->GetSize()) {
+			/* keep a reference, because the ring may
+			   discard this page before the rest is sent */
+			current_page = page;
+			current_position = nbytes;
+			break;
+		}
+
+		nbytes -= page->GetSize();
+	}
 }
 
 ssize_t
 HttpdClient::GetBytesTillMetaData() const noexcept
 {
-	if (metadata_requested &&
-	    current_page->GetSize() - current_position > metaint - metadata_fill)
+	if (metadata_requested)
 		return metaint - metadata_fill;
 
 	return -1;
 }
 
-inline bool
-HttpdClient::TryWrite() noexcept
+HttpdClient::WriteResult
+HttpdClient::HandleWriteError() noexcept
 {
-	const std::lock_guard<Mutex> protect(httpd.mutex);
+	auto e = GetSocketError();
+	if (IsSocketErrorAgain(e))
+		return WriteResult::AGAIN;
+
+	if (!IsSocketErrorClosed(e)) {
+		SocketErrorMessage msg(e);
+		FormatWarning(httpd_output_domain,
+			      "failed to write to client: %s",
+			      (const char *)msg);
+	}
+
+	Close();
+	return WriteResult::CLOSED;
+}
 
+HttpdClient::WriteResult
+HttpdClient::WritePending() noexcept
+{
 	assert(state == State::RESPONSE);
 
 	if (current_page == nullptr) {
-		if (pages.empty()) {
-			/* another thread has removed the event source
-			   while this thread was waiting for
-			   httpd.mutex */
-			CancelWrite();
-			return true;
-		}
+		const auto &ring = httpd.GetPageRing();
+		if (next_page == ring.GetHead())
+			return WriteResult::EMPTY;
 
-		current_page = pages.front();
-		pages.pop();
+		current_page = ring.Get(next_page++);
 		current_position = 0;
-
-		assert(queue_size >= current_page->GetSize());
-		queue_size -= current_page->GetSize();
 	}
 
 	const ssize_t bytes_to_write = GetBytesTillMetaData();
@@ -257,21 +311,8 @@ HttpdClient::TryWrite() noexcept
 		if (!metadata_sent) {
 			ssize_t nbytes = TryWritePage(*metadata,
 						      metadata_current_position);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
+			if (nbytes < 0)
+				return HandleWriteError();
 
 			metadata_current_position += nbytes;
 
@@ -284,81 +325,136 @@ HttpdClient::TryWrite() noexcept
 			char empty_data = 0;
 
 			ssize_t nbytes = GetSocket().Write(&empty_data, 1);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
+			if (nbytes < 0)
+				return HandleWriteError();
 
 			metadata_fill = 0;
 			metadata_current_position = 0;
 		}
 	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
-		if (nbytes < 0) {
-			auto e = GetSocketError();
-			if (IsSocketErrorAgain(e))
-				return true;
-
-			if (!IsSocketErrorClosed(e)) {
-				SocketErrorMessage msg(e);
-				FormatWarning(httpd_output_domain,
-					      "failed to write to client: %s",
-					      (const char *)msg);
-			}
+		ssize_t nbytes = TryWritePages(bytes_to_write);
+		if (nbytes < 0)
+			return HandleWriteError();
 
-			Close();
-			return false;
-		}
-
-		current_position += nbytes;
-		assert(current_position <= current_page->GetSize());
+		ConsumePages(nbytes);
 
 		if (metadata_requested)
 			metadata_fill += nbytes;
+	}
+
+	return WriteResult::SENT;
+}
 
-		if (current_position >= current_page->GetSize()) {
-			current_page.reset();
+inline bool
+HttpdClient::TryWrite() noexcept
+{
+	const std::lock_guard<Mutex> protect(httpd.mutex);
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+	switch (WritePending()) {
+	case WriteResult::EMPTY:
+		/* another thread has removed the event source while
+		   this thread was waiting for httpd.mutex */
+		CancelWrite();
+		break;
+
+	case WriteResult::SENT:
+		if (!HasPendingPages())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
+		break;
+
+	case WriteResult::AGAIN:
+		break;
+
+	case WriteResult::CLOSED:
+		return false;
 	}
 
 	return true;
 }
 
 void
-HttpdClient::PushPage(PagePtr page) noexcept
+HttpdClient::BeginStream(PagePtr header, uint64_t first_page) noexcept
+{
+	assert(state == State::RESPONSE);
+	assert(current_page == nullptr);
+
+	current_page = std::move(header);
+	current_position = 0;
+	next_page = first_page;
+
+	if (HasPendingPages())
+		ScheduleWrite();
+}
+
+bool
+HttpdClient::HasPendingPages() const noexcept
+{
+	return current_page != nullptr ||
+		next_page != httpd.GetPageRing().GetHead();
+}
+
+bool
+HttpdClient::CheckLag() noexcept
 {
 	if (state != State::RESPONSE)
-		/* the client is still writing the HTTP request */
-		return;
+		return true;
+
+	const auto &ring = httpd.GetPageRing();
+	const uint64_t head = ring.GetHead();
 
-	if (queue_size > 256 * 1024) {
+	/* a client must not hold more than half of the ring, or
+	   else the output thread would have to wait for it */
+	if (ring.GetLag(next_page) <= httpd.max_client_lag &&
+	    head - next_page < ring.GetCapacity() / 2)
+		return true;
+
+	if (httpd.disconnect_slow_clients) {
 		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
+			    "client is too slow, disconnecting");
+		return false;
+	}
+
+	FormatDebug(httpd_output_domain,
+		    "client is too slow, skipping %llu pages",
+		    (unsigned long long)(head - next_page));
+	next_page = head;
+	return true;
+}
+
+bool
+HttpdClient::OnNewPages() noexcept
+{
+	if (state != State::RESPONSE || (GetScheduledFlags() & WRITE) != 0)
+		/* not ready, or still waiting for the socket to
+		   become writable */
+		return true;
+
+	/* try to send right away: the socket is usually writable,
+	   and this saves a round trip through the EventLoop for each
+	   client */
+	for (unsigned i = 0; i < MAX_DIRECT_WRITES; ++i) {
+		switch (WritePending()) {
+		case WriteResult::EMPTY:
+			return true;
+
+		case WriteResult::SENT:
+			break;
+
+		case WriteResult::AGAIN:
+			ScheduleWrite();
+			return true;
+
+		case WriteResult::CLOSED:
+			return false;
+		}
 	}
 
-	queue_size += page->GetSize();
-	pages.emplace(std::move(page));
+	if (HasPendingPages())
+		ScheduleWrite();
 
-	ScheduleWrite();
+	return true;
 }
 
 void
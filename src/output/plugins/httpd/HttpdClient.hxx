@@ -27,10 +27,8 @@
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
-#include <queue>
-#include <list>
-
 #include <stddef.h>
+#include <stdint.h>
 
 class UniqueSocketDescriptor;
 class HttpdOutput;
@@ -58,17 +56,16 @@ class HttpdClient final
 	} state = State::REQUEST;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
+	 * The sequence number of the next #PageRing page to be sent
+	 * to the client.  Only valid in #State::RESPONSE.
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	uint64_t next_page;
 
 	/**
-	 * The sum of all page sizes in #pages.
-	 */
-	size_t queue_size = 0;
-
-	/**
-	 * The #page which is currently being sent to the client.
+	 * The #page which is currently being sent to the client.  It
+	 * is either the stream header or a page from the
+	 * #PageRing; holding a reference allows the ring to discard
+	 * it before it is sent completely.
 	 */
 	PagePtr current_page;
 
@@ -148,7 +145,7 @@ public:
 	void LockClose() noexcept;
 
 	/**
-	 * Clears the page queue.
+	 * Skips all pages which are currently in the #PageRing.
 	 */
 	void CancelQueue() noexcept;
 
@@ -171,15 +168,51 @@ public:
 	ssize_t GetBytesTillMetaData() const noexcept;
 
 	ssize_t TryWritePage(const Page &page, size_t position) noexcept;
-	ssize_t TryWritePageN(const Page &page,
-			      size_t position, ssize_t n) noexcept;
+
+	/**
+	 * Send #current_page and as many pages from the #PageRing as
+	 * possible with one system call.
+	 *
+	 * @param limit the maximum number of bytes to send; -1 means
+	 * no limit
+	 */
+	ssize_t TryWritePages(ssize_t limit) noexcept;
 
 	bool TryWrite() noexcept;
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Start sending the stream: first the header page (if any),
+	 * then the pages from the #PageRing, beginning with the
+	 * specified one.
+	 */
+	void BeginStream(PagePtr header, uint64_t first_page) noexcept;
+
+	/**
+	 * Returns the sequence number of the next #PageRing page
+	 * this client needs, or UINT64_MAX if it needs none yet.
+	 */
+	gcc_pure
+	uint64_t GetNextPage() const noexcept {
+		return state == State::RESPONSE
+			? next_page
+			: UINT64_MAX;
+	}
+
+	/**
+	 * Apply the slow client policy if this client has fallen too
+	 * far behind.
+	 *
+	 * @return false if the client shall be disconnected
+	 */
+	bool CheckLag() noexcept;
+
+	/**
+	 * New pages have been added to the #PageRing.  Caller must
+	 * lock the mutex.
+	 *
+	 * @return false if the client has been closed
 	 */
-	void PushPage(PagePtr page) noexcept;
+	bool OnNewPages() noexcept;
 
 	/**
 	 * Sends the passed metadata.
@@ -187,7 +220,40 @@ public:
 	void PushMetaData(PagePtr page) noexcept;
 
 private:
-	void ClearQueue() noexcept;
+	enum class WriteResult {
+		/** there was nothing to send */
+		EMPTY,
+
+		/** some data has been sent */
+		SENT,
+
+		/** the socket is not writable */
+		AGAIN,
+
+		/** an error has occurred, and the client was closed */
+		CLOSED,
+	};
+
+	/**
+	 * Send the next portion of pending data (pages or
+	 * metadata).  Caller must lock the mutex.
+	 */
+	WriteResult WritePending() noexcept;
+
+	/**
+	 * Handle a failed write attempt.
+	 */
+	WriteResult HandleWriteError() noexcept;
+
+	gcc_pure
+	bool HasPendingPages() const noexcept;
+
+	/**
+	 * Mark the specified number of bytes, which were sent from
+	 * #current_page and the following #PageRing pages, as
+	 * consumed.
+	 */
+	void ConsumePages(size_t nbytes) noexcept;
 
 protected:
 	/* virtual methods from class SocketMonitor */
@@ -26,6 +26,8 @@
 #define MPD_OUTPUT_HTTPD_INTERNAL_H
 
 #include "HttpdClient.hxx"
+#include "PageRing.hxx"
+#include "FrameSync.hxx"
 #include "output/Interface.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
@@ -37,15 +39,15 @@
 
 #include <boost/intrusive/list.hpp>
 
-#include <queue>
-#include <list>
 #include <memory>
 
+#include <stdint.h>
+
 struct ConfigBlock;
 class EventLoop;
 class ServerSocket;
 class HttpdClient;
-class PreparedEncoder;
+class SharedPreparedEncoder;
 class Encoder;
 struct Tag;
 
@@ -61,7 +63,7 @@ class HttpdOutput final : AudioOutput, ServerSocket {
 	/**
 	 * The configured encoder plugin.
 	 */
-	std::unique_ptr<PreparedEncoder> prepared_encoder;
+	std::unique_ptr<SharedPreparedEncoder> prepared_encoder;
 	Encoder *encoder = nullptr;
 
 	/**
@@ -85,11 +87,29 @@ public:
 	mutable Mutex mutex;
 
 	/**
-	 * This condition gets signalled when an item is removed from
-	 * #pages.
+	 * This condition gets signalled when pages are released from
+	 * #ring.
 	 */
 	Cond cond;
 
+	/**
+	 * A client which is more than this number of bytes behind
+	 * the encoder is considered too slow.
+	 */
+	uint64_t max_client_lag;
+
+	/**
+	 * Disconnect slow clients instead of letting them skip the
+	 * pages they have missed?
+	 */
+	bool disconnect_slow_clients;
+
+	/**
+	 * The number of bytes of recent pages which are sent to a new
+	 * client right away, to fill its buffer quickly.
+	 */
+	uint64_t burst_size;
+
 private:
 	/**
 	 * A #Timer object to synchronize this output with the
@@ -99,21 +119,38 @@ private:
 
 	/**
 	 * The header page, which is sent to every client on connect.
+	 * Protected by #mutex.
 	 */
 	PagePtr header;
 
+	/**
+	 * The sequence number of the first #ring page after
+	 * #header.  A burst must not start before this page, because
+	 * older pages belong to the previous stream.  Protected by
+	 * #mutex.
+	 */
+	uint64_t stream_start = 0;
+
+	/**
+	 * The oldest #ring page which is sent to new clients (see
+	 * #burst_size).  The ring keeps all pages from here on.  Only
+	 * used in the IOThread.
+	 */
+	uint64_t burst_start = 0;
+
 	/**
 	 * The metadata, which is sent to every client.
 	 */
 	PagePtr metadata;
 
 	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
+	 * The pages from the encoder which are being sent to the
+	 * clients.  The OutputThread appends pages, and each client
+	 * reads them with its own cursor in the IOThread.  Pages
+	 * which all clients have sent are released by
+	 * OnDeferredBroadcast().
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	PageRing ring;
 
 	DeferEvent defer_broadcast;
 
@@ -145,6 +182,28 @@ private:
 	 */
 	char buffer[32768];
 
+	/**
+	 * The number of bytes of #buffer used by ReadPage().  It is a
+	 * multiple of the PCM frame size for all sample formats, so
+	 * pages from PCM encoders always begin at a frame boundary,
+	 * and new clients may start with any page.
+	 */
+	size_t page_size;
+
+	/**
+	 * The framing of the encoder output.  For MP3 and AAC,
+	 * ReadPage() cuts pages only at frame boundaries, so new
+	 * clients may start with any page, too.
+	 */
+	FrameFormat frame_format;
+
+	/**
+	 * The number of bytes at the beginning of #buffer left over
+	 * by the previous ReadPage() call: an incomplete frame which
+	 * will begin the next page.
+	 */
+	size_t buffered = 0;
+
 	/**
 	 * The maximum and current number of clients connected
 	 * at the same time.
@@ -153,6 +212,7 @@ private:
 
 public:
 	HttpdOutput(EventLoop &_loop, const ConfigBlock &block);
+	~HttpdOutput() noexcept;
 
 	static AudioOutput *Create(EventLoop &event_loop,
 				   const ConfigBlock &block) {
@@ -161,6 +221,13 @@ public:
 
 	using ServerSocket::GetEventLoop;
 
+	/**
+	 * May only be used in the IOThread.
+	 */
+	const PageRing &GetPageRing() const noexcept {
+		return ring;
+	}
+
 	void Bind();
 	void Unbind() noexcept;
 
@@ -216,8 +283,8 @@ public:
 	void RemoveClient(HttpdClient &client) noexcept;
 
 	/**
-	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
+	 * Sends the encoder header and the burst to the client.  This
+	 * is called right after the response headers have been sent.
 	 */
 	void SendHeader(HttpdClient &client) const noexcept;
 
@@ -237,6 +304,17 @@ public:
 	 */
 	void BroadcastPage(PagePtr page) noexcept;
 
+private:
+	/**
+	 * Append a page to #ring; if it is full, wait for the
+	 * IOThread to release pages.
+	 *
+	 * Mutext must not be locked.
+	 */
+	void PushPage(PagePtr &&page) noexcept;
+
+public:
+
 	/**
 	 * Broadcasts data from the encoder to all clients.
 	 */
@@ -257,6 +335,12 @@ public:
 	bool Pause() override;
 
 private:
+	/**
+	 * Advance #burst_start after new pages have been added to
+	 * #ring.
+	 */
+	void UpdateBurstStart() noexcept;
+
 	/* DeferEvent callback */
 	void OnDeferredBroadcast() noexcept;
 
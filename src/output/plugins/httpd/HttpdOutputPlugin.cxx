@@ -23,7 +23,7 @@
 #include "HttpdClient.hxx"
 #include "output/OutputAPI.hxx"
 #include "encoder/EncoderInterface.hxx"
-#include "encoder/Configured.hxx"
+#include "encoder/Shared.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "net/SocketAddress.hxx"
 #include "net/ToString.hxx"
@@ -34,6 +34,9 @@
 #include "util/DeleteDisposer.hxx"
 #include "Log.hxx"
 #include "config/Net.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 
@@ -42,11 +45,17 @@
 
 const Domain httpd_output_domain("httpd_output");
 
+/**
+ * The number of pages in #HttpdOutput::ring.
+ */
+static constexpr size_t PAGE_RING_CAPACITY = 1024;
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
 	 ServerSocket(_loop),
-	 prepared_encoder(CreateConfiguredEncoder(block)),
+	 prepared_encoder(CreateSharedEncoder(block)),
+	 ring(PAGE_RING_CAPACITY),
 	 defer_broadcast(_loop, BIND_THIS_METHOD(OnDeferredBroadcast))
 {
 	/* read configuration */
@@ -56,6 +65,22 @@ HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 
 	clients_max = block.GetBlockValue("max_clients", 0u);
 
+	max_client_lag = uint64_t(block.GetBlockValue("max_client_lag", 256u))
+		* 1024;
+
+	const char *slow_clients = block.GetBlockValue("slow_clients", "skip");
+	if (strcmp(slow_clients, "skip") == 0)
+		disconnect_slow_clients = false;
+	else if (strcmp(slow_clients, "disconnect") == 0)
+		disconnect_slow_clients = true;
+	else
+		throw FormatRuntimeError("Unsupported \"slow_clients\" value: %s",
+					 slow_clients);
+
+	burst_size = uint64_t(block.GetBlockValue("burst_size", 0u)) * 1024;
+	if (burst_size >= max_client_lag)
+		throw std::runtime_error("\"burst_size\" must be smaller than \"max_client_lag\"");
+
 	/* set up bind_to_address */
 
 	ServerSocketAddGeneric(*this, block.GetBlockValue("bind_to_address"), block.GetBlockValue("port", 8000u));
@@ -66,6 +91,8 @@ HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 		content_type = "application/octet-stream";
 }
 
+HttpdOutput::~HttpdOutput() noexcept = default;
+
 inline void
 HttpdOutput::Bind()
 {
@@ -102,24 +129,49 @@ HttpdOutput::AddClient(UniqueSocketDescriptor fd) noexcept
 		clients.front().PushMetaData(metadata);
 }
 
+inline void
+HttpdOutput::UpdateBurstStart() noexcept
+{
+	/* limit the number of pages, too, or else a new client
+	   would be considered too slow right away (see
+	   HttpdClient::CheckLag()) */
+	const uint64_t max_pages = ring.GetCapacity() / 4;
+
+	burst_start = ring.FindBurstStart(std::max(burst_start, stream_start),
+					  burst_size, max_pages);
+}
+
 void
 HttpdOutput::OnDeferredBroadcast() noexcept
 {
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
+	/* this method runs in the IOThread; it wakes up all clients
+	   which have new pages to send, and releases the pages which
+	   have been sent by all clients */
 
 	const std::lock_guard<Mutex> protect(mutex);
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
+	UpdateBurstStart();
+
+	uint64_t min_page = burst_start;
+
+	for (auto i = clients.begin(); i != clients.end();) {
+		auto &client = *i++;
+		if (!client.CheckLag()) {
+			RemoveClient(client);
+			continue;
+		}
+
+		if (!client.OnNewPages())
+			/* the client has been closed */
+			continue;
 
-		for (auto &client : clients)
-			client.PushPage(page);
+		min_page = std::min(min_page, client.GetNextPage());
 	}
 
-	/* wake up the client that may be waiting for the queue to be
-	   flushed */
+	ring.Release(min_page);
+
+	/* wake up the OutputThread that may be waiting for room in
+	   the ring */
 	cond.broadcast();
 }
 
@@ -153,22 +205,45 @@ HttpdOutput::ReadPage()
 		unflushed_input = 0;
 	}
 
-	size_t size = 0;
+	size_t size = buffered;
 	do {
 		size_t nbytes = encoder->Read(buffer + size,
-					      sizeof(buffer) - size);
+					      page_size - size);
 		if (nbytes == 0)
 			break;
 
 		unflushed_input = 0;
 
 		size += nbytes;
-	} while (size < sizeof(buffer));
+	} while (size < page_size);
+
+	buffered = 0;
+
+	if (frame_format != FrameFormat::NONE) {
+		const size_t end =
+			FindFramesEnd(frame_format, (const uint8_t *)buffer,
+				      size);
+		if (end == 0 && size < page_size) {
+			/* not a single complete frame yet */
+			buffered = size;
+			return nullptr;
+		}
+
+		if (end > 0 && end < size) {
+			/* keep the incomplete frame for the next
+			   page */
+			buffered = size - end;
+			size = end;
+		}
+	}
 
 	if (size == 0)
 		return nullptr;
 
-	return std::make_shared<Page>(buffer, size);
+	auto page = std::make_shared<Page>(buffer, size);
+	if (buffered > 0)
+		memmove(buffer, buffer + size, buffered);
+	return page;
 }
 
 inline void
@@ -176,6 +251,14 @@ HttpdOutput::OpenEncoder(AudioFormat &audio_format)
 {
 	encoder = prepared_encoder->Open(audio_format);
 
+	/* 12 is the least common multiple of all sample sizes
+	   (1, 2, 3 and 4 bytes) */
+	const size_t frame_size = 12 * audio_format.channels;
+	page_size = sizeof(buffer) - sizeof(buffer) % frame_size;
+
+	frame_format = GetFrameFormat(content_type);
+	buffered = 0;
+
 	/* we have to remember the encoder header, i.e. the first
 	   bytes of encoder output after opening it, because it has to
 	   be sent to every new client */
@@ -194,6 +277,10 @@ HttpdOutput::Open(AudioFormat &audio_format)
 
 	OpenEncoder(audio_format);
 
+	/* the ring is empty; the first page will be the first page
+	   of the stream */
+	stream_start = ring.GetHead();
+
 	/* initialize other attributes */
 
 	timer = new Timer(audio_format);
@@ -215,6 +302,8 @@ HttpdOutput::Close() noexcept
 			const std::lock_guard<Mutex> protect(mutex);
 			open = false;
 			clients.clear_and_dispose(DeleteDisposer());
+			ring.Clear();
+			burst_start = ring.GetHead();
 		});
 
 	header.reset();
@@ -234,8 +323,9 @@ HttpdOutput::RemoveClient(HttpdClient &client) noexcept
 void
 HttpdOutput::SendHeader(HttpdClient &client) const noexcept
 {
-	if (header != nullptr)
-		client.PushPage(header);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	client.BeginStream(header, std::max(burst_start, stream_start));
 }
 
 std::chrono::steady_clock::duration
@@ -259,35 +349,38 @@ HttpdOutput::Delay() const noexcept
 		: std::chrono::steady_clock::duration::zero();
 }
 
+inline void
+HttpdOutput::PushPage(PagePtr &&page) noexcept
+{
+	if (gcc_likely(ring.Push(std::move(page))))
+		return;
+
+	/* the ring is full; the IOThread will release pages after
+	   dealing with slow clients */
+	const std::lock_guard<Mutex> lock(mutex);
+	while (!ring.Push(std::move(page))) {
+		defer_broadcast.Schedule();
+		cond.wait(mutex);
+	}
+}
+
 void
 HttpdOutput::BroadcastPage(PagePtr page) noexcept
 {
 	assert(page != nullptr);
 
-	{
-		const std::lock_guard<Mutex> lock(mutex);
-		pages.emplace(std::move(page));
-	}
-
+	PushPage(std::move(page));
 	defer_broadcast.Schedule();
 }
 
 void
 HttpdOutput::BroadcastFromEncoder()
 {
-	/* synchronize with the IOThread */
-	{
-		const std::lock_guard<Mutex> lock(mutex);
-		while (!pages.empty())
-			cond.wait(mutex);
-	}
-
 	bool empty = true;
 
 	PagePtr page;
 	while ((page = ReadPage()) != nullptr) {
-		const std::lock_guard<Mutex> lock(mutex);
-		pages.emplace(std::move(page));
+		PushPage(std::move(page));
 		empty = false;
 	}
 
@@ -310,7 +403,12 @@ HttpdOutput::Play(const void *chunk, size_t size)
 {
 	pause = false;
 
-	if (LockHasClients())
+	/* a shared encoder is fed even without clients, because the
+	   other outputs need the data anyway, and our read position
+	   would fall behind; with a burst, the ring must always
+	   contain recent pages for the next client */
+	if (LockHasClients() || burst_size > 0 ||
+	    prepared_encoder->IsShared())
 		EncodeAndPlay(chunk, size);
 
 	if (!timer->IsStarted())
@@ -365,8 +463,13 @@ HttpdOutput::SendTag(const Tag &tag)
 
 		auto page = ReadPage();
 		if (page != nullptr) {
-			header = page;
 			BroadcastPage(page);
+
+			/* new clients shall not get pages from the
+			   previous stream in their burst */
+			const std::lock_guard<Mutex> protect(mutex);
+			header = page;
+			stream_start = ring.GetHead();
 		}
 	} else {
 		/* use Icy-Metadata */
@@ -390,14 +493,12 @@ HttpdOutput::CancelAllClients() noexcept
 {
 	const std::lock_guard<Mutex> protect(mutex);
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
-	}
-
 	for (auto &client : clients)
 		client.CancelQueue();
 
+	ring.Clear();
+	burst_start = ring.GetHead();
+
 	cond.broadcast();
 }
 
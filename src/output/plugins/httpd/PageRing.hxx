@@ -0,0 +1,205 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+#define MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+
+#include "Page.hxx"
+#include "util/Compiler.h"
+
+#include <atomic>
+#include <memory>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A bounded queue of #Page objects which is shared by all clients
+ * of a "httpd" output.  Each page gets a sequence number, and each
+ * client reads the ring at its own pace by remembering the sequence
+ * number of the next page it wants to send.
+ *
+ * There is exactly one producer thread (the output thread), which
+ * calls Push(), and exactly one consumer thread (the IOThread),
+ * which may call all other methods.  No mutex is needed between the
+ * two.
+ */
+class PageRing {
+	struct Slot {
+		PagePtr page;
+
+		/**
+		 * The stream offset of the first byte of this page,
+		 * i.e. the sum of the sizes of all pages before it.
+		 */
+		uint64_t offset;
+	};
+
+	const size_t capacity;
+
+	std::unique_ptr<Slot[]> slots;
+
+	/**
+	 * The sequence number of the oldest page which is still
+	 * available.  Written only by the consumer.
+	 */
+	std::atomic<uint64_t> tail{0};
+
+	/**
+	 * The sequence number of the next page to be pushed.
+	 * Written only by the producer.
+	 */
+	std::atomic<uint64_t> head{0};
+
+	/**
+	 * The stream offset of the next page to be pushed.  Used only
+	 * by the producer.
+	 */
+	uint64_t next_offset = 0;
+
+public:
+	explicit PageRing(size_t _capacity)
+		:capacity(_capacity), slots(new Slot[capacity]) {}
+
+	PageRing(const PageRing &) = delete;
+	PageRing &operator=(const PageRing &) = delete;
+
+	size_t GetCapacity() const noexcept {
+		return capacity;
+	}
+
+	/**
+	 * Returns the sequence number of the oldest page which is
+	 * still available.
+	 */
+	uint64_t GetTail() const noexcept {
+		return tail.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the sequence number which will be assigned to the
+	 * next page.
+	 */
+	uint64_t GetHead() const noexcept {
+		return head.load(std::memory_order_acquire);
+	}
+
+	gcc_pure
+	bool IsFull() const noexcept {
+		return head.load(std::memory_order_relaxed) -
+			tail.load(std::memory_order_acquire) >= capacity;
+	}
+
+	/**
+	 * Append a page.  Only the producer may call this.
+	 *
+	 * @return false if the ring is full (the page is left
+	 * untouched)
+	 */
+	bool Push(PagePtr &&page) noexcept {
+		assert(page != nullptr);
+
+		if (IsFull())
+			return false;
+
+		const uint64_t h = head.load(std::memory_order_relaxed);
+		Slot &slot = slots[h % capacity];
+		assert(slot.page == nullptr);
+		slot.offset = next_offset;
+		next_offset += page->GetSize();
+		slot.page = std::move(page);
+
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Returns the page with the specified sequence number, which
+	 * must be available.
+	 */
+	const PagePtr &Get(uint64_t seq) const noexcept {
+		assert(seq >= GetTail());
+		assert(seq < GetHead());
+
+		return slots[seq % capacity].page;
+	}
+
+	/**
+	 * Returns the number of bytes a reader whose next page is
+	 * the given one is behind the producer.
+	 */
+	gcc_pure
+	uint64_t GetLag(uint64_t seq) const noexcept {
+		const uint64_t h = GetHead();
+		assert(seq >= GetTail());
+		assert(seq <= h);
+
+		if (seq == h)
+			return 0;
+
+		const Slot &last = slots[(h - 1) % capacity];
+		return last.offset + last.page->GetSize() -
+			slots[seq % capacity].offset;
+	}
+
+	/**
+	 * Find the oldest page, not before the given one, from which
+	 * on the ring holds at most the given number of bytes and
+	 * pages.  A new client may start there.
+	 */
+	gcc_pure
+	uint64_t FindBurstStart(uint64_t seq, uint64_t max_bytes,
+				uint64_t max_pages) const noexcept {
+		const uint64_t h = GetHead();
+		assert(seq <= h);
+
+		if (h - seq > max_pages)
+			seq = h - max_pages;
+
+		while (seq < h && GetLag(seq) > max_bytes)
+			++seq;
+
+		return seq;
+	}
+
+	/**
+	 * Discard all pages before the specified sequence number,
+	 * which makes room for the producer.
+	 */
+	void Release(uint64_t new_tail) noexcept {
+		uint64_t t = GetTail();
+		assert(new_tail >= t);
+		assert(new_tail <= GetHead());
+
+		for (; t < new_tail; ++t)
+			slots[t % capacity].page.reset();
+
+		tail.store(new_tail, std::memory_order_release);
+	}
+
+	/**
+	 * Discard all pages.
+	 */
+	void Clear() noexcept {
+		Release(GetHead());
+	}
+};
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "ConfiguredResampler.hxx"
 #include "FallbackResampler.hxx"
+#include "FirResampler.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "config/Domain.hxx"
@@ -41,6 +42,8 @@
 enum class SelectedResampler {
 	FALLBACK,
 
+	FIR,
+
 #ifdef ENABLE_LIBSAMPLERATE
 	LIBSAMPLERATE,
 #endif
@@ -52,6 +55,8 @@ enum class SelectedResampler {
 
 static SelectedResampler selected_resampler = SelectedResampler::FALLBACK;
 
+static FirResamplerQuality fir_quality;
+
 static const ConfigBlock *
 MakeResamplerDefaultConfig(ConfigBlock &block) noexcept
 {
@@ -62,7 +67,7 @@ MakeResamplerDefaultConfig(ConfigBlock &block) noexcept
 #elif defined(ENABLE_SOXR)
 	block.AddBlockParam("plugin", "soxr");
 #else
-	block.AddBlockParam("plugin", "internal");
+	block.AddBlockParam("plugin", "fir");
 #endif
 	return &block;
 }
@@ -84,6 +89,17 @@ MigrateResamplerConfig(const ConfigParam &param, ConfigBlock &block) noexcept
 		return &block;
 	}
 
+	if (strcmp(converter, "fir") == 0) {
+		block.AddBlockParam("plugin", "fir");
+		return &block;
+	}
+
+	if (strncmp(converter, "fir ", 4) == 0) {
+		block.AddBlockParam("plugin", "fir");
+		block.AddBlockParam("quality", converter + 4);
+		return &block;
+	}
+
 #ifdef ENABLE_SOXR
 	if (strcmp(converter, "soxr") == 0) {
 		block.AddBlockParam("plugin", "soxr");
@@ -142,6 +158,9 @@ pcm_resampler_global_init(const ConfigData &config)
 
 	if (strcmp(plugin_name, "internal") == 0) {
 		selected_resampler = SelectedResampler::FALLBACK;
+	} else if (strcmp(plugin_name, "fir") == 0) {
+		selected_resampler = SelectedResampler::FIR;
+		fir_quality = pcm_resample_fir_global_init(*block);
 #ifdef ENABLE_SOXR
 	} else if (strcmp(plugin_name, "soxr") == 0) {
 		selected_resampler = SelectedResampler::SOXR;
@@ -165,6 +184,9 @@ pcm_resampler_create()
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
+	case SelectedResampler::FIR:
+		return new FirPcmResampler(fir_quality);
+
 #ifdef ENABLE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
 		return new LibsampleratePcmResampler();
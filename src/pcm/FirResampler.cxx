@@ -0,0 +1,418 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "FirResampler.hxx"
+#include "Kernels.hxx"
+#include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
+#include <forward_list>
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+static constexpr FirResamplerQuality FIR_DEFAULT_QUALITY =
+	FirResamplerQuality::HIGH;
+
+/**
+ * If the reduced "up" factor is larger than this, the filter phases
+ * are interpolated instead of being calculated exactly.
+ */
+static constexpr unsigned FIR_MAX_EXACT_PHASES = 2048;
+
+/**
+ * The number of phases in the table if they are interpolated.
+ */
+static constexpr unsigned FIR_INTERPOLATED_PHASES = 256;
+
+static constexpr struct {
+	FirResamplerQuality quality;
+	const char *name;
+
+	/**
+	 * The number of zero crossings of the sinc function on each
+	 * side of the center, i.e. half the filter length in input
+	 * frames (if not downsampling).
+	 */
+	unsigned zero_crossings;
+
+	/**
+	 * The "beta" parameter of the Kaiser window; larger values
+	 * improve stop-band attenuation at the cost of a wider
+	 * transition band.
+	 */
+	double beta;
+
+	/**
+	 * The cutoff frequency relative to the lower Nyquist
+	 * frequency.
+	 */
+	double cutoff;
+} fir_quality_table[] = {
+	{ FirResamplerQuality::VERY_HIGH, "very high", 64, 12.0, 0.97 },
+	{ FirResamplerQuality::HIGH, "high", 32, 10.0, 0.95 },
+	{ FirResamplerQuality::MEDIUM, "medium", 16, 8.0, 0.92 },
+	{ FirResamplerQuality::LOW, "low", 8, 6.0, 0.88 },
+};
+
+gcc_const
+static const auto &
+GetFirQualitySpec(FirResamplerQuality quality) noexcept
+{
+	for (const auto &i : fir_quality_table)
+		if (i.quality == quality)
+			return i;
+
+	assert(false);
+	gcc_unreachable();
+}
+
+FirResamplerQuality
+pcm_resample_fir_global_init(const ConfigBlock &block)
+{
+	const char *quality = block.GetBlockValue("quality");
+	if (quality == nullptr)
+		return FIR_DEFAULT_QUALITY;
+
+	for (const auto &i : fir_quality_table)
+		if (strcmp(i.name, quality) == 0)
+			return i.quality;
+
+	throw FormatRuntimeError("unknown quality setting '%s' in line %d",
+				 quality, block.line);
+}
+
+gcc_const
+static unsigned
+Gcd(unsigned a, unsigned b) noexcept
+{
+	while (b != 0) {
+		const unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/**
+ * The modified Bessel function of the first kind, order 0.
+ */
+gcc_const
+static double
+BesselI0(double x) noexcept
+{
+	double sum = 1, term = 1;
+	const double y = x * x / 4;
+
+	for (unsigned k = 1; term > sum * 1e-12; ++k) {
+		term *= y / (double(k) * double(k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+/**
+ * The filter coefficients for one combination of sample rates and
+ * quality.  Instances are immutable and shared between all
+ * #FirPcmResampler instances which need them.
+ */
+class FirFilterTable {
+public:
+	const unsigned in_rate, out_rate;
+	const FirResamplerQuality quality;
+
+	/**
+	 * The ratio of output to input sample rate, reduced to the
+	 * smallest integers.
+	 */
+	unsigned up, down;
+
+	/**
+	 * The number of filter phases in the table.
+	 */
+	unsigned n_phases;
+
+	/**
+	 * Are the coefficients interpolated between phases?  If not,
+	 * #n_phases equals #up.  If yes, the table contains one
+	 * additional phase.
+	 */
+	bool interpolate;
+
+	/**
+	 * The number of coefficients in each phase; a multiple of 8.
+	 */
+	unsigned n_taps;
+
+	std::unique_ptr<float[]> coefficients;
+
+	FirFilterTable(unsigned _in_rate, unsigned _out_rate,
+		       FirResamplerQuality _quality) noexcept;
+
+	bool Match(unsigned _in_rate, unsigned _out_rate,
+		   FirResamplerQuality _quality) const noexcept {
+		return in_rate == _in_rate && out_rate == _out_rate &&
+			quality == _quality;
+	}
+
+	const float *GetPhase(unsigned i) const noexcept {
+		assert(i < n_phases + interpolate);
+
+		return &coefficients[size_t(i) * n_taps];
+	}
+};
+
+FirFilterTable::FirFilterTable(unsigned _in_rate, unsigned _out_rate,
+			       FirResamplerQuality _quality) noexcept
+	:in_rate(_in_rate), out_rate(_out_rate), quality(_quality)
+{
+	const auto &spec = GetFirQualitySpec(quality);
+
+	const unsigned gcd = Gcd(in_rate, out_rate);
+	up = out_rate / gcd;
+	down = in_rate / gcd;
+
+	interpolate = up > FIR_MAX_EXACT_PHASES;
+	n_phases = interpolate ? FIR_INTERPOLATED_PHASES : up;
+
+	/* when downsampling, the cutoff frequency must be below the
+	   output's Nyquist frequency, and the filter gets longer */
+	const double scale = std::min(1.0, double(out_rate) / in_rate);
+	const double cutoff = spec.cutoff * scale;
+
+	unsigned half = unsigned(ceil(spec.zero_crossings / scale));
+	half = (half + 3) & ~3u;
+	n_taps = half * 2;
+
+	const unsigned n_rows = n_phases + interpolate;
+	coefficients.reset(new float[size_t(n_rows) * n_taps]);
+
+	const double i0_beta = BesselI0(spec.beta);
+
+	std::unique_ptr<double[]> row(new double[n_taps]);
+	for (unsigned p = 0; p < n_rows; ++p) {
+		/* the output frame is "offset" input frames after
+		   the (half-1)th tap */
+		const double offset = double(p) / n_phases;
+
+		double sum = 0;
+		for (unsigned j = 0; j < n_taps; ++j) {
+			const double t = double(j) - (half - 1) - offset;
+			const double x = t / half;
+			const double window = x * x < 1
+				? BesselI0(spec.beta * sqrt(1 - x * x)) / i0_beta
+				: 0;
+			const double arg = M_PI * cutoff * t;
+			const double sinc = fabs(arg) < 1e-9
+				? 1.
+				: sin(arg) / arg;
+
+			row[j] = cutoff * sinc * window;
+			sum += row[j];
+		}
+
+		/* normalize each phase to unity gain at DC */
+		float *dest = &coefficients[size_t(p) * n_taps];
+		for (unsigned j = 0; j < n_taps; ++j)
+			dest[j] = row[j] / sum;
+	}
+}
+
+static Mutex fir_table_mutex;
+
+/**
+ * All tables which are currently in use.
+ */
+static std::forward_list<std::weak_ptr<const FirFilterTable>> fir_tables;
+
+static std::shared_ptr<const FirFilterTable>
+GetFirFilterTable(unsigned in_rate, unsigned out_rate,
+		  FirResamplerQuality quality) noexcept
+{
+	const std::lock_guard<Mutex> protect(fir_table_mutex);
+
+	fir_tables.remove_if([](const std::weak_ptr<const FirFilterTable> &i){
+			return i.expired();
+		});
+
+	for (const auto &i : fir_tables) {
+		auto table = i.lock();
+		if (table && table->Match(in_rate, out_rate, quality))
+			return table;
+	}
+
+	auto table = std::make_shared<const FirFilterTable>(in_rate, out_rate,
+							    quality);
+	fir_tables.emplace_front(table);
+	return table;
+}
+
+FirPcmResampler::FirPcmResampler(FirResamplerQuality _quality) noexcept
+	:quality(_quality), kernels(GetPcmKernels())
+{
+}
+
+FirPcmResampler::~FirPcmResampler() noexcept = default;
+
+AudioFormat
+FirPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	/* the filter works with floating point samples */
+	af.format = SampleFormat::FLOAT;
+
+	channels = af.channels;
+	table = GetFirFilterTable(af.sample_rate, new_sample_rate, quality);
+	Reset();
+
+	AudioFormat result = af;
+	result.sample_rate = new_sample_rate;
+	return result;
+}
+
+void
+FirPcmResampler::Close() noexcept
+{
+	table.reset();
+
+	for (auto &i : history) {
+		i.clear();
+		i.shrink_to_fit();
+	}
+}
+
+void
+FirPcmResampler::Reset() noexcept
+{
+	/* pretend that the stream was preceded by silence, so the
+	   first output frame is aligned with the first input frame */
+	const size_t n_silence = table->n_taps / 2 - 1;
+	for (unsigned c = 0; c < channels; ++c)
+		history[c].assign(n_silence, 0);
+
+	phase = 0;
+	flushed = false;
+}
+
+ConstBuffer<void>
+FirPcmResampler::Resample(ConstBuffer<void> _src)
+{
+	const auto src = ConstBuffer<float>::FromVoid(_src);
+	assert(src.size % channels == 0);
+
+	const size_t n_frames = src.size / channels;
+
+	/* deinterleave into the history */
+	for (unsigned c = 0; c < channels; ++c) {
+		auto &h = history[c];
+		const size_t old_size = h.size();
+		h.resize(old_size + n_frames);
+
+		float *dest = &h[old_size];
+		for (size_t i = 0; i < n_frames; ++i)
+			dest[i] = src.data[i * channels + c];
+	}
+
+	return Process();
+}
+
+ConstBuffer<void>
+FirPcmResampler::Flush()
+{
+	if (flushed)
+		return nullptr;
+
+	flushed = true;
+
+	/* feed silence until the last input frame has passed the
+	   center of the filter */
+	const size_t n_silence = table->n_taps / 2;
+	for (unsigned c = 0; c < channels; ++c)
+		history[c].resize(history[c].size() + n_silence, 0);
+
+	auto result = Process();
+	if (result.empty())
+		return nullptr;
+
+	return result;
+}
+
+ConstBuffer<void>
+FirPcmResampler::Process() noexcept
+{
+	const FirFilterTable &t = *table;
+	const size_t available = history[0].size();
+	if (available < t.n_taps)
+		return {buffer.Get(0), 0};
+
+	/* count the output frames which can be generated: the
+	   position (i * up + phase) of the last one must not exceed
+	   the last complete window */
+	const uint64_t last = uint64_t(available - t.n_taps) * t.up
+		+ t.up - 1;
+	const size_t n_out = (last - phase) / t.down + 1;
+
+	float *const dest = buffer.GetT<float>(n_out * channels);
+
+	size_t i = 0;
+	unsigned p = phase;
+	for (size_t o = 0; o < n_out; ++o) {
+		float *d = dest + o * channels;
+
+		if (!t.interpolate) {
+			const float *coefficients = t.GetPhase(p);
+			for (unsigned c = 0; c < channels; ++c)
+				d[c] = kernels.dot_float(coefficients,
+							 &history[c][i],
+							 t.n_taps);
+		} else {
+			const uint64_t x = uint64_t(p) * t.n_phases;
+			const unsigned k = x / t.up;
+			const float fraction = float(x % t.up) / t.up;
+			const float *c0 = t.GetPhase(k), *c1 = t.GetPhase(k + 1);
+
+			for (unsigned c = 0; c < channels; ++c) {
+				const float *h = &history[c][i];
+				const float a = kernels.dot_float(c0, h, t.n_taps);
+				const float b = kernels.dot_float(c1, h, t.n_taps);
+				d[c] = a + fraction * (b - a);
+			}
+		}
+
+		p += t.down;
+		i += p / t.up;
+		p %= t.up;
+	}
+
+	phase = p;
+
+	assert(i <= available);
+	for (unsigned c = 0; c < channels; ++c)
+		history[c].erase(history[c].begin(), history[c].begin() + i);
+
+	return ConstBuffer<float>(dest, n_out * channels).ToVoid();
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_FIR_RESAMPLER_HXX
+#define MPD_PCM_FIR_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "PcmBuffer.hxx"
+#include "AudioFormat.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+struct ConfigBlock;
+struct PcmKernels;
+class FirFilterTable;
+
+enum class FirResamplerQuality : uint8_t {
+	LOW,
+	MEDIUM,
+	HIGH,
+	VERY_HIGH,
+};
+
+/**
+ * A polyphase FIR resampler built into MPD.  It uses a
+ * Kaiser-windowed sinc filter; the coefficient table for each
+ * combination of sample rates and quality is calculated once and
+ * shared by all resamplers which need it.
+ *
+ * If the reduced ratio of the two sample rates has a small
+ * numerator (e.g. 160/147 for 44.1 kHz to 48 kHz), the table
+ * contains exactly the needed filter phases.  Otherwise,
+ * coefficients are interpolated between 256 phases.
+ */
+class FirPcmResampler final : public PcmResampler {
+	const FirResamplerQuality quality;
+
+	const PcmKernels &kernels;
+
+	std::shared_ptr<const FirFilterTable> table;
+
+	unsigned channels;
+
+	/**
+	 * The input frames which have not been consumed yet, one
+	 * array for each channel.
+	 */
+	std::array<std::vector<float>, MAX_CHANNELS> history;
+
+	/**
+	 * The fractional input position of the next output frame, in
+	 * units of 1/up of an input frame.
+	 */
+	unsigned phase;
+
+	/**
+	 * Has Flush() already padded the input with silence?
+	 */
+	bool flushed;
+
+	PcmBuffer buffer;
+
+public:
+	explicit FirPcmResampler(FirResamplerQuality _quality) noexcept;
+	~FirPcmResampler() noexcept;
+
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
+	void Close() noexcept override;
+	void Reset() noexcept override;
+	ConstBuffer<void> Resample(ConstBuffer<void> src) override;
+	ConstBuffer<void> Flush() override;
+
+private:
+	ConstBuffer<void> Process() noexcept;
+};
+
+/**
+ * Parse the "fir" resampler settings.
+ *
+ * Throws on error.
+ */
+FirResamplerQuality
+pcm_resample_fir_global_init(const ConfigBlock &block);
+
+#endif
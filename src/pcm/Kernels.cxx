@@ -0,0 +1,176 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Kernels.hxx"
+#include "Clamp.hxx"
+#include "Traits.hxx"
+#include "FloatConvert.hxx"
+#include "ShiftConvert.hxx"
+
+#include <atomic>
+#include <initializer_list>
+
+template<typename C>
+static void
+PortableConvert(typename C::DstTraits::pointer_type gcc_restrict dest,
+		typename C::SrcTraits::const_pointer_type gcc_restrict src,
+		size_t n) noexcept
+{
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = C::Convert(src[i]);
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+PortableAdd(typename Traits::pointer_type a,
+	    typename Traits::const_pointer_type b,
+	    size_t n) noexcept
+{
+	for (size_t i = 0; i != n; ++i) {
+		typename Traits::sum_type sum = a[i];
+		sum += b[i];
+		a[i] = PcmClamp<F, Traits>(sum);
+	}
+}
+
+static void
+PortableVolumeFloat(float *dest, const float *src, size_t n,
+		    float volume) noexcept
+{
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = src[i] * volume;
+}
+
+static void
+PortableAddVolumeFloat(float *a, const float *b, size_t n,
+		       float volume1, float volume2) noexcept
+{
+	for (size_t i = 0; i != n; ++i)
+		a[i] = a[i] * volume1 + b[i] * volume2;
+}
+
+static void
+PortableAddFloat(float *a, const float *b, size_t n) noexcept
+{
+	for (size_t i = 0; i != n; ++i)
+		a[i] += b[i];
+}
+
+static float
+PortableDotFloat(const float *a, const float *b, size_t n) noexcept
+{
+	float sum = 0;
+	for (size_t i = 0; i != n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+const PcmKernels pcm_kernels_portable = {
+	PcmKernelLevel::PORTABLE,
+	PortableVolumeFloat,
+	PortableAddVolumeFloat,
+	PortableAdd<SampleFormat::S16>,
+	PortableAdd<SampleFormat::S24_P32>,
+	PortableAdd<SampleFormat::S32>,
+	PortableAddFloat,
+	PortableConvert<FloatToIntegerSampleConvert<SampleFormat::S16>>,
+	PortableConvert<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>,
+	PortableConvert<FloatToIntegerSampleConvert<SampleFormat::S32>>,
+	PortableConvert<IntegerToFloatSampleConvert<SampleFormat::S16>>,
+	PortableConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>,
+	PortableConvert<IntegerToFloatSampleConvert<SampleFormat::S32>>,
+	PortableConvert<LeftShiftSampleConvert<SampleFormat::S16,
+					       SampleFormat::S24_P32>>,
+	PortableConvert<LeftShiftSampleConvert<SampleFormat::S16,
+					       SampleFormat::S32>>,
+	PortableConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
+					       SampleFormat::S32>>,
+	PortableConvert<RightShiftSampleConvert<SampleFormat::S32,
+						SampleFormat::S24_P32>>,
+	PortableDotFloat,
+};
+
+const PcmKernels *
+GetPcmKernels(PcmKernelLevel level) noexcept
+{
+	switch (level) {
+	case PcmKernelLevel::PORTABLE:
+		return &pcm_kernels_portable;
+
+	case PcmKernelLevel::SSE2:
+#if defined(__x86_64__) || defined(__i386__)
+		if (__builtin_cpu_supports("sse2"))
+			return &pcm_kernels_sse2;
+#endif
+		break;
+
+	case PcmKernelLevel::AVX2:
+#if defined(__x86_64__) || defined(__i386__)
+		if (__builtin_cpu_supports("avx2"))
+			return &pcm_kernels_avx2;
+#endif
+		break;
+
+	case PcmKernelLevel::NEON:
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		return &pcm_kernels_neon;
+#endif
+		break;
+	}
+
+	return nullptr;
+}
+
+static const PcmKernels &
+DetectPcmKernels() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+	/* needed if this is called by a static constructor */
+	__builtin_cpu_init();
+#endif
+
+	for (auto level : {PcmKernelLevel::AVX2, PcmKernelLevel::SSE2,
+			   PcmKernelLevel::NEON}) {
+		const auto *kernels = GetPcmKernels(level);
+		if (kernels != nullptr)
+			return *kernels;
+	}
+
+	return pcm_kernels_portable;
+}
+
+/**
+ * Caches the result of DetectPcmKernels().  This is not a
+ * function-local static, because MPD is compiled with
+ * "-fno-threadsafe-statics"; a race between two threads is harmless
+ * here, because both store the same pointer.
+ */
+static std::atomic<const PcmKernels *> best_kernels{nullptr};
+
+const PcmKernels &
+GetPcmKernels() noexcept
+{
+	const auto *kernels = best_kernels.load(std::memory_order_relaxed);
+	if (gcc_unlikely(kernels == nullptr)) {
+		kernels = &DetectPcmKernels();
+		best_kernels.store(kernels, std::memory_order_relaxed);
+	}
+
+	return *kernels;
+}
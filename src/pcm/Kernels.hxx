@@ -0,0 +1,127 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_KERNELS_HXX
+#define MPD_PCM_KERNELS_HXX
+
+#include "util/Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The instruction set a #PcmKernels table was built for.
+ */
+enum class PcmKernelLevel : uint8_t {
+	PORTABLE,
+	SSE2,
+	AVX2,
+	NEON,
+};
+
+/**
+ * A table of the inner loops of PCM volume, mixing, format
+ * conversion and resampling which do not need dithering.  There is
+ * one table for each instruction set; all of them (except for
+ * dot_float) produce bit-exactly the same output as the portable
+ * implementation.
+ *
+ * Callers should look up the table once (e.g. when opening a
+ * filter) with GetPcmKernels() and then call through the function
+ * pointers.  The arrays may be unaligned; "dest" may be equal to
+ * "src", but the arrays must not overlap otherwise.
+ */
+struct PcmKernels {
+	PcmKernelLevel level;
+
+	/**
+	 * dest[i] = src[i] * volume
+	 */
+	void (*volume_float)(float *dest, const float *src, size_t n,
+			     float volume);
+
+	/**
+	 * a[i] = a[i] * volume1 + b[i] * volume2
+	 */
+	void (*add_volume_float)(float *a, const float *b, size_t n,
+				 float volume1, float volume2);
+
+	/**
+	 * a[i] = a[i] + b[i], clipping integer samples at the limits
+	 * of the sample format.
+	 */
+	void (*add_16)(int16_t *a, const int16_t *b, size_t n);
+	void (*add_24)(int32_t *a, const int32_t *b, size_t n);
+	void (*add_32)(int32_t *a, const int32_t *b, size_t n);
+	void (*add_float)(float *a, const float *b, size_t n);
+
+	void (*float_to_16)(int16_t *dest, const float *src, size_t n);
+	void (*float_to_24)(int32_t *dest, const float *src, size_t n);
+	void (*float_to_32)(int32_t *dest, const float *src, size_t n);
+
+	void (*s16_to_float)(float *dest, const int16_t *src, size_t n);
+	void (*s24_to_float)(float *dest, const int32_t *src, size_t n);
+	void (*s32_to_float)(float *dest, const int32_t *src, size_t n);
+
+	void (*s16_to_24)(int32_t *dest, const int16_t *src, size_t n);
+	void (*s16_to_32)(int32_t *dest, const int16_t *src, size_t n);
+	void (*s24_to_32)(int32_t *dest, const int32_t *src, size_t n);
+	void (*s32_to_24)(int32_t *dest, const int32_t *src, size_t n);
+
+	/**
+	 * Returns the sum of a[i] * b[i].  This is the only function
+	 * which is not bit-exact: the vectorized versions add in a
+	 * different order, so the result may differ from the portable
+	 * one by a rounding error.
+	 */
+	float (*dot_float)(const float *a, const float *b, size_t n);
+};
+
+/**
+ * The reference implementation, written in portable C++.  The
+ * optimized tables use it for the trailing samples which do not
+ * fill a whole vector.
+ */
+extern const PcmKernels pcm_kernels_portable;
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const PcmKernels pcm_kernels_sse2;
+extern const PcmKernels pcm_kernels_avx2;
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+extern const PcmKernels pcm_kernels_neon;
+#endif
+
+/**
+ * Returns the table for the given instruction set, or nullptr if
+ * it was not compiled in or is not supported by this CPU.
+ */
+gcc_pure
+const PcmKernels *
+GetPcmKernels(PcmKernelLevel level) noexcept;
+
+/**
+ * Returns the best table supported by this CPU.
+ */
+gcc_pure
+const PcmKernels &
+GetPcmKernels() noexcept;
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * AVX2 implementations of the #PcmKernels; see KernelsSse2.cxx for
+ * an explanation of the tricks used for bit-exact results.
+ */
+
+#include "Kernels.hxx"
+
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static constexpr size_t FLOATS = sizeof(__m256) / sizeof(float);
+static constexpr size_t INT16S = sizeof(__m256i) / sizeof(int16_t);
+static constexpr size_t INT32S = sizeof(__m256i) / sizeof(int32_t);
+
+AVX2_TARGET
+static inline __m256
+LoadFloat(const float *p) noexcept
+{
+	return _mm256_loadu_ps(p);
+}
+
+AVX2_TARGET
+static inline __m256i
+LoadInt(const void *p) noexcept
+{
+	return _mm256_loadu_si256((const __m256i *)p);
+}
+
+AVX2_TARGET
+static inline void
+StoreInt(void *p, __m256i v) noexcept
+{
+	_mm256_storeu_si256((__m256i *)p, v);
+}
+
+/**
+ * Load 8 16 bit integers and sign-extend them to 32 bit.
+ */
+AVX2_TARGET
+static inline __m256i
+LoadWiden16(const int16_t *p) noexcept
+{
+	return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p));
+}
+
+AVX2_TARGET
+static void
+Avx2VolumeFloat(float *dest, const float *src, size_t n,
+		float volume) noexcept
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(LoadFloat(src + i), v));
+
+	pcm_kernels_portable.volume_float(dest + i, src + i, n - i, volume);
+}
+
+AVX2_TARGET
+static void
+Avx2AddVolumeFloat(float *a, const float *b, size_t n,
+		   float volume1, float volume2) noexcept
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	/* no FMA here: the scalar code rounds after each
+	   multiplication */
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm256_storeu_ps(a + i,
+				 _mm256_add_ps(_mm256_mul_ps(LoadFloat(a + i), v1),
+					       _mm256_mul_ps(LoadFloat(b + i), v2)));
+
+	pcm_kernels_portable.add_volume_float(a + i, b + i, n - i,
+					      volume1, volume2);
+}
+
+AVX2_TARGET
+static void
+Avx2Add16(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S)
+		StoreInt(a + i, _mm256_adds_epi16(LoadInt(a + i),
+						  LoadInt(b + i)));
+
+	pcm_kernels_portable.add_16(a + i, b + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2Add24(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const __m256i min = _mm256_set1_epi32(-0x800000);
+	const __m256i max = _mm256_set1_epi32(0x7fffff);
+
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S) {
+		const __m256i sum = _mm256_add_epi32(LoadInt(a + i),
+						     LoadInt(b + i));
+		StoreInt(a + i,
+			 _mm256_max_epi32(_mm256_min_epi32(sum, max), min));
+	}
+
+	pcm_kernels_portable.add_24(a + i, b + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2Add32(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const __m256i max = _mm256_set1_epi32(0x7fffffff);
+
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S) {
+		const __m256i x = LoadInt(a + i), y = LoadInt(b + i);
+		const __m256i sum = _mm256_add_epi32(x, y);
+		const __m256i overflow =
+			_mm256_and_si256(_mm256_xor_si256(x, sum),
+					 _mm256_xor_si256(y, sum));
+		const __m256i saturated =
+			_mm256_xor_si256(_mm256_srai_epi32(x, 31), max);
+
+		/* blendv selects by the sign bit only */
+		StoreInt(a + i,
+			 _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(sum),
+							      _mm256_castsi256_ps(saturated),
+							      _mm256_castsi256_ps(overflow))));
+	}
+
+	pcm_kernels_portable.add_32(a + i, b + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2AddFloat(float *a, const float *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm256_storeu_ps(a + i, _mm256_add_ps(LoadFloat(a + i),
+						      LoadFloat(b + i)));
+
+	pcm_kernels_portable.add_float(a + i, b + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2FloatTo16(int16_t *dest, const float *src, size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(32768);
+
+	size_t i = 0;
+	for (; i + 2 * FLOATS <= n; i += 2 * FLOATS) {
+		const __m256i lo =
+			_mm256_cvttps_epi32(_mm256_mul_ps(LoadFloat(src + i),
+							  factor));
+		const __m256i hi =
+			_mm256_cvttps_epi32(_mm256_mul_ps(LoadFloat(src + i + FLOATS),
+							  factor));
+
+		/* _mm256_packs_epi32() works on each 128 bit lane
+		   separately; restore the sample order */
+		StoreInt(dest + i,
+			 _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi),
+						  _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	pcm_kernels_portable.float_to_16(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2FloatTo24(int32_t *dest, const float *src, size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(0x800000);
+	const __m256 min = _mm256_set1_ps(-0x800000);
+	const __m256 max = _mm256_set1_ps(0x7fffff);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS) {
+		__m256 v = _mm256_mul_ps(LoadFloat(src + i), factor);
+		v = _mm256_min_ps(_mm256_max_ps(v, min), max);
+		StoreInt(dest + i, _mm256_cvttps_epi32(v));
+	}
+
+	pcm_kernels_portable.float_to_24(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2FloatTo32(int32_t *dest, const float *src, size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(2147483648.f);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS) {
+		const __m256 v = _mm256_mul_ps(LoadFloat(src + i), factor);
+		const __m256i too_large =
+			_mm256_castps_si256(_mm256_cmp_ps(v, factor,
+							  _CMP_GE_OQ));
+		StoreInt(dest + i, _mm256_xor_si256(_mm256_cvttps_epi32(v),
+						    too_large));
+	}
+
+	pcm_kernels_portable.float_to_32(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2S16ToFloat(float *dest, const int16_t *src, size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(1.f / 32768);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(LoadWiden16(src + i)),
+					       factor));
+
+	pcm_kernels_portable.s16_to_float(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static inline void
+Int32ToFloat(float *dest, const int32_t *src, size_t n,
+	     __m256 factor) noexcept
+{
+	for (size_t i = 0; i != n; i += FLOATS)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(LoadInt(src + i)),
+					       factor));
+}
+
+AVX2_TARGET
+static void
+Avx2S24ToFloat(float *dest, const int32_t *src, size_t n) noexcept
+{
+	const size_t done = n - n % FLOATS;
+	Int32ToFloat(dest, src, done, _mm256_set1_ps(1.f / 0x800000));
+	pcm_kernels_portable.s24_to_float(dest + done, src + done, n - done);
+}
+
+AVX2_TARGET
+static void
+Avx2S32ToFloat(float *dest, const int32_t *src, size_t n) noexcept
+{
+	const size_t done = n - n % FLOATS;
+	Int32ToFloat(dest, src, done, _mm256_set1_ps(1.f / 2147483648.f));
+	pcm_kernels_portable.s32_to_float(dest + done, src + done, n - done);
+}
+
+AVX2_TARGET
+static void
+Avx2S16To24(int32_t *dest, const int16_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(dest + i, _mm256_slli_epi32(LoadWiden16(src + i), 8));
+
+	pcm_kernels_portable.s16_to_24(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2S16To32(int32_t *dest, const int16_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(dest + i, _mm256_slli_epi32(LoadWiden16(src + i), 16));
+
+	pcm_kernels_portable.s16_to_32(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2S24To32(int32_t *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(dest + i, _mm256_slli_epi32(LoadInt(src + i), 8));
+
+	pcm_kernels_portable.s24_to_32(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static void
+Avx2S32To24(int32_t *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(dest + i, _mm256_srai_epi32(LoadInt(src + i), 8));
+
+	pcm_kernels_portable.s32_to_24(dest + i, src + i, n - i);
+}
+
+AVX2_TARGET
+static float
+Avx2DotFloat(const float *a, const float *b, size_t n) noexcept
+{
+	/* two accumulators hide the latency of the addition; no FMA,
+	   because not all AVX2 CPUs have it */
+	__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 2 * FLOATS <= n; i += 2 * FLOATS) {
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(LoadFloat(a + i),
+							 LoadFloat(b + i)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(LoadFloat(a + i + FLOATS),
+							 LoadFloat(b + i + FLOATS)));
+	}
+
+	for (; i + FLOATS <= n; i += FLOATS)
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(LoadFloat(a + i),
+							 LoadFloat(b + i)));
+
+	sum0 = _mm256_add_ps(sum0, sum1);
+
+	/* horizontal sum */
+	__m128 v = _mm_add_ps(_mm256_castps256_ps128(sum0),
+			      _mm256_extractf128_ps(sum0, 1));
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+
+	return _mm_cvtss_f32(v) +
+		pcm_kernels_portable.dot_float(a + i, b + i, n - i);
+}
+
+const PcmKernels pcm_kernels_avx2 = {
+	PcmKernelLevel::AVX2,
+	Avx2VolumeFloat,
+	Avx2AddVolumeFloat,
+	Avx2Add16,
+	Avx2Add24,
+	Avx2Add32,
+	Avx2AddFloat,
+	Avx2FloatTo16,
+	Avx2FloatTo24,
+	Avx2FloatTo32,
+	Avx2S16ToFloat,
+	Avx2S24ToFloat,
+	Avx2S32ToFloat,
+	Avx2S16To24,
+	Avx2S16To32,
+	Avx2S24To32,
+	Avx2S32To24,
+	Avx2DotFloat,
+};
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * ARM NEON implementations of the #PcmKernels.  NEON is selected at
+ * compile time (it is always available on AArch64, and on 32 bit
+ * ARM only if the compiler was told so with "-mfpu=neon").
+ *
+ * Note that 32 bit ARM NEON flushes denormal floating point values
+ * to zero; those are far below the resolution of any integer sample
+ * format.
+ */
+
+#include "Kernels.hxx"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+static constexpr size_t FLOATS = 4;
+static constexpr size_t INT16S = 8;
+static constexpr size_t INT32S = 4;
+
+static void
+NeonVolumeFloat(float *dest, const float *src, size_t n,
+		float volume) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		vst1q_f32(dest + i, vmulq_n_f32(vld1q_f32(src + i), volume));
+
+	pcm_kernels_portable.volume_float(dest + i, src + i, n - i, volume);
+}
+
+static void
+NeonAddVolumeFloat(float *a, const float *b, size_t n,
+		   float volume1, float volume2) noexcept
+{
+	/* no NEON version: the compiler may contract the scalar
+	   code to fused multiply-add instructions, which round
+	   differently */
+	pcm_kernels_portable.add_volume_float(a, b, n, volume1, volume2);
+}
+
+static void
+NeonAdd16(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S)
+		vst1q_s16(a + i, vqaddq_s16(vld1q_s16(a + i),
+					    vld1q_s16(b + i)));
+
+	pcm_kernels_portable.add_16(a + i, b + i, n - i);
+}
+
+static void
+NeonAdd24(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const int32x4_t min = vdupq_n_s32(-0x800000);
+	const int32x4_t max = vdupq_n_s32(0x7fffff);
+
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S) {
+		const int32x4_t sum = vaddq_s32(vld1q_s32(a + i),
+						vld1q_s32(b + i));
+		vst1q_s32(a + i, vmaxq_s32(vminq_s32(sum, max), min));
+	}
+
+	pcm_kernels_portable.add_24(a + i, b + i, n - i);
+}
+
+static void
+NeonAdd32(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		vst1q_s32(a + i, vqaddq_s32(vld1q_s32(a + i),
+					    vld1q_s32(b + i)));
+
+	pcm_kernels_portable.add_32(a + i, b + i, n - i);
+}
+
+static void
+NeonAddFloat(float *a, const float *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		vst1q_f32(a + i, vaddq_f32(vld1q_f32(a + i),
+					   vld1q_f32(b + i)));
+
+	pcm_kernels_portable.add_float(a + i, b + i, n - i);
+}
+
+/*
+ * vcvtq_s32_f32() truncates and saturates, just like the scalar
+ * float-to-integer conversion on ARM.
+ */
+
+static void
+NeonFloatTo16(int16_t *dest, const float *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S) {
+		const int32x4_t lo =
+			vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 32768));
+		const int32x4_t hi =
+			vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + FLOATS),
+						  32768));
+		vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(lo),
+						 vqmovn_s32(hi)));
+	}
+
+	pcm_kernels_portable.float_to_16(dest + i, src + i, n - i);
+}
+
+static void
+NeonFloatTo24(int32_t *dest, const float *src, size_t n) noexcept
+{
+	const int32x4_t min = vdupq_n_s32(-0x800000);
+	const int32x4_t max = vdupq_n_s32(0x7fffff);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS) {
+		const int32x4_t v =
+			vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(src + i),
+						  0x800000));
+		vst1q_s32(dest + i, vmaxq_s32(vminq_s32(v, max), min));
+	}
+
+	pcm_kernels_portable.float_to_24(dest + i, src + i, n - i);
+}
+
+static void
+NeonFloatTo32(int32_t *dest, const float *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		vst1q_s32(dest + i,
+			  vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(src + i),
+						    2147483648.f)));
+
+	pcm_kernels_portable.float_to_32(dest + i, src + i, n - i);
+}
+
+static void
+NeonS16ToFloat(float *dest, const int16_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS) {
+		const int32x4_t v = vmovl_s16(vld1_s16(src + i));
+		vst1q_f32(dest + i,
+			  vmulq_n_f32(vcvtq_f32_s32(v), 1.f / 32768));
+	}
+
+	pcm_kernels_portable.s16_to_float(dest + i, src + i, n - i);
+}
+
+static void
+NeonS24ToFloat(float *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		vst1q_f32(dest + i,
+			  vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)),
+				      1.f / 0x800000));
+
+	pcm_kernels_portable.s24_to_float(dest + i, src + i, n - i);
+}
+
+static void
+NeonS32ToFloat(float *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		vst1q_f32(dest + i,
+			  vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)),
+				      1.f / 2147483648.f));
+
+	pcm_kernels_portable.s32_to_float(dest + i, src + i, n - i);
+}
+
+static void
+NeonS16To24(int32_t *dest, const int16_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		vst1q_s32(dest + i,
+			  vshlq_n_s32(vmovl_s16(vld1_s16(src + i)), 8));
+
+	pcm_kernels_portable.s16_to_24(dest + i, src + i, n - i);
+}
+
+static void
+NeonS16To32(int32_t *dest, const int16_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		vst1q_s32(dest + i,
+			  vshlq_n_s32(vmovl_s16(vld1_s16(src + i)), 16));
+
+	pcm_kernels_portable.s16_to_32(dest + i, src + i, n - i);
+}
+
+static void
+NeonS24To32(int32_t *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		vst1q_s32(dest + i, vshlq_n_s32(vld1q_s32(src + i), 8));
+
+	pcm_kernels_portable.s24_to_32(dest + i, src + i, n - i);
+}
+
+static void
+NeonS32To24(int32_t *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		vst1q_s32(dest + i, vshrq_n_s32(vld1q_s32(src + i), 8));
+
+	pcm_kernels_portable.s32_to_24(dest + i, src + i, n - i);
+}
+
+static float
+NeonDotFloat(const float *a, const float *b, size_t n) noexcept
+{
+	float32x4_t sum = vdupq_n_f32(0);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+
+	const float32x2_t s = vadd_f32(vget_low_f32(sum),
+				       vget_high_f32(sum));
+
+	return vget_lane_f32(vpadd_f32(s, s), 0) +
+		pcm_kernels_portable.dot_float(a + i, b + i, n - i);
+}
+
+const PcmKernels pcm_kernels_neon = {
+	PcmKernelLevel::NEON,
+	NeonVolumeFloat,
+	NeonAddVolumeFloat,
+	NeonAdd16,
+	NeonAdd24,
+	NeonAdd32,
+	NeonAddFloat,
+	NeonFloatTo16,
+	NeonFloatTo24,
+	NeonFloatTo32,
+	NeonS16ToFloat,
+	NeonS24ToFloat,
+	NeonS32ToFloat,
+	NeonS16To24,
+	NeonS16To32,
+	NeonS24To32,
+	NeonS32To24,
+	NeonDotFloat,
+};
+
+#endif
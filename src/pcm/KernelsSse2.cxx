@@ -0,0 +1,413 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * SSE2 implementations of the #PcmKernels.  The functions are
+ * compiled with a "target" attribute, so this file does not need
+ * special compiler flags even on 32 bit x86; GetPcmKernels() checks
+ * whether the CPU supports the instruction set.
+ */
+
+#include "Kernels.hxx"
+
+#include <emmintrin.h>
+
+#define SSE2_TARGET __attribute__((target("sse2")))
+
+static constexpr size_t FLOATS = sizeof(__m128) / sizeof(float);
+static constexpr size_t INT16S = sizeof(__m128i) / sizeof(int16_t);
+static constexpr size_t INT32S = sizeof(__m128i) / sizeof(int32_t);
+
+SSE2_TARGET
+static inline __m128
+LoadFloat(const float *p) noexcept
+{
+	return _mm_loadu_ps(p);
+}
+
+SSE2_TARGET
+static inline __m128i
+LoadInt(const void *p) noexcept
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+SSE2_TARGET
+static inline void
+StoreInt(void *p, __m128i v) noexcept
+{
+	_mm_storeu_si128((__m128i *)p, v);
+}
+
+/**
+ * Select "a" where the mask is set, "b" otherwise.
+ */
+SSE2_TARGET
+static inline __m128i
+Select(__m128i mask, __m128i a, __m128i b) noexcept
+{
+	return _mm_or_si128(_mm_and_si128(mask, a),
+			    _mm_andnot_si128(mask, b));
+}
+
+/**
+ * Sign-extend the given 8 16 bit integers to two vectors of 32 bit
+ * integers.
+ */
+SSE2_TARGET
+static inline void
+Widen16(__m128i v, __m128i &lo, __m128i &hi) noexcept
+{
+	lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+
+SSE2_TARGET
+static void
+Sse2VolumeFloat(float *dest, const float *src, size_t n,
+		float volume) noexcept
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm_storeu_ps(dest + i, _mm_mul_ps(LoadFloat(src + i), v));
+
+	pcm_kernels_portable.volume_float(dest + i, src + i, n - i, volume);
+}
+
+SSE2_TARGET
+static void
+Sse2AddVolumeFloat(float *a, const float *b, size_t n,
+		   float volume1, float volume2) noexcept
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm_storeu_ps(a + i,
+			      _mm_add_ps(_mm_mul_ps(LoadFloat(a + i), v1),
+					 _mm_mul_ps(LoadFloat(b + i), v2)));
+
+	pcm_kernels_portable.add_volume_float(a + i, b + i, n - i,
+					      volume1, volume2);
+}
+
+SSE2_TARGET
+static void
+Sse2Add16(int16_t *a, const int16_t *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S)
+		StoreInt(a + i, _mm_adds_epi16(LoadInt(a + i),
+					       LoadInt(b + i)));
+
+	pcm_kernels_portable.add_16(a + i, b + i, n - i);
+}
+
+/**
+ * Clamp 32 bit integers to the given range (SSE2 has no
+ * _mm_min_epi32()).
+ */
+SSE2_TARGET
+static inline __m128i
+Clamp32(__m128i v, __m128i min, __m128i max) noexcept
+{
+	v = Select(_mm_cmpgt_epi32(v, max), max, v);
+	return Select(_mm_cmplt_epi32(v, min), min, v);
+}
+
+SSE2_TARGET
+static void
+Sse2Add24(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const __m128i min = _mm_set1_epi32(-0x800000);
+	const __m128i max = _mm_set1_epi32(0x7fffff);
+
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(a + i, Clamp32(_mm_add_epi32(LoadInt(a + i),
+						      LoadInt(b + i)),
+					min, max));
+
+	pcm_kernels_portable.add_24(a + i, b + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2Add32(int32_t *a, const int32_t *b, size_t n) noexcept
+{
+	const __m128i max = _mm_set1_epi32(0x7fffffff);
+
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S) {
+		const __m128i x = LoadInt(a + i), y = LoadInt(b + i);
+		const __m128i sum = _mm_add_epi32(x, y);
+
+		/* the addition has overflowed if the sign of the
+		   result differs from the sign of both operands; the
+		   saturated value is then INT32_MAX for positive and
+		   INT32_MIN for negative operands */
+		const __m128i overflow =
+			_mm_srai_epi32(_mm_and_si128(_mm_xor_si128(x, sum),
+						     _mm_xor_si128(y, sum)),
+				       31);
+		const __m128i saturated =
+			_mm_xor_si128(_mm_srai_epi32(x, 31), max);
+
+		StoreInt(a + i, Select(overflow, saturated, sum));
+	}
+
+	pcm_kernels_portable.add_32(a + i, b + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2AddFloat(float *a, const float *b, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS)
+		_mm_storeu_ps(a + i, _mm_add_ps(LoadFloat(a + i),
+						LoadFloat(b + i)));
+
+	pcm_kernels_portable.add_float(a + i, b + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2FloatTo16(int16_t *dest, const float *src, size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(32768);
+
+	/* out-of-range values are converted to INT32_MIN by
+	   _mm_cvttps_epi32(), just like the scalar conversion, and
+	   _mm_packs_epi32() does the clamping */
+	size_t i = 0;
+	for (; i + 2 * FLOATS <= n; i += 2 * FLOATS) {
+		const __m128i lo =
+			_mm_cvttps_epi32(_mm_mul_ps(LoadFloat(src + i),
+						    factor));
+		const __m128i hi =
+			_mm_cvttps_epi32(_mm_mul_ps(LoadFloat(src + i + FLOATS),
+						    factor));
+		StoreInt(dest + i, _mm_packs_epi32(lo, hi));
+	}
+
+	pcm_kernels_portable.float_to_16(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2FloatTo24(int32_t *dest, const float *src, size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(0x800000);
+	const __m128 min = _mm_set1_ps(-0x800000), max = _mm_set1_ps(0x7fffff);
+
+	/* clamp before converting; the limits are integers, so
+	   this is equivalent to clamping the integer, and
+	   _mm_max_ps() maps NaN to the minimum like the scalar
+	   code does */
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS) {
+		__m128 v = _mm_mul_ps(LoadFloat(src + i), factor);
+		v = _mm_min_ps(_mm_max_ps(v, min), max);
+		StoreInt(dest + i, _mm_cvttps_epi32(v));
+	}
+
+	pcm_kernels_portable.float_to_24(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2FloatTo32(int32_t *dest, const float *src, size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(2147483648.f);
+
+	/* _mm_cvttps_epi32() returns INT32_MIN for values which are
+	   too large; flip all bits of those to get INT32_MAX */
+	size_t i = 0;
+	for (; i + FLOATS <= n; i += FLOATS) {
+		const __m128 v = _mm_mul_ps(LoadFloat(src + i), factor);
+		const __m128i too_large =
+			_mm_castps_si128(_mm_cmpge_ps(v, factor));
+		StoreInt(dest + i, _mm_xor_si128(_mm_cvttps_epi32(v),
+						 too_large));
+	}
+
+	pcm_kernels_portable.float_to_32(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2S16ToFloat(float *dest, const int16_t *src, size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(1.f / 32768);
+
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S) {
+		__m128i lo, hi;
+		Widen16(LoadInt(src + i), lo, hi);
+		_mm_storeu_ps(dest + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(lo), factor));
+		_mm_storeu_ps(dest + i + FLOATS,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), factor));
+	}
+
+	pcm_kernels_portable.s16_to_float(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static inline void
+Int32ToFloat(float *dest, const int32_t *src, size_t n,
+	     __m128 factor) noexcept
+{
+	for (size_t i = 0; i != n; i += FLOATS)
+		_mm_storeu_ps(dest + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(LoadInt(src + i)),
+					 factor));
+}
+
+SSE2_TARGET
+static void
+Sse2S24ToFloat(float *dest, const int32_t *src, size_t n) noexcept
+{
+	const size_t done = n - n % FLOATS;
+	Int32ToFloat(dest, src, done, _mm_set1_ps(1.f / 0x800000));
+	pcm_kernels_portable.s24_to_float(dest + done, src + done, n - done);
+}
+
+SSE2_TARGET
+static void
+Sse2S32ToFloat(float *dest, const int32_t *src, size_t n) noexcept
+{
+	const size_t done = n - n % FLOATS;
+	Int32ToFloat(dest, src, done, _mm_set1_ps(1.f / 2147483648.f));
+	pcm_kernels_portable.s32_to_float(dest + done, src + done, n - done);
+}
+
+SSE2_TARGET
+static void
+Sse2S16To24(int32_t *dest, const int16_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S) {
+		__m128i lo, hi;
+		Widen16(LoadInt(src + i), lo, hi);
+		StoreInt(dest + i, _mm_slli_epi32(lo, 8));
+		StoreInt(dest + i + INT32S, _mm_slli_epi32(hi, 8));
+	}
+
+	pcm_kernels_portable.s16_to_24(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2S16To32(int32_t *dest, const int16_t *src, size_t n) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	/* interleaving with zeroes moves each sample to the upper
+	   half of a 32 bit integer */
+	size_t i = 0;
+	for (; i + INT16S <= n; i += INT16S) {
+		const __m128i v = LoadInt(src + i);
+		StoreInt(dest + i, _mm_unpacklo_epi16(zero, v));
+		StoreInt(dest + i + INT32S, _mm_unpackhi_epi16(zero, v));
+	}
+
+	pcm_kernels_portable.s16_to_32(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2S24To32(int32_t *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(dest + i, _mm_slli_epi32(LoadInt(src + i), 8));
+
+	pcm_kernels_portable.s24_to_32(dest + i, src + i, n - i);
+}
+
+SSE2_TARGET
+static void
+Sse2S32To24(int32_t *dest, const int32_t *src, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + INT32S <= n; i += INT32S)
+		StoreInt(dest + i, _mm_srai_epi32(LoadInt(src + i), 8));
+
+	pcm_kernels_portable.s32_to_24(dest + i, src + i, n - i);
+}
+
+/**
+ * Returns the sum of the four floats in the vector.
+ */
+SSE2_TARGET
+static inline float
+HorizontalSum(__m128 v) noexcept
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+SSE2_TARGET
+static float
+Sse2DotFloat(const float *a, const float *b, size_t n) noexcept
+{
+	/* two accumulators hide the latency of the addition */
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 2 * FLOATS <= n; i += 2 * FLOATS) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(LoadFloat(a + i),
+						   LoadFloat(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(LoadFloat(a + i + FLOATS),
+						   LoadFloat(b + i + FLOATS)));
+	}
+
+	for (; i + FLOATS <= n; i += FLOATS)
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(LoadFloat(a + i),
+						   LoadFloat(b + i)));
+
+	return HorizontalSum(_mm_add_ps(sum0, sum1)) +
+		pcm_kernels_portable.dot_float(a + i, b + i, n - i);
+}
+
+const PcmKernels pcm_kernels_sse2 = {
+	PcmKernelLevel::SSE2,
+	Sse2VolumeFloat,
+	Sse2AddVolumeFloat,
+	Sse2Add16,
+	Sse2Add24,
+	Sse2Add32,
+	Sse2AddFloat,
+	Sse2FloatTo16,
+	Sse2FloatTo24,
+	Sse2FloatTo32,
+	Sse2S16ToFloat,
+	Sse2S24ToFloat,
+	Sse2S32ToFloat,
+	Sse2S16To24,
+	Sse2S16To32,
+	Sse2S24To32,
+	Sse2S32To24,
+	Sse2DotFloat,
+};
@@ -20,6 +20,7 @@
 #include "PcmConvert.hxx"
 #include "ConfiguredResampler.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
 
 #include <assert.h>
 
@@ -44,16 +45,22 @@ PcmConvert::~PcmConvert() noexcept
 }
 
 void
-PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format)
+PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format,
+		 gcc_unused unsigned dsd_threads)
 {
 	assert(!src_format.IsValid());
 	assert(!dest_format.IsValid());
 	assert(_src_format.IsValid());
 	assert(_dest_format.IsValid());
+	assert(dsd_threads > 0);
 
 	AudioFormat format = _src_format;
-	if (format.format == SampleFormat::DSD)
+	if (format.format == SampleFormat::DSD) {
+#ifdef ENABLE_DSD
+		dsd.SetThreads(dsd_threads);
+#endif
 		format.format = SampleFormat::FLOAT;
+	}
 
 	enable_resampler = format.sample_rate != _dest_format.sample_rate;
 	if (enable_resampler) {
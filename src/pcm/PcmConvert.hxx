@@ -59,8 +59,12 @@ public:
 	 * Prepare the object.  Call Close() when done.
 	 *
 	 * Throws std::runtime_error on error.
+	 *
+	 * @param dsd_threads the number of threads used for
+	 * converting DSD to PCM
 	 */
-	void Open(AudioFormat _src_format, AudioFormat _dest_format);
+	void Open(AudioFormat _src_format, AudioFormat _dest_format,
+		  unsigned dsd_threads=1);
 
 	/**
 	 * Close the object after it was prepared with Open().  After
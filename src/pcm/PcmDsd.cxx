@@ -18,29 +18,216 @@
  */
 
 #include "PcmDsd.hxx"
-#include "dsd2pcm/dsd2pcm.h"
+#include "thread/WorkerPool.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <algorithm>
 
 #include <assert.h>
+#include <string.h>
+
+static constexpr size_t HTAPS = 48;
+
+/**
+ * The number of lookup tables for each half of the filter; each one
+ * covers 8 taps, i.e. one input byte.
+ */
+static constexpr size_t CTABLES = HTAPS / 8;
+
+static_assert(PcmDsd::HISTORY == CTABLES * 2 - 1, "Wrong HISTORY");
+
+/**
+ * The minimum number of frames per job; smaller buffers are not
+ * worth the overhead of waking up a worker thread.
+ */
+static constexpr size_t MIN_FRAMES_PER_JOB = 2048;
+
+/**
+ * The 2nd half (48 coeffs) of a 96-tap symmetric lowpass filter,
+ * taken from the dsd2pcm library by Sebastian Gesemann.
+ */
+static constexpr double htaps[HTAPS] = {
+	0.09950731974056658,
+	0.09562845727714668,
+	0.08819647126516944,
+	0.07782552527068175,
+	0.06534876523171299,
+	0.05172629311427257,
+	0.0379429484910187,
+	0.02490921351762261,
+	0.0133774746265897,
+	0.003883043418804416,
+	-0.003284703416210726,
+	-0.008080250212687497,
+	-0.01067241812471033,
+	-0.01139427235000863,
+	-0.0106813877974587,
+	-0.009007905078766049,
+	-0.006828859761015335,
+	-0.004535184322001496,
+	-0.002425035959059578,
+	-0.0006922187080790708,
+	0.0005700762133516592,
+	0.001353838005269448,
+	0.001713709169690937,
+	0.001742046839472948,
+	0.001545601648013235,
+	0.001226696225277855,
+	0.0008704322683580222,
+	0.0005381636200535649,
+	0.000266446345425276,
+	7.002968738383528e-05,
+	-5.279407053811266e-05,
+	-0.0001140625650874684,
+	-0.0001304796361231895,
+	-0.0001189970287491285,
+	-9.396247155265073e-05,
+	-6.577634378272832e-05,
+	-4.07492895872535e-05,
+	-2.17407957554587e-05,
+	-9.163058931391722e-06,
+	-2.017460145032201e-06,
+	1.249721855219005e-06,
+	2.166655190537392e-06,
+	1.930520892991082e-06,
+	1.319400334374195e-06,
+	7.410039764949091e-07,
+	3.423230509967409e-07,
+	1.244182214744588e-07,
+	3.130441005359396e-08,
+};
+
+struct DsdTables {
+	/**
+	 * The sum of the 8 taps of table i for the given input byte
+	 * (most significant bit first), for the newer half of the
+	 * filter.
+	 */
+	float direct[CTABLES][256];
+
+	/**
+	 * Like #direct, but indexed with the bit-reversed byte, for
+	 * the older (mirrored) half of the filter.  dsd2pcm reverses
+	 * the bytes in its FIFO instead.
+	 */
+	float reversed[CTABLES][256];
+};
+
+static constexpr unsigned
+BitReverse(unsigned x) noexcept
+{
+	unsigned result = 0;
+	for (unsigned i = 0; i < 8; ++i)
+		if (x & (1u << i))
+			result |= 0x80u >> i;
+	return result;
+}
+
+/**
+ * Generate the lookup tables exactly like dsd2pcm's precalc()
+ * function does.
+ */
+static constexpr DsdTables
+GenerateDsdTables() noexcept
+{
+	DsdTables t{};
+
+	for (size_t i = 0; i < CTABLES; ++i) {
+		const size_t first_tap = (CTABLES - 1 - i) * 8;
+		for (unsigned e = 0; e < 256; ++e) {
+			double acc = 0;
+			for (unsigned m = 0; m < 8; ++m)
+				acc += (int((e >> (7 - m)) & 1) * 2 - 1)
+					* htaps[first_tap + m];
+			t.direct[i][e] = float(acc);
+		}
+	}
+
+	for (size_t i = 0; i < CTABLES; ++i)
+		for (unsigned e = 0; e < 256; ++e)
+			t.reversed[i][e] = t.direct[i][BitReverse(e)];
+
+	return t;
+}
+
+static constexpr DsdTables dsd_tables = GenerateDsdTables();
+
+/**
+ * Calculate one output sample.
+ *
+ * @param p the newest input byte; older bytes are at negative
+ * multiples of #stride
+ */
+gcc_always_inline
+static inline float
+DsdFir(const uint8_t *p, size_t stride) noexcept
+{
+	double acc = 0;
+	for (size_t i = 0; i < CTABLES; ++i)
+		acc += dsd_tables.direct[i][p[-ptrdiff_t(i * stride)]] +
+			dsd_tables.reversed[i][p[-ptrdiff_t((PcmDsd::HISTORY - i) * stride)]];
+	return float(acc);
+}
 
 PcmDsd::PcmDsd() noexcept
 {
-	dsd2pcm.fill(nullptr);
+	Reset();
 }
 
-PcmDsd::~PcmDsd() noexcept
+PcmDsd::~PcmDsd() noexcept = default;
+
+void
+PcmDsd::SetThreads(unsigned _n_threads)
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_destroy(i);
+	assert(_n_threads > 0);
+	assert(_n_threads <= MAX_THREADS);
+
+	if (_n_threads == n_threads)
+		return;
+
+	pool.reset();
+	n_threads = 1;
+
+	if (_n_threads > 1)
+		pool = std::make_unique<WorkerPool>("dsd", _n_threads - 1);
+
+	n_threads = _n_threads;
 }
 
 void
 PcmDsd::Reset() noexcept
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_reset(i);
+	/* this emulates dsd2pcm_reset(), which fills the FIFO with
+	   the silence pattern 0x69; dsd2pcm reverses each byte when
+	   it moves to the older half of the filter, but the bytes
+	   which are already there after a reset are not reversed */
+
+	for (auto &w : windows) {
+		std::fill_n(w.begin(), CTABLES - 1, BitReverse(0x69));
+		std::fill_n(w.begin() + CTABLES - 1, CTABLES, 0x69);
+	}
+}
+
+void
+PcmDsd::ConvertFrames(const uint8_t *src, unsigned channels,
+		      size_t start, size_t end,
+		      float *dest) const noexcept
+{
+	size_t n = start;
+
+	/* the first frames also need bytes from the previous call */
+	for (; n < end && n < HISTORY; ++n)
+		for (unsigned c = 0; c < channels; ++c)
+			dest[n * channels + c] =
+				DsdFir(&windows[c][HISTORY + n], 1);
+
+	for (; n < end; ++n) {
+		const uint8_t *p = src + n * channels;
+		float *d = dest + n * channels;
+		for (unsigned c = 0; c < channels; ++c)
+			d[c] = DsdFir(p + c, channels);
+	}
 }
 
 ConstBuffer<float>
@@ -49,23 +236,58 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src) noexcept
 	assert(!src.IsNull());
 	assert(!src.empty());
 	assert(src.size % channels == 0);
-	assert(channels <= dsd2pcm.max_size());
+	assert(channels <= windows.size());
 
-	const unsigned num_samples = src.size;
-	const unsigned num_frames = src.size / channels;
+	const size_t num_samples = src.size;
+	const size_t num_frames = src.size / channels;
 
 	float *dest = buffer.GetT<float>(num_samples);
 
-	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
+	/* append the first input bytes to the history */
+
+	const size_t head = std::min(num_frames, size_t(HISTORY));
+	for (unsigned c = 0; c < channels; ++c)
+		for (size_t i = 0; i < head; ++i)
+			windows[c][HISTORY + i] = src.data[i * channels + c];
+
+	const size_t n_jobs = pool != nullptr
+		? std::min<size_t>(n_threads,
+				   num_frames / MIN_FRAMES_PER_JOB)
+		: 1;
+
+	if (n_jobs > 1) {
+		/* the calling thread converts the first part, and
+		   the worker threads do the rest */
+
+		const size_t per_job = (num_frames + n_jobs - 1) / n_jobs;
+
+		const uint8_t *const data = src.data;
+
+		WorkerPool::Group group;
+		for (size_t start = per_job; start < num_frames;
+		     start += per_job) {
+			const size_t end = std::min(start + per_job,
+						    num_frames);
+			pool->Push(group, [this, data, channels, start, end, dest](){
+					ConvertFrames(data, channels,
+						      start, end, dest);
+				});
 		}
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
+		ConvertFrames(data, channels, 0, per_job, dest);
+		pool->Wait(group);
+	} else
+		ConvertFrames(src.data, channels, 0, num_frames, dest);
+
+	/* remember the last input bytes for the next call */
+
+	for (unsigned c = 0; c < channels; ++c) {
+		auto &w = windows[c];
+		if (num_frames >= HISTORY) {
+			for (size_t i = 0; i < HISTORY; ++i)
+				w[i] = src.data[(num_frames - HISTORY + i) * channels + c];
+		} else
+			memmove(&w[0], &w[num_frames], HISTORY);
 	}
 
 	return { dest, num_samples };
@@ -24,27 +24,77 @@
 #include "AudioFormat.hxx"
 
 #include <array>
+#include <memory>
 
+#include <stddef.h>
 #include <stdint.h>
 
 template<typename T> struct ConstBuffer;
+class WorkerPool;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD to PCM (float).  This implements the same 96-tap FIR
+ * filter as the dsd2pcm library with the same lookup tables and
+ * produces the same output, but it reads directly from the
+ * interleaved input and it can distribute the work on several
+ * threads.
  */
 class PcmDsd {
+public:
+	/**
+	 * The number of previous input bytes needed for each output
+	 * sample.
+	 */
+	static constexpr size_t HISTORY = 11;
+
+	/**
+	 * The maximum value for SetThreads().
+	 */
+	static constexpr unsigned MAX_THREADS = 16;
+
+private:
 	PcmBuffer buffer;
 
-	std::array<struct dsd2pcm_ctx_s *, MAX_CHANNELS> dsd2pcm;
+	/**
+	 * For each channel: the last #HISTORY input bytes of the
+	 * previous call, followed by the first #HISTORY input bytes
+	 * of the current call.
+	 */
+	std::array<std::array<uint8_t, 2 * HISTORY>, MAX_CHANNELS> windows;
+
+	/**
+	 * The worker threads which help the calling thread; nullptr
+	 * if #n_threads is 1.
+	 */
+	std::unique_ptr<WorkerPool> pool;
+
+	unsigned n_threads = 1;
 
 public:
 	PcmDsd() noexcept;
 	~PcmDsd() noexcept;
 
+	/**
+	 * Set the number of threads (including the calling thread)
+	 * used by ToFloat(); must not exceed #MAX_THREADS.
+	 *
+	 * Throws on error.
+	 */
+	void SetThreads(unsigned _n_threads);
+
 	void Reset() noexcept;
 
 	ConstBuffer<float> ToFloat(unsigned channels,
 				   ConstBuffer<uint8_t> src) noexcept;
+
+private:
+	/**
+	 * Convert the given range of frames.  This may be called
+	 * concurrently for different ranges.
+	 */
+	void ConvertFrames(const uint8_t *src, unsigned channels,
+			   size_t start, size_t end,
+			   float *dest) const noexcept;
 };
 
 #endif
@@ -22,6 +22,7 @@
 #include "Clamp.hxx"
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
+#include "Kernels.hxx"
 #include "ShiftConvert.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -74,47 +75,6 @@ struct Convert32To16 {
 	}
 };
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-struct PortableFloatToInteger
-	: PerSampleConvert<FloatToIntegerSampleConvert<F, Traits>> {};
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-struct FloatToInteger : PortableFloatToInteger<F, Traits> {};
-
-/**
- * A template class that attempts to use the "optimized" algorithm for
- * large portions of the buffer, and calls the "portable" algorithm"
- * for the rest when the last block is not full.
- */
-template<typename Optimized, typename Portable>
-class GlueOptimizedConvert : Optimized, Portable {
-public:
-	typedef typename Portable::SrcTraits SrcTraits;
-	typedef typename Portable::DstTraits DstTraits;
-
-	void Convert(typename DstTraits::pointer_type out,
-		     typename SrcTraits::const_pointer_type in,
-		     size_t n) const {
-		Optimized::Convert(out, in, n);
-
-		/* use the "portable" algorithm for the trailing
-		   samples */
-		size_t remaining = n % Optimized::BLOCK_SIZE;
-		size_t done = n - remaining;
-		Portable::Convert(out + done, in + done, remaining);
-	}
-};
-
-#ifdef __ARM_NEON__
-#include "Neon.hxx"
-
-template<>
-struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
-	: GlueOptimizedConvert<NeonFloatTo16,
-			       PortableFloatToInteger<SampleFormat::S16>> {};
-
-#endif
-
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -125,11 +85,19 @@ AllocateConvert(PcmBuffer &buffer, C convert,
 	return { dest, src.size };
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static ConstBuffer<typename Traits::value_type>
-AllocateFromFloat(PcmBuffer &buffer, ConstBuffer<float> src)
+/**
+ * Allocate a destination buffer and convert with one of the
+ * #PcmKernels.
+ */
+template<typename D, typename S>
+static ConstBuffer<D>
+AllocateKernel(PcmBuffer &buffer,
+	       void (*kernel)(D *dest, const S *src, size_t n),
+	       ConstBuffer<S> src)
 {
-	return AllocateConvert(buffer, FloatToInteger<F, Traits>(), src);
+	auto dest = buffer.GetT<D>(src.size);
+	kernel(dest, src.data, src.size);
+	return { dest, src.size };
 }
 
 static ConstBuffer<int16_t>
@@ -155,7 +123,7 @@ pcm_allocate_32_to_16(PcmBuffer &buffer, PcmDither &dither,
 static ConstBuffer<int16_t>
 pcm_allocate_float_to_16(PcmBuffer &buffer, ConstBuffer<float> src)
 {
-	return AllocateFromFloat<SampleFormat::S16>(buffer, src);
+	return AllocateKernel(buffer, GetPcmKernels().float_to_16, src);
 }
 
 ConstBuffer<int16_t>
@@ -194,10 +162,6 @@ struct Convert8To24
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S24_P32>> {};
 
-struct Convert16To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S24_P32>> {};
-
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -207,23 +171,19 @@ pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 static ConstBuffer<int32_t>
 pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 {
-	return AllocateConvert(buffer, Convert16To24(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s16_to_24, src);
 }
 
-struct Convert32To24
-	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
-						   SampleFormat::S24_P32>> {};
-
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert32To24(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s32_to_24, src);
 }
 
 static ConstBuffer<int32_t>
 pcm_allocate_float_to_24(PcmBuffer &buffer, ConstBuffer<float> src)
 {
-	return AllocateFromFloat<SampleFormat::S24_P32>(buffer, src);
+	return AllocateKernel(buffer, GetPcmKernels().float_to_24, src);
 }
 
 ConstBuffer<int32_t>
@@ -262,14 +222,6 @@ struct Convert8To32
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S32>> {};
 
-struct Convert16To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S32>> {};
-
-struct Convert24To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
-						  SampleFormat::S32>> {};
-
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -279,19 +231,19 @@ pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 static ConstBuffer<int32_t>
 pcm_allocate_16_to_32(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 {
-	return AllocateConvert(buffer, Convert16To32(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s16_to_32, src);
 }
 
 static ConstBuffer<int32_t>
 pcm_allocate_24p32_to_32(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert24To32(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s24_to_32, src);
 }
 
 static ConstBuffer<int32_t>
 pcm_allocate_float_to_32(PcmBuffer &buffer, ConstBuffer<float> src)
 {
-	return AllocateFromFloat<SampleFormat::S32>(buffer, src);
+	return AllocateKernel(buffer, GetPcmKernels().float_to_32, src);
 }
 
 ConstBuffer<int32_t>
@@ -329,15 +281,6 @@ pcm_convert_to_32(PcmBuffer &buffer,
 struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
-struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
-
-struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
-
-struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
-
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 {
@@ -347,19 +290,19 @@ pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
 static ConstBuffer<float>
 pcm_allocate_16_to_float(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 {
-	return AllocateConvert(buffer, Convert16ToFloat(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s16_to_float, src);
 }
 
 static ConstBuffer<float>
 pcm_allocate_24p32_to_float(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert24ToFloat(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s24_to_float, src);
 }
 
 static ConstBuffer<float>
 pcm_allocate_32_to_float(PcmBuffer &buffer, ConstBuffer<int32_t> src)
 {
-	return AllocateConvert(buffer, Convert32ToFloat(), src);
+	return AllocateKernel(buffer, GetPcmKernels().s32_to_float, src);
 }
 
 ConstBuffer<float>
@@ -19,6 +19,7 @@
 
 #include "PcmMix.hxx"
 #include "Volume.hxx"
+#include "Kernels.hxx"
 #include "Clamp.hxx"
 #include "Traits.hxx"
 #include "util/Clamp.hxx"
@@ -71,22 +72,9 @@ PcmAddVolumeVoid(PcmDither &dither,
 				volume1, volume2);
 }
 
-static void
-pcm_add_vol_float(float *buffer1, const float *buffer2,
-		  unsigned num_samples, float volume1, float volume2) noexcept
-{
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
-
-		sample1 = (sample1 * volume1 + sample2 * volume2);
-		*buffer1++ = sample1;
-		--num_samples;
-	}
-}
-
 static bool
-pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
+pcm_add_vol(const PcmKernels &kernels, PcmDither &dither,
+	    void *buffer1, const void *buffer2, size_t size,
 	    int vol1, int vol2,
 	    SampleFormat format) noexcept
 {
@@ -121,10 +109,11 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_vol_float((float *)buffer1, (const float *)buffer2,
-				  size / 4,
-				  pcm_volume_to_float(vol1),
-				  pcm_volume_to_float(vol2));
+		kernels.add_volume_float((float *)buffer1,
+					 (const float *)buffer2,
+					 size / sizeof(float),
+					 pcm_volume_to_float(vol1),
+					 pcm_volume_to_float(vol2));
 		return true;
 	}
 
@@ -163,20 +152,9 @@ PcmAddVoid(void *a, const void *b, size_t size) noexcept
 			  size / sample_size);
 }
 
-static void
-pcm_add_float(float *buffer1, const float *buffer2,
-	      unsigned num_samples) noexcept
-{
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
-		*buffer1++ = sample1 + sample2;
-		--num_samples;
-	}
-}
-
 static bool
-pcm_add(void *buffer1, const void *buffer2, size_t size,
+pcm_add(const PcmKernels &kernels,
+	void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format) noexcept
 {
 	switch (format) {
@@ -190,20 +168,23 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		kernels.add_16((int16_t *)buffer1, (const int16_t *)buffer2,
+			       size / sizeof(int16_t));
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
+		kernels.add_24((int32_t *)buffer1, (const int32_t *)buffer2,
+			       size / sizeof(int32_t));
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
+		kernels.add_32((int32_t *)buffer1, (const int32_t *)buffer2,
+			       size / sizeof(int32_t));
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_float((float *)buffer1, (const float *)buffer2,
-			      size / 4);
+		kernels.add_float((float *)buffer1, (const float *)buffer2,
+				  size / sizeof(float));
 		return true;
 	}
 
@@ -215,12 +196,14 @@ bool
 pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format, float portion1) noexcept
 {
+	const auto &kernels = GetPcmKernels();
+
 	float s;
 
 	/* portion1 is between 0.0 and 1.0 for crossfading, MixRamp uses -1
 	 * to signal mixing rather than fading */
 	if (portion1 < 0)
-		return pcm_add(buffer1, buffer2, size, format);
+		return pcm_add(kernels, buffer1, buffer2, size, format);
 
 	s = sin(M_PI_2 * portion1);
 	s *= s;
@@ -228,6 +211,6 @@ pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	int vol1 = std::lround(s * PCM_VOLUME_1S);
 	vol1 = Clamp<int>(vol1, 0, PCM_VOLUME_1S);
 
-	return pcm_add_vol(dither, buffer1, buffer2, size,
+	return pcm_add_vol(kernels, dither, buffer1, buffer2, size,
 			   vol1, PCM_VOLUME_1S - vol1, format);
 }
@@ -19,6 +19,7 @@
 
 #include "Volume.hxx"
 #include "Silence.hxx"
+#include "Kernels.hxx"
 #include "Traits.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/WritableBuffer.hxx"
@@ -88,14 +89,6 @@ pcm_volume_change_32(PcmDither &dither,
 	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume);
 }
 
-static void
-pcm_volume_change_float(float *dest, const float *src, size_t n,
-			float volume) noexcept
-{
-	for (size_t i = 0; i != n; ++i)
-		dest[i] = src[i] * volume;
-}
-
 void
 PcmVolume::Open(SampleFormat _format)
 {
@@ -119,6 +112,7 @@ PcmVolume::Open(SampleFormat _format)
 	}
 
 	format = _format;
+	kernels = &GetPcmKernels();
 }
 
 ConstBuffer<void>
@@ -169,10 +163,10 @@ PcmVolume::Apply(ConstBuffer<void> src) noexcept
 		break;
 
 	case SampleFormat::FLOAT:
-		pcm_volume_change_float((float *)data,
-					(const float *)src.data,
-					src.size / sizeof(float),
-					pcm_volume_to_float(volume));
+		kernels->volume_float((float *)data,
+				      (const float *)src.data,
+				      src.size / sizeof(float),
+				      pcm_volume_to_float(volume));
 		break;
 
 	case SampleFormat::DSD:
@@ -29,6 +29,7 @@
 #endif
 
 template<typename T> struct ConstBuffer;
+struct PcmKernels;
 
 /**
  * Number of fractional bits for a fixed-point volume value.
@@ -65,6 +66,12 @@ class PcmVolume {
 
 	unsigned volume;
 
+	/**
+	 * The optimized inner loops for this CPU, looked up by
+	 * Open().
+	 */
+	const PcmKernels *kernels;
+
 	PcmBuffer buffer;
 	PcmDither dither;
 
@@ -29,11 +29,17 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     PlayerOutputs &_outputs,
 			     unsigned _buffer_chunks,
+			     size_t _chunk_size,
+			     bool _lock_free_buffer,
 			     AudioFormat _configured_audio_format,
-			     const ReplayGainConfig &_replay_gain_config) noexcept
+			     const ReplayGainConfig &_replay_gain_config,
+			     InputCacheManager *_input_cache) noexcept
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 chunk_size(_chunk_size),
+	 lock_free_buffer(_lock_free_buffer),
 	 configured_audio_format(_configured_audio_format),
+	 input_cache(_input_cache),
 	 thread(BIND_THIS_METHOD(RunThread)),
 	 replay_gain_config(_replay_gain_config)
 {
@@ -40,6 +40,7 @@ struct Tag;
 class PlayerListener;
 class PlayerOutputs;
 class DetachedSong;
+class InputCacheManager;
 
 enum class PlayerState : uint8_t {
 	STOP,
@@ -118,11 +119,30 @@ class PlayerControl final : public AudioOutputClient {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The size of each #MusicChunk's PCM buffer.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The "audio_buffer_lock_free" setting: use a lock-free
+	 * #MusicBuffer and lock-free decoder pipes.
+	 */
+	const bool lock_free_buffer;
+
 	/**
 	 * The "audio_output_format" setting.
 	 */
 	const AudioFormat configured_audio_format;
 
+public:
+	/**
+	 * The global input cache (see "input_cache"); nullptr if
+	 * disabled.
+	 */
+	InputCacheManager *const input_cache;
+
+private:
 	/**
 	 * The handle of the player thread.
 	 */
@@ -235,8 +255,11 @@ public:
 	PlayerControl(PlayerListener &_listener,
 		      PlayerOutputs &_outputs,
 		      unsigned buffer_chunks,
+		      size_t chunk_size,
+		      bool lock_free_buffer,
 		      AudioFormat _configured_audio_format,
-		      const ReplayGainConfig &_replay_gain_config) noexcept;
+		      const ReplayGainConfig &_replay_gain_config,
+		      InputCacheManager *_input_cache) noexcept;
 	~PlayerControl() noexcept;
 
 	void Kill() noexcept;
@@ -211,6 +211,17 @@ private:
 		xfade_state = CrossFadeState::UNKNOWN;
 	}
 
+	/**
+	 * Create a new (empty) pipe for the decoder.  If the
+	 * #MusicBuffer is lock-free, then the pipe is, too; it is
+	 * large enough to hold all chunks of the buffer.
+	 */
+	std::shared_ptr<MusicPipe> NewPipe() const noexcept {
+		return buffer.IsLockFree()
+			? std::make_shared<MusicPipe>(buffer.GetSize())
+			: std::make_shared<MusicPipe>();
+	}
+
 	template<typename P>
 	void ReplacePipe(P &&_pipe) noexcept {
 		ResetCrossFade();
@@ -526,8 +537,8 @@ Player::CheckDecoderStartup() noexcept
 		const size_t buffer_before_play_size =
 			play_audio_format.TimeToSize(buffer_before_play_duration);
 		buffer_before_play =
-			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
-			/ sizeof(MusicChunk::data);
+			(buffer_before_play_size + buffer.GetChunkSize() - 1)
+			/ buffer.GetChunkSize();
 
 		idle_add(IDLE_PLAYER);
 
@@ -697,7 +708,7 @@ Player::ProcessCommand() noexcept
 		pc.CommandFinished();
 
 		if (dc.IsIdle())
-			StartDecoder(std::make_shared<MusicPipe>());
+			StartDecoder(NewPipe());
 
 		break;
 
@@ -958,7 +969,7 @@ Player::SongBorder() noexcept
 inline void
 Player::Run() noexcept
 {
-	pipe = std::make_shared<MusicPipe>();
+	pipe = NewPipe();
 
 	const std::lock_guard<Mutex> lock(pc.mutex);
 
@@ -1002,7 +1013,7 @@ Player::Run() noexcept
 
 			assert(dc.pipe == nullptr || dc.pipe == pipe);
 
-			StartDecoder(std::make_shared<MusicPipe>());
+			StartDecoder(NewPipe());
 		}
 
 		if (/* no cross-fading if MPD is going to pause at the
@@ -1022,6 +1033,7 @@ Player::Run() noexcept
 							dc.GetMixRampPreviousEnd(),
 							dc.out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							buffer_before_play);
 			if (cross_fade_chunks > 0)
@@ -1120,10 +1132,11 @@ try {
 
 	DecoderControl dc(mutex, cond,
 			  configured_audio_format,
-			  replay_gain_config);
+			  replay_gain_config,
+			  input_cache);
 	dc.StartThread();
 
-	MusicBuffer buffer(buffer_chunks);
+	MusicBuffer buffer(buffer_chunks, chunk_size, lock_free_buffer);
 
 	const std::lock_guard<Mutex> lock(mutex);
 
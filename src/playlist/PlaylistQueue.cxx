@@ -33,6 +33,7 @@
 #endif
 
 #include <memory>
+#include <vector>
 
 void
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
@@ -44,6 +45,11 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
+	/* append the songs in chunks, to avoid updating the
+	   "queued" song and notifying clients for each of them */
+	static constexpr size_t CHUNK_SIZE = 1024;
+	std::vector<DetachedSong> chunk;
+
 	std::unique_ptr<DetachedSong> song;
 	for (unsigned i = 0;
 	     i < end_index && (song = e.NextSong()) != nullptr;
@@ -58,8 +64,14 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			continue;
 		}
 
-		dest.AppendSong(pc, std::move(*song));
+		chunk.emplace_back(std::move(*song));
+		if (chunk.size() >= CHUNK_SIZE) {
+			dest.AppendSongs(pc, std::move(chunk));
+			chunk.clear();
+		}
 	}
+
+	dest.AppendSongs(pc, std::move(chunk));
 }
 
 void
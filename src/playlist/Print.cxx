@@ -23,6 +23,12 @@
 #include "PlaylistSong.hxx"
 #include "SongEnumerator.hxx"
 #include "SongPrint.hxx"
+#include "PlaylistFile.hxx"
+#include "PlaylistError.hxx"
+#include "PlaylistRegistry.hxx"
+#include "Mapper.hxx"
+#include "input/MemoryInputStream.hxx"
+#include "protocol/RangeArg.hxx"
 #include "song/DetachedSong.hxx"
 #include "fs/Traits.hxx"
 #include "thread/Mutex.hxx"
@@ -33,14 +39,21 @@ static void
 playlist_provider_print(Response &r,
 			const SongLoader &loader,
 			const char *uri,
-			SongEnumerator &e, bool detail) noexcept
+			SongEnumerator &e, RangeArg range,
+			bool detail) noexcept
 {
 	const std::string base_uri = uri != nullptr
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
 	std::unique_ptr<DetachedSong> song;
-	while ((song = e.NextSong()) != nullptr) {
+	for (unsigned i = 0;
+	     i < range.end && (song = e.NextSong()) != nullptr;
+	     ++i) {
+		if (i < range.start)
+			/* skip songs before the start index */
+			continue;
+
 		if (playlist_check_translate_song(*song, base_uri.c_str(),
 						  loader) &&
 		    detail)
@@ -52,11 +65,55 @@ playlist_provider_print(Response &r,
 	}
 }
 
+/**
+ * Print a range of a stored playlist, using its index instead of
+ * parsing the whole file.  The excerpt is parsed by the same
+ * playlist plugin which would parse the whole file, so the songs
+ * and their metadata (e.g. from "#EXTINF") are the same.
+ *
+ * @return false if there is no such stored playlist or if the range
+ * cannot be read from the index
+ */
+static bool
+playlist_file_print_range(Response &r, const SongLoader &loader,
+			  const char *name, RangeArg range, bool detail)
+{
+	std::string contents;
+
+	try {
+		if (!ReadPlaylistFileRange(name, range.start, range.end,
+					   contents))
+			return false;
+	} catch (const PlaylistError &e) {
+		if (e.GetCode() == PlaylistResult::NO_SUCH_LIST ||
+		    e.GetCode() == PlaylistResult::DISABLED)
+			return false;
+		throw;
+	}
+
+	Mutex mutex;
+	InputStreamPtr is =
+		std::make_unique<MemoryInputStream>(name, mutex,
+						    std::move(contents));
+	auto playlist = playlist_list_open_stream_suffix(std::move(is),
+							 PLAYLIST_FILE_SUFFIX + 1);
+	if (playlist == nullptr)
+		return false;
+
+	playlist_provider_print(r, loader, name, *playlist,
+				RangeArg::All(), detail);
+	return true;
+}
+
 bool
 playlist_file_print(Response &r, Partition &partition,
 		    const SongLoader &loader,
-		    const char *uri, bool detail)
+		    const char *uri, RangeArg range, bool detail)
 {
+	if (!range.IsAll() && spl_valid_name(uri) &&
+	    playlist_file_print_range(r, loader, uri, range, detail))
+		return true;
+
 	Mutex mutex;
 
 #ifndef ENABLE_DATABASE
@@ -71,6 +128,6 @@ playlist_file_print(Response &r, Partition &partition,
 	if (playlist == nullptr)
 		return false;
 
-	playlist_provider_print(r, loader, uri, *playlist, detail);
+	playlist_provider_print(r, loader, uri, *playlist, range, detail);
 	return true;
 }
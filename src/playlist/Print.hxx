@@ -23,17 +23,19 @@
 class Response;
 class SongLoader;
 struct Partition;
+struct RangeArg;
 
 /**
  * Send the playlist file to the client.
  *
  * @param uri the URI of the playlist file in UTF-8 encoding
+ * @param range only print the songs in this range
  * @param detail true if all details should be printed
  * @return true on success, false if the playlist does not exist
  */
 bool
 playlist_file_print(Response &r, Partition &partition,
 		    const SongLoader &loader,
-		    const char *uri, bool detail);
+		    const char *uri, RangeArg range, bool detail);
 
 #endif
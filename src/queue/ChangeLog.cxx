@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ChangeLog.hxx"
+
+#include <algorithm>
+
+void
+QueueChangeLog::Add(uint32_t version, unsigned position) noexcept
+{
+	if (n_entries > 0) {
+		/* try to merge with the previous entry; loops which
+		   shift items modify consecutive positions in either
+		   direction */
+		auto &back = Back();
+		if (back.version == version) {
+			if (position >= back.start && position < back.end)
+				return;
+
+			if (position == back.end) {
+				++back.end;
+				return;
+			}
+
+			if (position + 1 == back.start) {
+				--back.start;
+				return;
+			}
+		}
+	}
+
+	if (n_entries == CAPACITY) {
+		/* discard the oldest entry */
+		const auto &front = entries[head];
+		complete_since = std::max(complete_since, front.version + 1);
+		head = (head + 1) % CAPACITY;
+		--n_entries;
+	}
+
+	++n_entries;
+	Back() = {version, position, position + 1};
+}
+
+bool
+QueueChangeLog::Collect(uint32_t since, unsigned length,
+			std::vector<Range> &result) const
+{
+	if (since < complete_since)
+		return false;
+
+	/* entries are ordered by version; walk backwards until the
+	   first one which is too old */
+	for (size_t i = n_entries; i > 0; --i) {
+		const auto &entry = entries[(head + i - 1) % CAPACITY];
+		if (entry.version < since)
+			break;
+
+		if (entry.start < length)
+			result.push_back({entry.start,
+					  std::min(entry.end, length)});
+	}
+
+	std::sort(result.begin(), result.end(),
+		  [](const Range &a, const Range &b){
+			  return a.start < b.start;
+		  });
+
+	/* merge overlapping and adjacent ranges */
+	auto dest = result.begin();
+	for (auto i = result.begin(); i != result.end(); ++i) {
+		if (dest != result.begin() &&
+		    i->start <= std::prev(dest)->end)
+			std::prev(dest)->end = std::max(std::prev(dest)->end,
+							i->end);
+		else
+			*dest++ = *i;
+	}
+
+	result.erase(dest, result.end());
+	return true;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_CHANGE_LOG_HXX
+#define MPD_QUEUE_CHANGE_LOG_HXX
+
+#include "util/Compiler.h"
+
+#include <array>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A bounded log of queue modifications, used to answer "plchanges"
+ * without scanning the whole queue.  Each entry is a range of
+ * positions which was modified at a certain queue version; adjacent
+ * positions modified at the same version are merged into one entry.
+ *
+ * When the ring is full, the oldest entry is discarded, and queries
+ * for versions before it fail, which means the caller has to fall
+ * back to a full scan.
+ */
+class QueueChangeLog {
+	struct Entry {
+		uint32_t version;
+
+		/**
+		 * The range of modified positions (excluding
+		 * #end).
+		 */
+		unsigned start, end;
+	};
+
+	static constexpr size_t CAPACITY = 1024;
+
+	std::array<Entry, CAPACITY> entries;
+
+	/**
+	 * The index of the oldest entry.
+	 */
+	size_t head = 0;
+
+	/**
+	 * The number of valid entries.
+	 */
+	size_t n_entries = 0;
+
+	/**
+	 * All modifications with this version or newer are in the
+	 * log.
+	 */
+	uint32_t complete_since = 0;
+
+public:
+	struct Range {
+		unsigned start, end;
+	};
+
+	/**
+	 * Forget all entries.  This may be called when the queue has
+	 * been cleared, because there are no positions left which
+	 * could have been modified earlier.
+	 */
+	void Reset() noexcept {
+		head = n_entries = 0;
+		complete_since = 0;
+	}
+
+	/**
+	 * Forget all entries and refuse all queries until the next
+	 * Reset().  This is used after the version number has
+	 * wrapped around.
+	 */
+	void Invalidate() noexcept {
+		head = n_entries = 0;
+		complete_since = UINT32_MAX;
+	}
+
+	/**
+	 * Record that the given position was modified at the given
+	 * version.
+	 */
+	void Add(uint32_t version, unsigned position) noexcept;
+
+	/**
+	 * Determine the positions below #length which were modified
+	 * at the given version or later.  The result is sorted and
+	 * the ranges do not overlap.
+	 *
+	 * @return false if the log does not reach back to that
+	 * version
+	 */
+	bool Collect(uint32_t since, unsigned length,
+		     std::vector<Range> &result) const;
+
+private:
+	Entry &Back() noexcept {
+		return entries[(head + n_entries - 1) % CAPACITY];
+	}
+};
+
+#endif
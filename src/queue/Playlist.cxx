@@ -21,6 +21,7 @@
 #include "Listener.hxx"
 #include "PlaylistError.hxx"
 #include "player/Control.hxx"
+#include "input/cache/Manager.hxx"
 #include "song/DetachedSong.hxx"
 #include "SingleMode.hxx"
 #include "Log.hxx"
@@ -75,6 +76,24 @@ playlist::QueueSongOrder(PlayerControl &pc, unsigned order)
 		    queued, song.GetURI());
 
 	pc.LockEnqueueSong(std::make_unique<DetachedSong>(song));
+
+	if (pc.input_cache != nullptr)
+		PrefetchSongs(*pc.input_cache, order);
+}
+
+void
+playlist::PrefetchSongs(InputCacheManager &cache, unsigned order) noexcept
+{
+	for (unsigned n = cache.GetPrefetchCount(); n > 0; --n) {
+		const DetachedSong &song = queue.GetOrder(order);
+		cache.Prefetch(song.GetRealURI(), song.GetLastModified());
+
+		const int next = queue.GetNextOrder(order);
+		if (next < 0)
+			break;
+
+		order = next;
+	}
 }
 
 void
@@ -24,8 +24,11 @@
 #include "queue/Queue.hxx"
 #include "config.h"
 
+#include <vector>
+
 enum TagType : uint8_t;
 struct Tag;
+template<typename T> struct ConstBuffer;
 class PlayerControl;
 class DetachedSong;
 class Database;
@@ -33,6 +36,7 @@ class SongLoader;
 class SongTime;
 class SignedSongTime;
 class QueueListener;
+class InputCacheManager;
 
 struct playlist {
 	/**
@@ -176,6 +180,12 @@ protected:
 	 */
 	void QueueSongOrder(PlayerControl &pc, unsigned order);
 
+	/**
+	 * Start filling the input cache with the song at the given
+	 * order number and the ones following it.
+	 */
+	void PrefetchSongs(InputCacheManager &cache, unsigned order) noexcept;
+
 	/**
 	 * Called when the player thread has started playing the
 	 * "queued" song, i.e. it has switched from one song to the
@@ -226,6 +236,28 @@ public:
 			   const SongLoader &loader,
 			   const char *uri_utf8);
 
+	/**
+	 * Append many songs at once.  Unlike calling AppendSong() for
+	 * each of them, this updates the "queued" song and emits the
+	 * "modified" event only once.
+	 *
+	 * Throws PlaylistError if the queue would be too large; in
+	 * that case, all songs which fit have been appended.
+	 */
+	void AppendSongs(PlayerControl &pc,
+			 std::vector<DetachedSong> &&songs);
+
+	/**
+	 * Load and append many songs at once.  Database songs are
+	 * looked up in one batch.
+	 *
+	 * Throws #std::runtime_error on error; if loading one of the
+	 * songs fails, nothing is appended.
+	 */
+	void AppendURIs(PlayerControl &pc,
+			const SongLoader &loader,
+			ConstBuffer<const char *> uris);
+
 protected:
 	void DeleteInternal(PlayerControl &pc,
 			    unsigned song, const DetachedSong **queued_p);
@@ -29,6 +29,7 @@
 #include "player/Control.hxx"
 #include "song/DetachedSong.hxx"
 #include "SongLoader.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <memory>
 
@@ -127,6 +128,53 @@ playlist::AppendURI(PlayerControl &pc, const SongLoader &loader,
 	return AppendSong(pc, loader.LoadSong(uri));
 }
 
+void
+playlist::AppendSongs(PlayerControl &pc, std::vector<DetachedSong> &&songs)
+{
+	if (songs.empty())
+		return;
+
+	if (queue.IsFull())
+		throw PlaylistError(PlaylistResult::TOO_LARGE,
+				    "Playlist is too large");
+
+	const DetachedSong *const queued_song = GetQueuedSong();
+
+	/* the range of remaining songs to play which the new songs
+	   get shuffled into */
+	const unsigned start = queued >= 0
+		? unsigned(queued + 1)
+		: unsigned(current + 1);
+
+	bool truncated = false;
+	for (auto &song : songs) {
+		if (queue.IsFull()) {
+			truncated = true;
+			break;
+		}
+
+		queue.Append(std::move(song), 0);
+
+		if (queue.random && start < queue.GetLength())
+			queue.ShuffleOrderLastWithPriority(start,
+							   queue.GetLength());
+	}
+
+	UpdateQueuedSong(pc, queued_song);
+	OnModified();
+
+	if (truncated)
+		throw PlaylistError(PlaylistResult::TOO_LARGE,
+				    "Playlist is too large");
+}
+
+void
+playlist::AppendURIs(PlayerControl &pc, const SongLoader &loader,
+		     ConstBuffer<const char *> uris)
+{
+	AppendSongs(pc, loader.LoadSongs(uris));
+}
+
 void
 playlist::SwapPositions(PlayerControl &pc, unsigned song1, unsigned song2)
 {
@@ -64,6 +64,10 @@ Queue::IncrementVersion() noexcept
 		for (unsigned i = 0; i < length; i++)
 			items[i].version = 0;
 
+		/* all items are "newer" than any version now, which
+		   the change log cannot express */
+		change_log.Invalidate();
+
 		version = 1;
 	}
 }
@@ -88,8 +92,8 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
 	item.id = id;
-	item.version = version;
 	item.priority = priority;
+	ModifyAtPosition(position);
 
 	order[position] = position;
 
@@ -104,8 +108,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	ModifyAtPosition(position1);
+	ModifyAtPosition(position2);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -130,7 +134,7 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 
 	id_table.Move(tmp.id, to);
 	items[to] = tmp;
-	items[to].version = version;
+	ModifyAtPosition(to);
 
 	/* now deal with order */
 
@@ -170,7 +174,7 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 	{
 		id_table.Move(tmp[i - start].id, to + i - start);
 		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
+		ModifyAtPosition(to + i - start);
 	}
 
 	if (random) {
@@ -272,6 +276,10 @@ Queue::Clear() noexcept
 	}
 
 	length = 0;
+
+	/* no position is left which could have been modified
+	   earlier */
+	change_log.Reset();
 }
 
 static void
@@ -438,8 +446,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	ModifyAtPosition(position);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
@@ -22,6 +22,7 @@
 
 #include "util/Compiler.h"
 #include "IdTable.hxx"
+#include "ChangeLog.hxx"
 #include "SingleMode.hxx"
 #include "util/LazyRandomEngine.hxx"
 
@@ -88,6 +89,9 @@ struct Queue {
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/** recent modifications, see CollectChanges() */
+	QueueChangeLog change_log;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat = false;
@@ -226,6 +230,20 @@ struct Queue {
 			items[position].version == 0;
 	}
 
+	/**
+	 * Determine the positions which are newer than the specified
+	 * version (see IsNewerAtPosition()) from the change log,
+	 * without scanning the whole queue.
+	 *
+	 * @return false if the change log does not reach back to
+	 * that version; the caller must then check all positions
+	 */
+	bool CollectChanges(uint32_t _version,
+			    std::vector<QueueChangeLog::Range> &result) const {
+		return _version <= version &&
+			change_log.Collect(_version, length, result);
+	}
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -250,6 +268,7 @@ struct Queue {
 		assert(position < length);
 
 		items[position].version = version;
+		change_log.Add(version, position);
 	}
 
 	/**
@@ -382,7 +401,7 @@ private:
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		ModifyAtPosition(to);
 		id_table.Move(from_id, to);
 	}
 
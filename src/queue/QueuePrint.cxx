@@ -25,6 +25,9 @@
 #include "song/LightSong.hxx"
 #include "client/Response.hxx"
 
+#include <algorithm>
+#include <vector>
+
 /**
  * Send detailed information about a range of songs in the queue to a
  * client.
@@ -70,10 +73,16 @@ queue_print_uris(Response &r, const Queue &queue,
 	}
 }
 
-void
-queue_print_changes_info(Response &r, const Queue &queue,
-			 uint32_t version,
-			 unsigned start, unsigned end)
+/**
+ * Invoke the given function for each position in the given range
+ * which is newer than the specified version, in ascending order.
+ * The queue's change log is consulted first; only if it does not
+ * reach back far enough, all positions are checked.
+ */
+template<typename F>
+static void
+ForEachChange(const Queue &queue, uint32_t version,
+	      unsigned start, unsigned end, F &&f)
 {
 	assert(start <= end);
 
@@ -83,9 +92,31 @@ queue_print_changes_info(Response &r, const Queue &queue,
 	if (end > queue.GetLength())
 		end = queue.GetLength();
 
+	std::vector<QueueChangeLog::Range> changes;
+	if (queue.CollectChanges(version, changes)) {
+		for (const auto &i : changes) {
+			const unsigned range_end = std::min(i.end, end);
+			for (unsigned position = std::max(i.start, start);
+			     position < range_end; ++position)
+				f(position);
+		}
+
+		return;
+	}
+
 	for (unsigned i = start; i < end; i++)
 		if (queue.IsNewerAtPosition(i, version))
+			f(i);
+}
+
+void
+queue_print_changes_info(Response &r, const Queue &queue,
+			 uint32_t version,
+			 unsigned start, unsigned end)
+{
+	ForEachChange(queue, version, start, end, [&](unsigned i){
 			queue_print_song_info(r, queue, i);
+		});
 }
 
 void
@@ -93,18 +124,10 @@ queue_print_changes_position(Response &r, const Queue &queue,
 			     uint32_t version,
 			     unsigned start, unsigned end)
 {
-	assert(start <= end);
-
-	if (start >= queue.GetLength())
-		return;
-
-	if (end > queue.GetLength())
-		end = queue.GetLength();
-
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
+	ForEachChange(queue, version, start, end, [&](unsigned i){
 			r.Format("cpos: %i\nId: %i\n",
 				 i, queue.PositionToId(i));
+		});
 }
 
 void
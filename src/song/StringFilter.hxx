@@ -82,6 +82,10 @@ public:
 		return value;
 	}
 
+	bool IsSubstring() const noexcept {
+		return substring;
+	}
+
 	bool GetFoldCase() const noexcept {
 		return fold_case;
 	}
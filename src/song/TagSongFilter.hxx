@@ -56,6 +56,14 @@ public:
 		return filter.IsNegated();
 	}
 
+	bool IsSubstring() const noexcept {
+		return filter.IsSubstring();
+	}
+
+	bool IsRegex() const noexcept {
+		return filter.IsRegex();
+	}
+
 	void ToggleNegated() noexcept {
 		filter.ToggleNegated();
 	}
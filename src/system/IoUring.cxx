@@ -0,0 +1,194 @@
+/*
+ * Copyright 2013-2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "IoUring.hxx"
+#include "Error.hxx"
+
+#include <stdexcept>
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static int
+io_uring_setup(unsigned entries, io_uring_params *p) noexcept
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+	       unsigned flags, const void *arg, size_t arg_size) noexcept
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, arg, arg_size);
+}
+
+template<typename T>
+static T *
+At(void *base, size_t offset) noexcept
+{
+	return (T *)((uint8_t *)base + offset);
+}
+
+IoUring::IoUring(unsigned entries)
+{
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	fd = io_uring_setup(entries, &p);
+	if (fd < 0)
+		throw MakeErrno("io_uring_setup() failed");
+
+	/* the timeout argument of io_uring_enter() requires
+	   IORING_FEAT_EXT_ARG (Linux 5.11) */
+	if ((p.features & IORING_FEAT_EXT_ARG) == 0 ||
+	    (p.features & IORING_FEAT_NODROP) == 0) {
+		close(fd);
+		throw std::runtime_error("io_uring is too old");
+	}
+
+	sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+	const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap && cq_ring_size > sq_ring_size)
+		sq_ring_size = cq_ring_size;
+
+	sq_ring = mmap(nullptr, sq_ring_size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED) {
+		const int e = errno;
+		close(fd);
+		throw MakeErrno(e, "mmap() failed");
+	}
+
+	if (single_mmap) {
+		cq_ring = sq_ring;
+		cq_ring_size = 0;
+	} else {
+		cq_ring = mmap(nullptr, cq_ring_size, PROT_READ|PROT_WRITE,
+			       MAP_SHARED|MAP_POPULATE, fd,
+			       IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED) {
+			const int e = errno;
+			munmap(sq_ring, sq_ring_size);
+			close(fd);
+			throw MakeErrno(e, "mmap() failed");
+		}
+	}
+
+	sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe *)mmap(nullptr, sqes_size,
+				    PROT_READ|PROT_WRITE,
+				    MAP_SHARED|MAP_POPULATE, fd,
+				    IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		const int e = errno;
+		if (cq_ring_size > 0)
+			munmap(cq_ring, cq_ring_size);
+		munmap(sq_ring, sq_ring_size);
+		close(fd);
+		throw MakeErrno(e, "mmap() failed");
+	}
+
+	sq_head = At<unsigned>(sq_ring, p.sq_off.head);
+	sq_tail = At<unsigned>(sq_ring, p.sq_off.tail);
+	sq_array = At<unsigned>(sq_ring, p.sq_off.array);
+	sq_mask = *At<unsigned>(sq_ring, p.sq_off.ring_mask);
+	sq_entries = p.sq_entries;
+	sq_local_tail = *sq_tail;
+
+	cq_head = At<unsigned>(cq_ring, p.cq_off.head);
+	cq_tail = At<unsigned>(cq_ring, p.cq_off.tail);
+	cq_mask = *At<unsigned>(cq_ring, p.cq_off.ring_mask);
+	cqes = At<io_uring_cqe>(cq_ring, p.cq_off.cqes);
+}
+
+IoUring::~IoUring() noexcept
+{
+	munmap(sqes, sqes_size);
+	if (cq_ring_size > 0)
+		munmap(cq_ring, cq_ring_size);
+	munmap(sq_ring, sq_ring_size);
+	close(fd);
+}
+
+io_uring_sqe *
+IoUring::GetSubmitEntry() noexcept
+{
+	const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (sq_local_tail - head >= sq_entries)
+		return nullptr;
+
+	const unsigned index = sq_local_tail & sq_mask;
+	sq_array[index] = index;
+	++sq_local_tail;
+
+	io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+bool
+IoUring::Submit(int timeout_ms) noexcept
+{
+	const unsigned to_submit = sq_local_tail - *sq_tail;
+	__atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+	unsigned min_complete = 0, flags = 0;
+
+	struct __kernel_timespec ts;
+	io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+
+	if (timeout_ms != 0) {
+		min_complete = 1;
+		flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+		if (timeout_ms > 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+			arg.ts = (uint64_t)(uintptr_t)&ts;
+		}
+	} else if (to_submit == 0)
+		/* nothing to do */
+		return true;
+
+	++n_enter;
+	int result = io_uring_enter(fd, to_submit, min_complete, flags,
+				    (flags & IORING_ENTER_EXT_ARG) != 0 ? &arg : nullptr,
+				    (flags & IORING_ENTER_EXT_ARG) != 0 ? sizeof(arg) : 0);
+	return result >= 0 || errno == ETIME || errno == EINTR;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2013-2018 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IO_URING_HXX
+#define IO_URING_HXX
+
+#include "util/Compiler.h"
+
+#include <linux/io_uring.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A minimal wrapper for a Linux io_uring instance, using the system
+ * calls directly.  It supports submitting requests in batches and
+ * waiting for their completions with a timeout.
+ *
+ * This class is not thread-safe.
+ */
+class IoUring {
+	int fd;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size;
+
+	io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_head, *sq_tail, *sq_array;
+	unsigned sq_mask, sq_entries;
+
+	unsigned *cq_head, *cq_tail;
+	unsigned cq_mask;
+	io_uring_cqe *cqes;
+
+	/**
+	 * The local copy of the submission queue tail, which
+	 * includes requests which have not yet been submitted.
+	 */
+	unsigned sq_local_tail;
+
+	/**
+	 * The number of io_uring_enter() calls, for statistics.
+	 */
+	uint64_t n_enter = 0;
+
+public:
+	/**
+	 * Throws on error, e.g. if the kernel does not support
+	 * io_uring or a required feature.
+	 */
+	explicit IoUring(unsigned entries);
+
+	~IoUring() noexcept;
+
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+
+	uint64_t GetEnterCount() const noexcept {
+		return n_enter;
+	}
+
+	/**
+	 * Returns a new submission queue entry (cleared) or nullptr
+	 * if the queue is full; call Submit() to make room.
+	 */
+	io_uring_sqe *GetSubmitEntry() noexcept;
+
+	/**
+	 * Submit all pending requests and wait for at least one
+	 * completion.
+	 *
+	 * @param timeout_ms the maximum time to wait in
+	 * milliseconds; 0 means don't wait, a negative value means
+	 * wait forever
+	 * @return false on error (errno is set; ETIME and EINTR are
+	 * not errors)
+	 */
+	bool Submit(int timeout_ms) noexcept;
+
+	/**
+	 * Invoke the given function for each completion, and remove
+	 * them from the completion queue.
+	 */
+	template<typename F>
+	void ForEachCompletion(F &&f) noexcept {
+		unsigned head = *cq_head;
+		const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; ++head)
+			f(cqes[head & cq_mask]);
+
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+};
+
+#endif
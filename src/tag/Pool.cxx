@@ -19,73 +19,120 @@
 
 #include "Pool.hxx"
 #include "Item.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 #include "util/StringView.hxx"
 
-#include <limits>
+#include <algorithm>
+#include <atomic>
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
 
-Mutex tag_pool_lock;
+/**
+ * The number of independently locked parts of the pool.  A value is
+ * assigned to a shard by its hash, so threads which look up
+ * different values rarely contend for the same mutex.
+ */
+static constexpr unsigned NUM_SHARDS = 16;
 
-static constexpr size_t NUM_SLOTS = 4093;
+/**
+ * The initial number of hash buckets per shard.  Must be a power of
+ * two.
+ */
+static constexpr size_t INITIAL_BUCKETS = 256;
+
+/**
+ * Grow a shard's bucket array when it contains more than this many
+ * slots per bucket on average.
+ */
+static constexpr size_t MAX_LOAD_FACTOR = 2;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
-	uint8_t ref = 1;
-	TagItem item;
 
-	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
+	/**
+	 * The reference counter.  It is incremented without holding
+	 * the shard lock by tag_pool_dup_item() (the caller owns a
+	 * reference, so it cannot drop to zero concurrently), but
+	 * the transition to zero happens only while holding the
+	 * lock.
+	 */
+	std::atomic<uint32_t> ref{1};
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	/**
+	 * The value of calc_hash(), cached to avoid rehashing the
+	 * string when the bucket array grows or when the slot is
+	 * removed.
+	 */
+	const unsigned hash;
+
+	TagItem item;
+
+	TagPoolSlot(TagPoolSlot *_next, unsigned _hash, TagType type,
 		    StringView value) noexcept
-		:next(_next) {
+		:next(_next), hash(_hash) {
 		item.type = type;
 		memcpy(item.value, value.data, value.size);
 		item.value[value.size] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	static TagPoolSlot *Create(TagPoolSlot *_next, unsigned hash,
+				   TagType type,
 				   StringView value) noexcept;
 };
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(TagPoolSlot *_next, unsigned hash, TagType type,
 		    StringView value) noexcept
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       value.size + 1,
-				       _next, type,
+				       _next, hash, type,
 				       value);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+class TagPoolShard {
+	Mutex mutex;
 
-static inline unsigned
-calc_hash(TagType type, StringView p) noexcept
-{
-	unsigned hash = 5381;
+	/**
+	 * The hash table, allocated on first use.  It is never freed,
+	 * because #Tag instances in static objects may outlive this
+	 * object.
+	 */
+	TagPoolSlot **buckets = nullptr;
 
-	for (auto ch : p)
-		hash = (hash << 5) + hash + ch;
+	size_t n_buckets = 0;
 
-	return hash ^ type;
-}
+	size_t n_slots = 0;
+
+public:
+	TagItem *Get(unsigned hash, TagType type, StringView value) noexcept;
+	void Put(TagPoolSlot &slot) noexcept;
+
+	void CollectStats(TagPoolStats &stats) noexcept;
+
+private:
+	TagPoolSlot *&GetBucket(unsigned hash) noexcept {
+		return buckets[(hash / NUM_SHARDS) & (n_buckets - 1)];
+	}
+
+	void Grow() noexcept;
+};
+
+static TagPoolShard shards[NUM_SHARDS];
 
 static inline unsigned
-calc_hash(TagType type, const char *p) noexcept
+calc_hash(TagType type, StringView p) noexcept
 {
 	unsigned hash = 5381;
 
-	assert(p != nullptr);
-
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+	for (auto ch : p)
+		hash = (hash << 5) + hash + ch;
 
 	return hash ^ type;
 }
@@ -96,73 +143,161 @@ tag_item_to_slot(TagItem *item) noexcept
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, StringView value) noexcept
+static inline TagPoolShard &
+GetShard(unsigned hash) noexcept
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	return shards[hash % NUM_SHARDS];
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value) noexcept
+void
+TagPoolShard::Grow() noexcept
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	TagPoolSlot **const old_buckets = buckets;
+	const size_t old_n_buckets = n_buckets;
+
+	n_buckets = old_n_buckets > 0
+		? old_n_buckets * 2
+		: INITIAL_BUCKETS;
+	buckets = new TagPoolSlot *[n_buckets]();
+
+	for (size_t i = 0; i < old_n_buckets; ++i) {
+		for (auto *slot = old_buckets[i]; slot != nullptr;) {
+			auto *next = slot->next;
+			auto &bucket = GetBucket(slot->hash);
+			slot->next = bucket;
+			bucket = slot;
+			slot = next;
+		}
+	}
+
+	delete[] old_buckets;
 }
 
-TagItem *
-tag_pool_get_item(TagType type, StringView value) noexcept
+inline TagItem *
+TagPoolShard::Get(unsigned hash, TagType type, StringView value) noexcept
 {
-	auto slot_p = tag_value_slot_p(type, value);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
-		    value.Equals(slot->item.value) &&
-		    slot->ref < TagPoolSlot::MAX_REF) {
-			assert(slot->ref > 0);
-			++slot->ref;
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (buckets == nullptr)
+		Grow();
+
+	auto &bucket = GetBucket(hash);
+	for (auto slot = bucket; slot != nullptr; slot = slot->next) {
+		if (slot->hash == hash && slot->item.type == type &&
+		    value.Equals(slot->item.value)) {
+			/* the last owner may be waiting for our lock
+			   in Put(); it will see this new reference
+			   and keep the slot */
+			slot->ref.fetch_add(1, std::memory_order_relaxed);
 			return &slot->item;
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value);
-	*slot_p = slot;
+	auto slot = TagPoolSlot::Create(bucket, hash, type, value);
+	bucket = slot;
+
+	if (++n_slots > n_buckets * MAX_LOAD_FACTOR)
+		Grow();
+
 	return &slot->item;
 }
 
+inline void
+TagPoolShard::Put(TagPoolSlot &slot) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (slot.ref.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		/* Get() has obtained a new reference meanwhile */
+		return;
+
+	TagPoolSlot **slot_p;
+	for (slot_p = &GetBucket(slot.hash);
+	     *slot_p != &slot;
+	     slot_p = &(*slot_p)->next) {
+		assert(*slot_p != nullptr);
+	}
+
+	*slot_p = slot.next;
+	--n_slots;
+	DeleteVarSize(&slot);
+}
+
+void
+TagPoolShard::CollectStats(TagPoolStats &stats) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	stats.slots += n_slots;
+	stats.buckets += n_buckets;
+
+	for (size_t i = 0; i < n_buckets; ++i) {
+		size_t chain = 0;
+		for (auto *slot = buckets[i]; slot != nullptr; slot = slot->next) {
+			++chain;
+
+			const uint32_t ref = slot->ref.load(std::memory_order_relaxed);
+			const size_t length = strlen(slot->item.value);
+			stats.references += ref;
+			stats.value_bytes += length;
+			stats.referenced_bytes += uint64_t(length) * ref;
+		}
+
+		if (chain > 0) {
+			++stats.used_buckets;
+			stats.max_chain = std::max(stats.max_chain, chain);
+		}
+	}
+}
+
+TagItem *
+tag_pool_get_item(TagType type, StringView value) noexcept
+{
+	const unsigned hash = calc_hash(type, value);
+	return GetShard(hash).Get(hash, type, value);
+}
+
 TagItem *
 tag_pool_dup_item(TagItem *item) noexcept
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	assert(slot->ref > 0);
-
-	if (slot->ref < TagPoolSlot::MAX_REF) {
-		++slot->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above MAX_REF;
-		   obtain a reference to a different TagPoolSlot which
-		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
-	}
+	/* the caller owns a reference, therefore the counter cannot
+	   drop to zero while we increment it, and no lock is
+	   needed */
+	assert(slot->ref.load(std::memory_order_relaxed) > 0);
+	slot->ref.fetch_add(1, std::memory_order_relaxed);
+	return item;
 }
 
 void
 tag_pool_put_item(TagItem *item) noexcept
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
+	/* fast path: drop a reference which is not the last one
+	   without locking the shard */
+	uint32_t ref = slot->ref.load(std::memory_order_relaxed);
+	while (ref > 1) {
+		if (slot->ref.compare_exchange_weak(ref, ref - 1,
+						    std::memory_order_release,
+						    std::memory_order_relaxed))
+			return;
+	}
 
-	if (slot->ref > 0)
-		return;
+	assert(ref == 1);
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
-	}
+	GetShard(slot->hash).Put(*slot);
+}
+
+TagPoolStats
+tag_pool_stats() noexcept
+{
+	TagPoolStats stats{};
+	stats.shards = NUM_SHARDS;
+
+	for (auto &shard : shards)
+		shard.CollectStats(stats);
 
-	*slot_p = slot->next;
-	DeleteVarSize(slot);
+	return stats;
 }
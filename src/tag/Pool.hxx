@@ -21,13 +21,19 @@
 #define MPD_TAG_POOL_HXX
 
 #include "Type.h"
-#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
+#include <stdint.h>
 
 struct TagItem;
 struct StringView;
 
+/*
+ * The tag pool is thread-safe; all functions may be called from any
+ * thread without external locking.
+ */
+
 TagItem *
 tag_pool_get_item(TagType type, StringView value) noexcept;
 
@@ -37,4 +43,72 @@ tag_pool_dup_item(TagItem *item) noexcept;
 void
 tag_pool_put_item(TagItem *item) noexcept;
 
+struct TagPoolStats {
+	/**
+	 * The number of lock shards.
+	 */
+	unsigned shards;
+
+	/**
+	 * The number of distinct (type, value) pairs.
+	 */
+	size_t slots;
+
+	/**
+	 * The total number of hash buckets in all shards.
+	 */
+	size_t buckets;
+
+	/**
+	 * The number of buckets which contain at least one slot.
+	 */
+	size_t used_buckets;
+
+	/**
+	 * The length of the longest hash chain.
+	 */
+	size_t max_chain;
+
+	/**
+	 * The sum of all reference counters, i.e. the number of
+	 * #TagItem pointers handed out to callers.
+	 */
+	uint64_t references;
+
+	/**
+	 * The number of bytes occupied by tag values in the pool.
+	 */
+	size_t value_bytes;
+
+	/**
+	 * The number of value bytes that would have been allocated
+	 * without deduplication.
+	 */
+	uint64_t referenced_bytes;
+
+	gcc_pure
+	double GetAverageChain() const noexcept {
+		return used_buckets > 0
+			? double(slots) / used_buckets
+			: 0;
+	}
+
+	/**
+	 * How many references share one slot on average.
+	 */
+	gcc_pure
+	double GetDedupRatio() const noexcept {
+		return slots > 0
+			? double(references) / slots
+			: 0;
+	}
+};
+
+/**
+ * Collect statistics about the tag pool.  This walks all shards, one
+ * at a time, so the result is not an atomic snapshot.
+ */
+TagPoolStats
+tag_pool_stats() noexcept;
+
 #endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "WorkerPool.hxx"
+#include "Name.hxx"
+#include "Util.hxx"
+
+#include <algorithm>
+#include <utility>
+
+WorkerPool::WorkerPool(const char *_name, unsigned n_threads, bool _idle)
+	:name(_name), idle(_idle)
+{
+	try {
+		for (unsigned i = 0; i < n_threads; ++i) {
+			threads.emplace_front(BIND_THIS_METHOD(Run));
+			threads.front().Start();
+		}
+	} catch (...) {
+		/* stop the threads which were started already (the
+		   last one was not) */
+		threads.pop_front();
+		Stop();
+		throw;
+	}
+}
+
+WorkerPool::~WorkerPool() noexcept
+{
+	Stop();
+}
+
+void
+WorkerPool::Stop() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		quit = true;
+		work_cond.broadcast();
+	}
+
+	for (auto &i : threads)
+		i.Join();
+	threads.clear();
+
+	assert(groups.empty());
+}
+
+void
+WorkerPool::Push(Group &group, Job &&job) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	group.queue.emplace_back(std::move(job));
+
+	if (!group.scheduled && !threads.empty()) {
+		group.scheduled = true;
+		groups.push_back(&group);
+		work_cond.signal();
+	}
+}
+
+void
+WorkerPool::RunOne(Group &group) noexcept
+{
+	assert(!group.queue.empty());
+
+	Job job = std::move(group.queue.front());
+	group.queue.pop_front();
+	++group.running;
+
+	std::exception_ptr error;
+
+	{
+		const ScopeUnlock unlock(mutex);
+
+		try {
+			job();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	if (error && !group.error)
+		group.error = std::move(error);
+
+	assert(group.running > 0);
+	if (--group.running == 0 && group.queue.empty())
+		done_cond.broadcast();
+}
+
+void
+WorkerPool::Wait(Group &group)
+{
+	std::exception_ptr error;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		while (true) {
+			if (!group.queue.empty())
+				RunOne(group);
+			else if (group.running > 0)
+				done_cond.wait(mutex);
+			else
+				break;
+		}
+
+		if (group.scheduled) {
+			/* the workers would drop the empty group
+			   eventually, but it's about to be
+			   destroyed */
+			groups.erase(std::find(groups.begin(), groups.end(),
+					       &group));
+			group.scheduled = false;
+		}
+
+		/* reset the group, so it can be reused */
+		error = std::exchange(group.error, nullptr);
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void
+WorkerPool::Run() noexcept
+{
+	SetThreadName(name);
+
+	if (idle)
+		SetThreadIdlePriority();
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (!quit) {
+		if (groups.empty()) {
+			work_cond.wait(mutex);
+			continue;
+		}
+
+		Group &group = *groups.front();
+		if (group.queue.empty()) {
+			groups.pop_front();
+			group.scheduled = false;
+			continue;
+		}
+
+		RunOne(group);
+	}
+}
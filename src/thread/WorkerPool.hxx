@@ -0,0 +1,173 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_WORKER_POOL_HXX
+#define MPD_THREAD_WORKER_POOL_HXX
+
+#include "Thread.hxx"
+#include "Mutex.hxx"
+#include "Cond.hxx"
+#include "util/Compiler.h"
+
+#include <deque>
+#include <exception>
+#include <forward_list>
+#include <functional>
+
+#include <assert.h>
+
+/**
+ * A fixed number of threads which execute jobs submitted by other
+ * threads.  Jobs are submitted to a #Group, and the submitter waits
+ * for completion of the whole group with Wait().
+ *
+ * While waiting, the calling thread helps by executing jobs of the
+ * same group.  A job may itself submit jobs to another group and
+ * wait for them; since a thread only ever executes jobs of the
+ * group it is waiting for, nested groups form a tree, and this
+ * cannot deadlock even if all workers are waiting.
+ *
+ * A pool with zero threads is valid: all jobs are then executed by
+ * Wait() in the calling thread, in submission order.
+ *
+ * If a job throws, the exception is rethrown by Wait(); the other
+ * jobs of the group are still executed.
+ */
+class WorkerPool {
+public:
+	typedef std::function<void()> Job;
+
+	class Group {
+		friend class WorkerPool;
+
+		/**
+		 * Jobs which have not yet been started.
+		 */
+		std::deque<Job> queue;
+
+		/**
+		 * The number of jobs currently being executed.
+		 */
+		unsigned running = 0;
+
+		/**
+		 * Is this group listed in WorkerPool::groups?
+		 */
+		bool scheduled = false;
+
+		/**
+		 * The first exception thrown by a job of this group;
+		 * it is rethrown by WorkerPool::Wait().
+		 */
+		std::exception_ptr error;
+
+	public:
+		Group() = default;
+
+		Group(const Group &) = delete;
+		Group &operator=(const Group &) = delete;
+
+		~Group() noexcept {
+			/* WorkerPool::Wait() must have been called */
+			assert(queue.empty());
+			assert(running == 0);
+		}
+	};
+
+private:
+	const char *const name;
+	const bool idle;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when jobs are submitted or when the pool shall
+	 * quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Signalled when a job has finished.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Groups which have queued jobs, oldest first.
+	 */
+	std::deque<Group *> groups;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param _name the name of the worker threads
+	 * @param n_threads the number of worker threads to be started
+	 * @param _idle run the workers with "idle" priority?
+	 */
+	WorkerPool(const char *_name, unsigned n_threads, bool _idle=false);
+
+	~WorkerPool() noexcept;
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/**
+	 * Returns true if this pool has no threads, i.e. all jobs
+	 * are executed by Wait() in the calling thread.
+	 */
+	bool IsSerial() const noexcept {
+		return threads.empty();
+	}
+
+	/**
+	 * Submit a job.  If it throws, the exception is rethrown by
+	 * Wait().
+	 */
+	void Push(Group &group, Job &&job) noexcept;
+
+	/**
+	 * Execute or wait for all jobs of the given group, including
+	 * those which are submitted while waiting.
+	 *
+	 * Throws the first exception thrown by one of the jobs (after
+	 * all of them have finished).
+	 */
+	void Wait(Group &group);
+
+private:
+	void Stop() noexcept;
+
+	/**
+	 * Remove the next job from the group and execute it.  The
+	 * mutex is released while the job runs.  An exception thrown
+	 * by the job is stored in Group::error.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void RunOne(Group &group) noexcept;
+
+	/* the worker thread function */
+	void Run() noexcept;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOCK_FREE_SLICE_BUFFER_HXX
+#define MPD_LOCK_FREE_SLICE_BUFFER_HXX
+
+#include "HugeAllocator.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <new>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * A variant of #SliceBuffer which may be used by multiple threads
+ * concurrently without a mutex.  The free list is a Treiber stack of
+ * slice indexes; the stack head is tagged with a modification
+ * counter to avoid the ABA problem.
+ *
+ * Unlike #SliceBuffer, this class never discards its memory when
+ * the last slice is freed, because another thread may be allocating
+ * at the same time.
+ */
+template<typename T>
+class LockFreeSliceBuffer {
+	union Slice {
+		char dummy;
+
+		T value;
+	};
+
+	static constexpr uint32_t END = ~uint32_t(0);
+
+	HugeArray<Slice> buffer;
+
+	/**
+	 * The "next" pointers of the free list.  They are not stored
+	 * inside the slices, because a concurrent Allocate() may
+	 * read the link of a slice which was just handed out.
+	 */
+	std::unique_ptr<std::atomic<uint32_t>[]> next_free;
+
+	/**
+	 * The top of the free list: the lower 32 bits are the slice
+	 * index (or #END), the upper 32 bits are a tag which is
+	 * incremented on each modification.
+	 */
+	std::atomic<uint64_t> available{END};
+
+	/**
+	 * The number of slices that were ever handed out.  Slices
+	 * beyond this index have never been touched, which avoids
+	 * page faults until the memory is really needed.
+	 */
+	std::atomic<unsigned> n_initialized{0};
+
+	/**
+	 * The number of slices currently allocated.
+	 */
+	std::atomic<unsigned> n_allocated{0};
+
+public:
+	explicit LockFreeSliceBuffer(unsigned _count)
+		:buffer(_count),
+		 next_free(new std::atomic<uint32_t>[buffer.size()]) {
+		buffer.ForkCow(false);
+	}
+
+	~LockFreeSliceBuffer() noexcept {
+		/* all slices must be freed explicitly, and this
+		   assertion checks for leaks */
+		assert(n_allocated.load() == 0);
+	}
+
+	LockFreeSliceBuffer(const LockFreeSliceBuffer &other) = delete;
+	LockFreeSliceBuffer &operator=(const LockFreeSliceBuffer &other) = delete;
+
+	unsigned GetCapacity() const noexcept {
+		return buffer.size();
+	}
+
+	bool empty() const noexcept {
+		return n_allocated.load(std::memory_order_relaxed) == 0;
+	}
+
+	bool IsFull() const noexcept {
+		return n_allocated.load(std::memory_order_relaxed) == buffer.size();
+	}
+
+	/**
+	 * Returns the index of the specified (allocated) slice, a
+	 * number between 0 and GetCapacity()-1.
+	 */
+	gcc_pure
+	unsigned IndexOf(const T *value) const noexcept {
+		const Slice *slice = reinterpret_cast<const Slice *>(value);
+		assert(slice >= &buffer.front() && slice <= &buffer.back());
+
+		return slice - &buffer.front();
+	}
+
+	template<typename... Args>
+	T *Allocate(Args&&... args) {
+		uint32_t i = PopFree();
+		if (i == END) {
+			i = InitializeNew();
+			if (i == END)
+				/* out of (internal) memory, buffer is full */
+				return nullptr;
+		}
+
+		n_allocated.fetch_add(1, std::memory_order_relaxed);
+
+		/* construct the object */
+		return ::new((void *)&buffer[i]) T(std::forward<Args>(args)...);
+	}
+
+	void Free(T *value) noexcept {
+		assert(n_allocated.load() > 0);
+
+		const unsigned i = IndexOf(value);
+
+		/* destruct the object */
+		value->~T();
+
+		n_allocated.fetch_sub(1, std::memory_order_relaxed);
+		PushFree(i);
+	}
+
+private:
+	static constexpr uint64_t Pack(uint32_t index, uint32_t tag) noexcept {
+		return uint64_t(tag) << 32 | index;
+	}
+
+	static constexpr uint32_t GetIndex(uint64_t value) noexcept {
+		return uint32_t(value);
+	}
+
+	static constexpr uint32_t GetTag(uint64_t value) noexcept {
+		return uint32_t(value >> 32);
+	}
+
+	uint32_t PopFree() noexcept {
+		uint64_t old = available.load(std::memory_order_acquire);
+		while (true) {
+			const uint32_t i = GetIndex(old);
+			if (i == END)
+				return END;
+
+			const uint32_t next =
+				next_free[i].load(std::memory_order_relaxed);
+			if (available.compare_exchange_weak(old,
+							    Pack(next, GetTag(old) + 1),
+							    std::memory_order_acquire,
+							    std::memory_order_acquire))
+				return i;
+		}
+	}
+
+	void PushFree(uint32_t i) noexcept {
+		uint64_t old = available.load(std::memory_order_relaxed);
+		do {
+			next_free[i].store(GetIndex(old),
+					   std::memory_order_relaxed);
+		} while (!available.compare_exchange_weak(old,
+							  Pack(i, GetTag(old) + 1),
+							  std::memory_order_release,
+							  std::memory_order_relaxed));
+	}
+
+	uint32_t InitializeNew() noexcept {
+		unsigned n = n_initialized.load(std::memory_order_relaxed);
+		do {
+			if (n == buffer.size())
+				return END;
+		} while (!n_initialized.compare_exchange_weak(n, n + 1,
+							      std::memory_order_relaxed));
+
+		return n;
+	}
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SegmentBuffer.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+struct SegmentBuffer::Segment {
+	Segment *next = nullptr;
+
+	/**
+	 * The range of #data which is filled.
+	 */
+	size_t start = 0, end = 0;
+
+	static constexpr size_t CAPACITY =
+		SEGMENT_SIZE - 2 * sizeof(size_t) - sizeof(Segment *);
+
+	uint8_t data[CAPACITY];
+
+	size_t GetAvailable() const noexcept {
+		return end - start;
+	}
+};
+
+static_assert(sizeof(SegmentBuffer::Segment) == SegmentBuffer::SEGMENT_SIZE,
+	      "Wrong segment size");
+
+namespace {
+
+/**
+ * A free list of segments.  Each thread has its own instance, so no
+ * locking is needed; segments freed by another thread than the one
+ * which allocated them simply migrate.
+ */
+class SegmentPool {
+	/**
+	 * Never keep more than this number of free segments.
+	 */
+	static constexpr unsigned MAX_FREE = 64;
+
+	SegmentBuffer::Segment *free_list = nullptr;
+	unsigned n_free = 0;
+
+public:
+	~SegmentPool() noexcept {
+		while (free_list != nullptr) {
+			auto *s = free_list;
+			free_list = s->next;
+			delete s;
+		}
+	}
+
+	SegmentBuffer::Segment *Allocate() {
+		auto *s = free_list;
+		if (s == nullptr)
+			return new SegmentBuffer::Segment;
+
+		free_list = s->next;
+		--n_free;
+
+		s->next = nullptr;
+		s->start = s->end = 0;
+		return s;
+	}
+
+	void Free(SegmentBuffer::Segment *s) noexcept {
+		if (n_free >= MAX_FREE) {
+			delete s;
+			return;
+		}
+
+		s->next = free_list;
+		free_list = s;
+		++n_free;
+	}
+};
+
+static thread_local SegmentPool segment_pool;
+
+}
+
+SegmentBuffer::~SegmentBuffer() noexcept
+{
+	while (head != nullptr) {
+		auto *s = head;
+		head = s->next;
+		segment_pool.Free(s);
+	}
+}
+
+WritableBuffer<void>
+SegmentBuffer::Write()
+{
+	if (size >= max_size)
+		return nullptr;
+
+	if (tail == nullptr || tail->end == Segment::CAPACITY) {
+		auto *s = segment_pool.Allocate();
+		if (tail == nullptr)
+			head = s;
+		else
+			tail->next = s;
+		tail = s;
+	}
+
+	const size_t n = std::min(Segment::CAPACITY - tail->end,
+				  max_size - size);
+	return {tail->data + tail->end, n};
+}
+
+void
+SegmentBuffer::Append(size_t length) noexcept
+{
+	assert(tail != nullptr);
+	assert(tail->end + length <= Segment::CAPACITY);
+
+	tail->end += length;
+	size += length;
+}
+
+bool
+SegmentBuffer::Append(const void *data, size_t length)
+{
+	while (length > 0) {
+		auto w = Write();
+		if (w.empty())
+			return false;
+
+		const size_t nbytes = std::min(length, w.size);
+		memcpy(w.data, data, nbytes);
+		Append(nbytes);
+
+		data = (const uint8_t *)data + nbytes;
+		length -= nbytes;
+	}
+
+	return true;
+}
+
+ConstBuffer<void>
+SegmentBuffer::Read() const noexcept
+{
+	ConstBuffer<void> result;
+	if (Read(&result, 1) == 0)
+		return nullptr;
+
+	return result;
+}
+
+size_t
+SegmentBuffer::Read(ConstBuffer<void> *dest, size_t max) const noexcept
+{
+	size_t n = 0;
+
+	for (const auto *s = head; s != nullptr && n < max; s = s->next) {
+		if (s->GetAvailable() == 0)
+			/* this can only be the tail allocated by
+			   Write() */
+			continue;
+
+		dest[n++] = {s->data + s->start, s->GetAvailable()};
+	}
+
+	return n;
+}
+
+void
+SegmentBuffer::Consume(size_t length) noexcept
+{
+	assert(length <= size);
+
+	size -= length;
+
+	while (length > 0) {
+		assert(head != nullptr);
+
+		const size_t nbytes = std::min(length, head->GetAvailable());
+		head->start += nbytes;
+		length -= nbytes;
+
+		if (head->start == head->end && head->end == Segment::CAPACITY) {
+			/* this segment is used up */
+			auto *s = head;
+			head = s->next;
+			if (head == nullptr)
+				tail = nullptr;
+			segment_pool.Free(s);
+		}
+	}
+
+	if (size == 0 && head != nullptr) {
+		/* rewind the last segment instead of allocating a new
+		   one for the next response */
+		assert(head == tail);
+		head->start = head->end = 0;
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SEGMENT_BUFFER_HXX
+#define MPD_SEGMENT_BUFFER_HXX
+
+#include "ConstBuffer.hxx"
+#include "WritableBuffer.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A FIFO buffer which consists of a chain of fixed-size segments.
+ * Unlike #PeakBuffer, it grows in small steps and never needs to
+ * move data, and all filled segments can be passed to the kernel at
+ * once (e.g. with sendmsg()).  Segments are recycled through a small
+ * per-thread pool, so serving large responses does not hit the heap
+ * allocator for each of them.
+ */
+class SegmentBuffer {
+public:
+	/**
+	 * The size of one segment including its header.
+	 */
+	static constexpr size_t SEGMENT_SIZE = 16384;
+
+	struct Segment;
+
+private:
+	Segment *head = nullptr, *tail = nullptr;
+
+	/**
+	 * The number of bytes which have been appended but not yet
+	 * consumed.
+	 */
+	size_t size = 0;
+
+	/**
+	 * The maximum value of #size.
+	 */
+	const size_t max_size;
+
+public:
+	explicit SegmentBuffer(size_t _max_size) noexcept
+		:max_size(_max_size) {}
+
+	~SegmentBuffer() noexcept;
+
+	SegmentBuffer(const SegmentBuffer &) = delete;
+	SegmentBuffer &operator=(const SegmentBuffer &) = delete;
+
+	bool empty() const noexcept {
+		return size == 0;
+	}
+
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Prepare writing to the end of the buffer.  Call Append()
+	 * after filling (a part of) the returned buffer.
+	 *
+	 * Throws std::bad_alloc if a new segment cannot be allocated.
+	 *
+	 * @return a writable buffer; empty if the buffer is full
+	 */
+	WritableBuffer<void> Write();
+
+	/**
+	 * Commit data written into the buffer returned by Write().
+	 */
+	void Append(size_t length) noexcept;
+
+	/**
+	 * Copy data to the end of the buffer.
+	 *
+	 * @return false if the buffer is full (a part of the data
+	 * may have been appended)
+	 */
+	bool Append(const void *data, size_t length);
+
+	/**
+	 * Return the first filled segment.
+	 */
+	gcc_pure
+	ConstBuffer<void> Read() const noexcept;
+
+	/**
+	 * Fill the given array with the filled segments.
+	 *
+	 * @return the number of array elements used
+	 */
+	size_t Read(ConstBuffer<void> *dest, size_t max) const noexcept;
+
+	/**
+	 * Remove data from the beginning of the buffer; segments
+	 * which become empty are returned to the pool.
+	 */
+	void Consume(size_t length) noexcept;
+};
+
+#endif
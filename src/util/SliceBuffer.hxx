@@ -87,6 +87,18 @@ public:
 		return n_allocated == buffer.size();
 	}
 
+	/**
+	 * Returns the index of the specified (allocated) slice, a
+	 * number between 0 and GetCapacity()-1.
+	 */
+	gcc_pure
+	unsigned IndexOf(const T *value) const noexcept {
+		const Slice *slice = reinterpret_cast<const Slice *>(value);
+		assert(slice >= &buffer.front() && slice <= &buffer.back());
+
+		return slice - &buffer.front();
+	}
+
 	void DiscardMemory() noexcept {
 		assert(empty());
 
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SPSC_QUEUE_HXX
+#define MPD_SPSC_QUEUE_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * A bounded lock-free FIFO for exactly one producer thread and
+ * exactly one consumer thread.  The roles may be handed over to
+ * another thread, but only after synchronizing with the previous
+ * owner (e.g. through a mutex).
+ *
+ * Push() may only be called by the producer; Shift(), Front() and
+ * ForEach() only by the consumer.  GetSize() may be called by anybody,
+ * but the value may be stale by the time it is returned.
+ */
+template<typename T>
+class SpscQueue {
+	/**
+	 * One more slot than the capacity, to distinguish "full"
+	 * from "empty" without a shared counter.
+	 */
+	const size_t n_slots;
+
+	std::unique_ptr<T[]> slots;
+
+	/**
+	 * The index of the oldest item.  Written only by the
+	 * consumer.
+	 */
+	std::atomic<size_t> head{0};
+
+	/**
+	 * The index of the next free slot.  Written only by the
+	 * producer.
+	 */
+	std::atomic<size_t> tail{0};
+
+public:
+	explicit SpscQueue(size_t capacity)
+		:n_slots(capacity + 1), slots(new T[n_slots]) {}
+
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+
+	size_t GetCapacity() const noexcept {
+		return n_slots - 1;
+	}
+
+	gcc_pure
+	size_t GetSize() const noexcept {
+		const size_t t = tail.load(std::memory_order_acquire);
+		const size_t h = head.load(std::memory_order_acquire);
+		return (t + n_slots - h) % n_slots;
+	}
+
+	gcc_pure
+	bool IsEmpty() const noexcept {
+		return head.load(std::memory_order_acquire) ==
+			tail.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Append an item.  Only the producer may call this.
+	 *
+	 * @return false if the queue is full (the item is left
+	 * untouched)
+	 */
+	bool Push(T &&value) noexcept {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		const size_t next = Next(t);
+		if (next == head.load(std::memory_order_acquire))
+			return false;
+
+		slots[t] = std::move(value);
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Returns a pointer to the oldest item, or nullptr if the
+	 * queue is empty.  Only the consumer may call this.
+	 */
+	T *Front() noexcept {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &slots[h];
+	}
+
+	/**
+	 * Remove the oldest item and return it; returns a
+	 * default-constructed value if the queue is empty.  Only the
+	 * consumer may call this.
+	 */
+	T Shift() noexcept {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return T();
+
+		T value = std::move(slots[h]);
+		head.store(Next(h), std::memory_order_release);
+		return value;
+	}
+
+	/**
+	 * Invoke the given function for each item, from oldest to
+	 * newest.  Only the consumer may call this.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		const size_t t = tail.load(std::memory_order_acquire);
+		for (size_t i = head.load(std::memory_order_relaxed);
+		     i != t; i = Next(i))
+			f(slots[i]);
+	}
+
+private:
+	size_t Next(size_t i) const noexcept {
+		assert(i < n_slots);
+
+		return ++i == n_slots ? 0 : i;
+	}
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program converts a "simple" database file between the text
+ * and the binary format.  The input format is detected
+ * automatically.
+ *
+ * If the MPD configuration file disables some tags
+ * ("metadata_to_use"), pass it as the last argument, or the tag list
+ * check will reject the input file.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/BinaryDatabase.hxx"
+#include "config/File.hxx"
+#include "config/Migrate.hxx"
+#include "config/Data.hxx"
+#include "tag/Config.hxx"
+#include "fs/Path.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringAPI.hxx"
+#include "util/PrintException.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "fs/io/GzipOutputStream.hxx"
+#endif
+
+#include <memory>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static void
+Save(Path path, const Directory &root, const char *format)
+{
+	FileOutputStream fos(path);
+
+	if (StringIsEqual(format, "binary")) {
+		BufferedOutputStream bos(fos);
+		db_save_binary(bos, root);
+		bos.Flush();
+	} else if (StringIsEqual(format, "text")) {
+		BufferedOutputStream bos(fos);
+		db_save_internal(bos, root);
+		bos.Flush();
+#ifdef ENABLE_ZLIB
+	} else if (StringIsEqual(format, "gzip")) {
+		GzipOutputStream gzip(fos);
+		BufferedOutputStream bos(gzip);
+		db_save_internal(bos, root);
+		bos.Flush();
+		gzip.Flush();
+#endif
+	} else
+		throw std::runtime_error("Unknown format");
+
+	fos.Commit();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc != 4 && argc != 5) {
+		fprintf(stderr, "Usage: ConvertDatabase INPUT OUTPUT text|gzip|binary [CONFIG]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path input_path = Path::FromFS(argv[1]);
+	const Path output_path = Path::FromFS(argv[2]);
+	const char *const format = argv[3];
+
+	if (argc == 5) {
+		ConfigData config;
+		ReadConfigFile(config, Path::FromFS(argv[4]));
+		Migrate(config);
+		TagLoadConfig(config);
+	}
+
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+	db_load_file(input_path, *root);
+
+	Save(output_path, *root, format);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
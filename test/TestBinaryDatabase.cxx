@@ -0,0 +1,165 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/BinaryDatabase.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "tag/Builder.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	void Write(const void *data, size_t size) override {
+		value.append((const char *)data, size);
+	}
+};
+
+static std::string
+SaveText(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_internal(bos, root);
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+static std::string
+SaveBinary(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_binary(bos, root);
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+/**
+ * Copy the image to a properly aligned buffer and load it.
+ */
+static std::unique_ptr<Directory>
+LoadBinary(const std::string &image)
+{
+	std::unique_ptr<uint64_t[]> buffer(new uint64_t[image.size() / 8 + 1]);
+	memcpy(buffer.get(), image.data(), image.size());
+
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+	db_load_binary({buffer.get(), image.size()}, *root);
+	return root;
+}
+
+static void
+AddSong(Directory &directory, const char *name,
+	const char *artist, const char *title)
+{
+	Song *song = Song::NewFile(name, directory);
+
+	TagBuilder tag;
+	tag.SetDuration(SignedSongTime::FromMS(123456));
+	tag.AddItem(TAG_ARTIST, artist);
+	tag.AddItem(TAG_TITLE, title);
+	tag.Commit(song->tag);
+
+	song->mtime = std::chrono::system_clock::from_time_t(1500000000);
+	song->audio_format = AudioFormat(44100, SampleFormat::S16, 2);
+	directory.AddSong(song);
+}
+
+static std::unique_ptr<Directory>
+MakeTree()
+{
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	const ScopeDatabaseLock protect;
+
+	Directory *a = root->CreateChild("a");
+	a->mtime = std::chrono::system_clock::from_time_t(1400000000);
+	AddSong(*a, "1.flac", "Artist", "One");
+	AddSong(*a, "2.flac", "Artist", "Two");
+
+	Directory *b = a->CreateChild("b");
+	AddSong(*b, "3.ogg", "Other", "Three");
+	b->playlists.push_back(PlaylistInfo("list.m3u",
+					    std::chrono::system_clock::from_time_t(1300000000)));
+
+	Directory *c = root->CreateChild("c.cue");
+	c->device = DEVICE_CONTAINER;
+	Song *track = Song::NewFile("track001", *c);
+	track->start_time = SongTime::FromMS(1000);
+	track->end_time = SongTime::FromMS(2000);
+	c->AddSong(track);
+
+	/* many songs, to get a hash index */
+	Directory *many = root->CreateChild("many");
+	for (unsigned i = 0; i < 100; ++i)
+		AddSong(*many, (std::to_string(i) + ".mp3").c_str(),
+			"Artist", std::to_string(i).c_str());
+
+	return root;
+}
+
+TEST(BinaryDatabase, RoundTrip)
+{
+	const auto root = MakeTree();
+	const std::string text = SaveText(*root);
+	const std::string image = SaveBinary(*root);
+
+	EXPECT_TRUE(db_is_binary({image.data(), image.size()}));
+	EXPECT_FALSE(db_is_binary({text.data(), text.size()}));
+
+	const auto loaded = LoadBinary(image);
+	EXPECT_EQ(text, SaveText(*loaded));
+	EXPECT_EQ(image, SaveBinary(*loaded));
+
+	const ScopeDatabaseLock protect;
+	const Directory *many = loaded->FindChild("many");
+	ASSERT_NE(many, nullptr);
+	const Song *song = many->FindSong("42.mp3");
+	ASSERT_NE(song, nullptr);
+	EXPECT_STREQ("42", song->tag.GetValue(TAG_TITLE));
+	EXPECT_EQ(123456, song->tag.duration.ToMS());
+}
+
+TEST(BinaryDatabase, Corrupt)
+{
+	const auto root = MakeTree();
+	const std::string image = SaveBinary(*root);
+
+	/* every truncated image must be rejected */
+	for (size_t size = 0; size < image.size(); size += 7)
+		EXPECT_THROW(LoadBinary(image.substr(0, size)),
+			     std::runtime_error);
+
+	std::string bad = image;
+	bad[12] ^= 0xff;
+	EXPECT_THROW(LoadBinary(bad), std::runtime_error);
+}
@@ -0,0 +1,462 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This test starts the "mpd" executable (path in the environment
+ * variable "MPD") with "client_threads" and talks to it over a local
+ * socket: read-only queries executed by the worker threads run while
+ * other clients modify the queue and update the database through the
+ * main thread.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ftw.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utime.h>
+
+static constexpr unsigned N_DIRECTORIES = 20;
+static constexpr unsigned N_SONGS = 48;
+static constexpr unsigned N_ARTISTS = 4;
+static constexpr unsigned SONGS_PER_ARTIST =
+	N_DIRECTORIES * N_SONGS / N_ARTISTS;
+
+/**
+ * The modification time of all files, which is also stored in the
+ * database, so "update" considers them unmodified.
+ */
+static constexpr time_t FILE_MTIME = 1000000000;
+
+static constexpr unsigned MAX_CONNECTIONS = 20;
+
+static void
+WriteFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+		throw std::runtime_error("Failed to create " + path);
+
+	fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+
+	const struct utimbuf times{FILE_MTIME, FILE_MTIME};
+	utime(path.c_str(), &times);
+}
+
+static int
+RemoveCallback(const char *path, const struct stat *, int, struct FTW *)
+{
+	return remove(path);
+}
+
+/**
+ * A connection to MPD.  Each method throws on error, including an
+ * "ACK" response.
+ */
+class Connection {
+	int fd;
+	std::string buffer;
+
+public:
+	/**
+	 * Connect to the given local socket, retrying until MPD has
+	 * created it.
+	 */
+	explicit Connection(const std::string &path) {
+		struct sockaddr_un sun;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_LOCAL;
+		strncpy(sun.sun_path, path.c_str(), sizeof(sun.sun_path) - 1);
+
+		for (unsigned i = 0;; ++i) {
+			fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+			if (fd < 0)
+				throw std::runtime_error("socket() failed");
+
+			if (connect(fd, (const struct sockaddr *)&sun,
+				    sizeof(sun)) == 0)
+				break;
+
+			close(fd);
+
+			if (i >= 200)
+				throw std::runtime_error("Failed to connect");
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+
+		const auto greeting = ReadLine();
+		if (greeting.compare(0, 7, "OK MPD ") != 0)
+			throw std::runtime_error("Malformed greeting");
+	}
+
+	~Connection() noexcept {
+		if (fd >= 0)
+			close(fd);
+	}
+
+	Connection(const Connection &) = delete;
+	Connection &operator=(const Connection &) = delete;
+
+	void Send(const std::string &s) {
+		size_t position = 0;
+		while (position < s.size()) {
+			ssize_t nbytes = send(fd, s.data() + position,
+					      s.size() - position,
+					      MSG_NOSIGNAL);
+			if (nbytes <= 0)
+				throw std::runtime_error("send() failed");
+
+			position += nbytes;
+		}
+	}
+
+	std::string ReadLine() {
+		while (true) {
+			const auto newline = buffer.find('\n');
+			if (newline != buffer.npos) {
+				std::string line(buffer, 0, newline);
+				buffer.erase(0, newline + 1);
+				return line;
+			}
+
+			char data[16384];
+			ssize_t nbytes = recv(fd, data, sizeof(data), 0);
+			if (nbytes <= 0)
+				throw std::runtime_error("Connection closed");
+
+			buffer.append(data, nbytes);
+		}
+	}
+
+	/**
+	 * Read a response until "OK" and return its lines (without
+	 * the "OK").
+	 */
+	std::vector<std::string> ReadResponse() {
+		std::vector<std::string> lines;
+
+		while (true) {
+			auto line = ReadLine();
+			if (line == "OK")
+				return lines;
+
+			if (line.compare(0, 4, "ACK ") == 0)
+				throw std::runtime_error(line);
+
+			lines.emplace_back(std::move(line));
+		}
+	}
+
+	std::vector<std::string> Command(const std::string &command) {
+		Send(command + "\n");
+		return ReadResponse();
+	}
+};
+
+static unsigned
+CountPrefix(const std::vector<std::string> &lines, const char *prefix)
+{
+	unsigned n = 0;
+	for (const auto &i : lines)
+		if (i.compare(0, strlen(prefix), prefix) == 0)
+			++n;
+	return n;
+}
+
+class ClientThreads : public ::testing::Test {
+protected:
+	std::string directory, socket_path;
+	pid_t pid = -1;
+
+	void SetUp() override {
+		const char *mpd = getenv("MPD");
+		if (mpd == nullptr)
+			GTEST_SKIP();
+
+		char tmp[] = "/tmp/mpd-test-XXXXXX";
+		ASSERT_NE(mkdtemp(tmp), nullptr);
+		directory = tmp;
+		socket_path = directory + "/socket";
+
+		CreateDatabase();
+
+		WriteFile(directory + "/mpd.conf",
+			  "music_directory \"" + directory + "/music\"\n"
+			  "database {\n"
+			  "  plugin \"simple\"\n"
+			  "  path \"" + directory + "/db\"\n"
+			  "}\n"
+			  "bind_to_address \"" + socket_path + "\"\n"
+			  "log_file \"" + directory + "/log\"\n"
+			  "metadata_to_use \"artist,title\"\n"
+			  "max_connections \"" + std::to_string(MAX_CONNECTIONS) + "\"\n"
+			  "client_threads \"4\"\n"
+			  "update_threads \"4\"\n"
+			  "audio_output {\n"
+			  "  type \"null\"\n"
+			  "  name \"null\"\n"
+			  "}\n");
+
+		pid = fork();
+		ASSERT_GE(pid, 0);
+		if (pid == 0) {
+			const auto config = directory + "/mpd.conf";
+			execl(mpd, mpd, "--no-daemon", config.c_str(),
+			      nullptr);
+			_exit(127);
+		}
+	}
+
+	void TearDown() override {
+		if (pid > 0) {
+			kill(pid, SIGTERM);
+
+			int status;
+			ASSERT_EQ(waitpid(pid, &status, 0), pid);
+
+			/* a crash or an assertion failure while
+			   shutting down the client threads shows up
+			   here */
+			EXPECT_TRUE(WIFEXITED(status));
+			EXPECT_EQ(WEXITSTATUS(status), 0);
+		}
+
+		if (!directory.empty())
+			nftw(directory.c_str(), RemoveCallback, 16,
+			     FTW_DEPTH|FTW_PHYS);
+	}
+
+	/**
+	 * Create the music directory and a matching text database,
+	 * so the test does not depend on any decoder plugin.
+	 */
+	void CreateDatabase() {
+		const auto music = directory + "/music";
+		mkdir(music.c_str(), 0777);
+
+		std::string db =
+			"info_begin\n"
+			"format: 2\n"
+			"mpd_version: 0.21\n"
+			"fs_charset: UTF-8\n"
+			"tag: Artist\n"
+			"tag: Title\n"
+			"info_end\n";
+
+		for (unsigned i = 0; i < N_DIRECTORIES; ++i) {
+			const auto name = "dir" + std::to_string(i);
+			mkdir((music + "/" + name).c_str(), 0777);
+
+			db += "directory: " + name + "\n"
+				"mtime: " + std::to_string(FILE_MTIME) + "\n"
+				"begin: " + name + "\n";
+
+			for (unsigned j = 0; j < N_SONGS; ++j) {
+				const auto song = "song" + std::to_string(j) + ".test";
+				WriteFile(music + "/" + name + "/" + song, "");
+
+				db += "song_begin: " + song + "\n"
+					"Artist: artist" + std::to_string(j % N_ARTISTS) + "\n"
+					"Title: " + song + "\n"
+					"mtime: " + std::to_string(FILE_MTIME) + "\n"
+					"song_end\n";
+			}
+
+			/* a new playlist file gives the update
+			   something to modify */
+			WriteFile(music + "/" + name + "/list.m3u",
+				  name + "/song0.test\n");
+
+			db += "end: " + name + "\n";
+		}
+
+		WriteFile(directory + "/db", db);
+	}
+
+	void WaitUpdate(Connection &c) {
+		while (CountPrefix(c.Command("status"), "updating_db: ") > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	/**
+	 * Is the MPD process still running?
+	 */
+	bool IsAlive() noexcept {
+		int status;
+		return waitpid(pid, &status, WNOHANG) == 0;
+	}
+};
+
+TEST_F(ClientThreads, ConcurrentFindAndWrite)
+{
+	Connection writer(socket_path);
+
+	std::atomic_bool failed{false};
+	std::vector<std::thread> readers;
+
+	for (unsigned i = 0; i < 8; ++i) {
+		readers.emplace_back([this, &failed, i](){
+			try {
+				Connection c(socket_path);
+				const auto artist = "artist" + std::to_string(i % N_ARTISTS);
+
+				for (unsigned j = 0; j < 30; ++j) {
+					if (CountPrefix(c.Command("find artist " + artist),
+							"file: ") != SONGS_PER_ARTIST)
+						failed = true;
+
+					const auto count = c.Command("count artist " + artist);
+					if (count.empty() ||
+					    count.front() != "songs: " + std::to_string(SONGS_PER_ARTIST))
+						failed = true;
+
+					if (CountPrefix(c.Command("list artist"),
+							"Artist: ") != N_ARTISTS)
+						failed = true;
+				}
+			} catch (...) {
+				failed = true;
+			}
+		});
+	}
+
+	/* meanwhile, modify the queue and update the database
+	   through the main thread */
+	for (unsigned i = 0; i < 20; ++i) {
+		const auto name = "dir" + std::to_string(i % N_DIRECTORIES);
+		EXPECT_EQ(CountPrefix(writer.Command("update"),
+				      "updating_db: "), 1u);
+		writer.Command("add " + name);
+		EXPECT_EQ(CountPrefix(writer.Command("playlistinfo"),
+				      "file: "), N_SONGS);
+		writer.Command("clear");
+	}
+
+	for (auto &i : readers)
+		i.join();
+
+	EXPECT_FALSE(failed);
+
+	/* the update has found the playlist files, and all songs are
+	   still there */
+	WaitUpdate(writer);
+	EXPECT_EQ(CountPrefix(writer.Command("lsinfo dir0"), "playlist: "), 1u);
+	EXPECT_EQ(CountPrefix(writer.Command("find artist artist0"), "file: "),
+		  SONGS_PER_ARTIST);
+}
+
+TEST_F(ClientThreads, CloseWhilePending)
+{
+	for (unsigned i = 0; i < 50; ++i) {
+		/* don't exceed "max_connections"; closed clients are
+		   removed asynchronously */
+		if (i % 10 == 9)
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		/* close while the main thread (or the worker thread)
+		   is busy with a command */
+		Connection c(socket_path);
+		switch (i % 3) {
+		case 0:
+			c.Send("update\nstatus\n");
+			break;
+
+		case 1:
+			c.Send("find artist artist1\nplaylistinfo\n");
+			break;
+
+		case 2:
+			c.Send("idle\n");
+			break;
+		}
+	}
+
+	/* all of them have been removed from the client list, even
+	   those which were closed while waiting for the main
+	   thread */
+	bool success = false;
+	for (unsigned i = 0; i < 50 && !success; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		std::vector<std::unique_ptr<Connection>> all;
+
+		try {
+			for (unsigned j = 0; j < MAX_CONNECTIONS; ++j)
+				all.emplace_back(std::make_unique<Connection>(socket_path));
+
+			for (auto &c : all)
+				c->Command("ping");
+		} catch (...) {
+			continue;
+		}
+
+		WaitUpdate(*all.front());
+		success = true;
+	}
+
+	EXPECT_TRUE(success);
+	EXPECT_TRUE(IsAlive());
+}
+
+TEST_F(ClientThreads, Idle)
+{
+	Connection a(socket_path), b(socket_path);
+
+	/* an event from another client wakes up "idle" */
+	a.Send("idle playlist\n");
+	b.Command("add dir0");
+	auto response = a.ReadResponse();
+	ASSERT_EQ(response.size(), 1u);
+	EXPECT_EQ(response.front(), "changed: playlist");
+
+	/* the client accepts commands again after that */
+	a.Command("ping");
+	EXPECT_EQ(CountPrefix(a.Command("find artist artist2"), "file: "),
+		  SONGS_PER_ARTIST);
+
+	/* "noidle" cancels "idle" without events */
+	a.Send("idle\n");
+	response = a.Command("noidle");
+	EXPECT_TRUE(response.empty());
+
+	/* a pending event is delivered right away */
+	b.Command("clear");
+	response = a.Command("idle playlist");
+	ASSERT_EQ(response.size(), 1u);
+	EXPECT_EQ(response.front(), "changed: playlist");
+
+	a.Command("ping");
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/DatabaseJournal.hxx"
+#include "db/plugins/simple/BinaryDatabase.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Path.hxx"
+#include "tag/Builder.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	void Write(const void *data, size_t size) override {
+		value.append((const char *)data, size);
+	}
+};
+
+/**
+ * Serialize the tree for comparison.  The order of the entries
+ * matters, but replaying the journal preserves it in these test
+ * cases, therefore Directory::Sort() (which requires ICU
+ * initialization) is not needed here.
+ */
+static std::string
+SaveText(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_internal(bos, root);
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+/**
+ * Duplicate a tree through the binary format.
+ */
+static std::unique_ptr<Directory>
+Duplicate(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_binary(bos, root);
+	bos.Flush();
+
+	std::unique_ptr<uint64_t[]> buffer(new uint64_t[sos.value.size() / 8 + 1]);
+	memcpy(buffer.get(), sos.value.data(), sos.value.size());
+
+	std::unique_ptr<Directory> copy(Directory::NewRoot());
+	db_load_binary({buffer.get(), sos.value.size()}, *copy);
+
+	const ScopeDatabaseLock protect;
+	db_journal_clear(*copy);
+	return copy;
+}
+
+static void
+AddSong(Directory &directory, const char *name, const char *title)
+{
+	Song *song = Song::NewFile(name, directory);
+
+	TagBuilder tag;
+	tag.AddItem(TAG_TITLE, title);
+	tag.Commit(song->tag);
+
+	song->mtime = std::chrono::system_clock::from_time_t(1500000000);
+	directory.AddSong(song);
+}
+
+static std::unique_ptr<Directory>
+MakeTree()
+{
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	const ScopeDatabaseLock protect;
+
+	Directory *a = root->CreateChild("a");
+	a->mtime = std::chrono::system_clock::from_time_t(1400000000);
+	AddSong(*a, "1.flac", "One");
+	AddSong(*a, "2.flac", "Two");
+
+	Directory *b = a->CreateChild("b");
+	AddSong(*b, "3.ogg", "Three");
+	b->playlists.push_back(PlaylistInfo("list.m3u",
+					    std::chrono::system_clock::from_time_t(1300000000)));
+
+	Directory *c = root->CreateChild("c");
+	for (unsigned i = 0; i < 50; ++i)
+		AddSong(*c, (std::to_string(i) + ".mp3").c_str(),
+			std::to_string(i).c_str());
+
+	db_journal_clear(*root);
+	return root;
+}
+
+/**
+ * Replay a journal (which is passed through a temporary file).
+ */
+static int
+Replay(const std::string &journal, Directory &root, const char *base,
+       bool &truncated)
+{
+	char path[] = "/tmp/TestDatabaseJournal.XXXXXX";
+	const int fd = mkstemp(path);
+	if (fd < 0)
+		abort();
+
+	if (write(fd, journal.data(), journal.size()) != ssize_t(journal.size()))
+		abort();
+	close(fd);
+
+	int n;
+	try {
+		n = db_journal_load(Path::FromFS(path), root, base,
+				    truncated);
+	} catch (...) {
+		unlink(path);
+		throw;
+	}
+
+	unlink(path);
+	return n;
+}
+
+static int
+Replay(const std::string &journal, Directory &root, const char *base)
+{
+	bool truncated;
+	const int n = Replay(journal, root, base, truncated);
+	EXPECT_FALSE(truncated);
+	return n;
+}
+
+static std::string
+SaveJournal(Directory &root, const char *base, unsigned &n)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_journal_begin(bos, base);
+
+	{
+		const ScopeDatabaseLock protect;
+		n = db_journal_save(bos, root);
+	}
+
+	bos.Flush();
+	return std::move(sos.value);
+}
+
+TEST(DatabaseJournal, Unmodified)
+{
+	const auto root = MakeTree();
+
+	unsigned n;
+	const auto journal = SaveJournal(*root, "base", n);
+	EXPECT_EQ(0u, n);
+
+	const auto copy = Duplicate(*root);
+	EXPECT_EQ(0, Replay(journal, *copy, "base"));
+	EXPECT_EQ(SaveText(*root), SaveText(*copy));
+}
+
+TEST(DatabaseJournal, Replay)
+{
+	const auto root = MakeTree();
+	const auto base = Duplicate(*root);
+
+	{
+		const ScopeDatabaseLock protect;
+
+		/* new song, new directories */
+		Directory &a = *root->FindChild("a");
+		AddSong(a, "0.flac", "Zero");
+
+		Directory *d = root->CreateChild("d");
+		Directory *e = d->CreateChild("e");
+		AddSong(*e, "4.wav", "Four");
+
+		/* deleted directory and song */
+		a.FindChild("b")->Delete();
+
+		Directory &c = *root->FindChild("c");
+		Song *song = c.FindSong("7.mp3");
+		c.RemoveSong(song);
+		song->Free();
+
+		/* modified attributes and tags */
+		c.mtime = std::chrono::system_clock::from_time_t(1600000000);
+		song = c.FindSong("8.mp3");
+		TagBuilder tag;
+		tag.AddItem(TAG_TITLE, "Eight");
+		tag.Commit(song->tag);
+		c.dirty = true;
+	}
+
+	unsigned n;
+	std::string journal = SaveJournal(*root, "base", n);
+	EXPECT_EQ(5u, n);
+
+	/* a second batch of changes is appended */
+	{
+		const ScopeDatabaseLock protect;
+		root->FindChild("d")->FindChild("e")->Delete();
+	}
+
+	std::string journal2 = SaveJournal(*root, "base", n);
+	EXPECT_EQ(1u, n);
+	journal.append(journal2, journal2.find('\n') + 1, std::string::npos);
+
+	EXPECT_EQ(6, Replay(journal, *base, "base"));
+	EXPECT_EQ(SaveText(*root), SaveText(*base));
+}
+
+TEST(DatabaseJournal, Stale)
+{
+	const auto root = MakeTree();
+	const auto copy = Duplicate(*root);
+
+	{
+		const ScopeDatabaseLock protect;
+		root->CreateChild("x");
+	}
+
+	unsigned n;
+	const auto journal = SaveJournal(*root, "old", n);
+	EXPECT_EQ(-1, Replay(journal, *copy, "new"));
+}
+
+/**
+ * An interrupted write leaves an incomplete record at the end; it is
+ * ignored, but the complete records before it are replayed.
+ */
+TEST(DatabaseJournal, Truncated)
+{
+	const auto root = MakeTree();
+	const auto original = Duplicate(*root);
+
+	{
+		const ScopeDatabaseLock protect;
+		Directory *x = root->CreateChild("x");
+		AddSong(*x, "5.flac", "Five");
+	}
+
+	unsigned n;
+	std::string journal = SaveJournal(*root, "base", n);
+	EXPECT_EQ(2u, n);
+
+	/* the state after the first (complete) batch */
+	const auto expected = Duplicate(*root);
+
+	{
+		const ScopeDatabaseLock protect;
+		Directory &c = *root->FindChild("c");
+		Song *song = c.FindSong("9.mp3");
+		c.RemoveSong(song);
+		song->Free();
+		AddSong(c, "new.mp3", "New");
+	}
+
+	std::string journal2 = SaveJournal(*root, "base", n);
+	EXPECT_EQ(1u, n);
+	journal2.erase(0, journal2.find('\n') + 1);
+
+	/* cut the last record in the middle of a line, at a line
+	   boundary, and right before the end marker */
+	const size_t end_marker = journal2.rfind("journal_end");
+	ASSERT_NE(std::string::npos, end_marker);
+	for (size_t length : {size_t(1), journal2.size() / 2,
+			      journal2.find('\n') + 1, end_marker,
+			      end_marker + 5}) {
+		const auto copy = Duplicate(*original);
+
+		bool truncated;
+		EXPECT_EQ(2, Replay(journal + journal2.substr(0, length),
+				    *copy, "base", truncated));
+		EXPECT_TRUE(truncated);
+		EXPECT_EQ(SaveText(*expected), SaveText(*copy));
+	}
+
+	/* a missing newline after the end marker is harmless */
+	const auto copy = Duplicate(*original);
+	bool truncated;
+	EXPECT_EQ(3, Replay(journal + journal2.substr(0, journal2.size() - 1),
+			    *copy, "base", truncated));
+	EXPECT_FALSE(truncated);
+	EXPECT_EQ(SaveText(*root), SaveText(*copy));
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "output/plugins/httpd/FrameSync.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * Append a MPEG audio frame with the given header and the given
+ * total size.  The payload contains bytes which look like a sync
+ * word.
+ */
+static void
+AppendMpegFrame(std::string &s, uint8_t b1, uint8_t b2, size_t size)
+{
+	const size_t start = s.size();
+	s.push_back('\xff');
+	s.push_back(char(b1));
+	s.push_back(char(b2));
+	s.push_back('\0');
+	s.resize(start + size, '\0');
+	s[start + size / 2] = '\xff';
+	s[start + size / 2 + 1] = '\xfb';
+}
+
+static void
+AppendAdtsFrame(std::string &s, size_t size)
+{
+	const size_t start = s.size();
+	/* MPEG-4, no CRC, AAC LC, 44.1 kHz, stereo */
+	s.push_back('\xff');
+	s.push_back('\xf1');
+	s.push_back('\x50');
+	s.push_back(char(0x80 | (size >> 11)));
+	s.push_back(char(size >> 3));
+	s.push_back(char(((size & 0x7) << 5) | 0x1f));
+	s.push_back('\xfc');
+	s.resize(start + size, '\x42');
+}
+
+static size_t
+GetFrameSize(FrameFormat format, const std::string &s)
+{
+	return GetFrameSize(format, (const uint8_t *)s.data(), s.size());
+}
+
+static size_t
+FindFramesEnd(FrameFormat format, const std::string &s)
+{
+	return FindFramesEnd(format, (const uint8_t *)s.data(), s.size());
+}
+
+TEST(FrameSync, Format)
+{
+	EXPECT_EQ(FrameFormat::MPEG, GetFrameFormat("audio/mpeg"));
+	EXPECT_EQ(FrameFormat::ADTS, GetFrameFormat("audio/aac"));
+	EXPECT_EQ(FrameFormat::ADTS, GetFrameFormat("audio/aacp"));
+	EXPECT_EQ(FrameFormat::NONE, GetFrameFormat("audio/ogg"));
+	EXPECT_EQ(FrameFormat::NONE, GetFrameFormat("audio/wav"));
+	EXPECT_EQ(FrameFormat::NONE, GetFrameFormat(nullptr));
+}
+
+TEST(FrameSync, MpegFrameSize)
+{
+	std::string s;
+
+	/* MPEG-1 layer III, 128 kbit/s, 44.1 kHz */
+	AppendMpegFrame(s, 0xfb, 0x90, 417);
+	EXPECT_EQ(417u, GetFrameSize(FrameFormat::MPEG, s));
+
+	/* same with padding */
+	s.clear();
+	AppendMpegFrame(s, 0xfb, 0x92, 418);
+	EXPECT_EQ(418u, GetFrameSize(FrameFormat::MPEG, s));
+
+	/* MPEG-2 layer III, 64 kbit/s, 22.05 kHz */
+	s.clear();
+	AppendMpegFrame(s, 0xf3, 0x80, 208);
+	EXPECT_EQ(208u, GetFrameSize(FrameFormat::MPEG, s));
+
+	/* MPEG-1 layer II, 192 kbit/s, 48 kHz */
+	s.clear();
+	AppendMpegFrame(s, 0xfd, 0xa4, 576);
+	EXPECT_EQ(576u, GetFrameSize(FrameFormat::MPEG, s));
+
+	/* MPEG-1 layer I, 32 kbit/s, 32 kHz */
+	s.clear();
+	AppendMpegFrame(s, 0xff, 0x18, 48);
+	EXPECT_EQ(48u, GetFrameSize(FrameFormat::MPEG, s));
+
+	/* free format, reserved sample rate, reserved version */
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::MPEG, std::string("\xff\xfb\x00\x00", 4)));
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::MPEG, std::string("\xff\xfb\x9c\x00", 4)));
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::MPEG, std::string("\xff\xeb\x90\x00", 4)));
+
+	/* no sync word, incomplete header */
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::MPEG, std::string("\xfe\xfb\x90\x00", 4)));
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::MPEG, std::string("\xff\xfb\x90", 3)));
+
+	/* ADTS is not MPEG audio */
+	s.clear();
+	AppendAdtsFrame(s, 300);
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::MPEG, s));
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::NONE, s));
+}
+
+TEST(FrameSync, AdtsFrameSize)
+{
+	std::string s;
+	AppendAdtsFrame(s, 371);
+	EXPECT_EQ(371u, GetFrameSize(FrameFormat::ADTS, s));
+
+	s.clear();
+	AppendAdtsFrame(s, 4000);
+	EXPECT_EQ(4000u, GetFrameSize(FrameFormat::ADTS, s));
+
+	/* shorter than its own header */
+	s.clear();
+	AppendAdtsFrame(s, 7);
+	s[5] = '\x1f';
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::ADTS, s));
+
+	/* MPEG audio is not ADTS */
+	s.clear();
+	AppendMpegFrame(s, 0xfb, 0x90, 417);
+	EXPECT_EQ(0u, GetFrameSize(FrameFormat::ADTS, s));
+}
+
+TEST(FrameSync, FindFramesEnd)
+{
+	std::string s;
+	EXPECT_EQ(0u, FindFramesEnd(FrameFormat::MPEG, s));
+
+	AppendMpegFrame(s, 0xfb, 0x90, 417);
+	AppendMpegFrame(s, 0xfb, 0x92, 418);
+	EXPECT_EQ(835u, FindFramesEnd(FrameFormat::MPEG, s));
+
+	/* an incomplete frame stays */
+	AppendMpegFrame(s, 0xfb, 0x90, 417);
+	EXPECT_EQ(835u, FindFramesEnd(FrameFormat::MPEG,
+				      s.substr(0, 835 + 200)));
+
+	/* an incomplete header stays, too */
+	EXPECT_EQ(835u, FindFramesEnd(FrameFormat::MPEG,
+				      s.substr(0, 835 + 2)));
+
+	/* only part of the first frame */
+	EXPECT_EQ(0u, FindFramesEnd(FrameFormat::MPEG, s.substr(0, 100)));
+
+	s.clear();
+	AppendAdtsFrame(s, 300);
+	AppendAdtsFrame(s, 301);
+	AppendAdtsFrame(s, 302);
+	EXPECT_EQ(903u, FindFramesEnd(FrameFormat::ADTS, s));
+	EXPECT_EQ(601u, FindFramesEnd(FrameFormat::ADTS, s.substr(0, 900)));
+}
+
+TEST(FrameSync, Resync)
+{
+	/* garbage before the first frame is sent with it; the sync
+	   word inside the garbage is not mistaken for a frame */
+	std::string s("garbage\xff\xfb\x90\x00 more garbage", 24);
+	const size_t garbage = s.size();
+	AppendMpegFrame(s, 0xfb, 0x90, 417);
+	AppendMpegFrame(s, 0xfb, 0x90, 417);
+	EXPECT_EQ(garbage + 834, FindFramesEnd(FrameFormat::MPEG, s));
+
+	/* the next page begins with the incomplete frame after the
+	   garbage */
+	EXPECT_EQ(garbage + 417,
+		  FindFramesEnd(FrameFormat::MPEG,
+				s.substr(0, garbage + 417 + 100)));
+
+	/* the sync word inside the garbage cannot be verified yet,
+	   so it begins the next page; with more data, it turns out
+	   to be garbage */
+	EXPECT_EQ(7u,
+		  FindFramesEnd(FrameFormat::MPEG,
+				s.substr(0, garbage + 100)));
+	EXPECT_EQ(garbage - 7 + 834,
+		  FindFramesEnd(FrameFormat::MPEG, s.substr(7)));
+
+	/* garbage without any frame is sent as-is */
+	EXPECT_EQ(7u, FindFramesEnd(FrameFormat::MPEG, s.substr(0, 7)));
+}
+
+/**
+ * Split the stream into pages like HttpdOutput::ReadPage() does,
+ * with the encoder returning chunks of random sizes.
+ */
+static std::vector<std::string>
+Paginate(FrameFormat format, const std::string &stream,
+	 size_t page_size, std::mt19937 &rng)
+{
+	std::vector<std::string> pages;
+	std::uniform_int_distribution<size_t> chunk_size(1, 700);
+
+	std::string buffer;
+	size_t position = 0;
+	while (true) {
+		/* "encoder->Read()" */
+		while (buffer.size() < page_size && position < stream.size()) {
+			size_t n = std::min({chunk_size(rng),
+					     page_size - buffer.size(),
+					     stream.size() - position});
+			buffer.append(stream, position, n);
+			position += n;
+		}
+
+		if (buffer.empty())
+			break;
+
+		size_t end = FindFramesEnd(format, buffer);
+		if (end == 0) {
+			if (buffer.size() < page_size) {
+				/* wait for more data */
+				EXPECT_EQ(position, stream.size());
+				break;
+			}
+
+			end = buffer.size();
+		}
+
+		pages.emplace_back(buffer, 0, end);
+		buffer.erase(0, end);
+	}
+
+	/* the incomplete frame at the end is never sent */
+	return pages;
+}
+
+TEST(FrameSync, Alignment)
+{
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<unsigned> kind(0, 3);
+
+	std::string mpeg, adts;
+	for (unsigned i = 0; i < 500; ++i) {
+		switch (kind(rng)) {
+		case 0:
+			AppendMpegFrame(mpeg, 0xfb, 0x90, 417);
+			break;
+
+		case 1:
+			AppendMpegFrame(mpeg, 0xfb, 0x92, 418);
+			break;
+
+		case 2:
+			AppendMpegFrame(mpeg, 0xfd, 0xa4, 576);
+			break;
+
+		case 3:
+			AppendMpegFrame(mpeg, 0xff, 0x18, 48);
+			break;
+		}
+
+		AppendAdtsFrame(adts, 100 + rng() % 1000);
+	}
+
+	for (const size_t page_size : {1200, 4096, 32760}) {
+		for (const auto &i : {std::make_pair(FrameFormat::MPEG, &mpeg),
+				      std::make_pair(FrameFormat::ADTS, &adts)}) {
+			/* cut off the last frame */
+			const std::string stream = i.second->substr(0, i.second->size() - 5);
+
+			const auto pages = Paginate(i.first, stream,
+						    page_size, rng);
+
+			std::string joined;
+			for (const auto &page : pages) {
+				/* each page, i.e. each possible burst
+				   start, begins with a frame */
+				EXPECT_GT(GetFrameSize(i.first, page), 0u);
+				EXPECT_LE(page.size(), page_size);
+				EXPECT_EQ(page.size(), FindFramesEnd(i.first, page));
+				joined += page;
+			}
+
+			/* all complete frames have been sent */
+			EXPECT_EQ(stream.size(), joined.size() +
+				  GetFrameSize(i.first, stream.substr(joined.size())) - 5);
+			EXPECT_EQ(0, stream.compare(0, joined.size(), joined));
+		}
+	}
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "input/cache/Buffer.hxx"
+#include "fs/Path.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <fcntl.h>
+
+static void
+Fill(InputCacheBuffer &buffer, size_t offset, size_t length, uint8_t value)
+{
+	auto w = buffer.Write(offset);
+	ASSERT_GE(w.size, length);
+	memset(w.data, value, length);
+	buffer.Commit(offset, offset + length);
+}
+
+TEST(InputCacheBuffer, Empty)
+{
+	InputCacheBuffer buffer(1024, nullptr);
+
+	EXPECT_TRUE(buffer.Read(0).IsNull());
+	EXPECT_TRUE(buffer.Read(512).IsNull());
+	EXPECT_EQ(buffer.FindHole(0), 0u);
+	EXPECT_EQ(buffer.FindHole(100), 100u);
+
+	auto w = buffer.Write(0);
+	EXPECT_EQ(w.size, 1024u);
+}
+
+TEST(InputCacheBuffer, Holes)
+{
+	InputCacheBuffer buffer(1024, nullptr);
+
+	Fill(buffer, 0, 100, 'a');
+	Fill(buffer, 500, 200, 'b');
+
+	auto r = buffer.Read(0);
+	ASSERT_FALSE(r.IsNull());
+	EXPECT_EQ(r.size, 100u);
+	EXPECT_EQ(r.front(), 'a');
+
+	r = buffer.Read(550);
+	ASSERT_FALSE(r.IsNull());
+	EXPECT_EQ(r.size, 150u);
+	EXPECT_EQ(r.front(), 'b');
+
+	EXPECT_TRUE(buffer.Read(100).IsNull());
+	EXPECT_TRUE(buffer.Read(700).IsNull());
+
+	/* a write must not overlap the following known range */
+	EXPECT_EQ(buffer.Write(100).size, 400u);
+	EXPECT_EQ(buffer.Write(700).size, 324u);
+
+	EXPECT_EQ(buffer.FindHole(0), 100u);
+	EXPECT_EQ(buffer.FindHole(500), 700u);
+
+	/* fill the holes; adjacent ranges get merged */
+	Fill(buffer, 100, 400, 'c');
+	r = buffer.Read(0);
+	ASSERT_FALSE(r.IsNull());
+	EXPECT_EQ(r.size, 700u);
+	EXPECT_EQ(buffer.FindHole(0), 700u);
+
+	Fill(buffer, 700, 324, 'd');
+	EXPECT_EQ(buffer.FindHole(0), 1024u);
+	EXPECT_EQ(buffer.Read(0).size, 1024u);
+	EXPECT_EQ(buffer.Read(1023).back(), 'd');
+}
+
+#if defined(__linux__) && defined(O_TMPFILE)
+
+TEST(InputCacheBuffer, Spill)
+{
+	InputCacheBuffer buffer(65536, Path::FromFS("/tmp"));
+
+	Fill(buffer, 1000, 3000, 'x');
+	EXPECT_EQ(buffer.FindHole(0), 0u);
+	EXPECT_EQ(buffer.FindHole(1000), 4000u);
+
+	auto r = buffer.Read(2000);
+	ASSERT_FALSE(r.IsNull());
+	EXPECT_EQ(r.size, 2000u);
+	EXPECT_EQ(r.front(), 'x');
+}
+
+#endif
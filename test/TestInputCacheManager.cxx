@@ -0,0 +1,284 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "input/cache/Manager.hxx"
+#include "input/cache/Config.hxx"
+#include "input/InputStream.hxx"
+#include "input/CondHandler.hxx"
+#include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+#include <string.h>
+
+/**
+ * The contents of the fake remote files, keyed by URI.  Each byte
+ * is derived from its offset and the file's "generation", which
+ * allows telling a new version of a file from a stale one.
+ */
+struct FakeFile {
+	size_t size;
+	unsigned generation = 0;
+	unsigned n_opens = 0;
+};
+
+static Mutex fake_mutex;
+static std::map<std::string, FakeFile> fake_files;
+
+static uint8_t
+FakeByte(size_t offset, unsigned generation) noexcept
+{
+	return uint8_t(offset * 7 + generation);
+}
+
+class FakeInputStream final : public InputStream {
+	const unsigned generation;
+
+public:
+	FakeInputStream(const char *_uri, Mutex &_mutex,
+			size_t _size, unsigned _generation) noexcept
+		:InputStream(_uri, _mutex), generation(_generation) {
+		size = _size;
+		seekable = true;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	void Seek(offset_type new_offset) override {
+		offset = new_offset;
+	}
+
+	bool IsEOF() noexcept override {
+		return offset == size;
+	}
+
+	size_t Read(void *ptr, size_t read_size) override {
+		auto *p = (uint8_t *)ptr;
+		size_t nbytes = std::min<size_t>(size - offset, read_size);
+		for (size_t i = 0; i < nbytes; ++i)
+			p[i] = FakeByte(offset + i, generation);
+		offset += nbytes;
+		return nbytes;
+	}
+};
+
+/* this replaces the real implementation from input/Open.cxx, so
+   the #InputCacheManager fetches from #fake_files */
+InputStreamPtr
+InputStream::Open(const char *uri, Mutex &mutex)
+{
+	const std::lock_guard<Mutex> protect(fake_mutex);
+	auto i = fake_files.find(uri);
+	if (i == fake_files.end())
+		throw std::runtime_error("No such file");
+
+	++i->second.n_opens;
+	return std::make_unique<FakeInputStream>(uri, mutex,
+						 i->second.size,
+						 i->second.generation);
+}
+
+static void
+AddFakeFile(const char *uri, size_t size, unsigned generation=0)
+{
+	const std::lock_guard<Mutex> protect(fake_mutex);
+	auto &f = fake_files[uri];
+	f.size = size;
+	f.generation = generation;
+}
+
+static unsigned
+GetOpenCount(const char *uri)
+{
+	const std::lock_guard<Mutex> protect(fake_mutex);
+	return fake_files[uri].n_opens;
+}
+
+static std::chrono::system_clock::time_point
+MakeTime(unsigned seconds) noexcept
+{
+	return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+}
+
+static InputCacheConfig
+MakeConfig(unsigned size_kb)
+{
+	ConfigBlock block;
+	block.AddBlockParam("size", std::to_string(size_kb));
+	return InputCacheConfig(block);
+}
+
+/**
+ * A stream opened from the #InputCacheManager, which holds a lease
+ * on its item while it exists.
+ */
+class CachedFile {
+	Mutex mutex;
+	CondInputStreamHandler handler;
+	InputStreamPtr is;
+
+public:
+	CachedFile(InputCacheManager &manager, const char *uri,
+		   std::chrono::system_clock::time_point mtime)
+		:is(manager.Open(uri, mtime, mutex)) {
+		is->SetHandler(&handler);
+
+		const std::lock_guard<Mutex> protect(mutex);
+		while (true) {
+			is->Update();
+			if (is->IsReady())
+				break;
+
+			handler.cond.wait(mutex);
+		}
+
+		is->Check();
+	}
+
+	~CachedFile() noexcept {
+		is->SetHandler(nullptr);
+	}
+
+	/**
+	 * Read the whole file and verify its contents.
+	 */
+	void Verify(size_t size, unsigned generation) {
+		const std::lock_guard<Mutex> protect(mutex);
+		ASSERT_TRUE(is->KnownSize());
+		ASSERT_EQ(offset_type(size), is->GetSize());
+
+		std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+		is->ReadFull(buffer.get(), size);
+		for (size_t i = 0; i < size; ++i)
+			ASSERT_EQ(FakeByte(i, generation), buffer[i]);
+
+		EXPECT_TRUE(is->IsEOF());
+	}
+};
+
+static void
+ReadAndVerify(InputCacheManager &manager, const char *uri,
+	      std::chrono::system_clock::time_point mtime,
+	      size_t size, unsigned generation=0)
+{
+	CachedFile(manager, uri, mtime).Verify(size, generation);
+}
+
+TEST(InputCacheManager, Hit)
+{
+	InputCacheManager manager(MakeConfig(64));
+	AddFakeFile("test://hit", 4000);
+
+	ReadAndVerify(manager, "test://hit", MakeTime(1), 4000);
+	ReadAndVerify(manager, "test://hit", MakeTime(1), 4000);
+	EXPECT_EQ(1u, GetOpenCount("test://hit"));
+}
+
+TEST(InputCacheManager, LRU)
+{
+	/* room for two of these files, but not for three */
+	InputCacheManager manager(MakeConfig(1));
+	AddFakeFile("test://lru/a", 400);
+	AddFakeFile("test://lru/b", 400);
+	AddFakeFile("test://lru/c", 400);
+
+	ReadAndVerify(manager, "test://lru/a", MakeTime(1), 400);
+	ReadAndVerify(manager, "test://lru/b", MakeTime(1), 400);
+
+	/* touch "a", which makes "b" the least recently used
+	   item */
+	ReadAndVerify(manager, "test://lru/a", MakeTime(1), 400);
+	EXPECT_EQ(1u, GetOpenCount("test://lru/a"));
+
+	/* this evicts "b" */
+	ReadAndVerify(manager, "test://lru/c", MakeTime(1), 400);
+
+	ReadAndVerify(manager, "test://lru/a", MakeTime(1), 400);
+	EXPECT_EQ(1u, GetOpenCount("test://lru/a"));
+	EXPECT_EQ(1u, GetOpenCount("test://lru/c"));
+
+	ReadAndVerify(manager, "test://lru/b", MakeTime(1), 400);
+	EXPECT_EQ(2u, GetOpenCount("test://lru/b"));
+}
+
+TEST(InputCacheManager, LeasePinning)
+{
+	InputCacheManager manager(MakeConfig(1));
+	AddFakeFile("test://lease/a", 600);
+	AddFakeFile("test://lease/b", 600);
+
+	{
+		/* "a" is in use, so filling "b" must not evict
+		   it, even though the cache is now over its
+		   limit */
+		CachedFile a(manager, "test://lease/a", MakeTime(1));
+		a.Verify(600, 0);
+
+		ReadAndVerify(manager, "test://lease/b", MakeTime(1), 600);
+
+		ReadAndVerify(manager, "test://lease/a", MakeTime(1), 600);
+		EXPECT_EQ(1u, GetOpenCount("test://lease/a"));
+		EXPECT_EQ(1u, GetOpenCount("test://lease/b"));
+
+		/* releasing the lease performs the postponed
+		   eviction of the least recently used item,
+		   i.e. "b" */
+	}
+
+	ReadAndVerify(manager, "test://lease/a", MakeTime(1), 600);
+	EXPECT_EQ(1u, GetOpenCount("test://lease/a"));
+
+	ReadAndVerify(manager, "test://lease/b", MakeTime(1), 600);
+	EXPECT_EQ(2u, GetOpenCount("test://lease/b"));
+}
+
+TEST(InputCacheManager, StaleModificationTime)
+{
+	InputCacheManager manager(MakeConfig(64));
+	AddFakeFile("test://stale", 3000, 1);
+
+	ReadAndVerify(manager, "test://stale", MakeTime(1), 3000, 1);
+
+	/* the file has been modified; the cached copy must be
+	   replaced, even while a reader still uses it */
+	CachedFile old_reader(manager, "test://stale", MakeTime(1));
+	AddFakeFile("test://stale", 2000, 2);
+
+	ReadAndVerify(manager, "test://stale", MakeTime(2), 2000, 2);
+	EXPECT_EQ(2u, GetOpenCount("test://stale"));
+
+	old_reader.Verify(3000, 1);
+
+	ReadAndVerify(manager, "test://stale", MakeTime(2), 2000, 2);
+	EXPECT_EQ(2u, GetOpenCount("test://stale"));
+}
+
+TEST(InputCacheManager, TooLarge)
+{
+	InputCacheManager manager(MakeConfig(1));
+	AddFakeFile("test://large", 2000);
+
+	/* the item is marked "unsuitable", and the stream falls back
+	   to opening the resource directly */
+	ReadAndVerify(manager, "test://large", MakeTime(1), 2000);
+	ReadAndVerify(manager, "test://large", MakeTime(1), 2000);
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Builder.hxx"
+#include "util/LockFreeSliceBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr unsigned N_CHUNKS = 20000;
+static constexpr unsigned TAG_INTERVAL = 97;
+static constexpr unsigned REPLAY_GAIN_INTERVAL = 53;
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+static unsigned
+ReplayGainSerial(unsigned i)
+{
+	return i / REPLAY_GAIN_INTERVAL + 1;
+}
+
+static void
+Produce(MusicBuffer &buffer, MusicPipe &pipe)
+{
+	for (unsigned i = 0; i < N_CHUNKS;) {
+		auto chunk = buffer.Allocate();
+		if (chunk == nullptr) {
+			/* the consumer is behind; wait until it has
+			   returned some chunks */
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto w = chunk->Write(audio_format, SongTime::zero(), i & 0xffff);
+		ASSERT_GE(w.size, sizeof(i));
+		memcpy(w.data, &i, sizeof(i));
+		chunk->Expand(audio_format, sizeof(i));
+
+		if (i % TAG_INTERVAL == 0) {
+			TagBuilder tag;
+			tag.AddItem(TAG_TITLE, std::to_string(i).c_str());
+			chunk->tag = tag.CommitNew();
+		}
+
+		chunk->replay_gain_serial = ReplayGainSerial(i);
+		chunk->replay_gain_info.Clear();
+		chunk->replay_gain_info.track.gain = ReplayGainSerial(i);
+
+		pipe.Push(std::move(chunk));
+		++i;
+	}
+}
+
+static void
+Consume(MusicPipe &pipe)
+{
+	for (unsigned i = 0; i < N_CHUNKS;) {
+		auto chunk = pipe.Shift();
+		if (chunk == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		ASSERT_EQ(sizeof(i), chunk->length);
+		unsigned value;
+		memcpy(&value, chunk->data, sizeof(value));
+		ASSERT_EQ(i, value);
+		ASSERT_EQ(i & 0xffff, chunk->bit_rate);
+
+		if (i % TAG_INTERVAL == 0) {
+			ASSERT_NE(chunk->tag, nullptr);
+			const char *title = chunk->tag->GetValue(TAG_TITLE);
+			ASSERT_NE(title, nullptr);
+			ASSERT_EQ(i, strtoul(title, nullptr, 10));
+		} else
+			ASSERT_EQ(chunk->tag, nullptr);
+
+		ASSERT_EQ(ReplayGainSerial(i), chunk->replay_gain_serial);
+		ASSERT_EQ(float(ReplayGainSerial(i)),
+			  chunk->replay_gain_info.track.gain);
+		++i;
+	}
+}
+
+static void
+StressPipe(bool lock_free)
+{
+	MusicBuffer buffer(64, DEFAULT_CHUNK_SIZE, lock_free);
+
+	{
+		std::unique_ptr<MusicPipe> pipe;
+		if (lock_free)
+			pipe = std::make_unique<MusicPipe>(buffer.GetSize());
+		else
+			pipe = std::make_unique<MusicPipe>();
+
+		EXPECT_EQ(lock_free, pipe->IsLockFree());
+
+		std::thread producer(Produce, std::ref(buffer), std::ref(*pipe));
+		Consume(*pipe);
+		producer.join();
+
+		EXPECT_TRUE(pipe->IsEmpty());
+	}
+
+#ifndef NDEBUG
+	EXPECT_TRUE(buffer.IsEmptyUnsafe());
+#endif
+}
+
+TEST(MusicPipe, Locked)
+{
+	StressPipe(false);
+}
+
+TEST(MusicPipe, LockFree)
+{
+	StressPipe(true);
+}
+
+TEST(MusicPipe, LockFreeClear)
+{
+	MusicBuffer buffer(8, DEFAULT_CHUNK_SIZE, true);
+	MusicPipe pipe(buffer.GetSize());
+
+	for (unsigned i = 0; i < buffer.GetSize(); ++i) {
+		auto chunk = buffer.Allocate();
+		ASSERT_NE(chunk, nullptr);
+		chunk->Write(audio_format, SongTime::zero(), 0);
+		chunk->Expand(audio_format, audio_format.GetFrameSize());
+		pipe.Push(std::move(chunk));
+	}
+
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_EQ(buffer.GetSize(), pipe.GetSize());
+	EXPECT_EQ(buffer.Allocate(), nullptr);
+
+	pipe.Clear();
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_FALSE(buffer.IsFull());
+}
+
+TEST(MusicBuffer, ChunkSize)
+{
+	static constexpr size_t chunk_size = 16384;
+	MusicBuffer buffer(4, chunk_size);
+	EXPECT_EQ(chunk_size, buffer.GetChunkSize());
+
+	MusicChunkPtr chunks[4];
+	for (auto &chunk : chunks) {
+		chunk = buffer.Allocate();
+		ASSERT_NE(chunk, nullptr);
+		EXPECT_EQ(chunk_size, chunk->capacity);
+
+		auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+		EXPECT_EQ(w.data, chunk->data);
+		EXPECT_EQ(chunk_size, w.size);
+		memset(w.data, 0xab, w.size);
+		EXPECT_TRUE(chunk->Expand(audio_format, w.size));
+	}
+
+	/* the PCM buffers must not overlap */
+	for (unsigned i = 0; i < 4; ++i)
+		for (unsigned j = i + 1; j < 4; ++j)
+			EXPECT_GE(size_t(std::abs(chunks[i]->data - chunks[j]->data)),
+				  chunk_size);
+}
+
+TEST(MusicChunk, CalculateChunkSize)
+{
+	EXPECT_EQ(DEFAULT_CHUNK_SIZE, CalculateChunkSize(audio_format));
+	EXPECT_EQ(DEFAULT_CHUNK_SIZE,
+		  CalculateChunkSize(AudioFormat(22050, SampleFormat::S16, 1)));
+	EXPECT_EQ(size_t(64 * 1024),
+		  CalculateChunkSize(AudioFormat(192000, SampleFormat::S24_P32, 2)));
+	EXPECT_EQ(MAX_CHUNK_SIZE,
+		  CalculateChunkSize(AudioFormat(384000, SampleFormat::S32, 8)));
+	EXPECT_EQ(size_t(128 * 1024),
+		  CalculateChunkSize(AudioFormat(2822400, SampleFormat::DSD, 2)));
+}
+
+/**
+ * Several threads allocate and free concurrently; each one marks its
+ * slices, and verifies that nobody else got the same slice.
+ */
+TEST(LockFreeSliceBuffer, Concurrent)
+{
+	static constexpr unsigned N_THREADS = 4;
+	static constexpr unsigned N_SLICES = 16;
+	static constexpr unsigned N_ITERATIONS = 50000;
+
+	struct Slice {
+		std::atomic<unsigned> owner{0};
+	};
+
+	LockFreeSliceBuffer<Slice> buffer(N_SLICES);
+	std::atomic<unsigned> errors{0};
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 1; t <= N_THREADS; ++t)
+		threads.emplace_back([&buffer, &errors, t](){
+				Slice *mine[3];
+				for (unsigned i = 0; i < N_ITERATIONS; ++i) {
+					unsigned n = 0;
+					for (auto &s : mine) {
+						s = buffer.Allocate();
+						if (s == nullptr)
+							break;
+
+						s->owner.store(t);
+						++n;
+					}
+
+					for (unsigned j = 0; j < n; ++j) {
+						if (mine[j]->owner.load() != t)
+							++errors;
+						buffer.Free(mine[j]);
+					}
+				}
+			});
+
+	for (auto &i : threads)
+		i.join();
+
+	EXPECT_EQ(0u, errors.load());
+	EXPECT_TRUE(buffer.empty());
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "db/plugins/simple/NameIndex.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+
+#include <gtest/gtest.h>
+
+#include <boost/intrusive/list.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+namespace {
+
+struct Item
+	: boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	typedef boost::intrusive::unordered_set_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> IndexHook;
+	IndexHook index_hook;
+
+	std::string name;
+
+	explicit Item(const char *_name):name(_name) {}
+};
+
+struct GetItemName {
+	const char *operator()(const Item &item) const noexcept {
+		return item.name.c_str();
+	}
+};
+
+typedef boost::intrusive::list<Item,
+			       boost::intrusive::constant_time_size<false>> ItemList;
+typedef NameIndex<Item, Item::IndexHook, &Item::index_hook,
+		  GetItemName> ItemIndex;
+
+static std::string
+MakeName(unsigned i)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "item%u", i);
+	return buffer;
+}
+
+/**
+ * Owns a number of #Item instances and a list referring to them.
+ */
+struct Items {
+	std::vector<std::unique_ptr<Item>> storage;
+	ItemList list;
+
+	explicit Items(unsigned n) {
+		for (unsigned i = 0; i < n; ++i)
+			Add(MakeName(i).c_str());
+	}
+
+	~Items() noexcept {
+		list.clear();
+	}
+
+	Item &Add(const char *name) {
+		storage.emplace_back(new Item(name));
+		list.push_back(*storage.back());
+		return *storage.back();
+	}
+};
+
+} // anonymous namespace
+
+TEST(NameIndex, Find)
+{
+	/* enough items to make the index grow several times */
+	Items items(1000);
+	ItemIndex index(items.list);
+	EXPECT_EQ(size_t(1000), index.size());
+
+	for (unsigned i = 0; i < 1000; ++i) {
+		const auto name = MakeName(i);
+		const Item *item = index.Find(name.c_str());
+		ASSERT_NE(item, nullptr);
+		EXPECT_EQ(name, item->name);
+		EXPECT_EQ(items.storage[i].get(), item);
+	}
+
+	EXPECT_EQ(index.Find("item1000"), nullptr);
+	EXPECT_EQ(index.Find("item"), nullptr);
+	EXPECT_EQ(index.Find(""), nullptr);
+}
+
+TEST(NameIndex, InsertErase)
+{
+	Items items(100);
+	ItemIndex index(items.list);
+
+	Item &added = items.Add("new");
+	EXPECT_EQ(index.Find("new"), nullptr);
+	index.Insert(added);
+	EXPECT_EQ(&added, index.Find("new"));
+	EXPECT_EQ(size_t(101), index.size());
+
+	Item &erased = *items.storage[42];
+	index.Erase(erased);
+	EXPECT_EQ(index.Find("item42"), nullptr);
+	EXPECT_EQ(size_t(100), index.size());
+
+	/* the other entries are not affected */
+	EXPECT_EQ(items.storage[41].get(), index.Find("item41"));
+	EXPECT_EQ(items.storage[43].get(), index.Find("item43"));
+}
+
+TEST(NameIndex, Duplicates)
+{
+	Items items(0);
+	Item &a = items.Add("dup");
+	Item &b = items.Add("dup");
+
+	ItemIndex index(items.list);
+	EXPECT_EQ(size_t(2), index.size());
+
+	const Item *found = index.Find("dup");
+	EXPECT_TRUE(found == &a || found == &b);
+
+	/* after erasing one, the other one can still be found */
+	index.Erase(const_cast<Item &>(*found));
+	const Item *other = found == &a ? &b : &a;
+	EXPECT_EQ(other, index.Find("dup"));
+}
+
+TEST(NameIndex, IsWorthwhile)
+{
+	EXPECT_FALSE(ItemIndex::IsWorthwhile(Items(0).list));
+	EXPECT_FALSE(ItemIndex::IsWorthwhile(Items(ItemIndex::THRESHOLD).list));
+	EXPECT_TRUE(ItemIndex::IsWorthwhile(Items(ItemIndex::THRESHOLD + 1).list));
+}
+
+/**
+ * Verify that Directory::FindChild() and Directory::FindSong() work
+ * the same with and without the index, i.e. below and above
+ * NameIndex::THRESHOLD, and after removals.
+ */
+TEST(NameIndex, Directory)
+{
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	const ScopeDatabaseLock protect;
+
+	constexpr unsigned n = 200;
+
+	for (unsigned i = 0; i < n; ++i) {
+		const auto name = MakeName(i);
+		root->CreateChild(name.c_str());
+		root->AddSong(Song::NewFile(name.c_str(), *root));
+
+		/* every entry added so far must be found, no
+		   matter whether the index exists already */
+		for (unsigned j = 0; j <= i; j += 7) {
+			const auto name2 = MakeName(j);
+			const Directory *child = root->FindChild(name2.c_str());
+			ASSERT_NE(child, nullptr);
+			EXPECT_STREQ(name2.c_str(), child->GetName());
+
+			const Song *song = root->FindSong(name2.c_str());
+			ASSERT_NE(song, nullptr);
+			EXPECT_STREQ(name2.c_str(), song->uri);
+		}
+
+		EXPECT_EQ(root->FindChild("missing"), nullptr);
+		EXPECT_EQ(root->FindSong("missing"), nullptr);
+	}
+
+	/* remove every other entry */
+	for (unsigned i = 0; i < n; i += 2) {
+		const auto name = MakeName(i);
+
+		root->FindChild(name.c_str())->Delete();
+
+		Song *song = root->FindSong(name.c_str());
+		root->RemoveSong(song);
+		song->Free();
+	}
+
+	for (unsigned i = 0; i < n; ++i) {
+		const auto name = MakeName(i);
+		if (i % 2 == 0) {
+			EXPECT_EQ(root->FindChild(name.c_str()), nullptr);
+			EXPECT_EQ(root->FindSong(name.c_str()), nullptr);
+		} else {
+			EXPECT_NE(root->FindChild(name.c_str()), nullptr);
+			EXPECT_NE(root->FindSong(name.c_str()), nullptr);
+		}
+	}
+}
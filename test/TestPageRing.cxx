@@ -0,0 +1,153 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "output/plugins/httpd/PageRing.hxx"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <string.h>
+
+static constexpr unsigned N_PAGES = 20000;
+
+static PagePtr
+MakePage(unsigned i)
+{
+	/* pages of different sizes, which contain their own
+	   sequence number */
+	const size_t size = sizeof(i) + i % 7;
+	uint8_t buffer[sizeof(i) + 7];
+	memset(buffer, 0, sizeof(buffer));
+	memcpy(buffer, &i, sizeof(i));
+	return std::make_shared<Page>(buffer, size);
+}
+
+static unsigned
+GetPageNumber(const Page &page)
+{
+	unsigned i;
+	memcpy(&i, page.GetData(), sizeof(i));
+	return i;
+}
+
+TEST(PageRing, Basic)
+{
+	PageRing ring(4);
+	EXPECT_EQ(0u, ring.GetHead());
+	EXPECT_EQ(0u, ring.GetTail());
+	EXPECT_FALSE(ring.IsFull());
+
+	for (unsigned i = 0; i < 4; ++i)
+		EXPECT_TRUE(ring.Push(MakePage(i)));
+
+	EXPECT_TRUE(ring.IsFull());
+
+	auto page = MakePage(4);
+	EXPECT_FALSE(ring.Push(std::move(page)));
+	EXPECT_NE(page, nullptr);
+
+	EXPECT_EQ(4u, ring.GetHead());
+	EXPECT_EQ(2u, GetPageNumber(*ring.Get(2)));
+
+	/* sizes 4+5+6+7 */
+	EXPECT_EQ(22u, ring.GetLag(0));
+	EXPECT_EQ(13u, ring.GetLag(2));
+	EXPECT_EQ(0u, ring.GetLag(4));
+
+	/* a reader may keep a page after it was released */
+	PagePtr kept = ring.Get(1);
+	ring.Release(2);
+	EXPECT_EQ(2u, ring.GetTail());
+	EXPECT_EQ(1u, GetPageNumber(*kept));
+
+	EXPECT_TRUE(ring.Push(std::move(page)));
+	EXPECT_EQ(4u, GetPageNumber(*ring.Get(4)));
+	EXPECT_EQ(6u + 7 + 8, ring.GetLag(2));
+
+	ring.Clear();
+	EXPECT_EQ(5u, ring.GetTail());
+	EXPECT_EQ(0u, ring.GetLag(5));
+}
+
+TEST(PageRing, BurstStart)
+{
+	PageRing ring(16);
+
+	/* sizes 4+5+6+7+8+9+10+4 */
+	for (unsigned i = 0; i < 8; ++i)
+		EXPECT_TRUE(ring.Push(MakePage(i)));
+
+	/* everything fits */
+	EXPECT_EQ(0u, ring.FindBurstStart(0, 1000, 16));
+
+	/* never before the given page */
+	EXPECT_EQ(3u, ring.FindBurstStart(3, 1000, 16));
+
+	/* limited by bytes: the last three pages are 23 bytes */
+	EXPECT_EQ(5u, ring.FindBurstStart(0, 23, 16));
+	EXPECT_EQ(6u, ring.FindBurstStart(0, 22, 16));
+
+	/* limited by pages */
+	EXPECT_EQ(6u, ring.FindBurstStart(0, 1000, 2));
+
+	/* no burst */
+	EXPECT_EQ(8u, ring.FindBurstStart(0, 0, 16));
+	EXPECT_EQ(8u, ring.FindBurstStart(0, 1000, 0));
+	EXPECT_EQ(8u, ring.FindBurstStart(8, 1000, 16));
+}
+
+TEST(PageRing, Concurrent)
+{
+	PageRing ring(64);
+
+	std::thread producer([&ring](){
+			for (unsigned i = 0; i < N_PAGES;) {
+				if (ring.Push(MakePage(i)))
+					++i;
+				else
+					std::this_thread::yield();
+			}
+		});
+
+	/* two readers with different speeds; the slow one reads only
+	   every third round */
+	uint64_t fast = 0, slow = 0;
+	for (unsigned round = 0; slow < N_PAGES; ++round) {
+		const uint64_t head = ring.GetHead();
+
+		if (fast < head) {
+			ASSERT_EQ(fast, GetPageNumber(*ring.Get(fast)));
+			++fast;
+		}
+
+		if (round % 3 == 0 && slow < head) {
+			ASSERT_EQ(slow, GetPageNumber(*ring.Get(slow)));
+			++slow;
+		}
+
+		ring.Release(std::min(fast, slow));
+	}
+
+	producer.join();
+
+	EXPECT_EQ(uint64_t(N_PAGES), fast);
+	EXPECT_EQ(uint64_t(N_PAGES), ring.GetHead());
+	EXPECT_EQ(uint64_t(N_PAGES), ring.GetTail());
+}
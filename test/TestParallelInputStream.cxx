@@ -0,0 +1,332 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "input/ParallelInputStream.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <stdexcept>
+#include <string>
+
+static constexpr offset_type SIZE = 1000;
+static constexpr offset_type RANGE_SIZE = 100;
+
+using Range = ParallelInputStream::Range;
+
+class TestParallelInputStream final : public ParallelInputStream {
+public:
+	unsigned n_schedule = 0;
+
+	explicit TestParallelInputStream(Mutex &_mutex)
+		:ParallelInputStream("test://", _mutex, SIZE, RANGE_SIZE) {
+		SetReady();
+	}
+
+	bool IsSequential() const noexcept {
+		return sequential;
+	}
+
+	void Fail() {
+		postponed_exception =
+			std::make_exception_ptr(std::runtime_error("error"));
+	}
+
+	/**
+	 * Pretend that a request has received the given data.
+	 */
+	void Receive(offset_type start, const std::string &data) {
+		Range range;
+		range.position = start;
+		range.end = start + data.size();
+		range.busy = true;
+		Append(range, {data.data(), data.size()});
+		EXPECT_EQ(range.end, range.position);
+	}
+
+	/* virtual methods from class ParallelInputStream */
+	void DoSchedule() noexcept override {
+		++n_schedule;
+	}
+};
+
+static Range
+MakeRange(offset_type position, offset_type end, bool busy=true)
+{
+	Range range;
+	range.position = position;
+	range.end = end;
+	range.busy = busy;
+	return range;
+}
+
+/**
+ * Returns a string of the given size, each byte derived from its
+ * offset in the resource.
+ */
+static std::string
+MakeData(offset_type start, size_t size, char base='a')
+{
+	std::string data;
+	for (size_t i = 0; i < size; ++i)
+		data.push_back(base + (start + i) % 26);
+	return data;
+}
+
+static std::string
+ReadString(InputStream &is, size_t size)
+{
+	char buffer[SIZE];
+	const size_t nbytes = is.Read(buffer, std::min<size_t>(size,
+							     sizeof(buffer)));
+	return std::string(buffer, nbytes);
+}
+
+TEST(ParallelInputStream, NextRange)
+{
+	Mutex mutex;
+	TestParallelInputStream is(mutex);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	const std::array<Range, 0> none{};
+	offset_type start, end;
+
+	/* an empty buffer is fetched in pieces of RANGE_SIZE */
+	ASSERT_TRUE(is.FindNextRange(none, start, end));
+	EXPECT_EQ(0u, start);
+	EXPECT_EQ(RANGE_SIZE, end);
+
+	/* data which is already known is skipped, and a range ends
+	   at the next known data */
+	is.Receive(0, MakeData(0, 50));
+	is.Receive(120, MakeData(120, 10));
+	ASSERT_TRUE(is.FindNextRange(none, start, end));
+	EXPECT_EQ(50u, start);
+	EXPECT_EQ(120u, end);
+
+	/* starting at the read offset */
+	is.Seek(125);
+	ASSERT_TRUE(is.FindNextRange(none, start, end));
+	EXPECT_EQ(130u, start);
+	EXPECT_EQ(230u, end);
+
+	/* the tail is shorter than RANGE_SIZE */
+	is.Seek(950);
+	ASSERT_TRUE(is.FindNextRange(none, start, end));
+	EXPECT_EQ(950u, start);
+	EXPECT_EQ(SIZE, end);
+
+	/* nothing left after the read offset */
+	is.Receive(950, MakeData(950, 50));
+	EXPECT_FALSE(is.FindNextRange(none, start, end));
+}
+
+TEST(ParallelInputStream, InFlight)
+{
+	Mutex mutex;
+	TestParallelInputStream is(mutex);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	offset_type start, end;
+
+	/* ranges which are being fetched are skipped; an idle one
+	   doesn't count */
+	const std::array<Range, 3> ranges{{
+		MakeRange(0, 100),
+		MakeRange(100, 200),
+		MakeRange(200, 300, false),
+	}};
+	EXPECT_TRUE(is.IsInFlight(ranges, 0));
+	EXPECT_TRUE(is.IsInFlight(ranges, 199));
+	EXPECT_FALSE(is.IsInFlight(ranges, 200));
+	EXPECT_FALSE(is.IsStalled(ranges));
+
+	ASSERT_TRUE(is.FindNextRange(ranges, start, end));
+	EXPECT_EQ(200u, start);
+	EXPECT_EQ(300u, end);
+
+	/* a range which has received part of its data: the rest is
+	   still in flight, the received part is known */
+	is.Receive(400, MakeData(400, 30));
+	const std::array<Range, 1> partial{{MakeRange(430, 500)}};
+	is.Seek(400);
+	ASSERT_TRUE(is.FindNextRange(partial, start, end));
+	EXPECT_EQ(500u, start);
+	EXPECT_EQ(600u, end);
+
+	/* a hole which nobody fetches stalls the reader */
+	is.Seek(300);
+	EXPECT_TRUE(is.IsStalled(ranges));
+	is.Seek(SIZE);
+	EXPECT_FALSE(is.IsStalled(ranges));
+}
+
+TEST(ParallelInputStream, CutAtBusyRange)
+{
+	Mutex mutex;
+	TestParallelInputStream is(mutex);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	offset_type start, end;
+
+	/* after a seek, the new range must not overlap with a range
+	   which is still being fetched ahead of it */
+	const std::array<Range, 2> ranges{{
+		MakeRange(60, 160),
+		/* an idle range doesn't cut */
+		MakeRange(30, 100, false),
+	}};
+	ASSERT_TRUE(is.FindNextRange(ranges, start, end));
+	EXPECT_EQ(0u, start);
+	EXPECT_EQ(60u, end);
+
+	/* a busy range at the very end of RANGE_SIZE doesn't cut */
+	const std::array<Range, 1> far{{MakeRange(100, 200)}};
+	ASSERT_TRUE(is.FindNextRange(far, start, end));
+	EXPECT_EQ(0u, start);
+	EXPECT_EQ(100u, end);
+}
+
+TEST(ParallelInputStream, Victim)
+{
+	std::array<Range, 4> ranges{{
+		MakeRange(300, 400),
+		MakeRange(700, 800),
+		MakeRange(900, 1000, false),
+		MakeRange(50, 100),
+	}};
+
+	/* a range behind the read offset is useless now */
+	EXPECT_EQ(&ranges[3], ParallelInputStream::FindVictim(ranges, 100));
+
+	/* else the one farthest from the read offset */
+	ranges[3].busy = false;
+	EXPECT_EQ(&ranges[1], ParallelInputStream::FindVictim(ranges, 100));
+	EXPECT_EQ(&ranges[1], ParallelInputStream::FindVictim(ranges, 300));
+
+	/* no busy range */
+	ranges[0].busy = ranges[1].busy = false;
+	EXPECT_EQ(nullptr, ParallelInputStream::FindVictim(ranges, 100));
+}
+
+TEST(ParallelInputStream, Append)
+{
+	Mutex mutex;
+	TestParallelInputStream is(mutex);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	/* excess data beyond the end of the range is ignored */
+	Range range = MakeRange(10, 20);
+	const std::string data = MakeData(10, 30);
+	is.Append(range, {data.data(), data.size()});
+	EXPECT_EQ(20u, range.position);
+
+	is.Seek(10);
+	EXPECT_TRUE(is.IsAvailable());
+	EXPECT_EQ(MakeData(10, 10), ReadString(is, 100));
+	EXPECT_FALSE(is.IsAvailable());
+	EXPECT_EQ(0u, is.n_schedule);
+}
+
+TEST(ParallelInputStream, Sequential)
+{
+	Mutex mutex;
+	TestParallelInputStream is(mutex);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	is.Receive(100, MakeData(100, 50, 'A'));
+
+	/* the server responds to a range request with the whole
+	   resource */
+	Range range = MakeRange(500, 600);
+	is.SetSequential(range);
+	EXPECT_TRUE(is.IsSequential());
+	EXPECT_EQ(0u, range.position);
+	EXPECT_EQ(SIZE, range.end);
+
+	/* no more ranges */
+	offset_type start, end;
+	const std::array<Range, 0> none{};
+	EXPECT_FALSE(is.FindNextRange(none, start, end));
+
+	/* the response fills the holes and skips data which is
+	   already known */
+	const std::string data = MakeData(0, SIZE);
+	for (size_t i = 0; i < data.size(); i += 70)
+		is.Append(range, {data.data() + i,
+				  std::min<size_t>(70, data.size() - i)});
+	EXPECT_EQ(SIZE, range.position);
+
+	EXPECT_EQ(data.substr(0, 100) + MakeData(100, 50, 'A') +
+		  data.substr(150), ReadString(is, SIZE));
+	EXPECT_TRUE(is.IsEOF());
+}
+
+TEST(ParallelInputStream, EndOfFile)
+{
+	Mutex mutex;
+	TestParallelInputStream is(mutex);
+	const std::lock_guard<Mutex> protect(mutex);
+
+	EXPECT_EQ(SIZE, is.GetSize());
+	EXPECT_TRUE(is.IsSeekable());
+	EXPECT_FALSE(is.IsEOF());
+
+	/* seeking into a hole schedules a request */
+	is.Seek(500);
+	EXPECT_FALSE(is.IsAvailable());
+	EXPECT_EQ(1u, is.n_schedule);
+
+	/* reading the last bytes */
+	is.Receive(990, MakeData(990, 10));
+	is.Seek(995);
+	EXPECT_EQ(1u, is.n_schedule);
+	EXPECT_FALSE(is.IsEOF());
+	EXPECT_EQ(MakeData(995, 5), ReadString(is, 100));
+	EXPECT_TRUE(is.IsEOF());
+	EXPECT_TRUE(is.IsAvailable());
+	EXPECT_EQ(0u, ReadString(is, 100).size());
+
+	/* seeking to the end is allowed and doesn't schedule
+	   anything */
+	is.Seek(0);
+	EXPECT_EQ(2u, is.n_schedule);
+	is.Seek(SIZE);
+	EXPECT_EQ(SIZE, is.GetOffset());
+	EXPECT_TRUE(is.IsEOF());
+	EXPECT_TRUE(is.IsAvailable());
+	EXPECT_EQ(0u, ReadString(is, 100).size());
+	EXPECT_EQ(2u, is.n_schedule);
+
+	offset_type start, end;
+	const std::array<Range, 0> none{};
+	EXPECT_FALSE(is.FindNextRange(none, start, end));
+	EXPECT_FALSE(is.IsStalled(none));
+
+	/* seeking beyond the end fails and leaves the offset */
+	EXPECT_THROW(is.Seek(SIZE + 1), std::runtime_error);
+	EXPECT_EQ(SIZE, is.GetOffset());
+
+	/* errors are reported by Read() unless at the end */
+	is.Fail();
+	EXPECT_THROW(is.Check(), std::runtime_error);
+	EXPECT_EQ(0u, ReadString(is, 100).size());
+	is.Seek(0);
+	EXPECT_THROW(ReadString(is, 100), std::runtime_error);
+}
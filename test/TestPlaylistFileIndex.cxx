@@ -0,0 +1,369 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PlaylistFileIndex.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "system/FileDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <unistd.h>
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	void Write(const void *data, size_t size) override {
+		value.append((const char *)data, size);
+	}
+};
+
+class PlaylistFileIndexTest : public ::testing::Test {
+protected:
+	FILE *file;
+	FileDescriptor fd;
+
+	void SetUp() override {
+		file = tmpfile();
+		ASSERT_NE(file, nullptr);
+		fd = FileDescriptor(fileno(file));
+	}
+
+	void TearDown() override {
+		fclose(file);
+	}
+
+	void SetContents(const std::string &contents) {
+		ASSERT_EQ(ftruncate(fd.Get(), 0), 0);
+		fd.Seek(0);
+		ASSERT_EQ(fd.Write(contents.data(), contents.size()),
+			  (ssize_t)contents.size());
+	}
+
+	std::string GetContents() {
+		std::string result;
+		fd.Seek(0);
+		char buffer[4096];
+		ssize_t nbytes;
+		while ((nbytes = fd.Read(buffer, sizeof(buffer))) > 0)
+			result.append(buffer, nbytes);
+		return result;
+	}
+
+	void Load(PlaylistFileIndex &index, unsigned max_length=1000) {
+		index.Load(fd, max_length);
+	}
+
+	/**
+	 * Parse the output of PlaylistFileIndex::Read() like the
+	 * extm3u playlist plugin does.  Entries with a "#EXTINF"
+	 * line are returned as "URI=EXTINF".
+	 */
+	static std::vector<std::string> Parse(const std::string &contents) {
+		std::vector<std::string> result;
+		std::string extinf;
+
+		size_t position = 0;
+		while (position < contents.length()) {
+			size_t newline = contents.find('\n', position);
+			if (newline == std::string::npos)
+				newline = contents.length();
+
+			std::string line(contents, position,
+					 newline - position);
+			position = newline + 1;
+
+			const size_t begin = line.find_first_not_of(" \t\r");
+			if (begin == std::string::npos)
+				continue;
+
+			line = line.substr(begin,
+					   line.find_last_not_of(" \t\r") + 1 - begin);
+			if (line.compare(0, 8, "#EXTINF:") == 0)
+				extinf = line.substr(8);
+			else if (line.front() != '#') {
+				if (!extinf.empty())
+					line += "=" + extinf;
+				result.emplace_back(std::move(line));
+				extinf.clear();
+			}
+		}
+
+		return result;
+	}
+
+	std::vector<std::string> Read(const PlaylistFileIndex &index,
+				      unsigned start=0, unsigned end=~0u) {
+		return Parse(index.Read(fd, start, end));
+	}
+
+	/**
+	 * Verify that the index matches the entries of the file.
+	 */
+	void Check(const PlaylistFileIndex &index,
+		   const std::vector<std::string> &expected) {
+		EXPECT_EQ(index.GetCount(), expected.size());
+		EXPECT_EQ(Read(index), expected);
+
+		PlaylistFileIndex fresh;
+		Load(fresh);
+		EXPECT_EQ(Read(fresh), expected);
+		EXPECT_EQ(fresh.GetFileSize(), index.GetFileSize());
+	}
+};
+
+TEST_F(PlaylistFileIndexTest, Load)
+{
+	SetContents("#EXTM3U\n"
+		    "a.mp3\n"
+		    "\n"
+		    "  # indented comment\n"
+		    "x.mp3\n"
+		    "b.mp3\r\n"
+		    "# comment\n"
+		    "http://example.com/c.ogg");
+
+	PlaylistFileIndex index;
+	Load(index);
+
+	EXPECT_EQ(index.GetCount(), 4u);
+	EXPECT_TRUE(index.IsComplete());
+	EXPECT_FALSE(index.IsTerminated());
+
+	const std::vector<std::string> all{"a.mp3", "x.mp3", "b.mp3", "http://example.com/c.ogg"};
+	EXPECT_EQ(Read(index), all);
+
+	/* the window includes the header and the comment lines
+	   preceding the entries */
+	EXPECT_EQ(index.Read(fd, 1, 2),
+		  "#EXTM3U\n\n  # indented comment\nx.mp3\n");
+	EXPECT_EQ(index.Read(fd, 2, 3), "#EXTM3U\nb.mp3\r\n");
+	EXPECT_EQ(index.Read(fd, 3, 100),
+		  "#EXTM3U\n# comment\nhttp://example.com/c.ogg");
+
+	EXPECT_TRUE(index.Read(fd, 4, 10).empty());
+
+	PlaylistFileIndex limited;
+	Load(limited, 2);
+	EXPECT_EQ(limited.GetCount(), 2u);
+	EXPECT_FALSE(limited.IsComplete());
+}
+
+TEST_F(PlaylistFileIndexTest, Remove)
+{
+	SetContents("a\nbb\r\nccc\n");
+
+	PlaylistFileIndex index;
+	Load(index);
+
+	index.Remove(fd, 1);
+	EXPECT_EQ(GetContents(), "a\n###\nccc\n");
+	Check(index, {"a", "ccc"});
+
+	index.Remove(fd, 0);
+	index.Remove(fd, 0);
+	EXPECT_EQ(GetContents(), "#\n###\n###\n");
+	Check(index, {});
+}
+
+TEST_F(PlaylistFileIndexTest, Move)
+{
+	SetContents("a\n#comment\nbb\nccc\ndddd");
+
+	PlaylistFileIndex index;
+	Load(index);
+
+	index.Move(fd, 0, 2);
+	EXPECT_EQ(GetContents(), "#comment\nbb\nccc\na\ndddd\n");
+	Check(index, {"bb", "ccc", "a", "dddd"});
+
+	/* the comment belongs to "bb" and moves with it */
+	index.Move(fd, 3, 0);
+	EXPECT_EQ(GetContents(), "dddd\n#comment\nbb\nccc\na\n");
+	Check(index, {"dddd", "bb", "ccc", "a"});
+
+	index.Move(fd, 1, 2);
+	Check(index, {"dddd", "ccc", "bb", "a"});
+}
+
+TEST_F(PlaylistFileIndexTest, Append)
+{
+	SetContents("a\nb");
+
+	PlaylistFileIndex index;
+	Load(index);
+	EXPECT_FALSE(index.IsTerminated());
+
+	std::string line = "\nc\n";
+	fd.Seek(index.GetFileSize());
+	ASSERT_EQ(fd.Write(line.data(), line.size()), (ssize_t)line.size());
+	index.Appended(index.GetFileSize() + line.size());
+
+	EXPECT_TRUE(index.IsTerminated());
+	Check(index, {"a", "b", "c"});
+}
+
+TEST_F(PlaylistFileIndexTest, ExtInf)
+{
+	const std::string original = "#EXTM3U\n"
+		"#EXTINF:1,One\n"
+		"a\n"
+		"#EXTINF:2,Two\n"
+		"b\n"
+		"c\n";
+	SetContents(original);
+
+	PlaylistFileIndex index;
+	Load(index);
+	Check(index, {"a=1,One", "b=2,Two", "c"});
+
+	/* the "#EXTINF" line moves with its entry; the header stays */
+	index.Move(fd, 0, 2);
+	EXPECT_EQ(GetContents(), "#EXTM3U\n"
+		  "#EXTINF:2,Two\n"
+		  "b\n"
+		  "c\n"
+		  "#EXTINF:1,One\n"
+		  "a\n");
+	Check(index, {"b=2,Two", "c", "a=1,One"});
+	EXPECT_EQ(index.Read(fd, 2, 3), "#EXTM3U\n#EXTINF:1,One\na\n");
+
+	index.Move(fd, 2, 0);
+	EXPECT_EQ(GetContents(), original);
+
+	/* the "#EXTINF" line is removed with its entry, and does not
+	   get attributed to the next one */
+	index.Remove(fd, 0);
+	EXPECT_EQ(GetContents(), "#EXTM3U\n"
+		  "#############\n"
+		  "#\n"
+		  "#EXTINF:2,Two\n"
+		  "b\n"
+		  "c\n");
+	Check(index, {"b=2,Two", "c"});
+}
+
+TEST_F(PlaylistFileIndexTest, Copy)
+{
+	SetContents("#EXTM3U\n"
+		    "#EXTINF:1,One\n"
+		    "a\n"
+		    "#EXTINF:2,Two\n"
+		    "b\n"
+		    "c");
+
+	PlaylistFileIndex index;
+	Load(index);
+	index.Remove(fd, 1);
+
+	StringOutputStream os;
+	index.Copy(fd, os, 0, 0);
+	EXPECT_EQ(os.value, "#EXTM3U\n"
+		  "#EXTINF:1,One\n"
+		  "a\n"
+		  "c\n");
+
+	StringOutputStream moved;
+	index.Copy(fd, moved, 0, 1);
+	EXPECT_EQ(moved.value, "#EXTM3U\n"
+		  "c\n"
+		  "#EXTINF:1,One\n"
+		  "a\n");
+
+	EXPECT_EQ(index.GetMoveSize(0, 1), index.GetFileSize() - 8);
+}
+
+TEST_F(PlaylistFileIndexTest, Stale)
+{
+	SetContents("aaa\nbbb\nccc\n");
+
+	PlaylistFileIndex index;
+	Load(index);
+
+	/* same size, but different line boundaries */
+	SetContents("aa\nbbbb\nccc\n");
+	EXPECT_THROW(Read(index, 1, 2), PlaylistFileIndex::Stale);
+	EXPECT_THROW(index.Remove(fd, 1), PlaylistFileIndex::Stale);
+
+	/* truncated */
+	SetContents("aaa\n");
+	EXPECT_THROW(Read(index), PlaylistFileIndex::Stale);
+}
+
+TEST_F(PlaylistFileIndexTest, Random)
+{
+	std::vector<std::string> expected;
+	std::string contents;
+	for (unsigned i = 0; i < 100; ++i) {
+		const std::string uri = "song" + std::to_string(i) +
+			std::string(i % 7, '_');
+		if (i % 3 == 0) {
+			const std::string extinf = "0,Title " + std::to_string(i);
+			contents += "#EXTINF:" + extinf + "\n";
+			expected.emplace_back(uri + "=" + extinf);
+		} else
+			expected.emplace_back(uri);
+
+		contents += uri;
+		contents += "\n";
+		if (i % 10 == 0)
+			contents += "#comment\n";
+	}
+
+	SetContents(contents);
+
+	PlaylistFileIndex index;
+	Load(index);
+	Check(index, expected);
+
+	std::mt19937 random(42);
+	for (unsigned i = 0; i < 200 && expected.size() > 1; ++i) {
+		const unsigned from = random() % expected.size();
+		const unsigned to = random() % expected.size();
+
+		if (i % 4 == 0) {
+			index.Remove(fd, from);
+			expected.erase(expected.begin() + from);
+		} else {
+			if (i % 10 == 1) {
+				/* rewrite the file instead of editing
+				   it in place */
+				StringOutputStream os;
+				index.Copy(fd, os, from, to);
+				SetContents(os.value);
+				Load(index);
+			} else
+				index.Move(fd, from, to);
+
+			auto value = std::move(expected[from]);
+			expected.erase(expected.begin() + from);
+			expected.insert(expected.begin() + to,
+					std::move(value));
+		}
+
+		ASSERT_EQ(Read(index), expected);
+	}
+
+	Check(index, expected);
+}
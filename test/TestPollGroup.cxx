@@ -0,0 +1,136 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "event/PollGroup.hxx"
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct SocketPair {
+	int fd, peer;
+
+	SocketPair() noexcept {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,
+			       0, sv) < 0)
+			abort();
+
+		fd = sv[0];
+		peer = sv[1];
+	}
+
+	~SocketPair() noexcept {
+		close(fd);
+		close(peer);
+	}
+};
+
+/**
+ * Collect events with a short timeout and return the mask reported
+ * for the specified object (or 0 if there was none).
+ */
+static unsigned
+Poll(PollGroup &group, const void *obj, int timeout_ms=50) noexcept
+{
+	PollResult result;
+	group.ReadEvents(result, timeout_ms);
+
+	unsigned events = 0;
+	for (size_t i = 0; i < result.GetSize(); ++i)
+		if (result.GetObject(i) == obj)
+			events |= result.GetEvents(i);
+
+	result.Reset();
+	return events;
+}
+
+TEST(PollGroup, LevelTriggered)
+{
+	PollGroup group;
+	SocketPair s;
+	int obj;
+
+	ASSERT_TRUE(group.Add(s.fd, PollGroup::READ, &obj));
+	EXPECT_EQ(0u, Poll(group, &obj));
+
+	ASSERT_EQ(1, write(s.peer, "x", 1));
+
+	/* the event must be reported again as long as the data has
+	   not been consumed */
+	EXPECT_TRUE(Poll(group, &obj) & PollGroup::READ);
+	EXPECT_TRUE(Poll(group, &obj) & PollGroup::READ);
+
+	char buffer[4];
+	ASSERT_EQ(1, read(s.fd, buffer, sizeof(buffer)));
+	EXPECT_EQ(0u, Poll(group, &obj));
+
+	group.Remove(s.fd);
+}
+
+TEST(PollGroup, Modify)
+{
+	PollGroup group;
+	SocketPair s;
+	int obj1, obj2;
+
+	ASSERT_TRUE(group.Add(s.fd, PollGroup::READ, &obj1));
+	EXPECT_EQ(0u, Poll(group, &obj1));
+
+	/* the socket is always writable */
+	ASSERT_TRUE(group.Modify(s.fd, PollGroup::READ|PollGroup::WRITE,
+				 &obj2));
+	EXPECT_EQ(unsigned(PollGroup::WRITE), Poll(group, &obj2));
+	EXPECT_EQ(unsigned(PollGroup::WRITE), Poll(group, &obj2));
+
+	ASSERT_TRUE(group.Modify(s.fd, PollGroup::READ, &obj2));
+	EXPECT_EQ(0u, Poll(group, &obj2));
+
+	ASSERT_EQ(1, write(s.peer, "x", 1));
+	EXPECT_EQ(unsigned(PollGroup::READ), Poll(group, &obj2));
+
+	group.Remove(s.fd);
+}
+
+TEST(PollGroup, Remove)
+{
+	PollGroup group;
+	int obj1, obj2;
+
+	{
+		SocketPair s;
+		ASSERT_TRUE(group.Add(s.fd, PollGroup::WRITE, &obj1));
+		EXPECT_TRUE(Poll(group, &obj1) & PollGroup::WRITE);
+
+		ASSERT_TRUE(group.Remove(s.fd));
+		EXPECT_EQ(0u, Poll(group, &obj1));
+	}
+
+	/* the new socket is likely to get the same file descriptor;
+	   no stale event of the old one may be reported */
+	SocketPair s;
+	ASSERT_TRUE(group.Add(s.fd, PollGroup::READ, &obj2));
+	EXPECT_EQ(0u, Poll(group, &obj1));
+
+	ASSERT_EQ(1, write(s.peer, "x", 1));
+	EXPECT_EQ(unsigned(PollGroup::READ), Poll(group, &obj2));
+
+	group.Remove(s.fd);
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+Tag::Tag(const Tag &) noexcept {}
+void Tag::Clear() noexcept {}
+
+/**
+ * Determine the modified positions by scanning the whole queue.
+ */
+static std::vector<unsigned>
+Scan(const Queue &queue, uint32_t version)
+{
+	std::vector<unsigned> result;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (queue.IsNewerAtPosition(i, version))
+			result.push_back(i);
+	return result;
+}
+
+/**
+ * Determine the modified positions from the change log.
+ */
+static bool
+Collect(const Queue &queue, uint32_t version,
+	std::vector<unsigned> &result)
+{
+	std::vector<QueueChangeLog::Range> changes;
+	if (!queue.CollectChanges(version, changes))
+		return false;
+
+	unsigned last_end = 0;
+	for (const auto &i : changes) {
+		EXPECT_LT(i.start, i.end);
+		EXPECT_TRUE(result.empty() || i.start > last_end);
+		last_end = i.end;
+
+		for (unsigned position = i.start; position < i.end; ++position)
+			result.push_back(position);
+	}
+
+	return true;
+}
+
+static void
+Append(Queue &queue, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		queue.Append(DetachedSong("foo.ogg"), 0);
+	queue.IncrementVersion();
+}
+
+TEST(QueueChangeLog, Basic)
+{
+	Queue queue(64);
+	Append(queue, 16);
+
+	const uint32_t v1 = queue.version;
+
+	std::vector<unsigned> result;
+	ASSERT_TRUE(Collect(queue, v1, result));
+	EXPECT_TRUE(result.empty());
+
+	result.clear();
+	ASSERT_TRUE(Collect(queue, 0, result));
+	EXPECT_EQ(result.size(), 16u);
+
+	queue.SwapPositions(3, 10);
+	queue.IncrementVersion();
+
+	result.clear();
+	ASSERT_TRUE(Collect(queue, v1, result));
+	EXPECT_EQ(result, (std::vector<unsigned>{3, 10}));
+
+	const uint32_t v2 = queue.version;
+	queue.DeletePosition(12);
+	queue.IncrementVersion();
+
+	result.clear();
+	ASSERT_TRUE(Collect(queue, v2, result));
+	EXPECT_EQ(result, (std::vector<unsigned>{12, 13, 14}));
+	EXPECT_EQ(result, Scan(queue, v2));
+
+	/* a version from the future means "everything" */
+	EXPECT_FALSE(Collect(queue, queue.version + 1, result));
+}
+
+TEST(QueueChangeLog, Random)
+{
+	Queue queue(256);
+	Append(queue, 128);
+
+	std::mt19937 rng(42);
+	std::vector<uint32_t> versions{0};
+	unsigned n_collected = 0;
+
+	for (unsigned n = 0; n < 2000; ++n) {
+		versions.push_back(queue.version);
+
+		const unsigned length = queue.GetLength();
+		std::uniform_int_distribution<unsigned> pos(0, length - 1);
+
+		switch (rng() % 6) {
+		case 0:
+			if (!queue.IsFull())
+				Append(queue, 1);
+			break;
+
+		case 1:
+			if (length > 16)
+				queue.DeletePosition(pos(rng));
+			break;
+
+		case 2:
+			queue.SwapPositions(pos(rng), pos(rng));
+			break;
+
+		case 3:
+			queue.MovePostion(pos(rng), pos(rng));
+			break;
+
+		case 4:
+			{
+				unsigned start = pos(rng);
+				unsigned end = std::min(start + 4, length);
+				std::uniform_int_distribution<unsigned> to(0, length - (end - start));
+				queue.MoveRange(start, end, to(rng));
+			}
+			break;
+
+		case 5:
+			queue.SetPriority(pos(rng), rng() % 4, -1);
+			break;
+		}
+
+		queue.IncrementVersion();
+
+		/* compare the change log with a full scan for a few
+		   recent versions */
+		for (unsigned i = 0; i < 8 && i < versions.size(); ++i) {
+			const uint32_t v = versions[versions.size() - 1 - i];
+			std::vector<unsigned> result;
+			if (Collect(queue, v, result)) {
+				ASSERT_EQ(result, Scan(queue, v));
+				++n_collected;
+			}
+		}
+	}
+
+	EXPECT_GT(n_collected, 15000u);
+
+	/* the oldest versions have aged out */
+	std::vector<unsigned> result;
+	EXPECT_FALSE(Collect(queue, versions[1], result));
+
+	/* after clearing the queue, the log is complete again */
+	queue.Clear();
+	queue.IncrementVersion();
+	Append(queue, 4);
+	result.clear();
+	ASSERT_TRUE(Collect(queue, versions[1], result));
+	EXPECT_EQ(result, Scan(queue, versions[1]));
+}
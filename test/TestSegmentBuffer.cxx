@@ -0,0 +1,147 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "util/SegmentBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+/**
+ * Drain the buffer by reading up to the given number of segments at
+ * a time and consuming a part of them, like a socket which accepts
+ * only some bytes.
+ */
+static std::string
+Drain(SegmentBuffer &buffer, size_t max_segments, size_t max_consume)
+{
+	std::string result;
+
+	while (!buffer.empty()) {
+		ConstBuffer<void> segments[8];
+		const size_t n = buffer.Read(segments, max_segments);
+		EXPECT_GT(n, 0u);
+
+		size_t consume = 0;
+		for (size_t i = 0; i < n && consume < max_consume; ++i) {
+			const size_t nbytes = std::min(segments[i].size,
+						       max_consume - consume);
+			result.append((const char *)segments[i].data, nbytes);
+			consume += nbytes;
+		}
+
+		buffer.Consume(consume);
+	}
+
+	return result;
+}
+
+static std::string
+MakeData(size_t size)
+{
+	std::string data;
+	for (size_t i = 0; i < size; ++i)
+		data.push_back('a' + i % 23);
+	return data;
+}
+
+TEST(SegmentBuffer, Empty)
+{
+	SegmentBuffer buffer(1024);
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_EQ(size_t(0), buffer.GetSize());
+	EXPECT_TRUE(buffer.Read().empty());
+}
+
+TEST(SegmentBuffer, AppendConsume)
+{
+	const auto data = MakeData(5 * SegmentBuffer::SEGMENT_SIZE + 123);
+
+	for (size_t max_segments : {1, 3, 8}) {
+		for (size_t max_consume : {7, 4096, 100000}) {
+			SegmentBuffer buffer(1 << 20);
+			ASSERT_TRUE(buffer.Append(data.data(), data.size()));
+			EXPECT_EQ(data.size(), buffer.GetSize());
+			EXPECT_EQ(data, Drain(buffer, max_segments, max_consume));
+			EXPECT_TRUE(buffer.empty());
+
+			/* the buffer is reusable after it has been
+			   drained */
+			ASSERT_TRUE(buffer.Append("foo", 3));
+			EXPECT_EQ("foo", Drain(buffer, max_segments, max_consume));
+		}
+	}
+}
+
+TEST(SegmentBuffer, Interleaved)
+{
+	const auto data = MakeData(100000);
+	SegmentBuffer buffer(1 << 20);
+	std::string result;
+
+	for (size_t position = 0; position < data.size();) {
+		const size_t n = std::min<size_t>(997, data.size() - position);
+		ASSERT_TRUE(buffer.Append(data.data() + position, n));
+		position += n;
+
+		/* consume a little less than was appended */
+		const auto r = buffer.Read();
+		ASSERT_FALSE(r.empty());
+		const size_t consume = std::min<size_t>(r.size, 900);
+		result.append((const char *)r.data, consume);
+		buffer.Consume(consume);
+	}
+
+	result += Drain(buffer, 8, 100000);
+	EXPECT_EQ(data, result);
+}
+
+TEST(SegmentBuffer, WriteAppend)
+{
+	SegmentBuffer buffer(1 << 20);
+
+	auto w = buffer.Write();
+	ASSERT_GE(w.size, size_t(5));
+	memcpy(w.data, "hello", 5);
+	buffer.Append(5);
+
+	/* an unused Write() does not change anything */
+	w = buffer.Write();
+	EXPECT_FALSE(w.empty());
+
+	EXPECT_EQ(size_t(5), buffer.GetSize());
+	EXPECT_EQ("hello", Drain(buffer, 8, 100));
+}
+
+TEST(SegmentBuffer, Full)
+{
+	const auto data = MakeData(50000);
+	SegmentBuffer buffer(40000);
+
+	EXPECT_FALSE(buffer.Append(data.data(), data.size()));
+	EXPECT_EQ(size_t(40000), buffer.GetSize());
+	EXPECT_TRUE(buffer.Write().empty());
+
+	buffer.Consume(1000);
+	EXPECT_FALSE(buffer.Write().empty());
+	EXPECT_TRUE(buffer.Append(data.data(), 1000));
+	EXPECT_FALSE(buffer.Append(data.data(), 1));
+}
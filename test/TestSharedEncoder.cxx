@@ -0,0 +1,367 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "encoder/Shared.hxx"
+#include "AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "config/Block.hxx"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+
+namespace {
+
+struct FakeEncoderStats {
+	unsigned n_opens = 0;
+	std::string input;
+};
+
+/**
+ * An encoder whose output is a copy of its input, decorated with
+ * markers for the stream header, tags and the end of the stream.
+ */
+class FakeEncoder final : public Encoder {
+	FakeEncoderStats &stats;
+	std::string output = "<header>";
+
+public:
+	explicit FakeEncoder(FakeEncoderStats &_stats)
+		:Encoder(true), stats(_stats) {
+		++stats.n_opens;
+	}
+
+	void End() override {
+		output += "<end>";
+	}
+
+	void PreTag() override {
+		output += "<pre>";
+	}
+
+	void SendTag(const Tag &) override {
+		output += "<tag>";
+	}
+
+	void Write(const void *data, size_t length) override {
+		stats.input.append((const char *)data, length);
+		output.append((const char *)data, length);
+	}
+
+	size_t Read(void *dest, size_t length) override {
+		length = std::min(length, output.length());
+		memcpy(dest, output.data(), length);
+		output.erase(0, length);
+		return length;
+	}
+};
+
+class FakePreparedEncoder final : public PreparedEncoder {
+	FakeEncoderStats &stats;
+
+public:
+	explicit FakePreparedEncoder(FakeEncoderStats &_stats)
+		:stats(_stats) {}
+
+	Encoder *Open(AudioFormat &audio_format) override {
+		/* pretend the encoder supports only 16 bit */
+		audio_format.format = SampleFormat::S16;
+		return new FakeEncoder(stats);
+	}
+};
+
+}
+
+static std::unique_ptr<SharedPreparedEncoder>
+MakeFake(FakeEncoderStats &stats, const char *key="fake")
+{
+	return std::make_unique<SharedPreparedEncoder>(std::make_unique<FakePreparedEncoder>(stats),
+						       key);
+}
+
+static std::string
+ReadAll(Encoder &encoder)
+{
+	std::string result;
+	char buffer[3];
+	size_t nbytes;
+	while ((nbytes = encoder.Read(buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+/**
+ * Read and discard all available data, and return its size.
+ */
+static size_t
+Skip(Encoder &encoder)
+{
+	size_t result = 0;
+	char buffer[65536];
+	size_t nbytes;
+	while ((nbytes = encoder.Read(buffer, sizeof(buffer))) > 0)
+		result += nbytes;
+	return result;
+}
+
+static void
+Write(Encoder &encoder, const char *s)
+{
+	encoder.Write(s, strlen(s));
+}
+
+TEST(SharedEncoder, EncodeOnce)
+{
+	FakeEncoderStats stats;
+	auto a = MakeFake(stats), b = MakeFake(stats);
+
+	AudioFormat af(44100, SampleFormat::S24_P32, 2);
+	std::unique_ptr<Encoder> ea(a->Open(af));
+	EXPECT_EQ(SampleFormat::S16, af.format);
+
+	af = AudioFormat(44100, SampleFormat::S24_P32, 2);
+	std::unique_ptr<Encoder> eb(b->Open(af));
+	EXPECT_EQ(SampleFormat::S16, af.format);
+
+	EXPECT_EQ(1u, stats.n_opens);
+	EXPECT_TRUE(a->IsShared());
+	EXPECT_TRUE(b->IsShared());
+
+	/* "a" is the feeder; the input of "b" is ignored, even if
+	   it differs */
+	Write(*ea, "abc");
+	Write(*ea, "def");
+	EXPECT_EQ("<header>abcdef", ReadAll(*ea));
+
+	Write(*eb, "ab");
+	EXPECT_EQ("<header>abcdef", ReadAll(*eb));
+	Write(*eb, "cdefgh");
+	EXPECT_EQ("", ReadAll(*eb));
+	Write(*ea, "gh");
+	EXPECT_EQ("gh", ReadAll(*eb));
+	EXPECT_EQ("gh", ReadAll(*ea));
+
+	EXPECT_EQ("abcdefgh", stats.input);
+
+	/* each tag is applied only once */
+	ea->PreTag();
+	ea->SendTag(Tag());
+	eb->PreTag();
+	eb->SendTag(Tag());
+	EXPECT_EQ("<pre><tag>", ReadAll(*ea));
+	EXPECT_EQ("<pre><tag>", ReadAll(*eb));
+
+	/* only the last output ends the stream */
+	ea->End();
+	EXPECT_EQ("", ReadAll(*ea));
+	ea.reset();
+	EXPECT_FALSE(b->IsShared());
+
+	/* "b" is the feeder now */
+	Write(*eb, "ij");
+	eb->End();
+	EXPECT_EQ("ij<end>", ReadAll(*eb));
+}
+
+TEST(SharedEncoder, LateJoin)
+{
+	FakeEncoderStats stats;
+	auto a = MakeFake(stats), b = MakeFake(stats);
+
+	AudioFormat af(48000, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> ea(a->Open(af));
+	Write(*ea, "abc");
+	ea->PreTag();
+	ea->SendTag(Tag());
+	Write(*ea, "def");
+	EXPECT_EQ("<header>abc<pre><tag>def", ReadAll(*ea));
+
+	/* the new output gets the header of the current stream and
+	   only new data */
+	std::unique_ptr<Encoder> eb(b->Open(af));
+	EXPECT_EQ("<tag>", ReadAll(*eb));
+	Write(*eb, "xy");
+	Write(*ea, "xy");
+	EXPECT_EQ("xy", ReadAll(*eb));
+	EXPECT_EQ("xy", ReadAll(*ea));
+	EXPECT_EQ("abcdefxy", stats.input);
+
+	/* the new output doesn't repeat old tags */
+	eb->PreTag();
+	eb->SendTag(Tag());
+	EXPECT_EQ("", ReadAll(*ea));
+	ea->PreTag();
+	ea->SendTag(Tag());
+	EXPECT_EQ("<pre><tag>", ReadAll(*ea));
+	EXPECT_EQ("<pre><tag>", ReadAll(*eb));
+}
+
+TEST(SharedEncoder, Handover)
+{
+	FakeEncoderStats stats;
+	auto a = MakeFake(stats), b = MakeFake(stats);
+
+	AudioFormat af(44100, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> ea(a->Open(af));
+	std::unique_ptr<Encoder> eb(b->Open(af));
+	EXPECT_EQ("<header>", ReadAll(*ea));
+	EXPECT_EQ("<header>", ReadAll(*eb));
+
+	/* "b" writes silence while paused, but "a" (the feeder)
+	   doesn't: a short pause is ignored */
+	const std::string silence(af.TimeToSize(std::chrono::milliseconds(500)),
+				  '\0');
+	eb->Write(silence.data(), silence.size());
+	EXPECT_EQ("", ReadAll(*eb));
+
+	/* a new chunk from "a" resets the stall counter */
+	Write(*ea, "abc");
+	eb->Write(silence.data(), silence.size());
+	EXPECT_EQ("abc", ReadAll(*ea));
+	EXPECT_EQ("abc", ReadAll(*eb));
+	EXPECT_EQ("abc", stats.input);
+
+	/* after more than one second, "b" takes over */
+	eb->Write(silence.data(), silence.size());
+	eb->Write(silence.data(), silence.size());
+	EXPECT_EQ(silence, ReadAll(*ea));
+	EXPECT_EQ(silence, ReadAll(*eb));
+	EXPECT_EQ("abc" + silence, stats.input);
+
+	/* now the input of "a" is ignored */
+	Write(*ea, "def");
+	Write(*eb, "ghi");
+	EXPECT_EQ("ghi", ReadAll(*ea));
+	EXPECT_EQ("abc" + silence + "ghi", stats.input);
+
+	/* closing the feeder makes the other output the feeder */
+	eb.reset();
+	Write(*ea, "jk");
+	EXPECT_EQ("jk", ReadAll(*ea));
+}
+
+TEST(SharedEncoder, Overrun)
+{
+	FakeEncoderStats stats;
+	auto a = MakeFake(stats), b = MakeFake(stats);
+
+	AudioFormat af(44100, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> ea(a->Open(af));
+	std::unique_ptr<Encoder> eb(b->Open(af));
+
+	/* "b" doesn't read while "a" keeps up */
+	const std::string chunk(65536, 'x');
+	size_t total = 0;
+	for (unsigned i = 0; i < 100; ++i) {
+		ea->Write(chunk.data(), chunk.size());
+		total += Skip(*ea);
+	}
+
+	EXPECT_EQ(strlen("<header>") + 100 * chunk.size(), total);
+
+	/* the data "b" has lost is reported instead of being
+	   skipped silently */
+	EXPECT_THROW(Skip(*eb), std::runtime_error);
+
+	/* the other output is not affected */
+	ea->Write(chunk.data(), chunk.size());
+	EXPECT_EQ(chunk.size(), Skip(*ea));
+
+	/* after reopening, the output gets the stream header and
+	   new data */
+	eb.reset();
+	eb.reset(b->Open(af));
+	ea->Write(chunk.data(), chunk.size());
+	EXPECT_EQ(strlen("<header>") + chunk.size(), Skip(*eb));
+}
+
+TEST(SharedEncoder, Private)
+{
+	FakeEncoderStats stats;
+
+	/* different audio format */
+	auto a = MakeFake(stats), b = MakeFake(stats);
+	AudioFormat af(44100, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> ea(a->Open(af));
+	af = AudioFormat(48000, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> eb(b->Open(af));
+	EXPECT_EQ(2u, stats.n_opens);
+	EXPECT_FALSE(a->IsShared());
+
+	/* different key */
+	auto c = MakeFake(stats, "other");
+	af = AudioFormat(44100, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> ec(c->Open(af));
+	EXPECT_EQ(3u, stats.n_opens);
+
+	/* sharing disabled */
+	auto d = MakeFake(stats, "");
+	std::unique_ptr<Encoder> ed(d->Open(af));
+	EXPECT_EQ(4u, stats.n_opens);
+	EXPECT_FALSE(d->IsShared());
+
+	Write(*ea, "a");
+	Write(*eb, "b");
+	Write(*ec, "c");
+	Write(*ed, "d");
+	EXPECT_EQ("abcd", stats.input);
+}
+
+static bool
+ConfigShares(ConfigBlock &a, ConfigBlock &b)
+{
+	auto pa = CreateSharedEncoder(a), pb = CreateSharedEncoder(b);
+
+	AudioFormat af(44100, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> ea(pa->Open(af));
+	std::unique_ptr<Encoder> eb(pb->Open(af));
+	return pa->IsShared();
+}
+
+TEST(SharedEncoder, Config)
+{
+	ConfigBlock a(1), b(2);
+	a.AddBlockParam("encoder", "null");
+	b.AddBlockParam("encoder", "null");
+	EXPECT_TRUE(ConfigShares(a, b));
+
+	a.AddBlockParam("format", "48000:16:2");
+	EXPECT_FALSE(ConfigShares(a, b));
+
+	b.AddBlockParam("format", "48000:16:2");
+	b.AddBlockParam("name", "other");
+	EXPECT_TRUE(ConfigShares(a, b));
+
+	ConfigBlock c(3);
+	c.AddBlockParam("encoder", "null");
+	c.AddBlockParam("format", "48000:16:2");
+	c.AddBlockParam("mixer_type", "software");
+	EXPECT_FALSE(ConfigShares(a, c));
+
+	ConfigBlock d(4);
+	d.AddBlockParam("encoder", "null");
+	d.AddBlockParam("format", "48000:16:2");
+	d.AddBlockParam("share_encoder", "no");
+	EXPECT_FALSE(ConfigShares(a, d));
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "output/SharedFilter.hxx"
+#include "output/Filtered.hxx"
+#include "filter/Factory.hxx"
+#include "config/Data.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "MusicChunkPtr.hxx"
+#include "ReplayGainConfig.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+static constexpr AudioFormat in_audio_format(44100, SampleFormat::S16, 2);
+static constexpr AudioFormat out_audio_format(44100, SampleFormat::S16, 2);
+static constexpr AudioFormat other_out_audio_format(44100, SampleFormat::S32, 2);
+
+class SharedOutputFilterTest : public ::testing::Test {
+protected:
+	const ConfigData config;
+	FilterFactory filter_factory{config};
+	const ReplayGainConfig replay_gain_config;
+
+	MusicBuffer buffer{8, 4096};
+
+	std::unique_ptr<SharedOutputFilter> filter;
+
+	void SetUp() override {
+		AudioOutputFilterSettings settings;
+		settings.config_audio_format = out_audio_format;
+		settings.shareable = true;
+
+		filter = std::make_unique<SharedOutputFilter>(settings,
+							      replay_gain_config,
+							      filter_factory);
+	}
+
+	/**
+	 * Allocate a chunk filled with a pattern derived from the
+	 * given seed.
+	 */
+	MusicChunkPtr MakeChunk(unsigned seed) {
+		auto chunk = buffer.Allocate();
+		auto w = chunk->Write(in_audio_format, SongTime::zero(), 0);
+		auto *p = (uint8_t *)w.data;
+		for (size_t i = 0; i < 1024; ++i)
+			p[i] = uint8_t(seed * 31 + i);
+		chunk->Expand(in_audio_format, 1024);
+		return chunk;
+	}
+
+	static std::string ToString(ConstBuffer<void> b) {
+		return std::string((const char *)b.data, b.size);
+	}
+};
+
+TEST_F(SharedOutputFilterTest, FilterOnce)
+{
+	const unsigned generation = filter->Open(in_audio_format,
+						 out_audio_format);
+	EXPECT_NE(0u, generation);
+
+	/* the second output with the same formats joins the same
+	   generation */
+	EXPECT_EQ(generation, filter->Open(in_audio_format,
+					   out_audio_format));
+
+	auto chunk = MakeChunk(1);
+
+	ConstBuffer<void> a, b;
+	SharedOutputFilter::BufferRef a_ref, b_ref;
+	ASSERT_TRUE(filter->FilterChunk(generation, *chunk,
+					ReplayGainMode::OFF, a, a_ref));
+	ASSERT_TRUE(filter->FilterChunk(generation, *chunk,
+					ReplayGainMode::OFF, b, b_ref));
+
+	/* the chunk has been filtered only once */
+	EXPECT_EQ(a.data, b.data);
+	EXPECT_EQ(size_t(1024), a.size);
+	EXPECT_EQ(ToString({chunk->data, chunk->length}), ToString(a));
+
+	filter->Forget(*chunk);
+}
+
+/**
+ * Reconfiguring the filter must not free or overwrite data which
+ * another output is still playing.
+ */
+TEST_F(SharedOutputFilterTest, ReconfigureWhilePlaying)
+{
+	const unsigned generation = filter->Open(in_audio_format,
+						 out_audio_format);
+
+	auto chunk1 = MakeChunk(1);
+
+	ConstBuffer<void> old_data;
+	SharedOutputFilter::BufferRef old_ref;
+	ASSERT_TRUE(filter->FilterChunk(generation, *chunk1,
+					ReplayGainMode::OFF,
+					old_data, old_ref));
+	const auto expected = ToString(old_data);
+
+	/* another output opens with a different format */
+	const unsigned generation2 = filter->Open(in_audio_format,
+						  other_out_audio_format);
+	EXPECT_NE(generation, generation2);
+
+	ConstBuffer<void> dummy;
+	SharedOutputFilter::BufferRef dummy_ref;
+	EXPECT_FALSE(filter->FilterChunk(generation, *chunk1,
+					 ReplayGainMode::OFF,
+					 dummy, dummy_ref));
+
+	/* the new generation filters new data into new buffers */
+	for (unsigned i = 2; i < 6; ++i) {
+		auto chunk = MakeChunk(i);
+		ConstBuffer<void> data;
+		SharedOutputFilter::BufferRef ref;
+		ASSERT_TRUE(filter->FilterChunk(generation2, *chunk,
+						ReplayGainMode::OFF,
+						data, ref));
+		EXPECT_EQ(size_t(2048), data.size);
+		filter->Forget(*chunk);
+	}
+
+	/* the first output's data is still intact */
+	EXPECT_EQ(expected, ToString(old_data));
+
+	filter->Cancel();
+	EXPECT_EQ(expected, ToString(old_data));
+}
+
+/**
+ * Forget() drops only the entry of the given chunk, even if the
+ * entries are not in pipe order.
+ */
+TEST_F(SharedOutputFilterTest, Forget)
+{
+	const unsigned generation = filter->Open(in_audio_format,
+						 out_audio_format);
+
+	auto chunk1 = MakeChunk(1), chunk2 = MakeChunk(2);
+
+	ConstBuffer<void> data1, data2;
+	SharedOutputFilter::BufferRef ref1, ref2;
+	ASSERT_TRUE(filter->FilterChunk(generation, *chunk2,
+					ReplayGainMode::OFF, data2, ref2));
+	ASSERT_TRUE(filter->FilterChunk(generation, *chunk1,
+					ReplayGainMode::OFF, data1, ref1));
+
+	filter->Forget(*chunk1);
+
+	/* chunk2 is still known */
+	ConstBuffer<void> again;
+	SharedOutputFilter::BufferRef again_ref;
+	ASSERT_TRUE(filter->FilterChunk(generation, *chunk2,
+					ReplayGainMode::OFF,
+					again, again_ref));
+	EXPECT_EQ(data2.data, again.data);
+
+	/* a chunk which was never filtered */
+	auto chunk3 = MakeChunk(3);
+	filter->Forget(*chunk3);
+
+	filter->Forget(*chunk2);
+
+	/* releasing the last reference frees the buffer */
+	std::weak_ptr<const uint8_t> weak(ref2);
+	ref2.reset();
+	EXPECT_FALSE(weak.expired());
+	again_ref.reset();
+	EXPECT_TRUE(weak.expired());
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Builder.hxx"
+#include "tag/VisitFallback.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+static void
+AddSong(Directory &directory, const char *name,
+	std::initializer_list<std::pair<TagType, const char *>> items)
+{
+	Song *song = Song::NewFile(name, directory);
+
+	TagBuilder tag;
+	for (const auto &i : items)
+		tag.AddItem(i.first, i.second);
+	tag.Commit(song->tag);
+
+	directory.AddSong(song);
+}
+
+/**
+ * Build a small tree.  The order of the entries is the insertion
+ * order (no Directory::Sort(), which requires ICU initialization).
+ */
+static std::unique_ptr<Directory>
+MakeTree()
+{
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	const ScopeDatabaseLock protect;
+
+	AddSong(*root, "r1.ogg", {{TAG_ARTIST, "Foo"}, {TAG_ALBUM, "Root"}});
+
+	Directory *a = root->CreateChild("a");
+	AddSong(*a, "a1.ogg", {{TAG_ARTIST, "Foo"}, {TAG_ALBUM, "One"},
+			      {TAG_GENRE, "Rock"}});
+	AddSong(*a, "a2.ogg", {{TAG_ARTIST, "Bar"}, {TAG_ARTIST, "Foo"},
+			      {TAG_ALBUM, "One"}, {TAG_ALBUM_ARTIST, "Foo"}});
+	AddSong(*a, "a3.ogg", {{TAG_ARTIST, "Bar"}, {TAG_ALBUM, "One"},
+			      {TAG_ALBUM_ARTIST, "Foo"}});
+
+	Directory *x = a->CreateChild("x");
+	AddSong(*x, "x1.ogg", {{TAG_ARTIST, "Foo"}, {TAG_ARTIST, "Foo"},
+			      {TAG_ALBUM, "Two"}});
+	AddSong(*x, "x2.ogg", {{TAG_TITLE, "untagged"}});
+
+	Directory *b = root->CreateChild("b");
+	AddSong(*b, "b1.ogg", {{TAG_ARTIST, "Baz"}, {TAG_ALBUM, "Two"},
+			      {TAG_GENRE, "Rock"}});
+	AddSong(*b, "b2.ogg", {{TAG_ARTIST, "Foo"}, {TAG_ALBUM, "Two"}});
+
+	return root;
+}
+
+static SongFilter
+MakeFilter(std::initializer_list<const char *> args, bool fold_case=false)
+{
+	SongFilter filter;
+	filter.Parse({args.begin(), args.size()}, fold_case);
+	return filter;
+}
+
+static std::vector<std::string>
+WalkUris(const Directory &directory, bool recursive, const SongFilter &filter)
+{
+	std::vector<std::string> result;
+	directory.Walk(recursive, &filter, VisitDirectory(),
+		       [&result](const LightSong &song){
+			       result.emplace_back(song.GetURI());
+		       },
+		       VisitPlaylist());
+	return result;
+}
+
+static std::vector<std::string>
+IndexUris(const TagIndex &index, const Directory &directory, bool recursive,
+	  const SongFilter &filter)
+{
+	std::vector<std::string> result;
+	EXPECT_TRUE(index.Visit(directory, recursive, filter,
+				[&result](const LightSong &song){
+					result.emplace_back(song.GetURI());
+				}));
+	return result;
+}
+
+TEST(TagIndex, Find)
+{
+	const auto root = MakeTree();
+	const ScopeDatabaseLock protect;
+	const TagIndex index(*root);
+	EXPECT_TRUE(index.IsValid());
+	EXPECT_FALSE(index.HasMounts());
+
+	const SongFilter filters[] = {
+		MakeFilter({"artist", "Foo"}),
+		MakeFilter({"artist", "Bar"}),
+		MakeFilter({"artist", "Nobody"}),
+		/* falls back to "Artist" */
+		MakeFilter({"albumartist", "Foo"}),
+		MakeFilter({"albumartistsort", "Foo"}),
+		MakeFilter({"album", "Two", "artist", "Foo"}),
+		MakeFilter({"genre", "Rock", "artist", "Baz"}),
+		MakeFilter({"artist", "Foo", "title", "untagged"}),
+		MakeFilter({"(artist == \"Foo\")"}),
+		MakeFilter({"(album == \"One\")", "(artist != \"Bar\")"}),
+	};
+
+	const Directory *a = root->FindChild("a");
+	ASSERT_NE(a, nullptr);
+
+	const Directory *const directories[] = {root.get(), a};
+
+	for (const auto &filter : filters) {
+		EXPECT_TRUE(TagIndex::CanVisit(filter))
+			<< filter.ToExpression();
+
+		for (const Directory *d : directories) {
+			for (bool recursive : {true, false}) {
+				EXPECT_EQ(WalkUris(*d, recursive, filter),
+					  IndexUris(index, *d, recursive, filter))
+					<< filter.ToExpression()
+					<< " in '" << d->GetPath() << "'";
+			}
+		}
+	}
+
+	EXPECT_EQ(std::vector<std::string>({"r1.ogg", "a/a1.ogg",
+					"a/a2.ogg", "a/x/x1.ogg",
+					"b/b2.ogg"}),
+		  IndexUris(index, *root, true, filters[0]));
+	EXPECT_EQ(std::vector<std::string>({"r1.ogg", "a/a1.ogg",
+					"a/a2.ogg", "a/a3.ogg",
+					"a/x/x1.ogg", "b/b2.ogg"}),
+		  IndexUris(index, *root, true, filters[3]));
+}
+
+TEST(TagIndex, NotIndexable)
+{
+	const auto root = MakeTree();
+	const ScopeDatabaseLock protect;
+	const TagIndex index(*root);
+
+	const SongFilter filters[] = {
+		MakeFilter({"(artist != \"Foo\")"}),
+		MakeFilter({"(artist contains \"Fo\")"}),
+		MakeFilter({"artist", ""}),
+		MakeFilter({"any", "Foo"}),
+		MakeFilter({"file", "a/a1.ogg"}),
+	};
+
+	for (const auto &filter : filters) {
+		EXPECT_FALSE(TagIndex::CanVisit(filter))
+			<< filter.ToExpression();
+		EXPECT_FALSE(index.Visit(*root, true, filter,
+					 [](const LightSong &){}))
+			<< filter.ToExpression();
+	}
+}
+
+TEST(TagIndex, Stale)
+{
+	const auto root = MakeTree();
+	const ScopeDatabaseLock protect;
+	const TagIndex index(*root);
+	EXPECT_TRUE(index.IsValid());
+
+	AddSong(*root, "r2.ogg", {{TAG_ARTIST, "Foo"}});
+	EXPECT_FALSE(index.IsValid());
+}
+
+TEST(TagIndex, CollectValues)
+{
+	const auto root = MakeTree();
+	const ScopeDatabaseLock protect;
+	const TagIndex index(*root);
+
+	for (TagType type : {TAG_ARTIST, TAG_ALBUM, TAG_ALBUM_ARTIST,
+			     TAG_GENRE, TAG_COMPOSER}) {
+		std::set<std::string> expected;
+		root->Walk(true, nullptr, VisitDirectory(),
+			   [&expected, type](const LightSong &song){
+				   VisitTagWithFallbackOrEmpty(song.tag, type,
+							       [&expected](const char *value){
+								       expected.emplace(value);
+							       });
+			   },
+			   VisitPlaylist());
+
+		std::set<std::string> actual;
+		index.CollectValues(type, actual);
+		EXPECT_EQ(expected, actual) << tag_item_names[type];
+	}
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "tag/Pool.hxx"
+#include "tag/Item.hxx"
+#include "util/StringView.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+
+TEST(TagPool, Dedup)
+{
+	const auto before = tag_pool_stats();
+
+	/* more references than the old 8 bit counter could hold */
+	static constexpr unsigned N = 1000;
+	std::vector<TagItem *> items;
+	for (unsigned i = 0; i < N; ++i)
+		items.push_back(tag_pool_get_item(TAG_ARTIST, "TagPool.Dedup"));
+
+	for (auto i : items) {
+		EXPECT_EQ(items.front(), i);
+		EXPECT_EQ(TAG_ARTIST, i->type);
+		EXPECT_STREQ("TagPool.Dedup", i->value);
+	}
+
+	/* a different type must not share the slot */
+	auto *other = tag_pool_get_item(TAG_ALBUM, "TagPool.Dedup");
+	EXPECT_NE(items.front(), other);
+
+	EXPECT_EQ(items.front(), tag_pool_dup_item(items.front()));
+	items.push_back(items.front());
+
+	const auto stats = tag_pool_stats();
+	EXPECT_EQ(before.slots + 2, stats.slots);
+	EXPECT_EQ(before.references + N + 2, stats.references);
+	EXPECT_GE(stats.max_chain, 1u);
+
+	tag_pool_put_item(other);
+	for (auto i : items)
+		tag_pool_put_item(i);
+
+	const auto after = tag_pool_stats();
+	EXPECT_EQ(before.slots, after.slots);
+	EXPECT_EQ(before.references, after.references);
+}
+
+TEST(TagPool, Grow)
+{
+	static constexpr unsigned N = 100000;
+
+	const auto before = tag_pool_stats();
+
+	std::vector<TagItem *> items;
+	items.reserve(N);
+	for (unsigned i = 0; i < N; ++i) {
+		const auto value = "TagPool.Grow." + std::to_string(i);
+		items.push_back(tag_pool_get_item(TAG_TITLE, value.c_str()));
+	}
+
+	const auto stats = tag_pool_stats();
+	EXPECT_EQ(before.slots + N, stats.slots);
+	EXPECT_GT(stats.buckets, before.buckets);
+	EXPECT_LE(stats.GetAverageChain(), 4.0);
+
+	for (unsigned i = 0; i < N; ++i) {
+		const auto value = "TagPool.Grow." + std::to_string(i);
+		EXPECT_STREQ(value.c_str(), items[i]->value);
+		EXPECT_EQ(items[i],
+			  tag_pool_get_item(TAG_TITLE, value.c_str()));
+		tag_pool_put_item(items[i]);
+		tag_pool_put_item(items[i]);
+	}
+
+	EXPECT_EQ(before.slots, tag_pool_stats().slots);
+}
+
+/**
+ * Several threads obtain and release the same few values
+ * concurrently; afterwards, the pool must be back in its initial
+ * state.
+ */
+TEST(TagPool, Concurrent)
+{
+	static constexpr unsigned N_THREADS = 4;
+	static constexpr unsigned N_VALUES = 8;
+	static constexpr unsigned N_ITERATIONS = 20000;
+
+	const auto before = tag_pool_stats();
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < N_THREADS; ++t)
+		threads.emplace_back([](){
+				for (unsigned i = 0; i < N_ITERATIONS; ++i) {
+					const auto value = "TagPool.Concurrent." +
+						std::to_string(i % N_VALUES);
+					auto *a = tag_pool_get_item(TAG_GENRE,
+								    value.c_str());
+					auto *b = tag_pool_dup_item(a);
+					ASSERT_EQ(a, b);
+					ASSERT_STREQ(value.c_str(), a->value);
+					tag_pool_put_item(a);
+					tag_pool_put_item(b);
+				}
+			});
+
+	for (auto &i : threads)
+		i.join();
+
+	const auto after = tag_pool_stats();
+	EXPECT_EQ(before.slots, after.slots);
+	EXPECT_EQ(before.references, after.references);
+}
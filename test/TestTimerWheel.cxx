@@ -0,0 +1,173 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "event/TimerWheel.hxx"
+#include "event/Loop.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+typedef TimerWheel::TimePoint TimePoint;
+typedef TimerWheel::Duration Duration;
+
+struct Timer {
+	TimerWheel &wheel;
+	CoarseTimerEvent event;
+
+	const TimePoint &now;
+
+	TimePoint due, fired;
+	unsigned n_fired = 0;
+
+	Timer(EventLoop &loop, TimerWheel &_wheel,
+	      const TimePoint &_now) noexcept
+		:wheel(_wheel), event(loop, BIND_THIS_METHOD(OnTimer)),
+		 now(_now) {}
+
+	void Schedule(TimePoint _due) noexcept {
+		event.Cancel();
+		due = _due;
+		wheel.Insert(event, due);
+	}
+
+	virtual ~Timer() noexcept = default;
+
+	virtual void OnTimer() noexcept {
+		fired = now;
+		++n_fired;
+	}
+};
+
+/**
+ * Schedule timers with random due times (some of them beyond the
+ * range of the wheel), advance the clock in random steps and verify
+ * that each timer is invoked exactly once, not before it is due and
+ * not later than #RESOLUTION after it is due.
+ */
+TEST(TimerWheel, Random)
+{
+	static constexpr unsigned N_TIMERS = 2000;
+
+	EventLoop loop;
+	TimePoint now(std::chrono::hours(1000));
+	TimerWheel wheel(now);
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int64_t> due_dist(0, 40LL * 24 * 3600 * 1000);
+
+	std::vector<std::unique_ptr<Timer>> timers;
+	for (unsigned i = 0; i < N_TIMERS; ++i) {
+		timers.emplace_back(new Timer(loop, wheel, now));
+		timers.back()->Schedule(now + std::chrono::milliseconds(due_dist(rng)));
+	}
+
+	/* a few timers which are due already */
+	for (unsigned i = 0; i < 10; ++i)
+		timers[i]->Schedule(now - std::chrono::seconds(i));
+
+	/* mostly small steps, sometimes huge ones */
+	std::uniform_int_distribution<int64_t> step_dist(1, 1000);
+	std::uniform_int_distribution<unsigned> big_dist(0, 99);
+
+	while (!wheel.IsEmpty()) {
+		const auto timeout = wheel.Run(now);
+
+		for (const auto &t : timers) {
+			if (t->n_fired == 0) {
+				/* it must have been invoked if it was
+				   due one tick ago */
+				ASSERT_LT(now, t->due + TimerWheel::RESOLUTION);
+				ASSERT_TRUE(t->event.IsActive());
+
+				/* the wheel must not sleep past it */
+				ASSERT_GE(timeout, timeout.zero());
+				ASSERT_LE(now + timeout, t->due + TimerWheel::RESOLUTION);
+			}
+		}
+
+		if (big_dist(rng) == 0)
+			now += std::chrono::hours(step_dist(rng));
+		else if (big_dist(rng) < 20)
+			now += timeout;
+		else
+			now += std::chrono::milliseconds(step_dist(rng));
+	}
+
+	for (const auto &t : timers) {
+		EXPECT_EQ(1u, t->n_fired);
+		EXPECT_GE(t->fired, t->due);
+		EXPECT_FALSE(t->event.IsActive());
+	}
+}
+
+struct RearmTimer : Timer {
+	Timer *cancel = nullptr;
+	Duration interval{};
+
+	using Timer::Timer;
+
+	void OnTimer() noexcept override {
+		Timer::OnTimer();
+
+		if (cancel != nullptr)
+			cancel->event.Cancel();
+
+		if (interval > interval.zero())
+			Schedule(now + interval);
+	}
+};
+
+/**
+ * Callbacks may re-schedule themselves and cancel other timers which
+ * are due at the same time.
+ */
+TEST(TimerWheel, Callbacks)
+{
+	EventLoop loop;
+	TimePoint now(std::chrono::hours(1000));
+	TimerWheel wheel(now);
+
+	Timer a(loop, wheel, now), b(loop, wheel, now);
+	RearmTimer r(loop, wheel, now);
+	r.cancel = &b;
+	r.interval = std::chrono::seconds(10);
+
+	r.Schedule(now + std::chrono::seconds(10));
+	b.Schedule(now + std::chrono::seconds(10));
+	a.Schedule(now + std::chrono::seconds(25));
+
+	for (unsigned i = 0; i < 300; ++i) {
+		now += std::chrono::milliseconds(100);
+		wheel.Run(now);
+	}
+
+	/* r cancelled b before it was invoked (r was scheduled
+	   first), and re-armed itself three times */
+	EXPECT_EQ(3u, r.n_fired);
+	EXPECT_EQ(0u, b.n_fired);
+	EXPECT_EQ(1u, a.n_fired);
+	EXPECT_TRUE(r.event.IsActive());
+
+	r.event.Cancel();
+	EXPECT_TRUE(wheel.IsEmpty());
+	EXPECT_LT(wheel.Run(now), Duration::zero());
+}
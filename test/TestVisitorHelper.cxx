@@ -0,0 +1,148 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "db/VHelper.hxx"
+#include "song/LightSong.hxx"
+#include "song/Filter.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Builder.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+struct TestSong {
+	std::string uri;
+	Tag tag;
+	std::chrono::system_clock::time_point mtime;
+};
+
+/**
+ * Generate songs with many duplicate sort keys, to verify that the
+ * sort is stable.
+ */
+static std::vector<TestSong>
+MakeSongs(unsigned n)
+{
+	std::vector<TestSong> songs;
+	unsigned seed = 42;
+
+	for (unsigned i = 0; i < n; ++i) {
+		seed = seed * 1103515245 + 12345;
+		const unsigned r = seed >> 16;
+
+		char buffer[32];
+		TagBuilder tag;
+		snprintf(buffer, sizeof(buffer), "Title %u", r % 37);
+		tag.AddItem(TAG_TITLE, buffer);
+		snprintf(buffer, sizeof(buffer), "%u", r % 23);
+		tag.AddItem(TAG_TRACK, buffer);
+		if (r % 5 != 0) {
+			snprintf(buffer, sizeof(buffer), "Artist %u", r % 11);
+			tag.AddItem(TAG_ARTIST, buffer);
+		}
+
+		songs.push_back({"song" + std::to_string(i), tag.Commit(),
+				 std::chrono::system_clock::from_time_t(1500000000 + r % 17)});
+	}
+
+	return songs;
+}
+
+static std::vector<std::string>
+Query(const std::vector<TestSong> &songs, TagType sort, bool descending,
+    RangeArg window)
+{
+	DatabaseSelection selection("", true);
+	selection.sort = sort;
+	selection.descending = descending;
+	selection.window = window;
+
+	std::vector<std::string> result;
+	VisitSong visit_song = [&result](const LightSong &song){
+		result.emplace_back(song.uri);
+	};
+
+	DatabaseVisitorHelper helper(selection, visit_song);
+
+	for (const auto &i : songs) {
+		LightSong song(i.uri.c_str(), i.tag);
+		song.mtime = i.mtime;
+		visit_song(song);
+	}
+
+	helper.Commit();
+	return result;
+}
+
+TEST(DatabaseVisitorHelper, Window)
+{
+	const auto songs = MakeSongs(1000);
+
+	static constexpr RangeArg windows[] = {
+		{0, 0}, {0, 1}, {0, 50}, {10, 60}, {990, 1000},
+		{500, 2000}, {1000, 1010},
+	};
+
+	for (TagType sort : {TAG_TITLE, TAG_TRACK, TAG_ARTIST,
+			     TagType(SORT_TAG_LAST_MODIFIED)}) {
+		for (bool descending : {false, true}) {
+			/* the reference: sort everything, then apply
+			   the window */
+			const auto all = Query(songs, sort, descending,
+					     RangeArg::All());
+			ASSERT_EQ(songs.size(), all.size());
+
+			for (const auto &window : windows) {
+				std::vector<std::string> expected;
+				for (unsigned i = window.start;
+				     i < window.end && i < all.size(); ++i)
+					expected.push_back(all[i]);
+
+				EXPECT_EQ(expected,
+					  Query(songs, sort, descending, window))
+					<< "sort=" << unsigned(sort)
+					<< " descending=" << descending
+					<< " window=" << window.start
+					<< ":" << window.end;
+			}
+		}
+	}
+}
+
+TEST(DatabaseVisitorHelper, Stable)
+{
+	const auto songs = MakeSongs(200);
+	const auto all = Query(songs, TAG_TITLE, false, RangeArg::All());
+
+	/* songs with the same title remain in visit order */
+	for (size_t i = 1; i < all.size(); ++i) {
+		const auto a = std::stoul(all[i - 1].substr(4));
+		const auto b = std::stoul(all[i].substr(4));
+		const char *a_title = songs[a].tag.GetValue(TAG_TITLE);
+		const char *b_title = songs[b].tag.GetValue(TAG_TITLE);
+		if (strcmp(a_title, b_title) == 0) {
+			EXPECT_LT(a, b);
+		}
+	}
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "thread/WorkerPool.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+static void
+RunJobs(WorkerPool &pool, unsigned n_jobs)
+{
+	std::atomic_uint counter(0);
+	std::vector<unsigned> done(n_jobs, 0);
+
+	WorkerPool::Group group;
+	for (unsigned i = 0; i < n_jobs; ++i)
+		pool.Push(group, [&counter, &done, i](){
+				++done[i];
+				++counter;
+			});
+
+	pool.Wait(group);
+
+	EXPECT_EQ(n_jobs, counter.load());
+	for (unsigned i = 0; i < n_jobs; ++i)
+		EXPECT_EQ(1u, done[i]);
+}
+
+TEST(WorkerPool, Completion)
+{
+	WorkerPool pool("test", 4);
+	EXPECT_FALSE(pool.IsSerial());
+
+	RunJobs(pool, 1);
+	RunJobs(pool, 1000);
+
+	/* an empty group */
+	RunJobs(pool, 0);
+}
+
+TEST(WorkerPool, Serial)
+{
+	WorkerPool pool("test", 0);
+	EXPECT_TRUE(pool.IsSerial());
+
+	RunJobs(pool, 100);
+
+	/* without threads, the jobs are executed in submission
+	   order */
+	std::vector<unsigned> order;
+	WorkerPool::Group group;
+	for (unsigned i = 0; i < 10; ++i)
+		pool.Push(group, [&order, i](){
+				order.push_back(i);
+			});
+
+	EXPECT_TRUE(order.empty());
+	pool.Wait(group);
+
+	ASSERT_EQ(size_t(10), order.size());
+	for (unsigned i = 0; i < 10; ++i)
+		EXPECT_EQ(i, order[i]);
+}
+
+/**
+ * Jobs which submit jobs to a nested group and wait for it must not
+ * deadlock, even if there are more of them than threads.
+ */
+TEST(WorkerPool, Nested)
+{
+	WorkerPool pool("test", 2);
+
+	std::atomic_uint counter(0);
+
+	WorkerPool::Group outer;
+	for (unsigned i = 0; i < 16; ++i)
+		pool.Push(outer, [&pool, &counter](){
+				WorkerPool::Group inner;
+				for (unsigned j = 0; j < 16; ++j)
+					pool.Push(inner, [&counter](){
+							++counter;
+						});
+
+				pool.Wait(inner);
+			});
+
+	pool.Wait(outer);
+	EXPECT_EQ(16u * 16u, counter.load());
+}
+
+static void
+TestException(WorkerPool &pool)
+{
+	std::atomic_uint counter(0);
+
+	WorkerPool::Group group;
+	for (unsigned i = 0; i < 100; ++i)
+		pool.Push(group, [&counter, i](){
+				++counter;
+				if (i % 10 == 3)
+					throw std::runtime_error("Failure");
+			});
+
+	try {
+		pool.Wait(group);
+		FAIL() << "exception expected";
+	} catch (const std::runtime_error &e) {
+		EXPECT_STREQ("Failure", e.what());
+	}
+
+	/* the other jobs have been executed nonetheless */
+	EXPECT_EQ(100u, counter.load());
+
+	/* the error has been consumed; the group can be reused */
+	pool.Push(group, [&counter](){
+			++counter;
+		});
+	pool.Wait(group);
+	EXPECT_EQ(101u, counter.load());
+}
+
+TEST(WorkerPool, Exception)
+{
+	WorkerPool pool("test", 4);
+	TestException(pool);
+}
+
+TEST(WorkerPool, ExceptionSerial)
+{
+	WorkerPool pool("test", 0);
+	TestException(pool);
+}
+
+TEST(WorkerPool, NestedException)
+{
+	WorkerPool pool("test", 2);
+
+	WorkerPool::Group outer;
+	pool.Push(outer, [&pool](){
+			WorkerPool::Group inner;
+			pool.Push(inner, [](){
+					throw std::runtime_error("Inner");
+				});
+
+			/* the inner exception is rethrown here, and
+			   then propagated to the outer group */
+			pool.Wait(inner);
+		});
+
+	EXPECT_THROW(pool.Wait(outer), std::runtime_error);
+}
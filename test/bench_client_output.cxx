@@ -0,0 +1,202 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures how fast MPD delivers large responses to
+ * many clients at the same time.  It opens the given number of
+ * connections to a running MPD, sends the same command on all of them
+ * simultaneously (repeatedly), reads the complete responses and
+ * prints the total throughput.
+ *
+ * Example: 100 clients requesting "listallinfo" 5 times each:
+ *
+ *  bench_client_output localhost 6600 listallinfo 100 5
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdexcept>
+
+#include <netdb.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static int
+Connect(const char *host, const char *port)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *ai;
+	if (getaddrinfo(host, port, &hints, &ai) != 0)
+		throw std::runtime_error("Failed to resolve host name");
+
+	int fd = -1;
+	for (const auto *i = ai; i != nullptr; i = i->ai_next) {
+		fd = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		if (connect(fd, i->ai_addr, i->ai_addrlen) == 0)
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(ai);
+
+	if (fd < 0)
+		throw std::runtime_error("Failed to connect");
+
+	return fd;
+}
+
+/**
+ * Read one response (until "OK" or "ACK").
+ *
+ * @return the number of bytes received
+ */
+static uint64_t
+ReadResponse(int fd)
+{
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+	std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+
+	uint64_t total = 0;
+	std::string line;
+
+	while (true) {
+		ssize_t nbytes = recv(fd, buffer.get(), BUFFER_SIZE, 0);
+		if (nbytes <= 0)
+			throw std::runtime_error("Connection closed");
+
+		total += nbytes;
+
+		const char *p = buffer.get(), *const end = p + nbytes;
+		while (p < end) {
+			const char *newline = (const char *)
+				memchr(p, '\n', end - p);
+			if (newline == nullptr) {
+				line.append(p, end);
+				break;
+			}
+
+			line.append(p, newline);
+			p = newline + 1;
+
+			if (line == "OK" || line.compare(0, 4, "ACK ") == 0) {
+				if (p != end)
+					throw std::runtime_error("Unexpected data after response");
+				return total;
+			}
+
+			line.clear();
+		}
+	}
+}
+
+static void
+SendCommand(int fd, const std::string &command)
+{
+	if (send(fd, command.data(), command.size(), 0) !=
+	    (ssize_t)command.size())
+		throw std::runtime_error("Failed to send");
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 4 || argc > 6) {
+		fprintf(stderr, "Usage: bench_client_output HOST PORT COMMAND [CLIENTS [ITERATIONS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *const host = argv[1], *const port = argv[2];
+	const std::string command = std::string(argv[3]) + "\n";
+	const unsigned n_clients = argc >= 5
+		? std::max(strtoul(argv[4], nullptr, 10), 1ul)
+		: 100;
+	const unsigned iterations = argc >= 6
+		? std::max(strtoul(argv[5], nullptr, 10), 1ul)
+		: 1;
+
+	std::vector<int> fds;
+	for (unsigned i = 0; i < n_clients; ++i) {
+		const int fd = Connect(host, port);
+		fds.push_back(fd);
+
+		/* consume the greeting */
+		char greeting[256];
+		if (recv(fd, greeting, sizeof(greeting), 0) <= 0)
+			throw std::runtime_error("No greeting");
+	}
+
+	std::vector<uint64_t> received(n_clients);
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < iterations; ++i) {
+		/* send all requests first, so MPD has to serve all
+		   clients at the same time */
+		for (int fd : fds)
+			SendCommand(fd, command);
+
+		std::vector<std::thread> threads;
+		for (unsigned j = 0; j < n_clients; ++j)
+			threads.emplace_back([&received, &fds, j](){
+					received[j] += ReadResponse(fds[j]);
+				});
+
+		for (auto &t : threads)
+			t.join();
+	}
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	uint64_t total = 0;
+	for (auto i : received)
+		total += i;
+
+	for (int fd : fds)
+		close(fd);
+
+	printf("clients=%u iterations=%u response=%llu bytes\n",
+	       n_clients, iterations,
+	       (unsigned long long)(received.front() / iterations));
+	printf("total=%.1f MB time=%.3fs throughput=%.1f MB/s\n",
+	       total / 1e6, duration.count(),
+	       total / 1e6 / duration.count());
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures how long it takes to load a "simple"
+ * database in each of the supported formats, i.e. the database part
+ * of MPD's startup time.  It loads the given database file (any
+ * format), writes it to temporary files in the text, gzip and binary
+ * formats, and loads each of them repeatedly.
+ *
+ * Example:
+ *
+ *  bench_database_load ~/.mpd/database 5
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/BinaryDatabase.hxx"
+#include "config/File.hxx"
+#include "config/Migrate.hxx"
+#include "config/Data.hxx"
+#include "tag/Config.hxx"
+#include "fs/Path.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/PrintException.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "fs/io/GzipOutputStream.hxx"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+enum class Format {
+	TEXT,
+	GZIP,
+	BINARY,
+};
+
+static void
+Save(Path path, const Directory &root, Format format)
+{
+	FileOutputStream fos(path);
+
+	switch (format) {
+	case Format::TEXT:
+		{
+			BufferedOutputStream bos(fos);
+			db_save_internal(bos, root);
+			bos.Flush();
+		}
+		break;
+
+	case Format::GZIP:
+#ifdef ENABLE_ZLIB
+		{
+			GzipOutputStream gzip(fos);
+			BufferedOutputStream bos(gzip);
+			db_save_internal(bos, root);
+			bos.Flush();
+			gzip.Flush();
+		}
+#endif
+		break;
+
+	case Format::BINARY:
+		{
+			BufferedOutputStream bos(fos);
+			db_save_binary(bos, root);
+			bos.Flush();
+		}
+		break;
+	}
+
+	fos.Commit();
+}
+
+static unsigned
+CountSongs(const Directory &directory) noexcept
+{
+	unsigned n = 0;
+	for (gcc_unused const auto &song : directory.songs)
+		++n;
+
+	for (const auto &child : directory.children)
+		n += CountSongs(child);
+
+	return n;
+}
+
+static void
+Bench(const char *label, Path path, unsigned iterations)
+{
+	const FileInfo fi(path);
+
+	double best = 1e9, total = 0;
+	unsigned n_songs = 0;
+
+	for (unsigned i = 0; i < iterations; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+
+		std::unique_ptr<Directory> root(Directory::NewRoot());
+		db_load_file(path, *root);
+
+		const std::chrono::duration<double> duration =
+			std::chrono::steady_clock::now() - start;
+
+		n_songs = CountSongs(*root);
+		best = std::min(best, duration.count());
+		total += duration.count();
+	}
+
+	printf("%-6s size=%10llu songs=%u best=%.3fs avg=%.3fs\n",
+	       label, (unsigned long long)fi.GetSize(), n_songs,
+	       best, total / iterations);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "Usage: bench_database_load DATABASE [ITERATIONS [CONFIG]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path input_path = Path::FromFS(argv[1]);
+	const unsigned iterations = argc >= 3
+		? std::max(strtoul(argv[2], nullptr, 10), 1ul)
+		: 3;
+
+	if (argc >= 4) {
+		ConfigData config;
+		ReadConfigFile(config, Path::FromFS(argv[3]));
+		Migrate(config);
+		TagLoadConfig(config);
+	}
+
+	const std::string prefix = "/tmp/bench_database_load." +
+		std::to_string(getpid());
+	const auto text_path = AllocatedPath::FromFS(prefix + ".txt");
+	const auto gzip_path = AllocatedPath::FromFS(prefix + ".gz");
+	const auto binary_path = AllocatedPath::FromFS(prefix + ".bin");
+
+	{
+		std::unique_ptr<Directory> root(Directory::NewRoot());
+		db_load_file(input_path, *root);
+
+		Save(text_path, *root, Format::TEXT);
+#ifdef ENABLE_ZLIB
+		Save(gzip_path, *root, Format::GZIP);
+#endif
+		Save(binary_path, *root, Format::BINARY);
+	}
+
+	Bench("text", text_path, iterations);
+#ifdef ENABLE_ZLIB
+	Bench("gzip", gzip_path, iterations);
+#endif
+	Bench("binary", binary_path, iterations);
+
+	RemoveFile(text_path);
+#ifdef ENABLE_ZLIB
+	RemoveFile(gzip_path);
+#endif
+	RemoveFile(binary_path);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the cost of database queries on a "simple"
+ * database with and without the #TagIndex: "find" with exact tag
+ * values and "list" without a filter.  It loads the given database
+ * file and picks some artist and album names from it.
+ *
+ * Example:
+ *
+ *  bench_database_query ~/.mpd/database 10
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "config/File.hxx"
+#include "config/Migrate.hxx"
+#include "config/Data.hxx"
+#include "tag/Config.hxx"
+#include "tag/VisitFallback.hxx"
+#include "fs/Path.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static constexpr unsigned N_VALUES = 20;
+
+/**
+ * Pick up to #N_VALUES values, evenly distributed over the sorted
+ * set.
+ */
+static std::vector<std::string>
+PickValues(const std::set<std::string> &values)
+{
+	std::vector<std::string> result;
+	const size_t step = std::max<size_t>(values.size() / N_VALUES, 1);
+
+	size_t i = 0;
+	for (const auto &value : values) {
+		if (!value.empty() && i++ % step == 0)
+			result.push_back(value);
+		if (result.size() >= N_VALUES)
+			break;
+	}
+
+	return result;
+}
+
+template<typename F>
+static double
+Measure(unsigned iterations, F &&f)
+{
+	double best = 1e9;
+
+	for (unsigned i = 0; i < iterations; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		const std::chrono::duration<double> duration =
+			std::chrono::steady_clock::now() - start;
+		best = std::min(best, duration.count());
+	}
+
+	return best;
+}
+
+static void
+BenchFind(const Directory &root, const TagIndex &index,
+	  TagType type, const std::vector<std::string> &values,
+	  unsigned iterations)
+{
+	std::vector<SongFilter> filters;
+	for (const auto &value : values)
+		filters.emplace_back(type, value.c_str());
+
+	unsigned walk_matches = 0, index_matches = 0;
+
+	const double walk = Measure(iterations, [&](){
+			walk_matches = 0;
+			for (const auto &filter : filters)
+				root.Walk(true, &filter, VisitDirectory(),
+					  [&](const LightSong &){
+						  ++walk_matches;
+					  },
+					  VisitPlaylist());
+		});
+
+	const double indexed = Measure(iterations, [&](){
+			index_matches = 0;
+			for (const auto &filter : filters)
+				index.Visit(root, true, filter,
+					    [&](const LightSong &){
+						    ++index_matches;
+					    });
+		});
+
+	printf("find %-12s queries=%zu matches=%u walk=%.3fms index=%.3fms%s\n",
+	       tag_item_names[type], filters.size(), walk_matches,
+	       walk * 1e3 / filters.size(), indexed * 1e3 / filters.size(),
+	       walk_matches != index_matches ? " MISMATCH" : "");
+}
+
+static std::set<std::string>
+CollectByWalk(const Directory &root, TagType type)
+{
+	std::set<std::string> result;
+	root.Walk(true, nullptr, VisitDirectory(),
+		  [&result, type](const LightSong &song){
+			  VisitTagWithFallbackOrEmpty(song.tag, type,
+						      [&result](const char *value){
+							      result.emplace(value);
+						      });
+		  },
+		  VisitPlaylist());
+	return result;
+}
+
+static std::set<std::string>
+BenchList(const Directory &root, const TagIndex &index, TagType type,
+	  unsigned iterations)
+{
+	std::set<std::string> walk_result, index_result;
+
+	const double walk = Measure(iterations, [&](){
+			walk_result = CollectByWalk(root, type);
+		});
+
+	const double indexed = Measure(iterations, [&](){
+			index_result.clear();
+			index.CollectValues(type, index_result);
+		});
+
+	printf("list %-12s values=%zu walk=%.3fms index=%.3fms%s\n",
+	       tag_item_names[type], walk_result.size(),
+	       walk * 1e3, indexed * 1e3,
+	       walk_result != index_result ? " MISMATCH" : "");
+
+	return index_result;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr, "Usage: bench_database_query DATABASE [ITERATIONS [CONFIG]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path path = Path::FromFS(argv[1]);
+	const unsigned iterations = argc >= 3
+		? std::max(strtoul(argv[2], nullptr, 10), 1ul)
+		: 3;
+
+	if (argc >= 4) {
+		ConfigData config;
+		ReadConfigFile(config, Path::FromFS(argv[3]));
+		Migrate(config);
+		TagLoadConfig(config);
+	}
+
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+	db_load_file(path, *root);
+
+	const ScopeDatabaseLock protect;
+
+	const auto start = std::chrono::steady_clock::now();
+	const TagIndex index(*root);
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+	printf("build index: %.3fms\n", duration.count() * 1e3);
+
+	const auto artists = BenchList(*root, index, TAG_ARTIST, iterations);
+	const auto albums = BenchList(*root, index, TAG_ALBUM, iterations);
+	BenchList(*root, index, TAG_ALBUM_ARTIST, iterations);
+
+	BenchFind(*root, index, TAG_ARTIST, PickValues(artists), iterations);
+	BenchFind(*root, index, TAG_ALBUM, PickValues(albums), iterations);
+	BenchFind(*root, index, TAG_ALBUM_ARTIST, PickValues(artists),
+		  iterations);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
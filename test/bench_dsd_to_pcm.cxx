@@ -0,0 +1,155 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the DSD to PCM conversion
+ * of #PcmDsd with the given number of threads, and compares it with
+ * the dsd2pcm library.
+ *
+ * Example: convert 60 seconds of 6 channel DSD512 with 1 and with 4
+ * threads:
+ *
+ *  bench_dsd_to_pcm dsd512:6 60 1
+ *  bench_dsd_to_pcm dsd512:6 60 4
+ */
+
+#include "AudioParser.hxx"
+#include "AudioFormat.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/PrintException.hxx"
+
+#include <memory>
+#include <random>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * The number of frames converted per call, similar to the chunk size
+ * used by the player.
+ */
+static constexpr size_t CHUNK_FRAMES = 16384;
+
+static double
+GetWallTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+BenchDsd2pcm(unsigned channels, const uint8_t *src, size_t n_chunks)
+{
+	std::unique_ptr<dsd2pcm_ctx *[]> ctx(new dsd2pcm_ctx *[channels]);
+	for (unsigned c = 0; c < channels; ++c)
+		ctx[c] = dsd2pcm_init();
+
+	std::unique_ptr<float[]> dest(new float[CHUNK_FRAMES * channels]);
+
+	const double start = GetWallTime();
+
+	for (size_t i = 0; i < n_chunks; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			dsd2pcm_translate(ctx[c], CHUNK_FRAMES,
+					  src + c, channels, false,
+					  dest.get() + c, channels);
+
+	const double duration = GetWallTime() - start;
+
+	for (unsigned c = 0; c < channels; ++c)
+		dsd2pcm_destroy(ctx[c]);
+
+	return duration;
+}
+
+static double
+BenchPcmDsd(unsigned channels, unsigned threads,
+	    const uint8_t *src, size_t n_chunks)
+{
+	PcmDsd dsd;
+	dsd.SetThreads(threads);
+
+	const ConstBuffer<uint8_t> chunk(src, CHUNK_FRAMES * channels);
+
+	const double start = GetWallTime();
+
+	for (size_t i = 0; i < n_chunks; ++i)
+		dsd.ToFloat(channels, chunk);
+
+	return GetWallTime() - start;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 4) {
+		fprintf(stderr,
+			"Usage: bench_dsd_to_pcm FORMAT [SECONDS [THREADS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto audio_format = ParseAudioFormat(argv[1], false);
+	if (audio_format.format != SampleFormat::DSD) {
+		fprintf(stderr, "Not a DSD format\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned seconds = argc >= 3 ? strtoul(argv[2], nullptr, 10) : 60;
+	const unsigned threads = argc >= 4 ? strtoul(argv[3], nullptr, 10) : 1;
+	const unsigned channels = audio_format.channels;
+
+	/* the sample rate is in bytes per second per channel */
+	const size_t n_chunks =
+		(uint64_t(audio_format.sample_rate) * seconds + CHUNK_FRAMES - 1)
+		/ CHUNK_FRAMES;
+
+	/* random input defeats any shortcut for silence */
+	const size_t src_size = CHUNK_FRAMES * channels;
+	std::unique_ptr<uint8_t[]> src(new uint8_t[src_size]);
+	std::mt19937 rng(42);
+	for (size_t i = 0; i < src_size; ++i)
+		src[i] = rng();
+
+	const double input_mb = double(n_chunks) * src_size / (1024 * 1024);
+	const double audio_seconds =
+		double(n_chunks) * CHUNK_FRAMES / audio_format.sample_rate;
+
+	const double reference = BenchDsd2pcm(channels, src.get(), n_chunks);
+	const double duration = BenchPcmDsd(channels, threads,
+					    src.get(), n_chunks);
+
+	printf("format=%s seconds=%.1f threads=%u\n",
+	       ToString(audio_format).c_str(), audio_seconds, threads);
+	printf("dsd2pcm: %.3fs %.1f MB/s realtime=%.1fx\n",
+	       reference, input_mb / reference, audio_seconds / reference);
+	printf("PcmDsd:  %.3fs %.1f MB/s realtime=%.1fx speedup=%.2f\n",
+	       duration, input_mb / duration, audio_seconds / duration,
+	       reference / duration);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program is a load test for the "httpd" output plugin: it
+ * connects many HTTP clients to a running MPD and reads the stream
+ * with all of them, and finally reports how much data each client
+ * has received.  Optionally, it measures the CPU time MPD has used
+ * meanwhile.
+ *
+ * Example: 500 clients for 30 seconds:
+ *
+ *  bench_httpd_clients localhost 8000 500 30 $(pidof mpd)
+ */
+
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct Client {
+	int fd;
+
+	uint64_t received = 0;
+
+	bool closed = false;
+};
+
+static int
+Connect(const struct addrinfo &ai)
+{
+	int fd = socket(ai.ai_family, ai.ai_socktype | SOCK_CLOEXEC,
+			ai.ai_protocol);
+	if (fd < 0)
+		throw std::runtime_error(strerror(errno));
+
+	if (connect(fd, ai.ai_addr, ai.ai_addrlen) < 0) {
+		const int e = errno;
+		close(fd);
+		throw std::runtime_error(strerror(e));
+	}
+
+	static constexpr char request[] =
+		"GET / HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"\r\n";
+	if (write(fd, request, sizeof(request) - 1) != sizeof(request) - 1) {
+		const int e = errno;
+		close(fd);
+		throw std::runtime_error(strerror(e));
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+/**
+ * Returns the CPU time (user and system) of the specified process
+ * in seconds, or a negative value on error.
+ */
+static double
+GetProcessCpuTime(const char *pid)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%s/stat", pid);
+
+	FILE *file = fopen(path, "r");
+	if (file == nullptr)
+		return -1;
+
+	char buffer[1024];
+	size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+	fclose(file);
+	buffer[length] = 0;
+
+	/* skip "pid (comm)", which may contain spaces */
+	const char *p = strrchr(buffer, ')');
+	if (p == nullptr)
+		return -1;
+
+	/* utime and stime are fields 14 and 15 */
+	unsigned long utime, stime;
+	if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		   &utime, &stime) != 2)
+		return -1;
+
+	return double(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 4 || argc > 6) {
+		fprintf(stderr,
+			"Usage: bench_httpd_clients HOST PORT CLIENTS [SECONDS [PID]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *const host = argv[1], *const port = argv[2];
+	const unsigned n_clients = strtoul(argv[3], nullptr, 10);
+	const unsigned seconds = argc >= 5 ? strtoul(argv[4], nullptr, 10) : 10;
+	const char *const pid = argc >= 6 ? argv[5] : nullptr;
+
+	struct addrinfo hints, *ai;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_socktype = SOCK_STREAM;
+	int error = getaddrinfo(host, port, &hints, &ai);
+	if (error != 0)
+		throw std::runtime_error(gai_strerror(error));
+
+	std::vector<Client> clients;
+	clients.reserve(n_clients);
+	for (unsigned i = 0; i < n_clients; ++i)
+		clients.push_back({Connect(*ai)});
+
+	freeaddrinfo(ai);
+
+	const double start_cpu = pid != nullptr
+		? GetProcessCpuTime(pid)
+		: -1;
+
+	std::vector<struct pollfd> pfds(n_clients);
+	const auto start = std::chrono::steady_clock::now();
+	const auto end = start + std::chrono::seconds(seconds);
+
+	static char buffer[65536];
+
+	while (true) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			break;
+
+		unsigned n_open = 0;
+		for (unsigned i = 0; i < n_clients; ++i) {
+			pfds[i].fd = clients[i].closed ? -1 : clients[i].fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+			if (!clients[i].closed)
+				++n_open;
+		}
+
+		if (n_open == 0)
+			break;
+
+		const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(end - now);
+		if (poll(pfds.data(), n_clients, timeout.count() + 1) < 0 &&
+		    errno != EINTR)
+			throw std::runtime_error(strerror(errno));
+
+		for (unsigned i = 0; i < n_clients; ++i) {
+			if (pfds[i].revents == 0)
+				continue;
+
+			auto &client = clients[i];
+			ssize_t nbytes = read(client.fd, buffer, sizeof(buffer));
+			if (nbytes > 0)
+				client.received += nbytes;
+			else if (nbytes == 0 || errno != EAGAIN)
+				client.closed = true;
+		}
+	}
+
+	const double duration =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t total = 0, min = UINT64_MAX, max = 0;
+	unsigned n_closed = 0;
+	for (const auto &client : clients) {
+		total += client.received;
+		min = std::min(min, client.received);
+		max = std::max(max, client.received);
+		if (client.closed)
+			++n_closed;
+
+		close(client.fd);
+	}
+
+	printf("clients=%u disconnected=%u duration=%.1fs\n",
+	       n_clients, n_closed, duration);
+	printf("total=%.1f MB per_client min=%.1f avg=%.1f max=%.1f kB/s\n",
+	       total / 1e6,
+	       min / 1e3 / duration,
+	       total / 1e3 / duration / std::max(n_clients, 1u),
+	       max / 1e3 / duration);
+
+	if (start_cpu >= 0) {
+		const double cpu = GetProcessCpuTime(pid) - start_cpu;
+		printf("server_cpu=%.2fs (%.1f%%)\n", cpu, cpu * 100 / duration);
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
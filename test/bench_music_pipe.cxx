@@ -0,0 +1,142 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the CPU cost of moving audio data through a
+ * #MusicBuffer and a #MusicPipe, the way the decoder and the player
+ * thread do, for a given audio format and chunk size.
+ *
+ * Example: compare CD audio with 4 kB chunks against 384 kHz 8
+ * channel audio with 4 kB and with automatically sized chunks:
+ *
+ *  bench_music_pipe 44100:16:2 4
+ *  bench_music_pipe 384000:32:8 4
+ *  bench_music_pipe 384000:32:8
+ */
+
+#include "AudioParser.hxx"
+#include "AudioFormat.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <memory>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+static double
+GetCpuTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 5) {
+		fprintf(stderr,
+			"Usage: bench_music_pipe FORMAT [CHUNK_KB [SECONDS [lockfree]]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto audio_format = ParseAudioFormat(argv[1], false);
+	const size_t chunk_size = argc >= 3 && strcmp(argv[2], "auto") != 0
+		? strtoul(argv[2], nullptr, 10) * 1024
+		: CalculateChunkSize(audio_format);
+	const unsigned seconds = argc >= 4 ? strtoul(argv[3], nullptr, 10) : 600;
+	const bool lock_free = argc >= 5 && strcmp(argv[4], "lockfree") == 0;
+
+	if (chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE) {
+		fprintf(stderr, "Invalid chunk size\n");
+		return EXIT_FAILURE;
+	}
+
+	const uint64_t total_size = uint64_t(audio_format.TimeToSize(std::chrono::seconds(1)))
+		* seconds;
+	const size_t frame_size = audio_format.GetFrameSize();
+
+	MusicBuffer buffer(BUFFER_SIZE / chunk_size, chunk_size, lock_free);
+	auto pipe = lock_free
+		? std::make_unique<MusicPipe>(buffer.GetSize())
+		: std::make_unique<MusicPipe>();
+
+	/* the "decoded" source data */
+	std::unique_ptr<uint8_t[]> source(new uint8_t[chunk_size]);
+	memset(source.get(), 0x55, chunk_size);
+
+	uint64_t remaining = total_size, n_chunks = 0, checksum = 0;
+
+	const double start = GetCpuTime();
+
+	while (remaining > 0) {
+		/* decoder: fill the buffer */
+		while (remaining > 0) {
+			auto chunk = buffer.Allocate();
+			if (chunk == nullptr)
+				break;
+
+			auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+			size_t nbytes = std::min<uint64_t>(w.size, remaining);
+			nbytes -= nbytes % frame_size;
+			if (nbytes == 0)
+				nbytes = frame_size;
+
+			memcpy(w.data, source.get(), nbytes);
+			chunk->Expand(audio_format, nbytes);
+			chunk->replay_gain_serial = 1;
+			remaining -= std::min<uint64_t>(nbytes, remaining);
+
+			pipe->Push(std::move(chunk));
+			++n_chunks;
+		}
+
+		/* player: consume everything */
+		while (auto chunk = pipe->Shift()) {
+			if (chunk->tag == nullptr &&
+			    chunk->replay_gain_serial != 0)
+				checksum += chunk->data[chunk->length - 1];
+		}
+	}
+
+	const double duration = GetCpuTime() - start;
+
+	printf("format=%s chunk_size=%zu chunks=%llu\n",
+	       ToString(audio_format).c_str(), chunk_size,
+	       (unsigned long long)n_chunks);
+	printf("cpu=%.3fs per_chunk=%.1fns per_audio_second=%.3fms checksum=%llu\n",
+	       duration, duration * 1e9 / n_chunks,
+	       duration * 1e3 / seconds,
+	       (unsigned long long)checksum);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program compares the #PollGroup implementations: it creates
+ * many socket pairs, registers one end of each with the #PollGroup,
+ * and in each round makes some of them readable.  For each event,
+ * it toggles the WRITE flag on and off again, like MPD's clients do
+ * when they send a response.  It reports the number of system calls
+ * made by the #PollGroup (not counting the socket I/O of this
+ * program) and the CPU time.
+ *
+ * Example: 1000 connections, 50 of them active per round:
+ *
+ *  bench_poll_group epoll 1000 50
+ *  bench_poll_group io_uring 1000 50
+ */
+
+#include "config.h"
+#include "event/PollGroupEpoll.hxx"
+#ifdef USE_IO_URING
+#include "event/PollGroupUring.hxx"
+#endif
+#include "util/PrintException.hxx"
+
+#include <stdexcept>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static double
+GetCpuTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Connection {
+	int fd, peer;
+};
+
+/**
+ * Wraps #PollGroupEpoll and counts its system calls: each method
+ * call is exactly one.
+ */
+class CountingPollGroupEpoll {
+	PollGroupEpoll group;
+
+public:
+	typedef PollResultEpoll Result;
+
+	static constexpr unsigned READ = PollGroupEpoll::READ;
+	static constexpr unsigned WRITE = PollGroupEpoll::WRITE;
+
+	uint64_t n_syscalls = 0;
+
+	uint64_t GetSystemCallCount() const noexcept {
+		return n_syscalls;
+	}
+
+	void ReadEvents(Result &result, int timeout_ms) noexcept {
+		++n_syscalls;
+		group.ReadEvents(result, timeout_ms);
+	}
+
+	void Add(int fd, unsigned events, void *obj) noexcept {
+		++n_syscalls;
+		group.Add(fd, events, obj);
+	}
+
+	void Modify(int fd, unsigned events, void *obj) noexcept {
+		++n_syscalls;
+		group.Modify(fd, events, obj);
+	}
+
+	void Remove(int fd) noexcept {
+		++n_syscalls;
+		group.Remove(fd);
+	}
+};
+
+#ifdef USE_IO_URING
+
+class CountingPollGroupUring {
+	PollGroupUring group;
+
+public:
+	typedef PollResultGeneric Result;
+
+	static constexpr unsigned READ = PollGroupUring::READ;
+	static constexpr unsigned WRITE = PollGroupUring::WRITE;
+
+	CountingPollGroupUring() {
+		if (!group.IsUring())
+			throw std::runtime_error("io_uring is not available");
+	}
+
+	uint64_t GetSystemCallCount() const noexcept {
+		return group.GetEnterCount();
+	}
+
+	void ReadEvents(Result &result, int timeout_ms) noexcept {
+		group.ReadEvents(result, timeout_ms);
+	}
+
+	void Add(int fd, unsigned events, void *obj) noexcept {
+		group.Add(fd, events, obj);
+	}
+
+	void Modify(int fd, unsigned events, void *obj) noexcept {
+		group.Modify(fd, events, obj);
+	}
+
+	void Remove(int fd) noexcept {
+		group.Remove(fd);
+	}
+};
+
+#endif
+
+template<typename G>
+static void
+Run(std::vector<Connection> &connections, unsigned n_active,
+    unsigned n_rounds)
+{
+	G group;
+
+	for (auto &c : connections)
+		group.Add(c.fd, G::READ, &c);
+
+	const uint64_t start_syscalls = group.GetSystemCallCount();
+	const double start = GetCpuTime();
+
+	typename G::Result result;
+	uint64_t n_events = 0;
+	size_t next = 0;
+
+	for (unsigned round = 0; round < n_rounds; ++round) {
+		for (unsigned i = 0; i < n_active; ++i) {
+			const auto &c = connections[next];
+			next = (next + 1) % connections.size();
+
+			if (write(c.peer, "x", 1) != 1)
+				throw std::runtime_error("write() failed");
+		}
+
+		for (unsigned remaining = n_active; remaining > 0;) {
+			group.ReadEvents(result, -1);
+
+			for (size_t i = 0; i < result.GetSize(); ++i) {
+				auto &c = *(Connection *)result.GetObject(i);
+
+				char buffer[16];
+				if (read(c.fd, buffer, sizeof(buffer)) != 1)
+					throw std::runtime_error("read() failed");
+
+				/* schedule and cancel writing, like
+				   a client sending its response */
+				group.Modify(c.fd, G::READ|G::WRITE, &c);
+				group.Modify(c.fd, G::READ, &c);
+
+				--remaining;
+				++n_events;
+			}
+
+			result.Reset();
+		}
+	}
+
+	const double duration = GetCpuTime() - start;
+	const uint64_t n_syscalls = group.GetSystemCallCount() - start_syscalls;
+
+	printf("connections=%zu active=%u rounds=%u events=%llu\n",
+	       connections.size(), n_active, n_rounds,
+	       (unsigned long long)n_events);
+	printf("poll_syscalls=%llu (%.2f per event) cpu=%.3fs (%.0f ns per event)\n",
+	       (unsigned long long)n_syscalls,
+	       double(n_syscalls) / n_events,
+	       duration, duration * 1e9 / n_events);
+
+	for (auto &c : connections)
+		group.Remove(c.fd);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 5) {
+		fprintf(stderr,
+			"Usage: bench_poll_group epoll|io_uring [CONNECTIONS [ACTIVE [ROUNDS]]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *const backend = argv[1];
+	const unsigned n_connections = argc >= 3 ? strtoul(argv[2], nullptr, 10) : 1000;
+	const unsigned n_active = argc >= 4 ? strtoul(argv[3], nullptr, 10) : 50;
+	const unsigned n_rounds = argc >= 5 ? strtoul(argv[4], nullptr, 10) : 10000;
+
+	if (n_connections == 0 || n_active > n_connections) {
+		fprintf(stderr, "Invalid number of connections\n");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Connection> connections;
+	connections.reserve(n_connections);
+	for (unsigned i = 0; i < n_connections; ++i) {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,
+			       0, sv) < 0)
+			throw std::runtime_error("socketpair() failed");
+
+		connections.push_back({sv[0], sv[1]});
+	}
+
+	if (strcmp(backend, "epoll") == 0)
+		Run<CountingPollGroupEpoll>(connections, n_active, n_rounds);
+#ifdef USE_IO_URING
+	else if (strcmp(backend, "io_uring") == 0)
+		Run<CountingPollGroupUring>(connections, n_active, n_rounds);
+#endif
+	else {
+		fprintf(stderr, "Unsupported backend: %s\n", backend);
+		return EXIT_FAILURE;
+	}
+
+	for (auto &c : connections) {
+		close(c.fd);
+		close(c.peer);
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
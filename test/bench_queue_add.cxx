@@ -0,0 +1,312 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures how fast MPD appends many songs to the
+ * queue.  It reads song URIs (one per line) from standard input,
+ * repeats them until COUNT songs are collected, and then appends
+ * them to the queue of a running MPD twice: once with command lists
+ * of "add" commands, and once with command lists of "addmulti"
+ * commands.  The queue is cleared before each run.
+ *
+ * MPD's "max_playlist_length" must be at least COUNT.
+ *
+ * Example:
+ *
+ *  mpc listall | bench_queue_add localhost 6600 200000
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdexcept>
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Stay well below the default "max_command_list_size" (2 MB).
+ */
+static constexpr size_t MAX_COMMAND_LIST_SIZE = 1024 * 1024;
+
+/**
+ * Stay below MPD's input line length and argument limit.
+ */
+static constexpr size_t MAX_LINE_SIZE = 4096;
+static constexpr unsigned MAX_LINE_ARGS = 200;
+
+static int
+Connect(const char *host, const char *port)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *ai;
+	if (getaddrinfo(host, port, &hints, &ai) != 0)
+		throw std::runtime_error("Failed to resolve host name");
+
+	int fd = -1;
+	for (const auto *i = ai; i != nullptr; i = i->ai_next) {
+		fd = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		if (connect(fd, i->ai_addr, i->ai_addrlen) == 0)
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(ai);
+
+	if (fd < 0)
+		throw std::runtime_error("Failed to connect");
+
+	return fd;
+}
+
+/**
+ * Read one response (until "OK" or "ACK") and return the last line.
+ */
+static std::string
+ReadResponse(int fd)
+{
+	char buffer[4096];
+	std::string line;
+
+	while (true) {
+		ssize_t nbytes = recv(fd, buffer, sizeof(buffer), 0);
+		if (nbytes <= 0)
+			throw std::runtime_error("Connection closed");
+
+		const char *p = buffer, *const end = p + nbytes;
+		while (p < end) {
+			const char *newline = (const char *)
+				memchr(p, '\n', end - p);
+			if (newline == nullptr) {
+				line.append(p, end);
+				break;
+			}
+
+			line.append(p, newline);
+			p = newline + 1;
+
+			if (line == "OK")
+				return line;
+
+			if (line.compare(0, 4, "ACK ") == 0)
+				throw std::runtime_error(line);
+
+			line.clear();
+		}
+	}
+}
+
+static void
+SendAll(int fd, const std::string &data)
+{
+	const char *p = data.data();
+	size_t size = data.size();
+
+	while (size > 0) {
+		ssize_t nbytes = send(fd, p, size, 0);
+		if (nbytes <= 0)
+			throw std::runtime_error("Failed to send");
+
+		p += nbytes;
+		size -= nbytes;
+	}
+}
+
+/**
+ * Send one command list and wait for its response.
+ */
+static void
+SendCommandList(int fd, const std::string &commands)
+{
+	SendAll(fd, "command_list_begin\n" + commands +
+		"command_list_end\n");
+	ReadResponse(fd);
+}
+
+static std::string
+Quote(const std::string &s)
+{
+	std::string result = "\"";
+	for (char ch : s) {
+		if (ch == '"' || ch == '\\')
+			result.push_back('\\');
+		result.push_back(ch);
+	}
+
+	result.push_back('"');
+	return result;
+}
+
+static void
+Clear(int fd)
+{
+	SendAll(fd, "clear\n");
+	ReadResponse(fd);
+}
+
+/**
+ * Append all URIs with one "add" command per song.
+ */
+static void
+RunAdd(int fd, const std::vector<std::string> &uris)
+{
+	std::string commands;
+	for (const auto &uri : uris) {
+		commands += "add ";
+		commands += Quote(uri);
+		commands += "\n";
+
+		if (commands.size() >= MAX_COMMAND_LIST_SIZE) {
+			SendCommandList(fd, commands);
+			commands.clear();
+		}
+	}
+
+	if (!commands.empty())
+		SendCommandList(fd, commands);
+}
+
+/**
+ * Append all URIs with "addmulti" commands carrying many songs each.
+ */
+static void
+RunAddMulti(int fd, const std::vector<std::string> &uris)
+{
+	std::string commands, line;
+	unsigned n_args = 0;
+
+	const auto flush_line = [&](){
+		if (n_args == 0)
+			return;
+
+		commands += "addmulti";
+		commands += line;
+		commands += "\n";
+		line.clear();
+		n_args = 0;
+
+		if (commands.size() >= MAX_COMMAND_LIST_SIZE) {
+			SendCommandList(fd, commands);
+			commands.clear();
+		}
+	};
+
+	for (const auto &uri : uris) {
+		const std::string quoted = Quote(uri);
+		if (n_args >= MAX_LINE_ARGS ||
+		    line.size() + quoted.size() + 1 >= MAX_LINE_SIZE)
+			flush_line();
+
+		line += " ";
+		line += quoted;
+		++n_args;
+	}
+
+	flush_line();
+
+	if (!commands.empty())
+		SendCommandList(fd, commands);
+}
+
+template<typename F>
+static double
+Measure(int fd, const std::vector<std::string> &uris, F &&f)
+{
+	Clear(fd);
+
+	const auto start = std::chrono::steady_clock::now();
+	f(fd, uris);
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	return duration.count();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "Usage: bench_queue_add HOST PORT [COUNT] <URIS\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *const host = argv[1], *const port = argv[2];
+	const unsigned count = argc >= 4
+		? std::max(strtoul(argv[3], nullptr, 10), 1ul)
+		: 200000;
+
+	std::vector<std::string> input;
+	char buffer[4096];
+	while (fgets(buffer, sizeof(buffer), stdin) != nullptr) {
+		size_t length = strlen(buffer);
+		while (length > 0 && (buffer[length - 1] == '\n' ||
+				      buffer[length - 1] == '\r'))
+			--length;
+
+		if (length > 0)
+			input.emplace_back(buffer, length);
+	}
+
+	if (input.empty())
+		throw std::runtime_error("No URIs on standard input");
+
+	std::vector<std::string> uris;
+	uris.reserve(count);
+	for (unsigned i = 0; i < count; ++i)
+		uris.push_back(input[i % input.size()]);
+
+	const int fd = Connect(host, port);
+
+	/* consume the greeting */
+	char greeting[256];
+	if (recv(fd, greeting, sizeof(greeting), 0) <= 0)
+		throw std::runtime_error("No greeting");
+
+	const double add_time = Measure(fd, uris, RunAdd);
+	const double addmulti_time = Measure(fd, uris, RunAddMulti);
+
+	Clear(fd);
+	close(fd);
+
+	printf("songs=%u\n", count);
+	printf("add:      %.3fs (%.0f songs/s)\n",
+	       add_time, count / add_time);
+	printf("addmulti: %.3fs (%.0f songs/s)\n",
+	       addmulti_time, count / addmulti_time);
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
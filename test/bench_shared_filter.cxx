@@ -0,0 +1,224 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the CPU cost of feeding several "null"
+ * audio outputs which need the same conversion, with and without
+ * the #SharedOutputFilter.
+ *
+ * Example: four outputs resampling CD audio to 48 kHz float, first
+ * with a shared filter chain, then with one chain per output:
+ *
+ *  bench_shared_filter 44100:16:2 48000:f:2 4
+ *  bench_shared_filter 44100:16:2 48000:f:2 4 60 noshare
+ */
+
+#include "output/MultipleOutputs.hxx"
+#include "output/Client.hxx"
+#include "mixer/Listener.hxx"
+#include "config/Data.hxx"
+#include "config/Block.hxx"
+#include "config/Param.hxx"
+#include "config/Option.hxx"
+#include "event/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "AudioParser.hxx"
+#include "AudioFormat.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "ReplayGainConfig.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+class DummyMixerListener final : public MixerListener {
+public:
+	void OnMixerVolumeChanged(Mixer &, int) override {}
+};
+
+/**
+ * Wakes up the main thread whenever an output has consumed a chunk.
+ */
+class BenchOutputClient final : public AudioOutputClient {
+	Mutex mutex;
+	Cond cond;
+	bool consumed = false;
+
+public:
+	void Wait() noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+		if (!consumed)
+			cond.timed_wait(mutex, std::chrono::milliseconds(10));
+		consumed = false;
+	}
+
+	/* virtual methods from class AudioOutputClient */
+	void ChunksConsumed() override {
+		const std::lock_guard<Mutex> protect(mutex);
+		consumed = true;
+		cond.signal();
+	}
+
+	void ApplyEnabled() override {}
+};
+
+static double
+GetCpuTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+GetWallTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 3 || argc > 6) {
+		fprintf(stderr,
+			"Usage: bench_shared_filter IN_FORMAT OUT_FORMAT [N_OUTPUTS [SECONDS [noshare]]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto in_audio_format = ParseAudioFormat(argv[1], false);
+	const char *const out_format = argv[2];
+	const unsigned n_outputs = argc >= 4 ? strtoul(argv[3], nullptr, 10) : 4;
+	const unsigned seconds = argc >= 5 ? strtoul(argv[4], nullptr, 10) : 60;
+	const bool share = argc < 6 || strcmp(argv[5], "noshare") != 0;
+
+	if (n_outputs == 0) {
+		fprintf(stderr, "Invalid number of outputs\n");
+		return EXIT_FAILURE;
+	}
+
+	ConfigData config;
+	config.AddParam(ConfigOption::SHARE_OUTPUT_FILTERS,
+			ConfigParam(share ? "yes" : "no"));
+
+	for (unsigned i = 0; i < n_outputs; ++i) {
+		/* a positive line number marks the block as
+		   "configured" */
+		ConfigBlock block(i + 1);
+		block.AddBlockParam("type", "null");
+		block.AddBlockParam("name", "null" + std::to_string(i));
+		block.AddBlockParam("sync", "no");
+		block.AddBlockParam("format", out_format);
+		config.AddBlock(ConfigBlockOption::AUDIO_OUTPUT,
+				std::move(block));
+	}
+
+	EventThread io_thread;
+	io_thread.Start();
+
+	DummyMixerListener mixer_listener;
+	BenchOutputClient client;
+	const ReplayGainConfig replay_gain_config;
+
+	MultipleOutputs outputs(mixer_listener);
+	outputs.Configure(io_thread.GetEventLoop(), config,
+			  replay_gain_config, client);
+
+	const size_t chunk_size = CalculateChunkSize(in_audio_format);
+	MusicBuffer buffer(BUFFER_SIZE / chunk_size, chunk_size);
+
+	const uint64_t total_size = uint64_t(in_audio_format.TimeToSize(std::chrono::seconds(1)))
+		* seconds;
+	const size_t frame_size = in_audio_format.GetFrameSize();
+
+	/* drive the outputs the way the player thread does */
+	PlayerOutputs &player_outputs = outputs;
+	player_outputs.Open(in_audio_format);
+
+	uint64_t remaining = total_size, n_chunks = 0;
+	uint32_t noise = 1;
+
+	const double start = GetCpuTime(), wall_start = GetWallTime();
+
+	while (true) {
+		/* decoder: fill the buffer with noise */
+		while (remaining > 0) {
+			auto chunk = buffer.Allocate();
+			if (chunk == nullptr)
+				break;
+
+			auto w = chunk->Write(in_audio_format,
+					      SongTime::zero(), 0);
+			size_t nbytes = std::min<uint64_t>(w.size, remaining);
+			nbytes -= nbytes % frame_size;
+			if (nbytes == 0)
+				nbytes = frame_size;
+
+			auto *p = (uint8_t *)w.data;
+			for (size_t i = 0; i < nbytes; ++i) {
+				noise = noise * 1103515245 + 12345;
+				p[i] = noise >> 16;
+			}
+
+			chunk->Expand(in_audio_format, nbytes);
+			remaining -= std::min<uint64_t>(nbytes, remaining);
+
+			player_outputs.Play(std::move(chunk));
+			++n_chunks;
+		}
+
+		/* player: return consumed chunks to the buffer */
+		if (player_outputs.CheckPipe() == 0 && remaining == 0)
+			break;
+
+		client.Wait();
+	}
+
+	player_outputs.Drain();
+
+	const double duration = GetCpuTime() - start;
+	const double wall_duration = GetWallTime() - wall_start;
+
+	player_outputs.Close();
+
+	printf("in=%s out=%s outputs=%u shared=%s chunks=%llu\n",
+	       ToString(in_audio_format).c_str(), out_format,
+	       n_outputs, share ? "yes" : "no",
+	       (unsigned long long)n_chunks);
+	printf("cpu=%.3fs wall=%.3fs per_audio_second=%.3fms\n",
+	       duration, wall_duration, duration * 1e3 / seconds);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the cost of re-arming timers, the way MPD
+ * re-arms the idle timeout of a client after each command.  It
+ * compares #TimerEvent (a sorted tree) with #CoarseTimerEvent (a
+ * timing wheel).
+ *
+ * Example: 10000 timers, each re-armed 100 times:
+ *
+ *  bench_timers 10000 100
+ */
+
+#include "event/Loop.hxx"
+#include "event/TimerEvent.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "util/PrintException.hxx"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double
+GetCpuTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Callback {
+	void OnTimer() noexcept {}
+};
+
+template<typename T>
+static void
+Run(const char *name, EventLoop &loop, unsigned n_timers, unsigned n_rounds)
+{
+	Callback callback;
+
+	std::vector<std::unique_ptr<T>> timers;
+	timers.reserve(n_timers);
+	for (unsigned i = 0; i < n_timers; ++i)
+		timers.emplace_back(new T(loop, BIND_METHOD(callback, &Callback::OnTimer)));
+
+	/* timeouts between 10 and 70 seconds, in millisecond
+	   steps */
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<unsigned> dist(10000, 70000);
+
+	std::vector<std::chrono::steady_clock::duration> durations;
+	durations.reserve(n_timers);
+	for (unsigned i = 0; i < n_timers; ++i)
+		durations.emplace_back(std::chrono::milliseconds(dist(rng)));
+
+	/* initial population */
+	for (unsigned i = 0; i < n_timers; ++i)
+		timers[i]->Schedule(durations[i]);
+
+	const double start = GetCpuTime();
+
+	for (unsigned round = 0; round < n_rounds; ++round)
+		for (unsigned i = 0; i < n_timers; ++i)
+			timers[(i * 7919u + round) % n_timers]->Schedule(durations[(i + round) % n_timers]);
+
+	const double duration = GetCpuTime() - start;
+	const uint64_t n = uint64_t(n_timers) * n_rounds;
+
+	printf("%s: timers=%u rearms=%llu cpu=%.3fs (%.1f ns per rearm)\n",
+	       name, n_timers, (unsigned long long)n,
+	       duration, duration * 1e9 / n);
+
+	for (auto &t : timers)
+		t->Cancel();
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 3) {
+		fprintf(stderr, "Usage: bench_timers [TIMERS [ROUNDS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_timers = argc >= 2 ? strtoul(argv[1], nullptr, 10) : 10000;
+	const unsigned n_rounds = argc >= 3 ? strtoul(argv[2], nullptr, 10) : 100;
+
+	if (n_timers == 0) {
+		fprintf(stderr, "Invalid number of timers\n");
+		return EXIT_FAILURE;
+	}
+
+	EventLoop loop;
+
+	Run<TimerEvent>("TimerEvent", loop, n_timers, n_rounds);
+	Run<CoarseTimerEvent>("CoarseTimerEvent", loop, n_timers, n_rounds);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the time it takes #UpdateWalk to scan a
+ * music directory, once from scratch and once more without
+ * modifications (which is dominated by Directory::FindSong() and
+ * Directory::FindChild()) and finally once more, reading all tags
+ * again.
+ *
+ * To benchmark a directory with many files, it can populate the
+ * directory with hard links to one template file:
+ *
+ *  mkdir /tmp/walk
+ *  bench_update_walk /tmp/walk 1 /path/to/template.flac 20000
+ *
+ * The second parameter is the number of update threads.  The
+ * "fingerprint" (a hash of the resulting tree in list order) must
+ * not depend on it.
+ */
+
+#include "config.h"
+#include "db/update/Walk.hxx"
+#include "db/update/Config.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "storage/StorageInterface.hxx"
+#include "storage/plugins/LocalStorage.hxx"
+#include "config/Data.hxx"
+#include "config/Param.hxx"
+#include "config/Option.hxx"
+#include "event/Thread.hxx"
+#include "decoder/DecoderList.hxx"
+#include "input/Init.hxx"
+#include "fs/Path.hxx"
+#include "LogBackend.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/PrintException.hxx"
+
+#include <chrono>
+#include <memory>
+
+#include <stdint.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() override {}
+	void OnDatabaseSongRemoved(const char *) override {}
+};
+
+static void
+Populate(const char *directory, const char *template_path, unsigned n)
+{
+	const char *suffix = strrchr(template_path, '.');
+	if (suffix == nullptr)
+		suffix = "";
+
+	for (unsigned i = 0; i < n; ++i) {
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/%06u%s",
+			 directory, i, suffix);
+		if (link(template_path, path) < 0 && errno != EEXIST) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static unsigned
+CountSongs(const Directory &directory) noexcept
+{
+	unsigned n = 0;
+	for (const auto &song : directory.songs) {
+		(void)song;
+		++n;
+	}
+
+	for (const auto &child : directory.children)
+		n += CountSongs(child);
+
+	return n;
+}
+
+static uint64_t
+Fingerprint(uint64_t hash, const char *s) noexcept
+{
+	/* FNV-1a */
+	do {
+		hash = (hash ^ (unsigned char)*s) * 0x100000001b3ULL;
+	} while (*s++ != 0);
+
+	return hash;
+}
+
+static uint64_t
+Fingerprint(uint64_t hash, const Directory &directory) noexcept
+{
+	hash = Fingerprint(hash, directory.GetPath());
+
+	for (const auto &song : directory.songs) {
+		hash = Fingerprint(hash, song.uri);
+		for (const auto &item : song.tag)
+			hash = Fingerprint(hash, item.value);
+	}
+
+	for (const auto &child : directory.children)
+		hash = Fingerprint(hash, child);
+
+	return hash;
+}
+
+static void
+TimeWalk(UpdateWalk &walk, Directory &root, bool discard,
+	 const char *label)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const bool modified = walk.Walk(root, nullptr, discard);
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	unsigned n_songs;
+	uint64_t fingerprint;
+	{
+		const ScopeDatabaseLock protect;
+		n_songs = CountSongs(root);
+		fingerprint = Fingerprint(0xcbf29ce484222325ULL, root);
+	}
+
+	printf("%s: %.3fs modified=%d songs=%u fingerprint=%016llx\n",
+	       label, duration.count(), modified, n_songs,
+	       (unsigned long long)fingerprint);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc != 2 && argc != 3 && argc != 5) {
+		fprintf(stderr,
+			"Usage: bench_update_walk DIRECTORY [THREADS [TEMPLATE COUNT]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *const directory = argv[1];
+
+	SetLogThreshold(LogLevel::WARNING);
+
+	if (argc == 5)
+		Populate(directory, argv[3], strtoul(argv[4], nullptr, 10));
+
+	ConfigData config;
+	if (argc >= 3)
+		config.AddParam(ConfigOption::UPDATE_THREADS,
+				ConfigParam(argv[2]));
+
+	EventThread io_thread;
+	io_thread.Start();
+
+	input_stream_global_init(config, io_thread.GetEventLoop());
+	AtScopeExit() { input_stream_global_finish(); };
+
+	decoder_plugin_init_all(config);
+	AtScopeExit() { decoder_plugin_deinit_all(); };
+
+	const auto storage = CreateLocalStorage(Path::FromFS(directory));
+
+	NullDatabaseListener listener;
+	UpdateWalk walk(UpdateConfig(config), io_thread.GetEventLoop(),
+			listener, *storage);
+
+	std::unique_ptr<Directory> root(Directory::NewRoot());
+
+	TimeWalk(walk, *root, false, "initial");
+	TimeWalk(walk, *root, false, "unmodified");
+	TimeWalk(walk, *root, true, "rescan");
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "test_pcm_util.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+/**
+ * Converts DSD with the dsd2pcm library, as reference for #PcmDsd.
+ */
+class ReferenceDsd {
+	std::array<dsd2pcm_ctx *, MAX_CHANNELS> ctx;
+
+public:
+	ReferenceDsd() noexcept {
+		for (auto &i : ctx)
+			i = dsd2pcm_init();
+	}
+
+	~ReferenceDsd() noexcept {
+		for (auto i : ctx)
+			dsd2pcm_destroy(i);
+	}
+
+	void Reset() noexcept {
+		for (auto i : ctx)
+			dsd2pcm_reset(i);
+	}
+
+	std::vector<float> ToFloat(unsigned channels,
+				   ConstBuffer<uint8_t> src) noexcept {
+		const size_t num_frames = src.size / channels;
+		std::vector<float> dest(src.size);
+		for (unsigned c = 0; c < channels; ++c)
+			dsd2pcm_translate(ctx[c], num_frames,
+					  src.data + c, channels,
+					  false, &dest[c], channels);
+		return dest;
+	}
+};
+
+/**
+ * Feed random DSD data with varying buffer sizes to #PcmDsd and to
+ * dsd2pcm and compare the results.
+ */
+static void
+TestDsdToFloat(unsigned channels, unsigned threads)
+{
+	/* the sizes include buffers shorter than PcmDsd::HISTORY and
+	   buffers which are large enough to be split among threads */
+	static constexpr size_t chunk_frames[] = {
+		1, 3, 4096, 7, 11, 12, 30000, 2, 10, 9000, 1,
+	};
+
+	RandomInt<uint8_t> random;
+
+	PcmDsd dsd;
+	dsd.SetThreads(threads);
+
+	ReferenceDsd reference;
+
+	for (unsigned pass = 0; pass < 2; ++pass) {
+		for (const size_t frames : chunk_frames) {
+			std::vector<uint8_t> src(frames * channels);
+			for (auto &i : src)
+				i = random();
+
+			const ConstBuffer<uint8_t> s(src.data(), src.size());
+			const auto expected = reference.ToFloat(channels, s);
+			const auto result = dsd.ToFloat(channels, s);
+			ASSERT_EQ(expected.size(), result.size);
+
+			/* the table-driven implementation is
+			   bit-exact */
+			for (size_t i = 0; i < expected.size(); ++i)
+				ASSERT_EQ(expected[i], result[i]);
+		}
+
+		/* the second pass verifies Reset() */
+		dsd.Reset();
+		reference.Reset();
+	}
+}
+
+TEST(PcmTest, DsdToFloatMono)
+{
+	TestDsdToFloat(1, 1);
+}
+
+TEST(PcmTest, DsdToFloatStereo)
+{
+	TestDsdToFloat(2, 1);
+}
+
+TEST(PcmTest, DsdToFloatMultiChannel)
+{
+	TestDsdToFloat(6, 1);
+}
+
+TEST(PcmTest, DsdToFloatThreads)
+{
+	TestDsdToFloat(2, 3);
+	TestDsdToFloat(6, 4);
+}
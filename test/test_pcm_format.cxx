@@ -159,3 +159,58 @@ TEST(PcmTest, FormatFloat32)
 	for (size_t i = 4; i < N; ++i)
 		EXPECT_NEAR(src[i], d[i], error);
 }
+
+template<typename D, typename S, typename G=RandomInt<S>>
+static void
+TestConvertKernel(void (*PcmKernels::*kernel)(D *, const S *, size_t),
+		  G g=G())
+{
+	constexpr size_t N = 509;
+	auto src = TestDataBuffer<S, N>(g);
+
+	ForEachOptimizedPcmKernels([&](const PcmKernels &kernels){
+			AssertKernelBitExact(kernels.*kernel,
+					     pcm_kernels_portable.*kernel,
+					     src.begin(), N);
+		});
+}
+
+/**
+ * Random floats, with some values out of range and some exactly at
+ * the limits to check clamping.
+ */
+struct RandomFloatClamp : RandomFloat {
+	unsigned n = 0;
+
+	float operator()() {
+		static constexpr float special[] = {
+			1, -1, 1.01, -1.01, 10, -10, 0.99999994, -0.99999994,
+		};
+
+		float value = RandomFloat::operator()();
+		if (++n % 5 == 0)
+			value = special[(n / 5) % 8];
+		return value;
+	}
+};
+
+TEST(PcmTest, FormatKernels)
+{
+	TestConvertKernel<int16_t, float>(&PcmKernels::float_to_16,
+					  RandomFloatClamp());
+	TestConvertKernel<int32_t, float>(&PcmKernels::float_to_24,
+					  RandomFloatClamp());
+	TestConvertKernel<int32_t, float>(&PcmKernels::float_to_32,
+					  RandomFloatClamp());
+
+	TestConvertKernel<float, int16_t>(&PcmKernels::s16_to_float);
+	TestConvertKernel<float, int32_t>(&PcmKernels::s24_to_float,
+					  RandomInt24());
+	TestConvertKernel<float, int32_t>(&PcmKernels::s32_to_float);
+
+	TestConvertKernel<int32_t, int16_t>(&PcmKernels::s16_to_24);
+	TestConvertKernel<int32_t, int16_t>(&PcmKernels::s16_to_32);
+	TestConvertKernel<int32_t, int32_t>(&PcmKernels::s24_to_32,
+					    RandomInt24());
+	TestConvertKernel<int32_t, int32_t>(&PcmKernels::s32_to_24);
+}
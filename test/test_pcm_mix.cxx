@@ -81,3 +81,42 @@ TEST(PcmTest, Mix32)
 {
 	TestPcmMix<int32_t, SampleFormat::S32>();
 }
+
+template<typename T, typename G=RandomInt<T>>
+static void
+TestAddKernel(void (*PcmKernels::*kernel)(T *, const T *, size_t),
+	      G g=G())
+{
+	constexpr unsigned N = 509;
+	const auto a = TestDataBuffer<T, N>(g);
+	const auto b = TestDataBuffer<T, N>(g);
+
+	ForEachOptimizedPcmKernels([&](const PcmKernels &kernels){
+			AssertInPlaceKernelBitExact(kernels.*kernel,
+						    pcm_kernels_portable.*kernel,
+						    a.begin(), b.begin(), N);
+		});
+}
+
+TEST(PcmTest, AddKernels)
+{
+	TestAddKernel<int16_t>(&PcmKernels::add_16);
+	TestAddKernel<int32_t>(&PcmKernels::add_24, RandomInt24());
+	TestAddKernel<int32_t>(&PcmKernels::add_32);
+	TestAddKernel<float>(&PcmKernels::add_float, RandomFloat());
+}
+
+TEST(PcmTest, AddVolumeFloatKernels)
+{
+	constexpr unsigned N = 509;
+	const auto a = TestDataBuffer<float, N>(RandomFloat());
+	const auto b = TestDataBuffer<float, N>(RandomFloat());
+
+	ForEachOptimizedPcmKernels([&](const PcmKernels &kernels){
+			for (float volume : {0.f, 0.25f, 0.5f, 0.9f})
+				AssertInPlaceKernelBitExact(kernels.add_volume_float,
+							    pcm_kernels_portable.add_volume_float,
+							    a.begin(), b.begin(), N,
+							    volume, 1.f - volume);
+		});
+}
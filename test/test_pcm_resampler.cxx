@@ -0,0 +1,211 @@
+/*
+ * Copyright 2003-2018 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "test_pcm_util.hxx"
+#include "pcm/FirResampler.hxx"
+#include "pcm/Kernels.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <math.h>
+
+TEST(PcmTest, DotFloatKernels)
+{
+	constexpr unsigned N = 509;
+	const auto a = TestDataBuffer<float, N>(RandomFloat());
+	const auto b = TestDataBuffer<float, N>(RandomFloat());
+
+	auto check = [&](const PcmKernels &kernels){
+		for (size_t offset : {0, 1, 3})
+			for (size_t n : {0, 1, 7, 8, 15, 16, 64, 500}) {
+				double expected = 0;
+				for (size_t i = 0; i < n; ++i)
+					expected += double(a.begin()[offset + i]) *
+						b.begin()[offset + i];
+
+				EXPECT_NEAR(expected,
+					    kernels.dot_float(a.begin() + offset,
+							      b.begin() + offset,
+							      n),
+					    1e-4);
+			}
+	};
+
+	check(pcm_kernels_portable);
+	ForEachOptimizedPcmKernels(check);
+}
+
+static std::vector<float>
+GenerateSine(unsigned sample_rate, unsigned channels,
+	     double frequency, size_t n_frames)
+{
+	std::vector<float> result;
+	result.reserve(n_frames * channels);
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		const double value = 0.5 * sin(2 * M_PI * frequency * i / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			/* invert the second channel to tell them apart */
+			result.push_back(c % 2 == 0 ? value : -value);
+	}
+
+	return result;
+}
+
+/**
+ * Feed the input into a #FirPcmResampler in chunks of irregular
+ * size, flush it and return the whole output.
+ */
+static std::vector<float>
+Resample(FirResamplerQuality quality, AudioFormat format,
+	 unsigned out_rate, const std::vector<float> &src,
+	 std::initializer_list<size_t> chunk_frames)
+{
+	FirPcmResampler resampler(quality);
+	const auto out_format = resampler.Open(format, out_rate);
+	EXPECT_EQ(SampleFormat::FLOAT, format.format);
+	EXPECT_EQ(out_rate, out_format.sample_rate);
+
+	std::vector<float> result;
+	auto append = [&result](ConstBuffer<void> b){
+		const auto f = ConstBuffer<float>::FromVoid(b);
+		result.insert(result.end(), f.begin(), f.end());
+	};
+
+	const size_t n_frames = src.size() / format.channels;
+	auto chunk = chunk_frames.begin();
+	for (size_t position = 0; position < n_frames;) {
+		const size_t n = std::min(*chunk, n_frames - position);
+		if (++chunk == chunk_frames.end())
+			chunk = chunk_frames.begin();
+
+		append(resampler.Resample({&src[position * format.channels],
+						  n * format.channels * sizeof(float)}));
+		position += n;
+	}
+
+	while (true) {
+		auto b = resampler.Flush();
+		if (b.IsNull())
+			break;
+		append(b);
+	}
+
+	resampler.Close();
+	return result;
+}
+
+/**
+ * Resample a sine wave and compare the output with the ideal sine
+ * at the new sample rate, skipping the edges where the filter sees
+ * the start and end of the signal.
+ */
+static void
+TestSine(FirResamplerQuality quality, unsigned in_rate, unsigned out_rate,
+	 unsigned channels, double frequency, double tolerance)
+{
+	const size_t n_frames = in_rate / 4;
+	const auto src = GenerateSine(in_rate, channels, frequency, n_frames);
+	const auto dest = Resample(quality,
+				   AudioFormat(in_rate, SampleFormat::S16,
+					       channels),
+				   out_rate, src, {4096, 1, 333, 17, 10000});
+
+	const size_t expected_frames = uint64_t(n_frames) * out_rate / in_rate;
+	const size_t out_frames = dest.size() / channels;
+	EXPECT_EQ(0u, dest.size() % channels);
+	EXPECT_NEAR(double(expected_frames), double(out_frames), 2);
+
+	const auto expected = GenerateSine(out_rate, channels, frequency,
+					   out_frames);
+	const size_t skip = out_rate / 100;
+	ASSERT_GT(out_frames, 2 * skip);
+
+	double max_error = 0;
+	for (size_t i = skip * channels; i < (out_frames - skip) * channels; ++i)
+		max_error = std::max(max_error,
+				     fabs(double(dest[i]) - expected[i]));
+
+	EXPECT_LT(max_error, tolerance);
+}
+
+TEST(PcmTest, FirResamplerUp)
+{
+	TestSine(FirResamplerQuality::HIGH, 44100, 48000, 2, 1000, 1e-4);
+	TestSine(FirResamplerQuality::HIGH, 44100, 96000, 1, 15000, 1e-4);
+	TestSine(FirResamplerQuality::VERY_HIGH, 48000, 192000, 2, 5000, 1e-5);
+	TestSine(FirResamplerQuality::LOW, 44100, 48000, 2, 1000, 1e-3);
+}
+
+TEST(PcmTest, FirResamplerDown)
+{
+	TestSine(FirResamplerQuality::HIGH, 48000, 44100, 2, 1000, 1e-4);
+	TestSine(FirResamplerQuality::HIGH, 96000, 44100, 6, 15000, 1e-4);
+	TestSine(FirResamplerQuality::MEDIUM, 192000, 48000, 1, 3000, 1e-3);
+}
+
+TEST(PcmTest, FirResamplerInterpolated)
+{
+	/* the reduced ratio 44101/44100 is too large for an exact
+	   table */
+	TestSine(FirResamplerQuality::HIGH, 44100, 44101, 2, 1000, 1e-4);
+	TestSine(FirResamplerQuality::HIGH, 48000, 44099, 1, 5000, 1e-4);
+}
+
+/**
+ * Frequencies above the new Nyquist frequency must be removed when
+ * downsampling.
+ */
+TEST(PcmTest, FirResamplerAliasing)
+{
+	const unsigned in_rate = 96000, out_rate = 44100;
+	const auto src = GenerateSine(in_rate, 1, 30000, in_rate / 4);
+	const auto dest = Resample(FirResamplerQuality::HIGH,
+				   AudioFormat(in_rate, SampleFormat::FLOAT, 1),
+				   out_rate, src, {8192});
+
+	double max = 0;
+	for (size_t i = out_rate / 100; i < dest.size() - out_rate / 100; ++i)
+		max = std::max(max, fabs(double(dest[i])));
+
+	/* at least 100 dB below the input level */
+	EXPECT_LT(max, 0.5 * 1e-5);
+}
+
+/**
+ * The output must not depend on how the input is split into
+ * chunks.
+ */
+TEST(PcmTest, FirResamplerChunks)
+{
+	const AudioFormat format(44100, SampleFormat::FLOAT, 2);
+	std::vector<float> src;
+	RandomFloat r;
+	for (unsigned i = 0; i < 20000 * format.channels; ++i)
+		src.push_back(r());
+
+	const auto a = Resample(FirResamplerQuality::MEDIUM, format, 48000,
+				src, {src.size()});
+	const auto b = Resample(FirResamplerQuality::MEDIUM, format, 48000,
+				src, {1, 2, 100, 3, 4097});
+	EXPECT_EQ(a, b);
+}
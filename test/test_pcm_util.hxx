@@ -17,15 +17,19 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "pcm/Kernels.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
 #include <random>
+#include <vector>
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 template<typename T>
 struct RandomInt {
@@ -105,3 +109,76 @@ AssertEqualWithTolerance(const T &a, const T &b, unsigned tolerance)
 
 	return true;
 }
+
+/**
+ * Invoke the given function for each optimized #PcmKernels table
+ * supported by this CPU.
+ */
+template<typename F>
+void
+ForEachOptimizedPcmKernels(F &&f)
+{
+	for (auto level : {PcmKernelLevel::SSE2, PcmKernelLevel::AVX2,
+			   PcmKernelLevel::NEON}) {
+		const auto *kernels = GetPcmKernels(level);
+		if (kernels != nullptr) {
+			SCOPED_TRACE(unsigned(level));
+			f(*kernels);
+		}
+	}
+}
+
+/**
+ * Call the given member of an optimized #PcmKernels table and of
+ * the portable one with the same input, and expect bit-exactly the
+ * same output.  Several lengths and offsets are tried to cover the
+ * scalar tail and unaligned buffers.
+ */
+template<typename D, typename S, typename... Args>
+void
+AssertKernelBitExact(void (*optimized)(D *, const S *, size_t, Args...),
+		     void (*portable)(D *, const S *, size_t, Args...),
+		     const S *src, size_t n, Args... args)
+{
+	std::vector<D> a(n), b(n);
+
+	for (size_t offset = 0; offset < 4 && offset < n; ++offset) {
+		for (size_t length : {n - offset, (n - offset) / 2, size_t(7)}) {
+			length = std::min(length, n - offset);
+
+			std::fill(a.begin(), a.end(), D());
+			std::fill(b.begin(), b.end(), D());
+			optimized(a.data() + offset, src + offset, length,
+				  args...);
+			portable(b.data() + offset, src + offset, length,
+				 args...);
+			ASSERT_EQ(0, memcmp(a.data(), b.data(),
+					    n * sizeof(D)));
+		}
+	}
+}
+
+/**
+ * Like AssertKernelBitExact(), but for kernels which modify their
+ * first argument in place (i.e. the mixers).
+ */
+template<typename T, typename... Args>
+void
+AssertInPlaceKernelBitExact(void (*optimized)(T *, const T *, size_t, Args...),
+			    void (*portable)(T *, const T *, size_t, Args...),
+			    const T *a, const T *b, size_t n, Args... args)
+{
+	for (size_t offset = 0; offset < 4 && offset < n; ++offset) {
+		for (size_t length : {n - offset, (n - offset) / 2, size_t(7)}) {
+			length = std::min(length, n - offset);
+
+			std::vector<T> x(a, a + n), y(a, a + n);
+			optimized(x.data() + offset, b + offset, length,
+				  args...);
+			portable(y.data() + offset, b + offset, length,
+				 args...);
+			ASSERT_EQ(0, memcmp(x.data(), y.data(),
+					    n * sizeof(T)));
+		}
+	}
+}
@@ -117,3 +117,16 @@ TEST(PcmTest, VolumeFloat)
 
 	pv.Close();
 }
+
+TEST(PcmTest, VolumeFloatKernels)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<float, N>(RandomFloat());
+
+	ForEachOptimizedPcmKernels([&src](const PcmKernels &kernels){
+			for (float volume : {0.f, 0.3f, 1.f, 1.7f})
+				AssertKernelBitExact(kernels.volume_float,
+						     pcm_kernels_portable.volume_float,
+						     src.begin(), N, volume);
+		});
+}
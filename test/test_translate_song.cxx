@@ -116,6 +116,13 @@ DatabaseDetachSong(gcc_unused const Database &db,
 	throw std::runtime_error("No such song");
 }
 
+DetachedSong
+DatabaseDetachSong(gcc_unused const Storage *_storage,
+		   gcc_unused const LightSong &song)
+{
+	throw std::runtime_error("Not implemented");
+}
+
 bool
 DetachedSong::LoadFile(Path path) noexcept
 {